@@ -3,6 +3,10 @@
 #define PTE_P 0x001      // Present
 #define PTE_W 0x002      // Writeable
 #define PTE_U 0x004      // User
+#define PTE_PWT 0x008    // Write-through
+#define PTE_PCD 0x010    // Cache disabled (device registers)
+#define PTE_A 0x020      // Accessed (set by the MMU)
+#define PTE_D 0x040      // Dirty (set by the MMU on write)
 
 #define PTE_USER (PTE_U | PTE_W | PTE_P)
 
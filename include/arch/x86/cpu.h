@@ -25,6 +25,19 @@
 #define FL_VIP 0x00100000        // Virtual Interrupt Pending
 #define FL_ID 0x00200000         // ID flag
 
+/* CPUID leaf 1 feature bits (EDX) */
+#define CPUID_FEAT_EDX_TSC  (1 << 4)   // Time Stamp Counter
+#define CPUID_FEAT_EDX_SSE  (1 << 25)  // SSE
+#define CPUID_FEAT_EDX_SSE2 (1 << 26)  // SSE2 (movnti)
+
+// Feature bits detected by cpu_init()
+extern uint32_t cpu_feature_edx;
+
+#define cpu_has(feature) (cpu_feature_edx & (feature))
+
+void cpu_init(void);
+
+static inline void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) __attribute__((always_inline));
 static inline void sti(void) __attribute__((always_inline));
 static inline void cli(void) __attribute__((always_inline));
 
@@ -35,3 +48,9 @@ static inline void sti(void) {
 static inline void cli(void) {
     asm volatile("cli" ::: "memory");
 }
+
+static inline void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
+    asm volatile("cpuid"
+                 : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                 : "a"(leaf), "c"(0));
+}
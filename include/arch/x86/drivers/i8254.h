@@ -13,6 +13,14 @@
 #define PIT_BINARY 0x00  // 二进制计数器
 #define PIT_BCD    0x01  // BCD（Binary-Coded Decimal）计数器
 
+#define PIT_ONESHOT   0x00  // mode 0: output goes high at terminal count
 #define PIT_RATE_GEN  0x04
 
-#define PIT_16BIT     0x30
\ No newline at end of file
+#define PIT_16BIT     0x30
+
+// System control port B: bit 0 gates timer 2, bit 1 drives the speaker,
+// bit 5 reads timer 2 output
+#define PIT_CTRL_PORTB  0x61
+#define PIT_PORTB_GATE2 0x01
+#define PIT_PORTB_SPKR  0x02
+#define PIT_PORTB_OUT2  0x20
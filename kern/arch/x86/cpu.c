@@ -0,0 +1,27 @@
+#include <arch/x86/cpu.h>
+
+#include "stdio.h"
+#include "memory.h"
+
+uint32_t cpu_feature_edx = 0;
+
+// clear_page() uses non-temporal stores when SSE2 is available
+int clear_page_nt = 0;
+
+/* cpu_init - detect CPU features used by the kernel fast paths */
+void cpu_init(void) {
+    uint32_t max_leaf, ebx, ecx, edx;
+    cpuid(0, &max_leaf, &ebx, &ecx, &edx);
+
+    if (max_leaf >= 1) {
+        uint32_t eax;
+        cpuid(1, &eax, &ebx, &ecx, &cpu_feature_edx);
+    }
+
+    clear_page_nt = cpu_has(CPUID_FEAT_EDX_SSE2) ? 1 : 0;
+
+    cprintf("cpu: tsc=%d sse=%d sse2=%d\n",
+            cpu_has(CPUID_FEAT_EDX_TSC) ? 1 : 0,
+            cpu_has(CPUID_FEAT_EDX_SSE) ? 1 : 0,
+            cpu_has(CPUID_FEAT_EDX_SSE2) ? 1 : 0);
+}
@@ -3,8 +3,19 @@
 #include "stdio.h"
 #include "../mm/vmm.h"
 #include "../mm/swap_test.h"
+#include "../mm/mm_bench.h"
+#include "../mm/pmm.h"
+#include "../mm/slab.h"
+#include "../mm/swap.h"
+#include "../mm/kswapd.h"
 #include "../drivers/hd.h"
 #include "../drivers/blk.h"
+#include "../drivers/pci.h"
+#include "../drivers/ahci.h"
+#include "../drivers/virtio_blk.h"
+#include "../drivers/bcache.h"
+#include "../drivers/bio.h"
+#include "../drivers/md.h"
 #include "../sched/sched.h"
 
 #include <base/types.h>
@@ -17,6 +28,9 @@
 static char cmd_buffer[CMD_BUF_SIZE];
 static int cmd_pos = 0;
 
+// Arguments of the running command: the text after its name, spaces skipped
+static const char *cmd_args = "";
+
 typedef struct {
     const char *name;
     const char *desc;
@@ -25,6 +39,7 @@ typedef struct {
 
 // Forward declarations
 static int strncmp(const char *s1, const char *s2, size_t n);
+static int parse_int(const char *s, int *val);
 
 // Command implementations
 static void cmd_help(void) {
@@ -82,15 +97,79 @@ static void cmd_hdparm(void) {
                dev->info.size, dev->info.size / 2048);
         cprintf("  CHS: %d cylinders, %d heads, %d sectors/track\n", 
                dev->info.cylinders, dev->info.heads, dev->info.sectors);
+        cprintf("  Multiple sector mode: %d sectors per block\n", dev->multiple);
+        cprintf("  Bus-master DMA: %s\n", dev->dma ? "yes" : "no");
         cprintf("\n");
     }
 }
 
+static void cmd_ahcibench(void) {
+    ahci_bench();
+}
+
+static void cmd_vblkbench(void) {
+    virtio_blk_bench();
+}
+
+static void cmd_bcacheinfo(void) {
+    bcache_print_info();
+}
+
+static void cmd_bcachebench(void) {
+    bcache_bench();
+}
+
+// iosched                  list request queues and their schedulers
+// iosched <dev> <sched>    switch a device to noop, deadline or clook
+static void cmd_iosched(void) {
+    char name[IDE_NAME_LEN];
+    const char *p = cmd_args;
+    int n = 0;
+
+    if (*p == '\0') {
+        blk_print_queues();
+        return;
+    }
+
+    while (*p != '\0' && *p != ' ' && n < IDE_NAME_LEN - 1) {
+        name[n++] = *p++;
+    }
+    name[n] = '\0';
+    while (*p == ' ') p++;
+
+    block_device_t *dev = blk_get_device_by_name(name);
+    if (dev == NULL) {
+        cprintf("iosched: no device %s\n", name);
+        return;
+    }
+    if (blk_set_scheduler(dev, p) != 0) {
+        cprintf("iosched: unknown scheduler '%s'\n", p);
+        return;
+    }
+    cprintf("iosched: %s now uses %s\n", name, p);
+}
+
+static void cmd_ioschedbench(void) {
+    iosched_bench();
+}
+
+static void cmd_lspci(void) {
+    pci_list_devices();
+}
+
 static void cmd_disktest(void) {
     cprintf("Running disk test...\n");
     hd_test();
 }
 
+static void cmd_hdbench(void) {
+    hd_bench();
+}
+
+static void cmd_hdstream(void) {
+    hd_stream_bench();
+}
+
 static void cmd_dd(void) {
     cprintf("dd - disk read/write utility\n");
     cprintf("Usage: Use disktest for basic disk I/O testing\n");
@@ -113,6 +192,117 @@ static void cmd_ps(void) {
     print_all_procs();
 }
 
+static void cmd_slabinfo(void) {
+    slab_print_info();
+}
+
+static void cmd_pmmbench(void) {
+    pmm_bench();
+}
+
+static void cmd_meminfo(void) {
+    pmm_print_info();
+}
+
+static void cmd_pcpbench(void) {
+    pcp_bench();
+}
+
+static void cmd_zerobench(void) {
+    zero_bench();
+}
+
+static void cmd_membench(void) {
+    mem_bench();
+}
+
+static void cmd_rmapbench(void) {
+    rmap_bench();
+}
+
+static void cmd_swapbench(void) {
+    swap_bench();
+}
+
+static void cmd_zipfbench(void) {
+    zipf_bench();
+}
+
+static void cmd_vmstat(void) {
+    vmstat_print();
+}
+
+static void cmd_swapinfo(void) {
+    swap_print_info();
+}
+
+// swapon               list swap areas with usage and throughput
+// swapon <dev> [prio]  add a disk as a swap area
+static void cmd_swapon(void) {
+    char name[IDE_NAME_LEN];
+    const char *p = cmd_args;
+    int n = 0, prio = 0;
+
+    if (*p == '\0') {
+        swap_print_areas();
+        return;
+    }
+
+    while (*p != '\0' && *p != ' ' && n < IDE_NAME_LEN - 1) {
+        name[n++] = *p++;
+    }
+    name[n] = '\0';
+    while (*p == ' ') p++;
+
+    if (*p != '\0' && parse_int(p, &prio) != 0) {
+        cprintf("usage: swapon [device [priority]]\n");
+        return;
+    }
+    swapon(name, prio);
+}
+
+// md                            list md arrays
+// md <chunk KB> <dev> <dev>...  stripe disks into a new RAID-0 array
+static void cmd_md(void) {
+    char names[MD_MAX_MEMBERS][IDE_NAME_LEN];
+    const char *members[MD_MAX_MEMBERS];
+    const char *p = cmd_args;
+    int chunk_kb, n = 0;
+
+    if (*p == '\0') {
+        md_print_arrays();
+        return;
+    }
+
+    if (parse_int(p, &chunk_kb) != 0) {
+        cprintf("usage: md [chunk-KB device device...]\n");
+        return;
+    }
+    while (*p != '\0' && *p != ' ') p++;
+    while (*p == ' ') p++;
+
+    while (*p != '\0') {
+        int len = 0;
+        if (n == MD_MAX_MEMBERS) {
+            cprintf("md: at most %d members\n", MD_MAX_MEMBERS);
+            return;
+        }
+        while (*p != '\0' && *p != ' ' && len < IDE_NAME_LEN - 1) {
+            names[n][len++] = *p++;
+        }
+        names[n][len] = '\0';
+        members[n] = names[n];
+        n++;
+        while (*p != '\0' && *p != ' ') p++;
+        while (*p == ' ') p++;
+    }
+    md_create(chunk_kb, members, n);
+}
+
+static void cmd_mdbench(void) {
+    md_bench();
+}
+
 // Command table
 shell_cmd_t commands[] = {
     {"help",     "Show this help message", cmd_help},
@@ -123,9 +313,32 @@ shell_cmd_t commands[] = {
     {"hdparm",   "Show disk information", cmd_hdparm},
     {"disktest", "Test disk read/write", cmd_disktest},
     {"dd",       "Disk dump/copy (info only)", cmd_dd},
+    {"hdbench",  "Benchmark disk I/O: PIO vs DMA, polled vs interrupts, transfer sizes", cmd_hdbench},
+    {"hdstream", "Benchmark reads from hdb and hdc at once against one channel", cmd_hdstream},
+    {"lspci",    "List PCI devices", cmd_lspci},
+    {"ahcibench", "Benchmark AHCI random reads across NCQ queue depths", cmd_ahcibench},
+    {"vblkbench", "Benchmark virtio-blk against the IDE disk", cmd_vblkbench},
+    {"bcacheinfo", "Show buffer cache statistics", cmd_bcacheinfo},
+    {"bcachebench", "Benchmark the buffer cache with repeated block access patterns", cmd_bcachebench},
+    {"iosched",  "List request queues, or set one: iosched <dev> <noop|deadline|clook>", cmd_iosched},
+    {"ioschedbench", "Benchmark random swap I/O under each I/O scheduler", cmd_ioschedbench},
+    {"md",       "List md arrays, or create one: md <chunk KB> <dev> <dev>...", cmd_md},
+    {"mdbench",  "Benchmark sequential reads from md0 against one member disk", cmd_mdbench},
     {"uname -a", "Print all system information", cmd_uname_a},
     {"uname",    "Print system information", cmd_uname},
     {"ps",       "List all processes", cmd_ps},
+    {"slabinfo", "Show slab cache utilisation", cmd_slabinfo},
+    {"meminfo",  "Show physical memory statistics", cmd_meminfo},
+    {"swapinfo", "Show swap slot usage and fragmentation", cmd_swapinfo},
+    {"swapon",   "List swap areas, or add one: swapon <dev> [prio]", cmd_swapon},
+    {"vmstat",   "Show watermarks and reclaim statistics", cmd_vmstat},
+    {"pmmbench", "Benchmark page allocators", cmd_pmmbench},
+    {"pcpbench", "Benchmark the per-CPU page cache", cmd_pcpbench},
+    {"zerobench", "Benchmark faults with the zeroed page pool", cmd_zerobench},
+    {"membench", "Benchmark memset/memcpy and clear_page", cmd_membench},
+    {"rmapbench", "Benchmark swap-out with reverse mapping", cmd_rmapbench},
+    {"swapbench", "Benchmark paging with clustering and readahead", cmd_swapbench},
+    {"zipfbench", "Compare replacement policies on a Zipf trace", cmd_zipfbench},
 };
 
 int command_count = sizeof(commands) / sizeof(shell_cmd_t);
@@ -146,6 +359,8 @@ static void execute_command(const char *cmd) {
         
         if (strncmp(cmd, commands[i].name, len) == 0 &&
             (cmd[len] == '\0' || cmd[len] == ' ')) {
+            cmd_args = cmd + len;
+            while (*cmd_args == ' ') cmd_args++;
             commands[i].func();
             return;
         }
@@ -168,6 +383,27 @@ static int strncmp(const char *s1, const char *s2, size_t n) {
     return (*(unsigned char *)s1 - *(unsigned char *)s2);
 }
 
+// Decimal integer with optional sign, up to the end of the string or a space
+static int parse_int(const char *s, int *val) {
+    int neg = 0, v = 0;
+
+    if (*s == '-') {
+        neg = 1;
+        s++;
+    }
+    if (*s < '0' || *s > '9') {
+        return -1;
+    }
+    while (*s >= '0' && *s <= '9') {
+        v = v * 10 + (*s++ - '0');
+    }
+    if (*s != '\0' && *s != ' ') {
+        return -1;
+    }
+    *val = neg ? -v : v;
+    return 0;
+}
+
 void shell_prompt(void) {
     cprintf("zonix> ");
 }
@@ -0,0 +1,692 @@
+#include "ahci.h"
+#include "stdio.h"
+#include "math.h"
+#include "memory.h"
+
+#include <arch/x86/io.h>
+#include <arch/x86/cpu.h>
+#include <arch/x86/mmu.h>
+#include "pci.h"
+#include "pic.h"
+#include "pit.h"
+#include "intr.h"
+#include "../sched/sched.h"
+#include "../trap/trap.h"
+#include "../mm/pmm.h"
+#include "../mm/vmm.h"
+#include "../mm/slab.h"
+
+// AHCI SATA Driver
+//
+// Each port has a command list of up to 32 slots in memory. A command is
+// a register FIS plus a PRD table of physical ranges in the slot's command
+// table; setting the slot's bit in PxCI hands it to the HBA, which moves
+// the data by DMA and clears the bit when the drive is done.
+//
+// With NCQ (HBA CAP.SNCQ and IDENTIFY word 76) reads and writes go out as
+// READ/WRITE FPDMA QUEUED with the slot as tag, also set in PxSACT, and up
+// to the drive's queue depth are outstanding at once. The drive reports
+// finished tags with a Set Device Bits FIS, clearing them from PxSACT, in
+// whatever order it completed them. Without NCQ one READ/WRITE DMA EXT is
+// in flight per port.
+//
+// Requests wait on the port queue until a slot is free. Issuers sleep or
+// poll as in the IDE driver.
+
+static ahci_port_t ahci_ports[AHCI_MAX_DISKS];
+static int num_ahci = 0;
+static volatile uint8_t *ahci_abar = NULL;
+static uint32_t ahci_cap = 0;
+static int ahci_irq = -1;
+
+static inline uint32_t hba_read(uint32_t reg) {
+    return *(volatile uint32_t *)(ahci_abar + reg);
+}
+
+static inline void hba_write(uint32_t reg, uint32_t val) {
+    *(volatile uint32_t *)(ahci_abar + reg) = val;
+}
+
+static inline uint32_t port_read(ahci_port_t *p, uint32_t reg) {
+    return *(volatile uint32_t *)(p->regs + reg);
+}
+
+static inline void port_write(ahci_port_t *p, uint32_t reg, uint32_t val) {
+    *(volatile uint32_t *)(p->regs + reg) = val;
+}
+
+// Physical address of a direct-mapped kernel buffer
+static uint32_t ahci_pa(void *kva) {
+    return page2pa(kva2page(kva)) + PG_OFF(kva);
+}
+
+/**
+ * Wait until the bits in mask read as clear in a port register
+ * @return 0 on success, -1 on timeout
+ */
+static int ahci_wait_clear(ahci_port_t *p, uint32_t reg, uint32_t mask) {
+    for (int timeout = 1000000; timeout > 0; timeout--) {
+        if (!(port_read(p, reg) & mask)) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int ahci_port_stop(ahci_port_t *p) {
+    port_write(p, PX_CMD, port_read(p, PX_CMD) & ~PX_CMD_ST);
+    if (ahci_wait_clear(p, PX_CMD, PX_CMD_CR) != 0) {
+        return -1;
+    }
+    port_write(p, PX_CMD, port_read(p, PX_CMD) & ~PX_CMD_FRE);
+    return ahci_wait_clear(p, PX_CMD, PX_CMD_FR);
+}
+
+static void ahci_port_start(ahci_port_t *p) {
+    port_write(p, PX_SERR, 0xFFFFFFFF);
+    port_write(p, PX_IS, 0xFFFFFFFF);
+    port_write(p, PX_CMD, port_read(p, PX_CMD) | PX_CMD_FRE);
+    port_write(p, PX_CMD, port_read(p, PX_CMD) | PX_CMD_ST);
+}
+
+/**
+ * Describe nbytes of the request data in a command table, a page (or
+ * segment) at a time, merging physically adjacent pieces
+ * @return number of PRD entries, -1 if they do not fit
+ */
+static int ahci_prd_build(ahci_cmd_table_t *t, const blk_cursor_t *data, size_t nbytes) {
+    blk_cursor_t c = *data;
+    uint32_t len = 0;
+    int nprd = 0;
+
+    while (nbytes > 0) {
+        size_t chunk;
+        uint8_t *buf = blk_cursor_map(&c, nbytes, &chunk);
+        if (chunk > PG_SIZE - PG_OFF(buf)) {
+            chunk = PG_SIZE - PG_OFF(buf);
+        }
+        uint32_t pa = ahci_pa(buf);
+
+        ahci_prd_t *prd = nprd > 0 ? &t->prdt[nprd - 1] : NULL;
+        if (prd != NULL && prd->dba + len == pa && len + chunk <= AHCI_PRD_MAX_BYTES) {
+            len += chunk;
+        } else {
+            if (nprd == AHCI_PRDT_MAX) {
+                return -1;
+            }
+            if (prd != NULL) {
+                prd->dbc = len - 1;
+            }
+            prd = &t->prdt[nprd++];
+            prd->dba = pa;
+            prd->dbau = 0;
+            prd->reserved = 0;
+            len = chunk;
+        }
+        blk_cursor_advance(&c, chunk);
+        nbytes -= chunk;
+    }
+
+    t->prdt[nprd - 1].dbc = len - 1;
+    return nprd;
+}
+
+// Register FIS for req; NCQ commands carry the count in FEATURES and the tag in COUNT
+static void ahci_build_fis(ahci_port_t *p, ahci_request_t *req, int slot) {
+    uint8_t *fis = p->tables[slot].cfis;
+    uint16_t count = req->nsecs;
+
+    memset(fis, 0, sizeof(p->tables[slot].cfis));
+    fis[0] = FIS_TYPE_REG_H2D;
+    fis[1] = FIS_H2D_CMD;
+    if (req->op == AHCI_OP_IDENTIFY) {
+        fis[2] = ATA_CMD_IDENTIFY;
+        return;
+    }
+
+    fis[4] = req->lba & 0xFF;
+    fis[5] = (req->lba >> 8) & 0xFF;
+    fis[6] = (req->lba >> 16) & 0xFF;
+    fis[7] = ATA_DEV_LBA;
+    fis[8] = (req->lba >> 24) & 0xFF;
+
+    if (p->ncq) {
+        fis[2] = req->op == AHCI_OP_WRITE ? ATA_CMD_WRITE_FPDMA : ATA_CMD_READ_FPDMA;
+        fis[3] = count & 0xFF;
+        fis[11] = count >> 8;
+        fis[12] = slot << 3;
+    } else {
+        fis[2] = req->op == AHCI_OP_WRITE ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT;
+        fis[12] = count & 0xFF;
+        fis[13] = count >> 8;
+    }
+}
+
+/**
+ * Hand req to the HBA in a free slot
+ * Called with interrupts disabled.
+ */
+static void ahci_issue(ahci_port_t *p, ahci_request_t *req, int slot) {
+    ahci_cmd_table_t *t = &p->tables[slot];
+    ahci_cmd_header_t *hdr = &p->clb[slot];
+    size_t nbytes = (req->op == AHCI_OP_IDENTIFY ? 1 : req->nsecs) * BLK_SIZE;
+    int nprd = ahci_prd_build(t, &req->data, nbytes);
+    int queued = p->ncq && req->op != AHCI_OP_IDENTIFY;
+
+    ahci_build_fis(p, req, slot);
+    hdr->flags = AHCI_HDR_CFL_H2D | (req->op == AHCI_OP_WRITE ? AHCI_HDR_WRITE : 0) |
+                 ((uint32_t)nprd << 16);
+    hdr->prdbc = 0;
+    hdr->ctba = ahci_pa(t);
+    hdr->ctbau = 0;
+
+    req->slot = slot;
+    req->issued = rdtsc();
+    p->slots[slot] = req;
+    p->busy |= 1U << slot;
+
+    if (queued) {
+        port_write(p, PX_SACT, 1U << slot);
+        p->stats.ncq++;
+    }
+    port_write(p, PX_CI, 1U << slot);
+    p->stats.commands++;
+}
+
+static int ahci_inflight(ahci_port_t *p) {
+    int n = 0;
+    for (uint32_t b = p->busy; b; b &= b - 1) {
+        n++;
+    }
+    return n;
+}
+
+/**
+ * Issue queued requests while slots below the depth limit are free
+ */
+static void ahci_kick(ahci_port_t *p) {
+    list_entry_t *le;
+
+    while ((le = list_next(&p->queue)) != &p->queue) {
+        int n = ahci_inflight(p);
+        if (n >= p->depth) {
+            return;
+        }
+        int slot = 0;
+        while (p->busy & (1U << slot)) {
+            slot++;
+        }
+        list_del(le);
+        ahci_issue(p, le2ahci_req(le), slot);
+        if (n + 1 > p->stats.max_inflight) {
+            p->stats.max_inflight = n + 1;
+        }
+    }
+}
+
+static void ahci_complete(ahci_port_t *p, int slot, int status) {
+    ahci_request_t *req = p->slots[slot];
+
+    p->slots[slot] = NULL;
+    p->busy &= ~(1U << slot);
+    req->completed = rdtsc();
+    req->status = status;
+    wake_up(&req->wait);
+}
+
+/**
+ * Fail everything in flight and restart the port
+ * A drive left busy would need a COMRESET; this only clears the HBA side.
+ */
+static void ahci_port_error(ahci_port_t *p) {
+    p->stats.errors++;
+    ahci_port_stop(p);
+    for (int slot = 0; slot < AHCI_MAX_SLOTS; slot++) {
+        if (p->busy & (1U << slot)) {
+            ahci_complete(p, slot, AHCI_REQ_ERROR);
+        }
+    }
+    ahci_port_start(p);
+    ahci_kick(p);
+}
+
+/**
+ * Complete the slots the HBA has finished and refill them
+ * Called with interrupts disabled.
+ * @return number of requests completed (or failed)
+ */
+static int ahci_port_service(ahci_port_t *p) {
+    uint32_t is = port_read(p, PX_IS);
+    int n = 0;
+
+    port_write(p, PX_IS, is);
+    hba_write(AHCI_IS, 1U << p->port);
+
+    if (is & PX_IS_ERR) {
+        n = ahci_inflight(p);
+        ahci_port_error(p);
+        return n;
+    }
+
+    uint32_t done = p->busy & ~(port_read(p, PX_CI) | port_read(p, PX_SACT));
+    for (int slot = 0; done; slot++, done >>= 1) {
+        if (done & 1) {
+            ahci_complete(p, slot, AHCI_REQ_DONE);
+            n++;
+        }
+    }
+    if (n > 0) {
+        ahci_kick(p);
+    }
+    return n;
+}
+
+static void ahci_intr(void) {
+    intr_save();
+    uint32_t is = hba_read(AHCI_IS);
+    for (int i = 0; i < num_ahci; i++) {
+        ahci_port_t *p = &ahci_ports[i];
+        if (is & (1U << p->port)) {
+            p->stats.irqs++;
+            ahci_port_service(p);
+        }
+    }
+    hba_write(AHCI_IS, is);     // ports we do not drive
+    intr_restore();
+}
+
+// Process context with interrupts on and an IRQ line to wake us
+static int ahci_can_sleep(void) {
+    return ahci_irq >= 0 && !in_irq() && (read_eflags() & FL_IF) &&
+           current != NULL && current->pid > 0;
+}
+
+static void ahci_submit(ahci_port_t *p, ahci_request_t *req) {
+    req->status = AHCI_REQ_PENDING;
+    wait_queue_init(&req->wait);
+
+    intr_save();
+    list_add_before(&p->queue, &req->link);
+    ahci_kick(p);
+    intr_restore();
+}
+
+/**
+ * Wait for a submitted request, sleeping if possible
+ * @return 0 on success, -1 on error
+ */
+static int ahci_wait(ahci_port_t *p, ahci_request_t *req) {
+    if (ahci_can_sleep()) {
+        intr_save();
+        while (req->status == AHCI_REQ_PENDING) {
+            wait_sleep(&req->wait);
+        }
+        intr_restore();
+    } else {
+        int idle = 0;
+        while (req->status == AHCI_REQ_PENDING) {
+            intr_save();
+            if (ahci_port_service(p) > 0) {
+                idle = 0;
+            } else if (++idle > AHCI_POLL_LIMIT) {
+                ahci_port_error(p);
+                idle = 0;
+            }
+            intr_restore();
+        }
+    }
+    return req->status == AHCI_REQ_DONE ? 0 : -1;
+}
+
+/**
+ * Transfer nsecs sectors, AHCI_MAX_SECTORS per command and up to
+ * AHCI_RW_BATCH commands in flight at once
+ */
+static int ahci_rw(ahci_port_t *p, uint32_t lba, const blk_cursor_t *data, size_t nsecs, int op) {
+    ahci_request_t reqs[AHCI_RW_BATCH];
+    blk_cursor_t c = *data;
+    int ret = 0;
+
+    if (!p->present || lba + nsecs > p->size) {
+        return -1;
+    }
+
+    while (nsecs > 0) {
+        int n = 0;
+        for (; n < AHCI_RW_BATCH && nsecs > 0; n++) {
+            size_t cnt = nsecs < AHCI_MAX_SECTORS ? nsecs : AHCI_MAX_SECTORS;
+            reqs[n].op = op;
+            reqs[n].lba = lba;
+            reqs[n].data = c;
+            reqs[n].nsecs = cnt;
+            ahci_submit(p, &reqs[n]);
+            lba += cnt;
+            blk_cursor_advance(&c, cnt * BLK_SIZE);
+            nsecs -= cnt;
+        }
+        for (int i = 0; i < n; i++) {
+            if (ahci_wait(p, &reqs[i]) != 0) {
+                ret = -1;
+            }
+        }
+        if (ret != 0) {
+            break;
+        }
+    }
+    return ret;
+}
+
+// The HBA needs a word-aligned, direct-mapped buffer
+static int ahci_rw_flat(ahci_port_t *p, uint32_t lba, void *buf, size_t nsecs, int op) {
+    blk_cursor_t data;
+
+    if (((uintptr_t)buf & 1) || (uintptr_t)buf < KERNEL_BASE) {
+        return -1;
+    }
+    blk_cursor_flat(&data, buf);
+    return ahci_rw(p, lba, &data, nsecs, op);
+}
+
+int ahci_read(ahci_port_t *p, uint32_t lba, void *buf, size_t nsecs) {
+    return ahci_rw_flat(p, lba, buf, nsecs, AHCI_OP_READ);
+}
+
+int ahci_write(ahci_port_t *p, uint32_t lba, const void *buf, size_t nsecs) {
+    return ahci_rw_flat(p, lba, (void *)buf, nsecs, AHCI_OP_WRITE);
+}
+
+static int ahci_blk_read(block_device_t *dev, uint32_t blockno, void *buf, size_t nblocks) {
+    return ahci_read(dev->private_data, blockno, buf, nblocks);
+}
+
+static int ahci_blk_write(block_device_t *dev, uint32_t blockno, const void *buf, size_t nblocks) {
+    return ahci_write(dev->private_data, blockno, buf, nblocks);
+}
+
+// Segments go straight into the PRD tables, one entry each at most
+static int ahci_blk_rw_vec(block_device_t *dev, int write, uint32_t blockno,
+                           const blk_seg_t *segs, int nsegs) {
+    int nsecs = blk_vec_sectors(segs, nsegs);
+    blk_cursor_t data;
+
+    if (nsecs < 0) {
+        return -1;
+    }
+    for (int i = 0; i < nsegs; i++) {
+        if (segs[i].offset & 1) {
+            return -1;
+        }
+    }
+    blk_cursor_vec(&data, segs, nsegs);
+    return ahci_rw(dev->private_data, blockno, &data, nsecs, write ? AHCI_OP_WRITE : AHCI_OP_READ);
+}
+
+ahci_port_t *ahci_get_port(int n) {
+    if (n < 0 || n >= num_ahci) {
+        return NULL;
+    }
+    return &ahci_ports[n];
+}
+
+void ahci_set_depth(ahci_port_t *p, int depth) {
+    int max = p->ncq ? p->ncq : 1;
+
+    intr_save();
+    p->depth = depth < 1 ? 1 : (depth > max ? max : depth);
+    ahci_kick(p);
+    intr_restore();
+}
+
+/**
+ * IDENTIFY the disk on p: capacity and NCQ depth
+ */
+static int ahci_identify(ahci_port_t *p) {
+    uint16_t *id = kmalloc(BLK_SIZE);
+    ahci_request_t req;
+
+    if (id == NULL) {
+        return -1;
+    }
+    req.op = AHCI_OP_IDENTIFY;
+    req.lba = 0;
+    blk_cursor_flat(&req.data, id);
+    req.nsecs = 1;
+    ahci_submit(p, &req);
+    if (ahci_wait(p, &req) != 0) {
+        kfree(id);
+        return -1;
+    }
+
+    if (id[ATA_ID_LBA48] & (1 << 10)) {
+        p->size = id[ATA_ID_LBA48_SECTORS] | ((uint32_t)id[ATA_ID_LBA48_SECTORS + 1] << 16);
+    } else {
+        p->size = id[ATA_ID_LBA28_SECTORS] | ((uint32_t)id[ATA_ID_LBA28_SECTORS + 1] << 16);
+    }
+
+    p->ncq = 0;
+    if ((ahci_cap & AHCI_CAP_SNCQ) && (id[ATA_ID_SATA_CAPS] & (1 << 8))) {
+        int qd = (id[ATA_ID_QUEUE_DEPTH] & 0x1F) + 1;
+        int ncs = AHCI_CAP_NCS(ahci_cap);
+        p->ncq = qd < ncs ? qd : ncs;
+    }
+    p->depth = p->ncq ? p->ncq : 1;
+
+    kfree(id);
+    return 0;
+}
+
+/**
+ * Give port n its command list, FIS area and command tables, start it and
+ * identify the disk
+ */
+static int ahci_port_init(ahci_port_t *p, int n) {
+    p->port = n;
+    p->regs = ahci_abar + AHCI_PORT_BASE + n * AHCI_PORT_SIZE;
+    p->busy = 0;
+    p->depth = 1;
+    p->ncq = 0;
+    list_init(&p->queue);
+    memset(p->slots, 0, sizeof(p->slots));
+    memset(&p->stats, 0, sizeof(p->stats));
+
+    if ((port_read(p, PX_SSTS) & 0xF) != PX_SSTS_DET_OK || port_read(p, PX_SIG) != AHCI_SIG_ATA) {
+        return -1;
+    }
+    if (ahci_port_stop(p) != 0) {
+        return -1;
+    }
+
+    // Command list (1K) and received FIS (256) share a page; tables need 32K
+    size_t ntables = AHCI_MAX_SLOTS * sizeof(ahci_cmd_table_t) / PG_SIZE;
+    PageDesc *list_page = alloc_zeroed_page();
+    PageDesc *table_pages = alloc_pages(ntables);
+    if (list_page == NULL || table_pages == NULL) {
+        if (list_page != NULL) {
+            free_page(list_page);
+        }
+        if (table_pages != NULL) {
+            pages_free(table_pages, ntables);
+        }
+        return -1;
+    }
+    p->clb = page2kva(list_page);
+    p->fis = (uint8_t *)p->clb + AHCI_MAX_SLOTS * sizeof(ahci_cmd_header_t);
+    p->tables = page2kva(table_pages);
+    memset(p->tables, 0, AHCI_MAX_SLOTS * sizeof(ahci_cmd_table_t));
+
+    port_write(p, PX_CLB, page2pa(list_page));
+    port_write(p, PX_CLBU, 0);
+    port_write(p, PX_FB, ahci_pa(p->fis));
+    port_write(p, PX_FBU, 0);
+    ahci_port_start(p);
+    port_write(p, PX_IE, PX_IS_DHRS | PX_IS_PSS | PX_IS_SDBS | PX_IS_ERR);
+
+    if (ahci_identify(p) != 0 || p->size == 0) {
+        ahci_port_stop(p);
+        free_page(list_page);
+        pages_free(table_pages, ntables);
+        return -1;
+    }
+    p->present = 1;
+    return 0;
+}
+
+void ahci_init(void) {
+    pci_device_t *pdev = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_SATA);
+
+    if (pdev == NULL || pdev->prog_if != 0x01) {
+        return;     // no AHCI controller
+    }
+    uint32_t abar = pci_bar(pdev, 5);
+    if (abar == 0 || (ahci_abar = ioremap(abar, AHCI_ABAR_SIZE)) == NULL) {
+        cprintf("ahci_init: cannot map ABAR\n");
+        return;
+    }
+    pci_enable(pdev, PCI_CMD_MEMORY | PCI_CMD_MASTER);
+
+    hba_write(AHCI_GHC, hba_read(AHCI_GHC) | AHCI_GHC_AE);
+    ahci_cap = hba_read(AHCI_CAP);
+    uint32_t pi = hba_read(AHCI_PI);
+
+    num_ahci = 0;
+    for (int n = 0; n < 32 && num_ahci < AHCI_MAX_DISKS; n++) {
+        ahci_port_t *p = &ahci_ports[num_ahci];
+        if (!(pi & (1U << n)) || ahci_port_init(p, n) != 0) {
+            continue;
+        }
+
+        p->name[0] = 's';
+        p->name[1] = 'd';
+        p->name[2] = 'a' + num_ahci;
+        p->name[3] = '\0';
+        p->blk.type = BLK_TYPE_DISK;
+        p->blk.name = p->name;
+        p->blk.size = p->size;
+        p->blk.read = ahci_blk_read;
+        p->blk.write = ahci_blk_write;
+        p->blk.rw_vec = ahci_blk_rw_vec;
+        p->blk.private_data = p;
+        blk_register(&p->blk);
+
+        cprintf("ahci_init: port %d: %s, %d sectors, ", n, p->name, p->size);
+        if (p->ncq) {
+            cprintf("NCQ depth %d\n", p->ncq);
+        } else {
+            cprintf("no NCQ\n");
+        }
+        num_ahci++;
+    }
+
+    // Interrupts once the ports are set up; without a line, issuers poll
+    if (pdev->irq_line < 16 && irq_register(pdev->irq_line, ahci_intr) == 0) {
+        ahci_irq = pdev->irq_line;
+        pic_enable(ahci_irq);
+        hba_write(AHCI_GHC, hba_read(AHCI_GHC) | AHCI_GHC_IE);
+    }
+    cprintf("ahci_init: %d disk(s), %d slots per port, irq %d\n",
+            num_ahci, AHCI_CAP_NCS(ahci_cap), ahci_irq);
+}
+
+// ahcibench: AHCI_BENCH_IOS random 4 KB reads from the first AHCI disk at
+// each queue depth. Every completed read is replaced by a new one, so the
+// depth stays constant. Runs in its own thread so the issuer can sleep.
+#define AHCI_BENCH_IOS      1024
+#define AHCI_BENCH_SECS     (PG_SIZE / BLK_SIZE)
+
+static const int ahci_bench_depths[] = {1, 2, 4, 8, 16, 32};
+
+static uint32_t ahci_bench_seed;
+
+static uint32_t ahci_bench_rand(void) {
+    ahci_bench_seed = ahci_bench_seed * 1103515245 + 12345;
+    return ahci_bench_seed >> 16;
+}
+
+static void ahci_bench_submit(ahci_port_t *p, ahci_request_t *req, uint8_t *buf) {
+    uint32_t pages = p->size / AHCI_BENCH_SECS;
+
+    req->op = AHCI_OP_READ;
+    req->lba = (ahci_bench_rand() % pages) * AHCI_BENCH_SECS;
+    blk_cursor_flat(&req->data, buf);
+    req->nsecs = AHCI_BENCH_SECS;
+    ahci_submit(p, req);
+}
+
+static int ahci_bench_main(void *arg) {
+    ahci_port_t *p = arg;
+    static ahci_request_t reqs[AHCI_MAX_SLOTS];
+    uint8_t *bufs = kmalloc(AHCI_MAX_SLOTS * PG_SIZE);
+    int saved_depth = p->depth, max = p->ncq ? p->ncq : 1;
+
+    if (bufs == NULL) {
+        cprintf("ahcibench: out of memory\n");
+        return -1;
+    }
+
+    cprintf("\nahcibench: %d random 4 KB reads from %s (", AHCI_BENCH_IOS, p->name);
+    if (p->ncq) {
+        cprintf("NCQ depth %d)\n", p->ncq);
+    } else {
+        cprintf("no NCQ: depth 1 only)\n");
+    }
+    cprintf("DEPTH  IOPS   KB/S    AVG LAT US  MAX INFLIGHT  IRQS\n");
+
+    for (int d = 0; d < sizeof(ahci_bench_depths) / sizeof(ahci_bench_depths[0]); d++) {
+        int depth = ahci_bench_depths[d];
+        if (depth > max) {
+            break;
+        }
+        ahci_set_depth(p, depth);
+        ahci_bench_seed = 1;
+        memset(&p->stats, 0, sizeof(p->stats));
+
+        uint64_t lat = 0, t0 = rdtsc();
+        int submitted = 0, errors = 0;
+        for (; submitted < depth; submitted++) {
+            ahci_bench_submit(p, &reqs[submitted], bufs + submitted * PG_SIZE);
+        }
+        // Reap in submission order and refill the slot just reaped
+        for (int done = 0; done < AHCI_BENCH_IOS; done++) {
+            int k = done % depth;
+            if (ahci_wait(p, &reqs[k]) != 0) {
+                errors++;
+            }
+            lat += reqs[k].completed - reqs[k].issued;
+            if (submitted < AHCI_BENCH_IOS) {
+                ahci_bench_submit(p, &reqs[k], bufs + k * PG_SIZE);
+                submitted++;
+            }
+        }
+        uint32_t us = tsc_cycles_to_us(rdtsc() - t0);
+        if (us == 0) {
+            us = 1;
+        }
+        if (errors) {
+            cprintf("%-5d  %d read errors\n", depth, errors);
+            continue;
+        }
+        uint32_t iops = AHCI_BENCH_IOS * 1000000U / us;
+        cprintf("%-5d  %-5u  %-6u  %-10u  %-12u  %u\n",
+                depth, iops, iops * (PG_SIZE / 1024),
+                tsc_cycles_to_us(lat) / AHCI_BENCH_IOS,
+                p->stats.max_inflight, p->stats.irqs);
+    }
+
+    ahci_set_depth(p, saved_depth);
+    kfree(bufs);
+    return 0;
+}
+
+void ahci_bench(void) {
+    if (num_ahci == 0) {
+        cprintf("ahcibench: no AHCI disk (run QEMU with -device ahci)\n");
+        return;
+    }
+    if (tsc_khz == 0) {
+        cprintf("ahcibench: TSC not calibrated\n");
+        return;
+    }
+    if (kernel_thread(ahci_bench_main, &ahci_ports[0], "ahcibench") <= 0) {
+        cprintf("ahcibench: cannot start thread\n");
+    }
+}
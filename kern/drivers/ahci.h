@@ -0,0 +1,171 @@
+#pragma once
+
+#include <base/types.h>
+
+#include "../include/list.h"
+#include "../sched/wait.h"
+#include "blk.h"
+
+// HBA registers (relative to ABAR, PCI BAR5)
+#define AHCI_CAP            0x00        // Capabilities
+#define AHCI_GHC            0x04        // Global host control
+#define AHCI_IS             0x08        // Interrupt status, one bit per port
+#define AHCI_PI             0x0C        // Ports implemented
+#define AHCI_VS             0x10        // Version
+#define AHCI_PORT_BASE      0x100       // Port 0 registers
+#define AHCI_PORT_SIZE      0x80        // Registers per port
+#define AHCI_ABAR_SIZE      (AHCI_PORT_BASE + 32 * AHCI_PORT_SIZE)
+
+#define AHCI_CAP_SNCQ       0x40000000  // Native command queuing
+#define AHCI_CAP_NCS(cap)   ((((cap) >> 8) & 0x1F) + 1)     // Command slots per port
+
+#define AHCI_GHC_IE         0x00000002  // Interrupt enable
+#define AHCI_GHC_AE         0x80000000  // AHCI enable
+
+// Port registers (relative to the port's block)
+#define PX_CLB              0x00        // Command list base (1K aligned)
+#define PX_CLBU             0x04
+#define PX_FB               0x08        // Received FIS base (256 aligned)
+#define PX_FBU              0x0C
+#define PX_IS               0x10        // Interrupt status (write 1 to clear)
+#define PX_IE               0x14        // Interrupt enable
+#define PX_CMD              0x18        // Command and status
+#define PX_TFD              0x20        // Task file data (ATA status in bits 0-7)
+#define PX_SIG              0x24        // Signature of the attached device
+#define PX_SSTS             0x28        // SATA status
+#define PX_SERR             0x30        // SATA error (write 1 to clear)
+#define PX_SACT             0x34        // NCQ tags outstanding
+#define PX_CI               0x38        // Command slots issued
+
+#define PX_CMD_ST           0x0001      // Process the command list
+#define PX_CMD_FRE          0x0010      // Accept received FISes
+#define PX_CMD_FR           0x4000      // FIS receive running
+#define PX_CMD_CR           0x8000      // Command list running
+
+#define PX_IS_DHRS          0x00000001  // D2H register FIS (non-queued command done)
+#define PX_IS_PSS           0x00000002  // PIO setup FIS (IDENTIFY)
+#define PX_IS_SDBS          0x00000008  // Set device bits FIS (NCQ commands done)
+#define PX_IS_ERR           0x78000010  // Task file, host bus, interface and unknown-FIS errors
+
+#define PX_SSTS_DET_OK      3           // Device present, PHY up
+#define AHCI_SIG_ATA        0x00000101  // SATA disk (ATAPI is 0xEB140101)
+
+// Command header flags
+#define AHCI_HDR_CFL_H2D    5           // Command FIS length in dwords
+#define AHCI_HDR_WRITE      0x40        // Host to device data
+
+// FIS and ATA commands
+#define FIS_TYPE_REG_H2D    0x27
+#define FIS_H2D_CMD         0x80        // Command register update
+#define ATA_DEV_LBA         0x40
+#define ATA_CMD_READ_DMA_EXT    0x25
+#define ATA_CMD_WRITE_DMA_EXT   0x35
+#define ATA_CMD_READ_FPDMA      0x60    // NCQ read, tag in the count field
+#define ATA_CMD_WRITE_FPDMA     0x61    // NCQ write
+#define ATA_CMD_IDENTIFY        0xEC
+
+// IDENTIFY data words
+#define ATA_ID_LBA28_SECTORS    60      // Words 60-61
+#define ATA_ID_QUEUE_DEPTH      75      // Bits 0-4: depth - 1
+#define ATA_ID_SATA_CAPS        76      // Bit 8: NCQ
+#define ATA_ID_LBA48            83      // Bit 10: 48-bit commands
+#define ATA_ID_LBA48_SECTORS    100     // Words 100-103
+
+#define AHCI_MAX_DISKS      4           // Disks registered (sda-sdd)
+#define AHCI_MAX_SLOTS      32
+#define AHCI_MAX_SECTORS    256         // Sectors per command
+#define AHCI_PRDT_MAX       56          // PRD entries per command table (1K table)
+#define AHCI_PRD_MAX_BYTES  0x400000    // Bytes per PRD entry
+#define AHCI_RW_BATCH       8           // Commands a single large request keeps in flight
+#define AHCI_POLL_LIMIT     10000000    // Idle polls before in-flight commands fail
+
+// Command list entry, one per slot
+typedef struct {
+    uint32_t flags;                     // CFL | W | PRDTL << 16
+    volatile uint32_t prdbc;            // bytes transferred
+    uint32_t ctba;                      // command table, 128 aligned
+    uint32_t ctbau;
+    uint32_t reserved[4];
+} ahci_cmd_header_t;
+
+typedef struct {
+    uint32_t dba;                       // data base address, even
+    uint32_t dbau;
+    uint32_t reserved;
+    uint32_t dbc;                       // byte count - 1
+} ahci_prd_t;
+
+typedef struct {
+    uint8_t cfis[64];                   // command FIS
+    uint8_t acmd[16];                   // ATAPI command
+    uint8_t reserved[48];
+    ahci_prd_t prdt[AHCI_PRDT_MAX];
+} ahci_cmd_table_t;
+
+// Request operations
+#define AHCI_OP_READ        0
+#define AHCI_OP_WRITE       1
+#define AHCI_OP_IDENTIFY    2
+
+// Request states, as for IDE
+#define AHCI_REQ_DONE       0
+#define AHCI_REQ_ERROR      (-1)
+#define AHCI_REQ_PENDING    1
+
+// One command: waits on the port queue for a free slot, then on the drive
+typedef struct ahci_request {
+    int op;                             // AHCI_OP_*
+    uint32_t lba;
+    blk_cursor_t data;                  // flat buffer or page segments
+    size_t nsecs;                       // at most AHCI_MAX_SECTORS
+    int slot;                           // command slot while issued
+    volatile int status;                // AHCI_REQ_*
+    uint64_t issued;                    // TSC when handed to the HBA
+    uint64_t completed;                 // TSC when the HBA reported it done
+    wait_queue_t wait;                  // issuer sleeping until completion
+    list_entry_t link;                  // link in the port queue
+} ahci_request_t;
+
+#define le2ahci_req(le) to_struct((le), ahci_request_t, link)
+
+typedef struct {
+    uint32_t commands;                  // commands issued
+    uint32_t ncq;                       // of which queued (FPDMA)
+    uint32_t irqs;                      // port interrupts serviced
+    uint32_t errors;                    // port errors (in-flight commands failed)
+    uint32_t max_inflight;              // most slots busy at once
+} ahci_stats_t;
+
+typedef struct {
+    int present;
+    int port;                           // HBA port number
+    volatile uint8_t *regs;             // port registers
+    ahci_cmd_header_t *clb;             // command list, 32 headers
+    uint8_t *fis;                       // received FIS area
+    ahci_cmd_table_t *tables;           // one command table per slot
+    uint32_t size;                      // sectors
+    int ncq;                            // NCQ queue depth, 0 if unsupported
+    int depth;                          // slots used at once (1 without NCQ)
+    uint32_t busy;                      // slots in flight
+    ahci_request_t *slots[AHCI_MAX_SLOTS];
+    list_entry_t queue;                 // requests waiting for a slot
+    ahci_stats_t stats;
+    char name[8];                       // sda, sdb, ...
+    block_device_t blk;
+} ahci_port_t;
+
+// Find the AHCI controller on PCI, start its ports and register each disk
+// with the block layer. Needs pmm/vmm (command lists live in pages).
+void ahci_init(void);
+
+// Synchronous transfers of any length, split into commands kept in flight together
+int ahci_read(ahci_port_t *p, uint32_t lba, void *buf, size_t nsecs);
+int ahci_write(ahci_port_t *p, uint32_t lba, const void *buf, size_t nsecs);
+
+ahci_port_t *ahci_get_port(int n);
+
+// Cap the commands in flight on a port (1 .. NCQ depth)
+void ahci_set_depth(ahci_port_t *p, int depth);
+
+// Random 4 KB read IOPS and latency at each queue depth
+void ahci_bench(void);
@@ -0,0 +1,544 @@
+#include "bcache.h"
+#include "stdio.h"
+#include "memory.h"
+
+#include <arch/x86/cpu.h>
+#include "pit.h"
+#include "intr.h"
+#include "../sched/sched.h"
+#include "../trap/trap.h"
+#include "../mm/slab.h"
+#include "../debug/assert.h"
+
+// Buffer Cache
+//
+// BCACHE_NBUF block-sized buffers, each caching one (device, block). A
+// hash on the pair finds a cached block; buffers nobody holds sit on an
+// LRU list, most recently released first, and a miss reuses the least
+// recently used clean one. bread() returns the buffer with a reference
+// that brelse() drops; BH_LOCKED covers the device read that fills it, and
+// others asking for the block meanwhile sleep on the buffer.
+//
+// Writes are delayed: bdirty() marks the buffer and the flusher thread,
+// woken from the timer every BCACHE_FLUSH_PERIOD ticks while anything is
+// dirty, writes back blocks dirty for BCACHE_DIRTY_EXPIRE ticks (all of
+// them above BCACHE_DIRTY_HIGH). A miss with only dirty buffers left
+// writes the oldest back itself.
+//
+// blk_read()/blk_write() still go to the device directly (swap pages have
+// their own cache); they patch cached copies so both paths agree.
+
+static buffer_head_t bcache_bufs[BCACHE_NBUF];
+static list_entry_t bcache_hash[BCACHE_HASH_SIZE];
+static list_entry_t bcache_lru;
+static int bcache_nr_used = 0;          // buffers holding some block
+static bcache_stats_t stats;
+
+static wait_queue_t flush_wait;
+static volatile int flush_pending = 0;
+static int flusher_started = 0;
+
+static inline list_entry_t *bcache_bucket(block_device_t *dev, uint32_t blockno) {
+    uint32_t h = ((uintptr_t)dev >> 4) ^ blockno ^ (blockno >> 6);
+    return &bcache_hash[h & (BCACHE_HASH_SIZE - 1)];
+}
+
+static buffer_head_t *bcache_lookup(block_device_t *dev, uint32_t blockno) {
+    list_entry_t *head = bcache_bucket(dev, blockno), *le = head;
+
+    while ((le = list_next(le)) != head) {
+        buffer_head_t *bh = le2bh(le, hash_link);
+        if (bh->dev == dev && bh->blockno == blockno) {
+            return bh;
+        }
+    }
+    return NULL;
+}
+
+// Process context that may sleep on a locked buffer
+static int bcache_can_sleep(void) {
+    return !in_irq() && (read_eflags() & FL_IF) && current != NULL && current->pid > 0;
+}
+
+/**
+ * Wait for another holder's I/O on bh to finish
+ * Called with interrupts disabled.
+ * @return 0 once unlocked, -1 if the caller cannot sleep
+ */
+static int bh_wait_unlocked(buffer_head_t *bh, int can_sleep) {
+    while (bh->flags & BH_LOCKED) {
+        if (!can_sleep) {
+            return -1;
+        }
+        wait_sleep(&bh->wait);
+    }
+    return 0;
+}
+
+static void bh_unlock(buffer_head_t *bh) {
+    bh->flags &= ~BH_LOCKED;
+    wake_up(&bh->wait);
+}
+
+/**
+ * Write back a dirty buffer the caller has locked and referenced, then
+ * unlock it and drop the reference
+ */
+static int bh_writeback(buffer_head_t *bh) {
+    {
+        intr_save();
+        if (bh->flags & BH_DIRTY) {
+            bh->flags &= ~BH_DIRTY;
+            stats.dirty--;
+        }
+        intr_restore();
+    }
+
+    int ret = bh->dev->write(bh->dev, bh->blockno, bh->data, 1);
+
+    intr_save();
+    if (ret != 0 && !(bh->flags & BH_DIRTY)) {
+        bh->flags |= BH_DIRTY;      // retried by the next flush
+        stats.dirty++;
+    }
+    bh_unlock(bh);
+    bh->refcnt--;
+    intr_restore();
+    return ret;
+}
+
+/**
+ * Least recently used buffer nobody holds, clean if possible
+ * Called with interrupts disabled.
+ */
+static buffer_head_t *bcache_victim(int clean) {
+    list_entry_t *le = &bcache_lru;
+
+    while ((le = list_prev(le)) != &bcache_lru) {
+        buffer_head_t *bh = le2bh(le, lru_link);
+        if (bh->refcnt == 0 && !(bh->flags & BH_LOCKED) && (!clean || !(bh->flags & BH_DIRTY))) {
+            return bh;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Find or claim the buffer for (dev, blockno) and take a reference
+ * @param fill: set to 1 if the buffer is locked for the caller to read
+ * @param wb: set to a dirty buffer the caller must write back and retry
+ */
+static buffer_head_t *bget(block_device_t *dev, uint32_t blockno, int can_sleep,
+                           int *fill, buffer_head_t **wb) {
+    buffer_head_t *bh;
+
+    intr_save();
+    bh = bcache_lookup(dev, blockno);
+    if (bh != NULL) {
+        bh->refcnt++;
+        if (bh_wait_unlocked(bh, can_sleep) != 0) {
+            bh->refcnt--;
+            stats.busy++;
+            intr_restore();
+            return NULL;
+        }
+        if (bh->flags & BH_VALID) {
+            stats.hits++;
+        } else {
+            bh->flags |= BH_LOCKED;     // an earlier read failed: try again
+            *fill = 1;
+        }
+        intr_restore();
+        return bh;
+    }
+
+    bh = bcache_victim(1);
+    if (bh == NULL) {
+        bh = bcache_victim(0);
+        if (bh != NULL) {
+            bh->refcnt++;
+            bh->flags |= BH_LOCKED;
+            *wb = bh;
+        } else {
+            stats.busy++;
+        }
+        intr_restore();
+        return NULL;
+    }
+
+    if (bh->dev != NULL) {
+        list_del(&bh->hash_link);
+        stats.evictions++;
+    } else {
+        bcache_nr_used++;
+    }
+    bh->dev = dev;
+    bh->blockno = blockno;
+    bh->flags = BH_LOCKED;
+    bh->refcnt = 1;
+    list_add(bcache_bucket(dev, blockno), &bh->hash_link);
+    *fill = 1;
+    intr_restore();
+    return bh;
+}
+
+buffer_head_t *bread(block_device_t *dev, uint32_t blockno) {
+    int can_sleep = bcache_can_sleep();
+    buffer_head_t *bh, *wb;
+    int fill;
+
+    if (dev == NULL || dev->read == NULL || blockno >= dev->size) {
+        return NULL;
+    }
+
+    stats.lookups++;
+    do {
+        fill = 0;
+        wb = NULL;
+        bh = bget(dev, blockno, can_sleep, &fill, &wb);
+        if (wb != NULL) {
+            stats.sync_writebacks++;
+            bh_writeback(wb);
+        }
+    } while (wb != NULL);
+
+    if (bh == NULL || !fill) {
+        return bh;
+    }
+
+    stats.misses++;
+    int ret = dev->read(dev, blockno, bh->data, 1);
+
+    intr_save();
+    if (ret == 0) {
+        bh->flags |= BH_VALID;
+    }
+    bh_unlock(bh);
+    if (ret != 0) {
+        bh->refcnt--;
+        bh = NULL;
+    }
+    intr_restore();
+    return bh;
+}
+
+void bdirty(buffer_head_t *bh) {
+    intr_save();
+    assert(bh->refcnt > 0);
+    if (!(bh->flags & BH_DIRTY)) {
+        bh->flags |= BH_DIRTY;
+        bh->dirtied = ticks;
+        stats.dirty++;
+    }
+    intr_restore();
+}
+
+void brelse(buffer_head_t *bh) {
+    intr_save();
+    assert(bh->refcnt > 0);
+    if (--bh->refcnt == 0) {
+        list_del(&bh->lru_link);
+        list_add(&bcache_lru, &bh->lru_link);
+    }
+    intr_restore();
+}
+
+/**
+ * Lock and reference the next dirty buffer of dev (any if NULL) that has
+ * been dirty for at least min_age ticks
+ */
+static buffer_head_t *bcache_pick_dirty(block_device_t *dev, int64_t min_age) {
+    intr_save();
+    for (int i = 0; i < BCACHE_NBUF; i++) {
+        buffer_head_t *bh = &bcache_bufs[i];
+        if ((bh->flags & (BH_DIRTY | BH_LOCKED)) == BH_DIRTY &&
+            (dev == NULL || bh->dev == dev) && ticks - bh->dirtied >= min_age) {
+            bh->refcnt++;
+            bh->flags |= BH_LOCKED;
+            intr_restore();
+            return bh;
+        }
+    }
+    intr_restore();
+    return NULL;
+}
+
+/**
+ * Write back dirty buffers old enough
+ * @return number written, -1 if any write failed
+ */
+static int bcache_flush(block_device_t *dev, int64_t min_age) {
+    buffer_head_t *bh;
+    int n = 0, err = 0;
+
+    while ((bh = bcache_pick_dirty(dev, min_age)) != NULL) {
+        if (bh_writeback(bh) != 0) {
+            err = 1;
+            break;      // leave the rest for the next pass
+        }
+        n++;
+    }
+    return err ? -1 : n;
+}
+
+int bsync(block_device_t *dev) {
+    return bcache_flush(dev, 0) < 0 ? -1 : 0;
+}
+
+void bcache_read_overlay(block_device_t *dev, uint32_t blockno, void *buf, size_t nblocks) {
+    if (stats.dirty == 0) {
+        return;
+    }
+
+    intr_save();
+    for (size_t i = 0; i < nblocks; i++) {
+        buffer_head_t *bh = bcache_lookup(dev, blockno + i);
+        if (bh != NULL && (bh->flags & BH_DIRTY)) {
+            memcpy((uint8_t *)buf + i * BLK_SIZE, bh->data, BLK_SIZE);
+        }
+    }
+    intr_restore();
+}
+
+void bcache_write_through(block_device_t *dev, uint32_t blockno, const void *buf, size_t nblocks) {
+    if (bcache_nr_used == 0) {
+        return;
+    }
+
+    intr_save();
+    for (size_t i = 0; i < nblocks; i++) {
+        buffer_head_t *bh = bcache_lookup(dev, blockno + i);
+        if (bh == NULL || !(bh->flags & BH_VALID)) {
+            continue;
+        }
+        memcpy(bh->data, (const uint8_t *)buf + i * BLK_SIZE, BLK_SIZE);
+        if (bh->flags & BH_LOCKED) {
+            // A writeback of the old contents is in flight: write again later
+            if (!(bh->flags & BH_DIRTY)) {
+                bh->flags |= BH_DIRTY;
+                bh->dirtied = ticks;
+                stats.dirty++;
+            }
+        } else if (bh->flags & BH_DIRTY) {
+            bh->flags &= ~BH_DIRTY;
+            stats.dirty--;
+        }
+    }
+    intr_restore();
+}
+
+void bcache_tick(void) {
+    if (flusher_started && stats.dirty > 0 && (int)ticks % BCACHE_FLUSH_PERIOD == 0) {
+        flush_pending = 1;
+        wake_up(&flush_wait);
+    }
+}
+
+static int bcache_flusher_main(void *arg) {
+    while (1) {
+        {
+            intr_save();
+            while (!flush_pending) {
+                wait_sleep(&flush_wait);
+            }
+            flush_pending = 0;
+            intr_restore();
+        }
+
+        stats.flusher_runs++;
+        int n = bcache_flush(NULL, stats.dirty > BCACHE_DIRTY_HIGH ? 0 : BCACHE_DIRTY_EXPIRE);
+        if (n > 0) {
+            stats.writebacks += n;
+        }
+    }
+    return 0;
+}
+
+void bcache_init(void) {
+    uint8_t *data = kmalloc(BCACHE_NBUF * BLK_SIZE);
+    assert(data != NULL);
+
+    for (int i = 0; i < BCACHE_HASH_SIZE; i++) {
+        list_init(&bcache_hash[i]);
+    }
+    list_init(&bcache_lru);
+    wait_queue_init(&flush_wait);
+
+    for (int i = 0; i < BCACHE_NBUF; i++) {
+        buffer_head_t *bh = &bcache_bufs[i];
+        bh->dev = NULL;
+        bh->blockno = 0;
+        bh->refcnt = 0;
+        bh->flags = 0;
+        bh->data = data + i * BLK_SIZE;
+        wait_queue_init(&bh->wait);
+        list_init(&bh->hash_link);
+        list_add_before(&bcache_lru, &bh->lru_link);
+    }
+}
+
+void bcache_flusher_init(void) {
+    int pid = kernel_thread(bcache_flusher_main, NULL, "bflush");
+    assert(pid > 0);
+    flusher_started = 1;
+    cprintf("bcache: %d buffers, flusher started (PID %d)\n", BCACHE_NBUF, pid);
+}
+
+const bcache_stats_t *bcache_get_stats(void) {
+    return &stats;
+}
+
+void bcache_print_info(void) {
+    uint32_t pct = stats.lookups ? stats.hits * 100 / stats.lookups : 0;
+
+    cprintf("Buffer cache: %d buffers of %d bytes, %d in use, %d dirty\n",
+            BCACHE_NBUF, BLK_SIZE, bcache_nr_used, stats.dirty);
+    cprintf("  lookups %u, hits %u (%u%c), misses %u, evictions %u, busy %u\n",
+            stats.lookups, stats.hits, pct, '%', stats.misses, stats.evictions, stats.busy);
+    cprintf("  writebacks %u by flusher (%u runs), %u to evict\n",
+            stats.writebacks, stats.flusher_runs, stats.sync_writebacks);
+}
+
+// bcachebench: block access patterns on the first disk, through bread()
+// and straight to the device. The rewrite pattern dirties blocks without
+// changing them, so it is safe on any disk.
+#define BCACHE_BENCH_HOT    16
+#define BCACHE_BENCH_COLD   1024
+#define BCACHE_BENCH_RANDOM 1024
+
+static uint32_t bcache_bench_seed;
+
+static uint32_t bcache_bench_rand(void) {
+    bcache_bench_seed = bcache_bench_seed * 1103515245 + 12345;
+    return bcache_bench_seed >> 16;
+}
+
+/**
+ * Block number of access i of a pattern
+ * loop: repeat blocks [0, n); hotcold: 90% in the first BCACHE_BENCH_HOT
+ */
+static uint32_t bcache_bench_block(int pattern, int n, int i) {
+    if (pattern < 2) {
+        return i % n;
+    }
+    uint32_t r = bcache_bench_rand();
+    if (r % 10 != 0) {
+        return r % BCACHE_BENCH_HOT;
+    }
+    return BCACHE_BENCH_HOT + r % BCACHE_BENCH_COLD;
+}
+
+// Write back and forget every cached block of dev
+static void bcache_bench_drop(block_device_t *dev) {
+    bsync(dev);
+    intr_save();
+    for (int i = 0; i < BCACHE_NBUF; i++) {
+        buffer_head_t *bh = &bcache_bufs[i];
+        if (bh->dev == dev && bh->refcnt == 0 && !(bh->flags & (BH_LOCKED | BH_DIRTY))) {
+            list_del(&bh->hash_link);
+            bh->dev = NULL;
+            bh->flags = 0;
+            bcache_nr_used--;
+            list_del(&bh->lru_link);
+            list_add_before(&bcache_lru, &bh->lru_link);
+        }
+    }
+    intr_restore();
+}
+
+static int bcache_bench_main(void *arg) {
+    static const struct {
+        const char *name;
+        int pattern;                // 0 loop, 1 rewrite loop, 2 hot/cold
+        int blocks;
+        int accesses;
+    } patterns[] = {
+        {"loop-64",  0, 64,  1024},
+        {"loop-256", 0, 256, 1024},
+        {"hotcold",  2, 0,   BCACHE_BENCH_RANDOM},
+        {"rewrite",  1, 32,  256},
+    };
+    block_device_t *dev = arg;
+    uint8_t *buf = kmalloc(BLK_SIZE);
+
+    if (buf == NULL) {
+        cprintf("bcachebench: out of memory\n");
+        return -1;
+    }
+
+    cprintf("\nbcachebench: %s, %d buffers\n", dev->name, BCACHE_NBUF);
+    cprintf("PATTERN   ACCESSES  HITS  HIT%c  DIRECT US  CACHED US  DISK WRITES\n", '%');
+
+    for (int p = 0; p < sizeof(patterns) / sizeof(patterns[0]); p++) {
+        int pattern = patterns[p].pattern, n = patterns[p].blocks, total = patterns[p].accesses;
+        int err = 0;
+
+        // Straight to the device
+        bcache_bench_seed = 1;
+        uint64_t t0 = rdtsc();
+        for (int i = 0; i < total && !err; i++) {
+            uint32_t b = bcache_bench_block(pattern, n, i);
+            err = dev->read(dev, b, buf, 1) != 0;
+            if (!err && pattern == 1) {
+                err = dev->write(dev, b, buf, 1) != 0;
+            }
+        }
+        uint32_t direct_us = tsc_cycles_to_us(rdtsc() - t0);
+
+        // Through the cache, from cold, including the final writeback
+        bcache_bench_drop(dev);
+        bcache_stats_t before = stats;
+        bcache_bench_seed = 1;
+        t0 = rdtsc();
+        for (int i = 0; i < total && !err; i++) {
+            buffer_head_t *bh = bread(dev, bcache_bench_block(pattern, n, i));
+            if (bh == NULL) {
+                err = 1;
+                break;
+            }
+            if (pattern == 1) {
+                bdirty(bh);
+            }
+            brelse(bh);
+        }
+        uint32_t writes = stats.dirty;
+        if (!err) {
+            err = bsync(dev) != 0;
+        }
+        uint32_t cached_us = tsc_cycles_to_us(rdtsc() - t0);
+
+        if (err) {
+            cprintf("%-8s  I/O error\n", patterns[p].name);
+            continue;
+        }
+        uint32_t hits = stats.hits - before.hits;
+        writes += stats.sync_writebacks - before.sync_writebacks;
+        cprintf("%-8s  %-8d  %-4u  %-4u  %-9u  %-9u  ",
+                patterns[p].name, total, hits, hits * 100 / total, direct_us, cached_us);
+        if (pattern == 1) {
+            cprintf("%u (direct %d)\n", writes, total);
+        } else {
+            cprintf("-\n");
+        }
+    }
+
+    bcache_bench_drop(dev);
+    kfree(buf);
+    return 0;
+}
+
+void bcache_bench(void) {
+    block_device_t *dev = blk_get_device(BLK_TYPE_DISK);
+
+    if (dev == NULL || dev->size < BCACHE_BENCH_HOT + BCACHE_BENCH_COLD) {
+        cprintf("bcachebench: no disk\n");
+        return;
+    }
+    if (tsc_khz == 0) {
+        cprintf("bcachebench: TSC not calibrated\n");
+        return;
+    }
+    if (kernel_thread(bcache_bench_main, dev, "bcachebench") <= 0) {
+        cprintf("bcachebench: cannot start thread\n");
+    }
+}
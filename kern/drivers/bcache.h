@@ -0,0 +1,72 @@
+#pragma once
+
+#include <base/types.h>
+
+#include "../include/list.h"
+#include "../sched/wait.h"
+#include "blk.h"
+
+#define BCACHE_NBUF         128         // Cached blocks (BLK_SIZE each)
+#define BCACHE_HASH_SIZE    64          // Hash buckets, power of two
+#define BCACHE_FLUSH_PERIOD 100         // Ticks between flusher passes (1 s)
+#define BCACHE_DIRTY_EXPIRE 300         // Ticks a block may stay dirty (3 s)
+#define BCACHE_DIRTY_HIGH   (BCACHE_NBUF / 2)   // Flush everything above this
+
+// Buffer state
+#define BH_VALID            0x1         // data matches the disk (or is newer)
+#define BH_DIRTY            0x2         // data is newer than the disk
+#define BH_LOCKED           0x4         // I/O in progress
+
+typedef struct buffer_head {
+    block_device_t *dev;
+    uint32_t blockno;
+    int refcnt;                         // holders between bread() and brelse()
+    uint32_t flags;                     // BH_*
+    int64_t dirtied;                    // ticks when it last became dirty
+    uint8_t *data;                      // BLK_SIZE bytes
+    wait_queue_t wait;                  // waiting for BH_LOCKED to clear
+    list_entry_t hash_link;             // link in its hash bucket
+    list_entry_t lru_link;              // link in the LRU list, most recent first
+} buffer_head_t;
+
+#define le2bh(le, member) to_struct((le), buffer_head_t, member)
+
+typedef struct {
+    uint32_t lookups;                   // bread() calls
+    uint32_t hits;                      // found valid in the cache
+    uint32_t misses;                    // read from the device
+    uint32_t evictions;                 // buffers reused for another block
+    uint32_t dirty;                     // buffers dirty now
+    uint32_t writebacks;                // dirty buffers written by the flusher
+    uint32_t sync_writebacks;           // dirty buffers written to evict them
+    uint32_t flusher_runs;              // flusher passes
+    uint32_t busy;                      // bread() failures: every buffer held or locked
+} bcache_stats_t;
+
+// Allocate the buffers; needs kmalloc
+void bcache_init(void);
+// Start the flusher thread; needs the scheduler
+void bcache_flusher_init(void);
+
+// Get the block with its data read, holding a reference; NULL on I/O error
+// or when no buffer can be freed
+buffer_head_t *bread(block_device_t *dev, uint32_t blockno);
+// The holder changed bh->data: write it back later
+void bdirty(buffer_head_t *bh);
+// Drop the reference taken by bread()
+void brelse(buffer_head_t *bh);
+// Write every dirty buffer of dev (all devices if NULL) now
+int bsync(block_device_t *dev);
+
+// Keep raw transfers coherent with cached blocks (called by blk_read/blk_write)
+void bcache_read_overlay(block_device_t *dev, uint32_t blockno, void *buf, size_t nblocks);
+void bcache_write_through(block_device_t *dev, uint32_t blockno, const void *buf, size_t nblocks);
+
+// Timer hook: wake the flusher every BCACHE_FLUSH_PERIOD ticks while blocks are dirty
+void bcache_tick(void);
+
+const bcache_stats_t *bcache_get_stats(void);
+void bcache_print_info(void);
+
+// Cached vs uncached access for repeated block patterns
+void bcache_bench(void);
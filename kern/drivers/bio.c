@@ -0,0 +1,731 @@
+#include "bio.h"
+#include "stdio.h"
+#include "math.h"
+#include "memory.h"
+
+#include <arch/x86/cpu.h>
+#include <arch/x86/mmu.h>
+#include "pit.h"
+#include "intr.h"
+#include "../sched/sched.h"
+#include "../trap/trap.h"
+#include "../mm/slab.h"
+#include "../mm/swap_slot.h"
+#include "../debug/assert.h"
+
+// Request queues
+//
+// Each device gets a queue on its first bio: a pool of BLK_NR_REQUESTS
+// requests, the scheduler's lists and a dispatcher thread. A new bio is
+// merged into a queued request of the same direction when their sectors
+// touch (up to BIO_MAX_SECTORS), otherwise it takes a free request and is
+// handed to the scheduler. The dispatcher asks the scheduler for the next
+// request and makes one driver call for it; merged bios whose buffers are
+// not contiguous go down as one segment list (or through the queue's
+// bounce buffer for drivers without rw_vec).
+//
+// Drivers are still synchronous underneath, so a queue keeps one request
+// at the driver; what the scheduler decides is the order of the rest.
+
+static blk_queue_t *queues[MAX_BLK_DEV];
+static int nr_queues = 0;
+static int dispatch_ok = 0;     // the scheduler can run dispatcher threads
+
+static iosched_t *ioscheds[] = {&iosched_noop, &iosched_deadline, &iosched_clook};
+
+#define NR_IOSCHEDS     (sizeof(ioscheds) / sizeof(ioscheds[0]))
+#define IOSCHED_DEFAULT (&iosched_deadline)
+
+// Process context that may sleep, and is not the dispatcher of q
+static int blk_can_sleep(blk_queue_t *q) {
+    return !in_irq() && (read_eflags() & FL_IF) && current != NULL && current->pid > 0 &&
+           (q == NULL || current->pid != q->thread);
+}
+
+/**
+ * Take the next request from the scheduler unless a dispatcher is busy
+ */
+static blk_request_t *blk_queue_pick(blk_queue_t *q) {
+    blk_request_t *rq = NULL;
+
+    intr_save();
+    if (!q->running && (rq = q->sched->next(q)) != NULL) {
+        list_del(&rq->queue_link);
+        q->nr_queued--;
+        q->running = 1;
+        q->stats.seek_sectors += rq->sector > q->head ? rq->sector - q->head : q->head - rq->sector;
+        q->head = rq->sector + rq->nsecs;
+    }
+    intr_restore();
+    return rq;
+}
+
+// Data cursor of a bio
+static void bio_cursor(bio_t *bio, blk_cursor_t *c) {
+    if (bio->segs != NULL) {
+        blk_cursor_vec(c, bio->segs, bio->nsegs);
+    } else {
+        blk_cursor_flat(c, bio->buf);
+    }
+}
+
+/**
+ * Describe the data of every bio in rq as one segment list in q->segs
+ * @return number of segments, -1 if a flat buffer is not made of whole
+ *         sectors in direct-mapped pages or the list is too long
+ */
+static int blk_gather(blk_queue_t *q, blk_request_t *rq) {
+    int n = 0;
+
+    for (list_entry_t *le = list_next(&rq->bios); le != &rq->bios; le = list_next(le)) {
+        bio_t *bio = le2bio(le);
+        if (bio->segs != NULL) {
+            if (n + bio->nsegs > BLK_MAX_SEGS) {
+                return -1;
+            }
+            memcpy(&q->segs[n], bio->segs, bio->nsegs * sizeof(blk_seg_t));
+            n += bio->nsegs;
+            continue;
+        }
+
+        uint8_t *p = bio->buf;
+        size_t left = bio->nsecs * BLK_SIZE;
+        if ((uintptr_t)p < KERNEL_BASE || PG_OFF(p) % BLK_SIZE != 0) {
+            return -1;
+        }
+        while (left > 0) {
+            size_t len = PG_SIZE - PG_OFF(p);
+            if (len > left) {
+                len = left;
+            }
+            if (n == BLK_MAX_SEGS) {
+                return -1;
+            }
+            q->segs[n].page = kva2page(p);
+            q->segs[n].offset = PG_OFF(p);
+            q->segs[n].len = len;
+            n++;
+            p += len;
+            left -= len;
+        }
+    }
+    return n;
+}
+
+/**
+ * Move one request with a single driver call and complete its bios
+ * A merged request whose data is not one flat buffer goes to the driver
+ * as a segment list when it takes one, else through the bounce buffer.
+ */
+static void blk_dispatch(blk_queue_t *q, blk_request_t *rq) {
+    block_device_t *dev = q->dev;
+    bio_t *first = le2bio(list_next(&rq->bios));
+    uint8_t *p = first->buf;
+    list_entry_t *le;
+    int flat = 1, nsegs, ret;
+
+    for (le = list_next(&rq->bios); le != &rq->bios; le = list_next(le)) {
+        bio_t *bio = le2bio(le);
+        if (bio->segs != NULL || bio->buf != p) {
+            flat = 0;
+            break;
+        }
+        p = (uint8_t *)bio->buf + bio->nsecs * BLK_SIZE;
+    }
+
+    if (flat) {
+        ret = rq->write ? blk_write(dev, rq->sector, first->buf, rq->nsecs)
+                        : blk_read(dev, rq->sector, first->buf, rq->nsecs);
+    } else if (list_next(&first->link) == &rq->bios) {
+        ret = blk_rw_vec(dev, rq->write, rq->sector, first->segs, first->nsegs);
+    } else if (dev->rw_vec != NULL && (nsegs = blk_gather(q, rq)) > 0) {
+        q->stats.vectored++;
+        ret = blk_rw_vec(dev, rq->write, rq->sector, q->segs, nsegs);
+    } else {
+        q->stats.bounced++;
+        if (rq->write) {
+            for (le = list_next(&rq->bios), p = q->bounce; le != &rq->bios; le = list_next(le)) {
+                blk_cursor_t c;
+                bio_cursor(le2bio(le), &c);
+                blk_cursor_copy(&c, p, le2bio(le)->nsecs * BLK_SIZE, 1);
+                p += le2bio(le)->nsecs * BLK_SIZE;
+            }
+            ret = blk_write(dev, rq->sector, q->bounce, rq->nsecs);
+        } else {
+            ret = blk_read(dev, rq->sector, q->bounce, rq->nsecs);
+            for (le = list_next(&rq->bios), p = q->bounce; ret == 0 && le != &rq->bios; le = list_next(le)) {
+                blk_cursor_t c;
+                bio_cursor(le2bio(le), &c);
+                blk_cursor_copy(&c, p, le2bio(le)->nsecs * BLK_SIZE, 0);
+                p += le2bio(le)->nsecs * BLK_SIZE;
+            }
+        }
+    }
+
+    q->stats.requests++;
+    q->stats.sectors += rq->nsecs;
+    if (ret != 0) {
+        q->stats.errors++;
+    }
+
+    uint64_t now = rdtsc();
+    le = list_next(&rq->bios);
+    while (le != &rq->bios) {
+        bio_t *bio = le2bio(le);
+        le = list_next(le);         // end_io may reuse the bio
+        bio->end = now;
+        bio->status = ret == 0 ? BIO_DONE : BIO_ERROR;
+        if (bio->end_io != NULL) {
+            bio->end_io(bio);
+        }
+        wake_up(&bio->wait);
+    }
+
+    intr_save();
+    list_add(&q->free_rqs, &rq->queue_link);
+    q->running = 0;
+    wake_up(&q->rq_wait);
+    intr_restore();
+}
+
+// Dispatch until the queue is empty or another dispatcher has it
+static void blk_queue_run(blk_queue_t *q) {
+    blk_request_t *rq;
+
+    while ((rq = blk_queue_pick(q)) != NULL) {
+        blk_dispatch(q, rq);
+    }
+}
+
+static int blk_dispatcher(void *arg) {
+    blk_queue_t *q = arg;
+
+    while (1) {
+        {
+            intr_save();
+            while (q->nr_queued == 0) {
+                wait_sleep(&q->wait);
+            }
+            intr_restore();
+        }
+        blk_queue_run(q);
+    }
+    return 0;
+}
+
+static void blk_queue_start(blk_queue_t *q) {
+    char name[16] = "kblockd/";
+    int n = 8;
+
+    for (const char *s = q->dev->name; *s != '\0' && n < sizeof(name) - 1; s++) {
+        name[n++] = *s;
+    }
+    name[n] = '\0';
+
+    int pid = kernel_thread(blk_dispatcher, q, name);
+    if (pid <= 0) {
+        cprintf("blk: no dispatcher for %s, bios are dispatched by their waiters\n", q->dev->name);
+        return;
+    }
+    q->thread = pid;
+}
+
+static blk_queue_t *blk_queue_get(block_device_t *dev) {
+    if (dev->queue != NULL) {
+        return dev->queue;
+    }
+    if (nr_queues >= MAX_BLK_DEV) {
+        return NULL;
+    }
+
+    blk_queue_t *q = kmalloc(sizeof(blk_queue_t));
+    uint8_t *bounce = kmalloc(BIO_MAX_SECTORS * BLK_SIZE);
+    if (q == NULL || bounce == NULL) {
+        cprintf("blk: out of memory for the %s queue\n", dev->name);
+        if (q != NULL) {
+            kfree(q);
+        }
+        if (bounce != NULL) {
+            kfree(bounce);
+        }
+        return NULL;
+    }
+
+    memset(q, 0, sizeof(blk_queue_t));
+    q->dev = dev;
+    q->bounce = bounce;
+    list_init(&q->queued);
+    list_init(&q->free_rqs);
+    for (int i = 0; i < BLK_NR_REQUESTS; i++) {
+        list_add_before(&q->free_rqs, &q->rqs[i].queue_link);
+    }
+    wait_queue_init(&q->wait);
+    wait_queue_init(&q->rq_wait);
+    q->sched = IOSCHED_DEFAULT;
+    q->sched->init(q);
+
+    dev->queue = q;
+    queues[nr_queues++] = q;
+    if (dispatch_ok) {
+        blk_queue_start(q);
+    }
+    return q;
+}
+
+void blk_queue_init(void) {
+    dispatch_ok = 1;
+    for (int i = 0; i < nr_queues; i++) {
+        if (queues[i]->thread == 0) {
+            blk_queue_start(queues[i]);
+        }
+    }
+}
+
+/**
+ * Add bio to a queued request it extends
+ * Called with interrupts disabled.
+ */
+static int blk_merge(blk_queue_t *q, bio_t *bio) {
+    list_entry_t *le = &q->queued;
+
+    while ((le = list_next(le)) != &q->queued) {
+        blk_request_t *rq = le2rq(le, queue_link);
+        if (rq->write != bio->write || rq->nsecs + bio->nsecs > BIO_MAX_SECTORS) {
+            continue;
+        }
+        if (rq->sector + rq->nsecs == bio->sector) {
+            list_add_before(&rq->bios, &bio->link);
+        } else if (bio->sector + bio->nsecs == rq->sector) {
+            // Still in place in a sorted list: nothing queued lies in between
+            list_add_after(&rq->bios, &bio->link);
+            rq->sector = bio->sector;
+        } else {
+            continue;
+        }
+        rq->nsecs += bio->nsecs;
+        return 1;
+    }
+    return 0;
+}
+
+void bio_prep(bio_t *bio, block_device_t *dev, int write, uint32_t sector, void *buf, size_t nsecs) {
+    bio->dev = dev;
+    bio->write = write;
+    bio->sector = sector;
+    bio->buf = buf;
+    bio->nsecs = nsecs;
+    bio->segs = NULL;
+    bio->nsegs = 0;
+    bio->end_io = NULL;
+    bio->private = NULL;
+}
+
+int bio_prep_vec(bio_t *bio, block_device_t *dev, int write, uint32_t sector,
+                 const blk_seg_t *segs, int nsegs) {
+    int nsecs = blk_vec_sectors(segs, nsegs);
+
+    if (nsecs < 0) {
+        return -1;
+    }
+    bio_prep(bio, dev, write, sector, NULL, nsecs);
+    bio->segs = segs;
+    bio->nsegs = nsegs;
+    return 0;
+}
+
+int bio_submit(bio_t *bio) {
+    block_device_t *dev = bio->dev;
+
+    if (dev == NULL || (bio->write ? dev->write == NULL : dev->read == NULL) ||
+        bio->nsecs == 0 || bio->nsecs > BIO_MAX_SECTORS ||
+        bio->sector >= dev->size || bio->nsecs > dev->size - bio->sector) {
+        return -1;
+    }
+
+    blk_queue_t *q = blk_queue_get(dev);
+    if (q == NULL) {
+        return -1;
+    }
+
+    int can_sleep = blk_can_sleep(q);
+    bio->status = BIO_PENDING;
+    wait_queue_init(&bio->wait);
+    bio->start = rdtsc();
+
+    intr_save();
+    if (blk_merge(q, bio)) {
+        q->stats.bios++;
+        q->stats.merges++;
+        intr_restore();
+        return 0;
+    }
+
+    while (list_next(&q->free_rqs) == &q->free_rqs) {
+        if (!can_sleep) {
+            intr_restore();
+            return -1;
+        }
+        wait_sleep(&q->rq_wait);
+    }
+
+    blk_request_t *rq = le2rq(list_next(&q->free_rqs), queue_link);
+    list_del(&rq->queue_link);
+    rq->write = bio->write;
+    rq->sector = bio->sector;
+    rq->nsecs = bio->nsecs;
+    list_init(&rq->bios);
+    list_add(&rq->bios, &bio->link);
+
+    list_add_before(&q->queued, &rq->queue_link);
+    q->sched->add(q, rq);
+    q->stats.bios++;
+    if (++q->nr_queued > q->stats.max_queued) {
+        q->stats.max_queued = q->nr_queued;
+    }
+    wake_up(&q->wait);
+    intr_restore();
+    return 0;
+}
+
+int bio_wait(bio_t *bio) {
+    blk_queue_t *q = bio->dev->queue;
+
+    if (q->thread > 0 && blk_can_sleep(q)) {
+        intr_save();
+        while (bio->status == BIO_PENDING) {
+            wait_sleep(&bio->wait);
+        }
+        intr_restore();
+        return bio->status;
+    }
+
+    // Nobody else will dispatch for us: do it here. A dispatcher this
+    // context interrupted cannot finish until it returns.
+    while (bio->status == BIO_PENDING) {
+        if (q->running) {
+            panic("bio_wait: %s dispatcher busy and the caller cannot sleep\n", q->dev->name);
+        }
+        blk_queue_run(q);
+    }
+    return bio->status;
+}
+
+int bio_can_wait(block_device_t *dev) {
+    return dispatch_ok && blk_can_sleep(dev->queue);
+}
+
+int blk_submit_sync(block_device_t *dev, int write, uint32_t sector, void *buf, size_t nsecs) {
+    if (dev == NULL) {
+        return -1;
+    }
+    if (!bio_can_wait(dev)) {
+        return write ? blk_write(dev, sector, buf, nsecs) : blk_read(dev, sector, buf, nsecs);
+    }
+
+    while (nsecs > 0) {
+        bio_t bio;
+        size_t n = nsecs < BIO_MAX_SECTORS ? nsecs : BIO_MAX_SECTORS;
+
+        bio_prep(&bio, dev, write, sector, buf, n);
+        if (bio_submit(&bio) != 0 || bio_wait(&bio) != BIO_DONE) {
+            return -1;
+        }
+        sector += n;
+        buf = (uint8_t *)buf + n * BLK_SIZE;
+        nsecs -= n;
+    }
+    return 0;
+}
+
+int blk_submit_sync_vec(block_device_t *dev, int write, uint32_t sector,
+                        const blk_seg_t *segs, int nsegs) {
+    if (dev == NULL || blk_vec_sectors(segs, nsegs) < 0) {
+        return -1;
+    }
+    if (!bio_can_wait(dev)) {
+        return blk_rw_vec(dev, write, sector, segs, nsegs);
+    }
+
+    // Bios of at most BIO_MAX_SECTORS, split at segment boundaries
+    while (nsegs > 0) {
+        bio_t bio;
+        int n = 0;
+        uint32_t secs = 0;
+
+        while (n < nsegs && secs + segs[n].len / BLK_SIZE <= BIO_MAX_SECTORS) {
+            secs += segs[n++].len / BLK_SIZE;
+        }
+        if (bio_prep_vec(&bio, dev, write, sector, segs, n) != 0 ||
+            bio_submit(&bio) != 0 || bio_wait(&bio) != BIO_DONE) {
+            return -1;
+        }
+        sector += secs;
+        segs += n;
+        nsegs -= n;
+    }
+    return 0;
+}
+
+static iosched_t *iosched_find(const char *name) {
+    for (int i = 0; i < NR_IOSCHEDS; i++) {
+        const char *a = ioscheds[i]->name, *b = name;
+        while (*a && *a == *b) {
+            a++;
+            b++;
+        }
+        if (*a == '\0' && *b == '\0') {
+            return ioscheds[i];
+        }
+    }
+    return NULL;
+}
+
+int blk_set_scheduler(block_device_t *dev, const char *name) {
+    iosched_t *sched = iosched_find(name);
+    blk_queue_t *q;
+
+    if (sched == NULL || (q = blk_queue_get(dev)) == NULL) {
+        return -1;
+    }
+
+    // Hand queued requests to the new scheduler in the old one's order
+    intr_save();
+    list_entry_t moved;
+    blk_request_t *rq;
+    list_init(&moved);
+    while ((rq = q->sched->next(q)) != NULL) {
+        list_add_before(&moved, &rq->sched_link);
+    }
+    q->sched = sched;
+    sched->init(q);
+    while (list_next(&moved) != &moved) {
+        rq = le2rq(list_next(&moved), sched_link);
+        list_del(&rq->sched_link);
+        sched->add(q, rq);
+    }
+    intr_restore();
+    return 0;
+}
+
+void blk_print_queues(void) {
+    if (nr_queues == 0) {
+        cprintf("No request queues yet (created by the first bio)\n");
+    }
+    cprintf("DEVICE  SCHED     BIOS    MERGES  REQUESTS  KB       VECTORED  BOUNCED  ERRORS  MAXQ\n");
+    for (int i = 0; i < nr_queues; i++) {
+        blk_queue_t *q = queues[i];
+        cprintf("%-6s  %-8s  %-6u  %-6u  %-8u  %-7u  %-8u  %-7u  %-6u  %u\n",
+                q->dev->name, q->sched->name, q->stats.bios, q->stats.merges,
+                q->stats.requests, q->stats.sectors / 2, q->stats.vectored, q->stats.bounced,
+                q->stats.errors, q->stats.max_queued);
+    }
+    cprintf("Schedulers:");
+    for (int i = 0; i < NR_IOSCHEDS; i++) {
+        cprintf(" %s", ioscheds[i]->name);
+    }
+    cprintf("\n");
+}
+
+// ioschedbench: random page-sized reads and writes to swap slots the bench
+// allocates itself, IOSCHED_BENCH_DEPTH in flight, once per scheduler
+#define IOSCHED_BENCH_DEPTH     32
+#define IOSCHED_BENCH_SLOTS     256
+#define IOSCHED_BENCH_IOS       1024
+#define IOSCHED_BENCH_SECTORS   (PG_SIZE / BLK_SIZE)
+
+static bio_t bench_bios[IOSCHED_BENCH_DEPTH];
+static bio_t *bench_free[IOSCHED_BENCH_DEPTH];
+static void *bench_bufs[IOSCHED_BENCH_DEPTH];
+static uint32_t bench_lat[IOSCHED_BENCH_IOS];   // us per bio
+static uint32_t bench_slots[IOSCHED_BENCH_SLOTS];
+static volatile int bench_nfree, bench_done, bench_errors;
+static wait_queue_t bench_wait;
+static uint32_t bench_seed;
+
+static uint32_t bench_rand(void) {
+    bench_seed = bench_seed * 1103515245 + 12345;
+    return bench_seed >> 16;
+}
+
+static void bench_end_io(bio_t *bio) {
+    intr_save();
+    bench_lat[bench_done++] = tsc_cycles_to_us(bio->end - bio->start);
+    if (bio->status != BIO_DONE) {
+        bench_errors++;
+    }
+    bench_free[bench_nfree++] = bio;
+    wake_up(&bench_wait);
+    intr_restore();
+}
+
+static void bench_put(bio_t *bio) {
+    intr_save();
+    bench_free[bench_nfree++] = bio;
+    intr_restore();
+}
+
+static bio_t *bench_get(void) {
+    bio_t *bio = NULL;
+
+    intr_save();
+    if (bench_nfree > 0) {
+        bio = bench_free[--bench_nfree];
+    }
+    intr_restore();
+    return bio;
+}
+
+static void bench_sort(uint32_t *a, int n) {
+    for (int i = 1; i < n; i++) {
+        uint32_t v = a[i];
+        int j = i - 1;
+        while (j >= 0 && a[j] > v) {
+            a[j + 1] = a[j];
+            j--;
+        }
+        a[j + 1] = v;
+    }
+}
+
+/**
+ * One run: keep IOSCHED_BENCH_DEPTH bios in flight until all are done
+ * @return elapsed us, 0 on error
+ */
+static uint32_t bench_run(block_device_t *dev, swap_area_t *si, int nslots) {
+    int issued = 0;
+
+    bench_nfree = 0;
+    bench_done = 0;
+    bench_errors = 0;
+    for (int i = 0; i < IOSCHED_BENCH_DEPTH; i++) {
+        bench_free[bench_nfree++] = &bench_bios[i];
+    }
+
+    uint64_t t0 = rdtsc();
+    while (1) {
+        bio_t *bio;
+        while (issued < IOSCHED_BENCH_IOS && (bio = bench_get()) != NULL) {
+            uint32_t slot = bench_slots[bench_rand() % nslots];
+            uint32_t sector = si->start_sector + (slot - si->base) * IOSCHED_BENCH_SECTORS;
+            bio_prep(bio, dev, bench_rand() % 4 == 0, sector,
+                     bench_bufs[bio - bench_bios], IOSCHED_BENCH_SECTORS);
+            bio->end_io = bench_end_io;
+            if (bio_submit(bio) != 0) {
+                bench_put(bio);
+                return 0;
+            }
+            issued++;
+        }
+
+        intr_save();
+        while (bench_done < issued && (issued == IOSCHED_BENCH_IOS || bench_nfree == 0)) {
+            wait_sleep(&bench_wait);
+        }
+        intr_restore();
+        if (bench_done == IOSCHED_BENCH_IOS) {
+            break;
+        }
+    }
+    uint32_t us = tsc_cycles_to_us(rdtsc() - t0);
+    return bench_errors == 0 && us > 0 ? us : 0;
+}
+
+static int iosched_bench_main(void *arg) {
+    swap_area_t *si = arg;
+    block_device_t *dev = si->dev;
+    iosched_t *saved = blk_queue_get(dev)->sched;
+    int nslots = 0;
+
+    // Slots of this area only, so every bio goes to one device
+    for (int i = 0; i < IOSCHED_BENCH_SLOTS; i++) {
+        uint32_t slot = swap_slot_alloc();
+        if (slot == 0) {
+            break;
+        }
+        if (swap_area_of(slot) != si) {
+            swap_slot_free(slot);
+            continue;
+        }
+        bench_slots[nslots++] = slot;
+    }
+
+    int nbufs = 0;
+    for (; nbufs < IOSCHED_BENCH_DEPTH; nbufs++) {
+        if ((bench_bufs[nbufs] = kmalloc(PG_SIZE)) == NULL) {
+            break;
+        }
+    }
+
+    if (nslots < IOSCHED_BENCH_DEPTH || nbufs < IOSCHED_BENCH_DEPTH) {
+        cprintf("ioschedbench: not enough free swap slots or memory\n");
+        goto out;
+    }
+
+    wait_queue_init(&bench_wait);
+    cprintf("\nioschedbench: %d random 4 KB swap-slot I/Os (1 in 4 writes) over %d slots of %s, %d in flight\n",
+            IOSCHED_BENCH_IOS, nslots, dev->name, IOSCHED_BENCH_DEPTH);
+    cprintf("SCHED     IOPS   KB/S   AVG US  P50 US  P99 US  MAX US  REQS  MERGES  AVG SEEK\n");
+
+    for (int s = 0; s < NR_IOSCHEDS; s++) {
+        blk_queue_t *q = dev->queue;
+        blk_set_scheduler(dev, ioscheds[s]->name);
+        blk_queue_stats_t before = q->stats;
+
+        bench_seed = 1;
+        uint32_t us = bench_run(dev, si, nslots);
+        if (us == 0) {
+            cprintf("%-8s  I/O error\n", ioscheds[s]->name);
+            // Let bios still in flight finish before the buffers go away
+            intr_save();
+            while (bench_nfree < IOSCHED_BENCH_DEPTH) {
+                wait_sleep(&bench_wait);
+            }
+            intr_restore();
+            break;
+        }
+
+        uint32_t sum = 0;
+        for (int i = 0; i < IOSCHED_BENCH_IOS; i++) {
+            sum += bench_lat[i];
+        }
+        bench_sort(bench_lat, IOSCHED_BENCH_IOS);
+
+        uint32_t reqs = q->stats.requests - before.requests;
+        uint64_t seek = q->stats.seek_sectors - before.seek_sectors;
+        do_div(seek, reqs ? reqs : 1);
+        uint32_t iops = IOSCHED_BENCH_IOS * 1000000U / us;
+        cprintf("%-8s  %-5u  %-5u  %-6u  %-6u  %-6u  %-6u  %-4u  %-6u  %u\n",
+                ioscheds[s]->name, iops, iops * (PG_SIZE / 1024), sum / IOSCHED_BENCH_IOS,
+                bench_lat[IOSCHED_BENCH_IOS / 2], bench_lat[IOSCHED_BENCH_IOS * 99 / 100],
+                bench_lat[IOSCHED_BENCH_IOS - 1], reqs, q->stats.merges - before.merges,
+                (uint32_t)seek);
+    }
+    blk_set_scheduler(dev, saved->name);
+
+out:
+    for (int i = 0; i < nbufs; i++) {
+        kfree(bench_bufs[i]);
+    }
+    for (int i = 0; i < nslots; i++) {
+        swap_slot_free(bench_slots[i]);
+    }
+    return 0;
+}
+
+void iosched_bench(void) {
+    if (swap_area_count() == 0) {
+        cprintf("ioschedbench: no swap area\n");
+        return;
+    }
+    if (tsc_khz == 0) {
+        cprintf("ioschedbench: TSC not calibrated\n");
+        return;
+    }
+    swap_area_t *si = swap_area_get(0);
+    if (blk_queue_get(si->dev) == NULL) {
+        return;
+    }
+    if (kernel_thread(iosched_bench_main, si, "ioschedbench") <= 0) {
+        cprintf("ioschedbench: cannot start thread\n");
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <base/types.h>
+
+#include "../include/list.h"
+#include "../sched/wait.h"
+#include "blk.h"
+
+// Asynchronous block I/O
+//
+// A bio is one transfer to or from a contiguous buffer or a list of page
+// segments. bio_submit() queues
+// it on the device's request queue and returns; a dispatcher thread per
+// device hands requests to the driver in the order the queue's I/O
+// scheduler picks, and completes each bio by calling its end_io and waking
+// bio_wait(). Bios for adjacent sectors are merged into one request.
+
+#define BIO_MAX_SECTORS     128         // Sectors per request after merging (64 KB)
+#define BLK_NR_REQUESTS     64          // Requests a queue holds before submitters wait
+
+// Deadline scheduler: a request waiting this long is dispatched next
+#define IOSCHED_READ_EXPIRE     50      // ticks (500 ms)
+#define IOSCHED_WRITE_EXPIRE    500     // ticks (5 s)
+
+// Bio states, as for IDE requests
+#define BIO_DONE            0
+#define BIO_ERROR           (-1)
+#define BIO_PENDING         1
+
+typedef struct bio {
+    block_device_t *dev;
+    int write;
+    uint32_t sector;
+    void *buf;                          // flat buffer, or NULL with segs
+    const blk_seg_t *segs;              // page segments (bio_prep_vec)
+    int nsegs;
+    size_t nsecs;                       // at most BIO_MAX_SECTORS
+    volatile int status;                // BIO_*
+    void (*end_io)(struct bio *bio);    // optional, called by the dispatcher; must not submit
+    void *private;                      // for end_io
+    uint64_t start;                     // rdtsc() at submission
+    uint64_t end;                       // rdtsc() at completion
+    wait_queue_t wait;
+    list_entry_t link;                  // link in its request
+} bio_t;
+
+#define le2bio(le) to_struct((le), bio_t, link)
+
+// Bios merged into one transfer of consecutive sectors
+typedef struct blk_request {
+    int write;
+    uint32_t sector;
+    size_t nsecs;
+    int64_t deadline;                   // ticks, for the deadline scheduler
+    list_entry_t bios;                  // in sector order
+    list_entry_t queue_link;            // every queued request, for merging
+    list_entry_t sched_link;            // scheduler's sorted or FIFO list
+    list_entry_t fifo_link;             // scheduler's second list (deadline FIFOs)
+} blk_request_t;
+
+#define le2rq(le, member) to_struct((le), blk_request_t, member)
+
+struct blk_queue;
+
+// I/O scheduler: orders the queued requests of one device
+typedef struct {
+    const char *name;
+    void (*init)(struct blk_queue *q);                    // set up an empty queue
+    void (*add)(struct blk_queue *q, blk_request_t *rq);  // a new request was queued
+    blk_request_t *(*next)(struct blk_queue *q);         // remove the request to dispatch
+} iosched_t;
+
+typedef struct {
+    uint32_t bios;                      // bios submitted
+    uint32_t merges;                    // bios added to a queued request
+    uint32_t requests;                  // requests dispatched to the driver
+    uint32_t sectors;
+    uint32_t vectored;                  // merged requests passed down as one segment list
+    uint32_t bounced;                   // merged requests copied through the bounce buffer
+    uint32_t errors;
+    uint32_t max_queued;                // deepest the queue has been
+    uint64_t seek_sectors;              // head movement between dispatched requests
+} blk_queue_stats_t;
+
+typedef struct blk_queue {
+    block_device_t *dev;
+    iosched_t *sched;
+    list_entry_t queued;                // requests waiting for dispatch
+    list_entry_t sched_lists[3];        // owned by the scheduler
+    uint32_t head;                      // sector after the last dispatched request
+    int nr_queued;
+    int running;                        // a dispatcher is inside a driver call
+    int thread;                         // dispatcher PID, 0 if not started
+    blk_request_t rqs[BLK_NR_REQUESTS];
+    list_entry_t free_rqs;
+    wait_queue_t wait;                  // dispatcher waits for requests
+    wait_queue_t rq_wait;               // submitters wait for a free request
+    uint8_t *bounce;                    // BIO_MAX_SECTORS sectors
+    blk_seg_t segs[BLK_MAX_SEGS];       // merged request being dispatched
+    blk_queue_stats_t stats;
+} blk_queue_t;
+
+// Schedulers
+extern iosched_t iosched_noop;
+extern iosched_t iosched_deadline;
+extern iosched_t iosched_clook;
+
+// Sector-sorted list shared by C-LOOK and deadline: insert, and remove the
+// first request at or above q->head, wrapping to the lowest sector
+void iosched_sort_add(list_entry_t *sorted, blk_request_t *rq);
+blk_request_t *iosched_sort_next(blk_queue_t *q, list_entry_t *sorted);
+
+// Start a dispatcher for every registered device; needs the scheduler.
+// Devices registered later get one on their first bio.
+void blk_queue_init(void);
+
+// Fill in a bio for bio_submit (no end_io)
+void bio_prep(bio_t *bio, block_device_t *dev, int write, uint32_t sector, void *buf, size_t nsecs);
+// Same for page segments, which must stay valid until completion; -1 if malformed
+int bio_prep_vec(bio_t *bio, block_device_t *dev, int write, uint32_t sector,
+                 const blk_seg_t *segs, int nsegs);
+// Queue a bio; 0 on success, -1 if it is invalid or the queue is full and
+// the caller cannot sleep
+int bio_submit(bio_t *bio);
+// Wait for a submitted bio; returns BIO_DONE or BIO_ERROR
+int bio_wait(bio_t *bio);
+
+// 1 if this context may queue bios for dev and sleep in bio_wait; the
+// sync helpers below go straight to the driver otherwise
+int bio_can_wait(block_device_t *dev);
+
+// Synchronous transfer through the queue when the caller can sleep,
+// straight to the driver otherwise (blk_read/blk_write)
+int blk_submit_sync(block_device_t *dev, int write, uint32_t sector, void *buf, size_t nsecs);
+int blk_submit_sync_vec(block_device_t *dev, int write, uint32_t sector,
+                        const blk_seg_t *segs, int nsegs);
+
+// Switch the scheduler of a device (noop, deadline, clook)
+int blk_set_scheduler(block_device_t *dev, const char *name);
+// Scheduler and counters of every device queue
+void blk_print_queues(void);
+
+// Random swap-slot I/O with many bios in flight, under each scheduler
+void iosched_bench(void);
@@ -1,6 +1,10 @@
 #include "blk.h"
 #include "hd.h"
+#include "bcache.h"
 #include "stdio.h"
+#include "memory.h"
+
+#include <arch/x86/mmu.h>
 
 // Block device registry
 static block_device_t *block_devices[MAX_BLK_DEV];
@@ -12,6 +16,7 @@ static block_device_t disk_devs[MAX_BLK_DEV];
 // Forward declarations for disk operations
 static int disk_read_wrapper(block_device_t *dev, uint32_t blockno, void *buf, size_t nblocks);
 static int disk_write_wrapper(block_device_t *dev, uint32_t blockno, const void *buf, size_t nblocks);
+static int disk_rw_vec_wrapper(block_device_t *dev, int write, uint32_t blockno, const blk_seg_t *segs, int nsegs);
 
 /**
  * Initialize block device layer
@@ -38,6 +43,7 @@ void blk_init(void) {
             disk_devs[i].size = ide_dev->info.size;
             disk_devs[i].read = disk_read_wrapper;
             disk_devs[i].write = disk_write_wrapper;
+            disk_devs[i].rw_vec = disk_rw_vec_wrapper;
             disk_devs[i].private_data = (void *)(long)i;  // Store device ID
             
             blk_register(&disk_devs[i]);
@@ -74,6 +80,23 @@ block_device_t *blk_get_device(int type) {
     return NULL;
 }
 
+/**
+ * Get a block device by name (e.g. "hdb")
+ */
+block_device_t *blk_get_device_by_name(const char *name) {
+    for (int i = 0; i < num_devices; i++) {
+        const char *a = block_devices[i]->name, *b = name;
+        while (*a && *a == *b) {
+            a++;
+            b++;
+        }
+        if (*a == '\0' && *b == '\0') {
+            return block_devices[i];
+        }
+    }
+    return NULL;
+}
+
 /**
  * Read blocks from a device
  */
@@ -82,7 +105,11 @@ int blk_read(block_device_t *dev, uint32_t blockno, void *buf, size_t nblocks) {
         return -1;
     }
     
-    return dev->read(dev, blockno, buf, nblocks);
+    int ret = dev->read(dev, blockno, buf, nblocks);
+    if (ret == 0) {
+        bcache_read_overlay(dev, blockno, buf, nblocks);  // newer data not yet written back
+    }
+    return ret;
 }
 
 /**
@@ -93,7 +120,129 @@ int blk_write(block_device_t *dev, uint32_t blockno, const void *buf, size_t nbl
         return -1;
     }
     
-    return dev->write(dev, blockno, buf, nblocks);
+    int ret = dev->write(dev, blockno, buf, nblocks);
+    if (ret == 0) {
+        bcache_write_through(dev, blockno, buf, nblocks);
+    }
+    return ret;
+}
+
+int blk_vec_sectors(const blk_seg_t *segs, int nsegs) {
+    uint32_t bytes = 0;
+
+    if (nsegs <= 0 || nsegs > BLK_MAX_SEGS) {
+        return -1;
+    }
+    for (int i = 0; i < nsegs; i++) {
+        if (segs[i].page == NULL || segs[i].len == 0 || segs[i].len % BLK_SIZE != 0 ||
+            segs[i].offset + segs[i].len > PG_SIZE) {
+            return -1;
+        }
+        bytes += segs[i].len;
+    }
+    return bytes / BLK_SIZE;
+}
+
+/**
+ * Transfer between the disk and page segments
+ * Without a driver rw_vec, runs of segments that follow each other in the
+ * kernel mapping (e.g. consecutive pages) still go as one call.
+ */
+int blk_rw_vec(block_device_t *dev, int write, uint32_t blockno, const blk_seg_t *segs, int nsegs) {
+    int nsecs = blk_vec_sectors(segs, nsegs);
+
+    if (dev == NULL || nsecs < 0 || blockno >= dev->size || nsecs > dev->size - blockno) {
+        return -1;
+    }
+
+    if (dev->rw_vec != NULL) {
+        int ret = dev->rw_vec(dev, write, blockno, segs, nsegs);
+        if (ret != 0) {
+            return ret;
+        }
+        // Coherence with the buffer cache, as in blk_read/blk_write
+        for (int i = 0; i < nsegs; i++) {
+            uint8_t *kva = (uint8_t *)page2kva(segs[i].page) + segs[i].offset;
+            if (write) {
+                bcache_write_through(dev, blockno, kva, segs[i].len / BLK_SIZE);
+            } else {
+                bcache_read_overlay(dev, blockno, kva, segs[i].len / BLK_SIZE);
+            }
+            blockno += segs[i].len / BLK_SIZE;
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < nsegs;) {
+        uint8_t *kva = (uint8_t *)page2kva(segs[i].page) + segs[i].offset;
+        size_t n = segs[i].len / BLK_SIZE;
+        for (i++; i < nsegs && (uint8_t *)page2kva(segs[i].page) + segs[i].offset == kva + n * BLK_SIZE; i++) {
+            n += segs[i].len / BLK_SIZE;
+        }
+        int ret = write ? blk_write(dev, blockno, kva, n) : blk_read(dev, blockno, kva, n);
+        if (ret != 0) {
+            return ret;
+        }
+        blockno += n;
+    }
+    return 0;
+}
+
+void blk_cursor_flat(blk_cursor_t *c, void *buf) {
+    c->buf = buf;
+    c->seg = NULL;
+    c->nsegs = 0;
+    c->left = 0;
+}
+
+void blk_cursor_vec(blk_cursor_t *c, const blk_seg_t *segs, int nsegs) {
+    c->buf = (uint8_t *)page2kva(segs[0].page) + segs[0].offset;
+    c->seg = segs;
+    c->nsegs = nsegs;
+    c->left = segs[0].len;
+}
+
+uint8_t *blk_cursor_map(const blk_cursor_t *c, size_t max, size_t *len) {
+    *len = (c->seg != NULL && c->left < max) ? c->left : max;
+    return c->buf;
+}
+
+void blk_cursor_advance(blk_cursor_t *c, size_t n) {
+    if (c->seg == NULL) {
+        c->buf += n;
+        return;
+    }
+    while (n > 0) {
+        size_t k = n < c->left ? n : c->left;
+        c->buf += k;
+        c->left -= k;
+        n -= k;
+        if (c->left == 0 && c->nsegs > 1) {
+            c->seg++;
+            c->nsegs--;
+            c->buf = (uint8_t *)page2kva(c->seg->page) + c->seg->offset;
+            c->left = c->seg->len;
+        } else if (c->left == 0) {
+            break;      // past the end
+        }
+    }
+}
+
+void blk_cursor_copy(blk_cursor_t *c, void *flat, size_t n, int to_flat) {
+    uint8_t *f = flat;
+
+    while (n > 0) {
+        size_t len;
+        uint8_t *p = blk_cursor_map(c, n, &len);
+        if (to_flat) {
+            memcpy(f, p, len);
+        } else {
+            memcpy(p, f, len);
+        }
+        blk_cursor_advance(c, len);
+        f += len;
+        n -= len;
+    }
 }
 
 /**
@@ -101,16 +250,22 @@ int blk_write(block_device_t *dev, uint32_t blockno, const void *buf, size_t nbl
  */
 void blk_list_devices(void) {
     // Print header
-    cprintf("NAME   MAJ:MIN RM  SIZE RO TYPE MOUNTPOINTS\n");
+    cprintf("NAME   MAJ:MIN RM  SIZE RO TYPE  MOUNTPOINTS\n");
     
+    int nr_md = 0;
     for (int i = 0; i < num_devices; i++) {
         if (block_devices[i]) {
             const char *type_str = "disk";
             const char *mount_str = "";
+            int major = 8, minor = i * 16;
             
             if (block_devices[i]->type == BLK_TYPE_SWAP) {
                 type_str = "disk";
                 mount_str = "[SWAP]";
+            } else if (block_devices[i]->type == BLK_TYPE_MD) {
+                type_str = "raid0";
+                major = 9;                  // md major number
+                minor = nr_md++;
             }
             
             // Calculate size in bytes
@@ -125,15 +280,15 @@ void blk_list_devices(void) {
             
             // Format: NAME   MAJ:MIN RM   SIZE RO TYPE MOUNTPOINTS
             // Now cprintf supports left-align with '-' flag
-            cprintf("%-6s %3d:%-3d %-2d %2d.%dM %-2d %-4s %s\n",
+            cprintf("%-6s %3d:%-3d %-2d %2d.%dM %-2d %-5s %s\n",
                    block_devices[i]->name,  // NAME (left-aligned, 6 chars)
-                   8,                        // MAJ (SCSI disk major number)
-                   i * 16,                   // MIN (minor number)
+                   major,                    // MAJ (8: SCSI disk, 9: md)
+                   minor,                    // MIN (minor number)
                    0,                        // RM (removable: 0=no, 1=yes)
                    size_mb,                  // SIZE integer part
                    decimal,                  // SIZE decimal part (one digit)
                    0,                        // RO (read-only: 0=no, 1=yes)
-                   type_str,                 // TYPE (left-aligned, 4 chars)
+                   type_str,                 // TYPE (left-aligned, 5 chars)
                    mount_str);               // MOUNTPOINTS
         }
     }
@@ -151,3 +306,8 @@ static int disk_write_wrapper(block_device_t *dev, uint32_t blockno, const void
     int dev_id = (int)(long)dev->private_data;
     return hd_write_device(dev_id, blockno, buf, nblocks);
 }
+
+static int disk_rw_vec_wrapper(block_device_t *dev, int write, uint32_t blockno, const blk_seg_t *segs, int nsegs) {
+    int dev_id = (int)(long)dev->private_data;
+    return hd_rw_vec_device(dev_id, write, blockno, segs, nsegs);
+}
@@ -2,13 +2,35 @@
 
 #include <base/types.h>
 
+#include "../mm/pmm.h"
+
 // Block device constants
 #define BLK_SIZE        512             // Standard block size (sector size)
-#define MAX_BLK_DEV     4               // Maximum number of block devices
+#define MAX_BLK_DEV     8               // Maximum number of block devices (IDE, AHCI, virtio, md)
 
 // Block device types
 #define BLK_TYPE_DISK   1               // Hard disk
 #define BLK_TYPE_SWAP   2               // Swap device
+#define BLK_TYPE_MD     3               // RAID-0 array over disks (md.c)
+
+struct blk_queue;
+
+// One piece of a vectored transfer: whole sectors inside one page
+typedef struct {
+    PageDesc *page;
+    uint32_t offset;                    // bytes into the page
+    uint32_t len;                       // bytes, a multiple of BLK_SIZE
+} blk_seg_t;
+
+#define BLK_MAX_SEGS    32              // Segments in one vectored transfer
+
+// Walks the data of a transfer: a flat kernel buffer or a segment list
+typedef struct {
+    uint8_t *buf;                       // next byte
+    const blk_seg_t *seg;               // current segment, NULL for a flat buffer
+    int nsegs;                          // segments from seg on
+    uint32_t left;                      // bytes left in seg
+} blk_cursor_t;
 
 // Block device operations
 typedef struct block_device {
@@ -16,16 +38,37 @@ typedef struct block_device {
     uint32_t size;                      // Size in blocks
     const char *name;                   // Device name
     void *private_data;                 // Private data (e.g., device ID)
+    struct blk_queue *queue;            // Request queue, created by the first bio
     
     // Operations
     int (*read)(struct block_device *dev, uint32_t blockno, void *buf, size_t nblocks);
     int (*write)(struct block_device *dev, uint32_t blockno, const void *buf, size_t nblocks);
+    // Optional: one transfer to or from a segment list (see blk_rw_vec)
+    int (*rw_vec)(struct block_device *dev, int write, uint32_t blockno, const blk_seg_t *segs, int nsegs);
 } block_device_t;
 
 // Block device management functions
 void blk_init(void);
 int blk_register(block_device_t *dev);
 block_device_t *blk_get_device(int type);
+block_device_t *blk_get_device_by_name(const char *name);
 int blk_read(block_device_t *dev, uint32_t blockno, void *buf, size_t nblocks);
 int blk_write(block_device_t *dev, uint32_t blockno, const void *buf, size_t nblocks);
 void blk_list_devices(void);
+
+// Move whole sectors between the disk and a list of page segments.
+// Devices without rw_vec get one read/write per run of segments that are
+// contiguous in the kernel mapping.
+int blk_rw_vec(block_device_t *dev, int write, uint32_t blockno, const blk_seg_t *segs, int nsegs);
+// Sectors covered by a segment list, -1 if a segment is malformed or
+// there are more than BLK_MAX_SEGS
+int blk_vec_sectors(const blk_seg_t *segs, int nsegs);
+
+void blk_cursor_flat(blk_cursor_t *c, void *buf);
+void blk_cursor_vec(blk_cursor_t *c, const blk_seg_t *segs, int nsegs);
+// Kernel address of the next byte; *len gets how many bytes from there
+// are contiguous in the kernel mapping, at most max
+uint8_t *blk_cursor_map(const blk_cursor_t *c, size_t max, size_t *len);
+void blk_cursor_advance(blk_cursor_t *c, size_t n);
+// Copy n bytes between the transfer data and a flat buffer (bounce buffers, PIO)
+void blk_cursor_copy(blk_cursor_t *c, void *flat, size_t n, int to_flat);
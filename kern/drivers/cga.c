@@ -5,6 +5,7 @@
 #include <arch/x86/segments.h>
 
 #include "cons_defs.h"
+#include "memory.h"
 
 // CGA hardware registers
 #define CGA_IDX_REG      0x3D4
@@ -63,11 +64,7 @@ void cga_putc(int c) {
 }
 
 void cga_scrup() {
-    uint16_t *source = crt_buf + CRT_COLS;
-    int count = (CRT_ROWS - 1) * CRT_COLS;
-
-    for (int i = 0; i < count; i++)
-        crt_buf[i] = source[i];
+    memmove(crt_buf, crt_buf + CRT_COLS, (CRT_ROWS - 1) * CRT_COLS * sizeof(uint16_t));
 
     // 使用 `memset` 模拟 `rep stosw`
     uint16_t *clear_start = crt_buf + CRT_COLS * (CRT_ROWS - 1);
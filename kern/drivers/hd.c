@@ -1,14 +1,70 @@
 #include "hd.h"
 #include "stdio.h"
+#include "math.h"
+#include "memory.h"
 
 #include <arch/x86/io.h>
+#include <arch/x86/cpu.h>
+#include <arch/x86/mmu.h>
 #include <arch/x86/drivers/i8259.h>
 #include "pic.h"
+#include "pit.h"
+#include "pci.h"
+#include "intr.h"
+#include "../sched/sched.h"
+#include "../trap/trap.h"
+#include "../mm/pmm.h"
+#include "../mm/slab.h"
+#include "../debug/assert.h"
+
+// Request Queue
+//
+// hd_read_device() and hd_write_device() queue a request on the device's
+// channel and start it if the channel is idle. One command covers up to
+// 256 sectors. The drive interrupts once per data block: a sector, or
+// dev->multiple sectors under READ/WRITE MULTIPLE. hd_intr() moves that
+// block, and when the command is done completes the request and starts
+// the next one in the queue.
+//
+// The issuer sleeps on the request's wait queue while the drive works, so
+// other tasks run during the disk latency. That needs process context:
+// boot code, the idle task and interrupt handlers (shell commands run in
+// the keyboard interrupt, which also holds off the IDE IRQs at the PIC)
+// cannot sleep. They drive the same state machine by polling the status
+// port instead, completing whatever requests are ahead of theirs.
+//
+// Channels
+//
+// hda/hdb (0x1F0, IRQ 14) and hdc/hdd (0x170, IRQ 15) sit on separate
+// channels with their own registers, PRD table and queue, and a command on
+// one does not wait for the other. A channel's queue, registers and
+// counters only change with interrupts disabled: in its interrupt handler,
+// or in an issuer for one queue edit or one ide_service() step, which moves
+// at most one block. Between steps a poller masks just its channel's IRQ
+// line, so the other channel's completions and the timer keep running
+// while it spins. The mask is counted, as a poller in an interrupt handler
+// may have interrupted another.
+//
+// DMA
+//
+// When PCI enumeration finds a bus-master IDE controller (the PIIX in
+// QEMU), commands for drives that report DMA in IDENTIFY use READ/WRITE
+// DMA instead. The buffer is described to the controller by a PRD table
+// of physical ranges; the controller moves the whole command without the
+// CPU and the drive interrupts once at the end. Buffers the table cannot
+// describe (odd addresses, too many pieces) fall back to PIO.
 
 // Global IDE devices
 static ide_device_t ide_devices[MAX_IDE_DEVICES];
 static int num_devices = 0;
 
+static ide_channel_t ide_channels[2];
+static int hd_irq_mode = 1;
+static int hd_multi_mode = 1;
+static int hd_dma_mode = 1;
+static ide_prd_t ide_prdt[2][IDE_PRD_MAX] __attribute__((aligned(PG_SIZE)));
+static hd_stats_t hd_stats;             // sum of the channel counters
+
 // Device initialization configurations
 static const struct {
     uint8_t channel;
@@ -68,6 +124,40 @@ static int hd_wait_data_on_base(uint16_t base) {
 
 
 
+// Wait 400ns for the status register to become valid
+static void hd_delay400(uint16_t base) {
+    for (int i = 0; i < 4; i++) {
+        inb(base + IDE_CONTROL);
+    }
+}
+
+/**
+ * Negotiate READ/WRITE MULTIPLE: the largest power-of-two block up to
+ * IDE_MULTI_MAX that IDENTIFY reports, set with SET MULTIPLE MODE
+ */
+static void hd_setup_multiple(ide_device_t *dev, const uint16_t *id) {
+    uint16_t max = id[IDE_ID_MAX_MULTI] & 0xFF;
+    uint8_t drive_sel = dev->drive ? IDE_DEV_SLAVE : IDE_DEV_MASTER;
+    uint16_t n = 1;
+
+    dev->multiple = 1;
+    while (n * 2 <= max && n * 2 <= IDE_MULTI_MAX) {
+        n *= 2;
+    }
+    if (n == 1) {
+        return;
+    }
+
+    outb(dev->base + IDE_SECTOR_COUNT, n);
+    outb(dev->base + IDE_DEVICE, drive_sel);
+    outb(dev->base + IDE_COMMAND, IDE_CMD_SET_MULTI);
+    hd_delay400(dev->base);
+    if (hd_wait_ready_on_base(dev->base) != 0 || (inb(dev->base + IDE_STATUS) & IDE_ERR)) {
+        return;     // rejected: stay with one sector per interrupt
+    }
+    dev->multiple = n;
+}
+
 /**
  * Detect a single IDE device
  */
@@ -118,6 +208,14 @@ static int hd_detect_device(int dev_id) {
     
     dev->info.valid = 1;
     dev->present = 1;
+    hd_setup_multiple(dev, buf);
+
+    // Tell the controller the drive is set up for DMA (as firmware would)
+    uint16_t bmide = ide_channels[dev->channel].bmide;
+    dev->dma = (bmide != 0 && (buf[IDE_ID_CAPS] & IDE_ID_CAP_DMA));
+    if (dev->dma) {
+        outb(bmide + BM_STATUS, inb(bmide + BM_STATUS) | (BM_ST_DRV0_DMA << dev->drive));
+    }
     
     // Copy device name
     for (int i = 0; i < IDE_NAME_LEN; i++) {
@@ -128,14 +226,51 @@ static int hd_detect_device(int dev_id) {
     return 0;
 }
 
+/**
+ * Find the bus-master registers of a PCI IDE controller
+ * BAR4 holds 16 ports: 8 for the primary channel, then 8 for the secondary.
+ */
+static void hd_dma_init(void) {
+    pci_device_t *pdev = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE);
+
+    if (pdev == NULL || !(pdev->prog_if & 0x80)) {
+        return;     // no controller, or not bus-master capable
+    }
+    uint32_t bar = pci_bar(pdev, 4);
+    if (bar == 0 || bar > 0xFFFF) {
+        return;
+    }
+    pci_enable(pdev, PCI_CMD_IO | PCI_CMD_MASTER);
+
+    for (int c = 0; c < 2; c++) {
+        ide_channels[c].bmide = bar + c * BM_CHANNEL_SIZE;
+        ide_channels[c].prdt = ide_prdt[c];
+        outb(ide_channels[c].bmide + BM_COMMAND, 0);
+        outb(ide_channels[c].bmide + BM_STATUS, BM_ST_IRQ | BM_ST_ERR);
+    }
+    cprintf("hd_init: bus-master DMA at 0x%x\n", bar);
+}
+
 /**
  * Initialize all IDE devices
  */
 void hd_init(void) {
-    // Enable IDE interrupts for both channels
-    pic_enable(IRQ_IDE1);
-    pic_enable(IRQ_IDE2);
-    
+    // Request queues; nIEN clear so the drives raise their IRQ
+    ide_channels[0].base = IDE0_BASE;
+    ide_channels[0].irq = IRQ_IDE1;
+    ide_channels[1].base = IDE1_BASE;
+    ide_channels[1].irq = IRQ_IDE2;
+    for (int c = 0; c < 2; c++) {
+        ide_channels[c].bmide = 0;
+        ide_channels[c].prdt = NULL;
+        list_init(&ide_channels[c].queue);
+        ide_channels[c].masked = 0;
+        memset(&ide_channels[c].stats, 0, sizeof(hd_stats_t));
+        outb(ide_channels[c].base + IDE_CONTROL, 0);
+        pic_enable(ide_channels[c].irq);
+    }
+    hd_dma_init();
+
     // Clear device array
     for (int i = 0; i < MAX_IDE_DEVICES; i++) {
         ide_devices[i].present = 0;
@@ -154,113 +289,468 @@ void hd_init(void) {
     cprintf("hd_init: found %d device(s)\n", num_devices);
 }
 
+// Keep the channel's interrupt handler from racing a poller for the drive.
+// Only a hint: the state itself is guarded by disabling interrupts.
+static void ide_mask(ide_channel_t *ch) {
+    intr_save();
+    if (ch->masked++ == 0) {
+        pic_disable(ch->irq);
+    }
+    intr_restore();
+}
+
+static void ide_unmask(ide_channel_t *ch) {
+    intr_save();
+    assert(ch->masked > 0);
+    if (--ch->masked == 0) {
+        pic_enable(ch->irq);
+    }
+    intr_restore();
+}
+
+// Account for n sectors moved by one data block
+static void ide_advance(ide_channel_t *ch, ide_request_t *req, size_t n) {
+    blk_cursor_advance(&req->data, n * SECTOR_SIZE);
+    req->secno += n;
+    req->nsecs -= n;
+    req->cmd_secs -= n;
+    ch->stats.blocks++;
+}
+
+// Move n sectors between the data port and the request data, a
+// contiguous piece at a time (segments of a vectored request)
+static void ide_pio_move(ide_channel_t *ch, ide_request_t *req, size_t n, int out) {
+    blk_cursor_t c = req->data;
+    size_t left = n * SECTOR_SIZE;
+
+    uint64_t t0 = rdtsc();
+    while (left > 0) {
+        size_t len;
+        uint8_t *p = blk_cursor_map(&c, left, &len);
+        if (out) {
+            outsw(ch->base + IDE_DATA, p, len / 2);
+        } else {
+            insw(ch->base + IDE_DATA, p, len / 2);
+        }
+        blk_cursor_advance(&c, len);
+        left -= len;
+    }
+    ch->stats.xfer_cycles += rdtsc() - t0;
+}
+
+// Move one data block (the last of a command may be short) between the
+// data port and the request data
+static void ide_pio_in(ide_channel_t *ch, ide_request_t *req) {
+    size_t n = req->cmd_secs < req->block ? req->cmd_secs : req->block;
+
+    ide_pio_move(ch, req, n, 0);
+    ide_advance(ch, req, n);
+}
+
+static void ide_pio_out(ide_channel_t *ch, ide_request_t *req) {
+    size_t n = req->cmd_secs < req->block ? req->cmd_secs : req->block;
+
+    ide_pio_move(ch, req, n, 1);
+    ide_advance(ch, req, n);
+
+    // BSY is not guaranteed to show for 400ns; do not mistake that for done
+    hd_delay400(ch->base);
+}
+
 /**
- * Read sectors from specific device
+ * Describe the next n sectors of the request data in the channel's PRD table
+ * The data is walked a page at a time, since virtually contiguous pages
+ * need not be physically contiguous, and a segment at a time for vectored
+ * requests; physically adjacent pieces share an entry as long as it stays
+ * inside one 64K region.
+ * @return 0 on success, -1 if the data needs PIO
  */
-int hd_read_device(int dev_id, uint32_t secno, void *dst, size_t nsecs) {
-    ide_device_t *dev = &ide_devices[dev_id];
-    if (!dev->present) {
-        return -1;
-    }
-    
-    if (secno + nsecs > dev->info.size) {
+static int ide_prd_build(ide_channel_t *ch, ide_request_t *req, size_t n) {
+    blk_cursor_t c = req->data;
+    size_t left = n * SECTOR_SIZE;
+    uint32_t len = 0;           // bytes in the entry being built
+    int nprd = 0;
+
+    if (c.seg == NULL && (uintptr_t)c.buf < KERNEL_BASE) {
         return -1;
     }
-    
-    uint16_t base = dev->base;
-    uint8_t drive_sel = dev->drive ? IDE_DEV_SLAVE : IDE_DEV_MASTER;
-    
-    // Read sectors one by one
-    for (size_t i = 0; i < nsecs; i++) {
-        uint32_t lba = secno + i;
-        
-        // Wait for disk ready
-        if (hd_wait_ready_on_base(base) != 0) {
+
+    while (left > 0) {
+        size_t chunk;
+        uint8_t *p = blk_cursor_map(&c, left, &chunk);
+        if (chunk > PG_SIZE - PG_OFF(p)) {
+            chunk = PG_SIZE - PG_OFF(p);
+        }
+        uint32_t pa = page2pa(kva2page(p)) + PG_OFF(p);
+        if (pa & 1) {
             return -1;
         }
-        
-        // Set sector count to 1
-        outb(base + IDE_SECTOR_COUNT, 1);
-        
-        // Set LBA address
-        outb(base + IDE_LBA_LOW, lba & 0xFF);
-        outb(base + IDE_LBA_MID, (lba >> 8) & 0xFF);
-        outb(base + IDE_LBA_HIGH, (lba >> 16) & 0xFF);
-        
-        // Set device (LBA mode, bits 24-27 of LBA)
-        outb(base + IDE_DEVICE, drive_sel | ((lba >> 24) & 0x0F));
-        
-        // Send read command
-        outb(base + IDE_COMMAND, IDE_CMD_READ);
-        
-        // Wait for data
+
+        ide_prd_t *prd = nprd > 0 ? &ch->prdt[nprd - 1] : NULL;
+        if (prd != NULL && prd->addr + len == pa &&
+            (prd->addr & (PRD_MAX_BYTES - 1)) + len + chunk <= PRD_MAX_BYTES) {
+            len += chunk;
+        } else {
+            if (nprd == IDE_PRD_MAX) {
+                return -1;
+            }
+            if (prd != NULL) {
+                prd->count = len & 0xFFFF;      // 64K is stored as 0
+            }
+            prd = &ch->prdt[nprd++];
+            prd->addr = pa;
+            prd->flags = 0;
+            len = chunk;
+        }
+        blk_cursor_advance(&c, chunk);
+        left -= chunk;
+    }
+
+    ch->prdt[nprd - 1].count = len & 0xFFFF;
+    ch->prdt[nprd - 1].flags = PRD_EOT;
+    return 0;
+}
+
+/**
+ * Issue the read or write command for the next part of req
+ * Drives with a negotiated block size get READ/WRITE MULTIPLE, so one
+ * interrupt covers dev->multiple sectors. For a write the first block is
+ * sent here; the drive interrupts after it.
+ */
+static int ide_issue(ide_channel_t *ch, ide_request_t *req) {
+    ide_device_t *dev = &ide_devices[req->dev_id];
+    uint16_t base = ch->base;
+    uint8_t drive_sel = dev->drive ? IDE_DEV_SLAVE : IDE_DEV_MASTER;
+    uint32_t lba = req->secno;
+    size_t n = req->nsecs < IDE_MAX_SECTORS ? req->nsecs : IDE_MAX_SECTORS;
+
+    if (hd_wait_ready_on_base(base) != 0) {
+        return -1;
+    }
+
+    req->cmd_secs = n;
+    req->block = (hd_multi_mode && dev->multiple > 1) ? dev->multiple : 1;
+    req->dma = (hd_dma_mode && dev->dma && ide_prd_build(ch, req, n) == 0);
+
+    if (req->dma) {
+        // The whole command is one block: the drive interrupts at the end
+        req->block = n;
+        outl(ch->bmide + BM_PRDT, P_ADDR(ch->prdt));
+        outb(ch->bmide + BM_COMMAND, req->write ? 0 : BM_CMD_READ);
+        outb(ch->bmide + BM_STATUS, inb(ch->bmide + BM_STATUS) | BM_ST_IRQ | BM_ST_ERR);
+    }
+
+    outb(base + IDE_SECTOR_COUNT, n & 0xFF);        // 0 means 256
+
+    // Set LBA address
+    outb(base + IDE_LBA_LOW, lba & 0xFF);
+    outb(base + IDE_LBA_MID, (lba >> 8) & 0xFF);
+    outb(base + IDE_LBA_HIGH, (lba >> 16) & 0xFF);
+
+    // Set device (LBA mode, bits 24-27 of LBA)
+    outb(base + IDE_DEVICE, drive_sel | ((lba >> 24) & 0x0F));
+
+    if (req->dma) {
+        outb(base + IDE_COMMAND, req->write ? IDE_CMD_WRITE_DMA : IDE_CMD_READ_DMA);
+        outb(ch->bmide + BM_COMMAND, (req->write ? 0 : BM_CMD_READ) | BM_CMD_START);
+        ch->stats.commands++;
+        ch->stats.dma_cmds++;
+        return 0;
+    } else if (req->block > 1) {
+        outb(base + IDE_COMMAND, req->write ? IDE_CMD_WRITE_MULTI : IDE_CMD_READ_MULTI);
+    } else {
+        outb(base + IDE_COMMAND, req->write ? IDE_CMD_WRITE : IDE_CMD_READ);
+    }
+    ch->stats.commands++;
+
+    if (req->write) {
+        // No interrupt announces the first block of a write
         if (hd_wait_data_on_base(base) != 0) {
             return -1;
         }
-        
-        // Read data
-        void *buf = (void *)((uint8_t *)dst + i * SECTOR_SIZE);
-        insw(base + IDE_DATA, buf, SECTOR_SIZE / 2);
+        ide_pio_out(ch, req);
     }
-    
     return 0;
 }
 
 /**
- * Write sectors to specific device
+ * Start requests from the head of the queue until one is on the drive
  */
-int hd_write_device(int dev_id, uint32_t secno, const void *src, size_t nsecs) {
+static void ide_kick(ide_channel_t *ch) {
+    list_entry_t *le;
+
+    while ((le = list_next(&ch->queue)) != &ch->queue) {
+        ide_request_t *req = le2req(le);
+        if (ide_issue(ch, req) == 0) {
+            return;
+        }
+        list_del(le);
+        req->status = IDE_REQ_ERROR;
+        wake_up(&req->wait);
+    }
+}
+
+// Stop the bus-master engine and acknowledge its status
+static void ide_dma_stop(ide_channel_t *ch) {
+    outb(ch->bmide + BM_COMMAND, 0);
+    outb(ch->bmide + BM_STATUS, inb(ch->bmide + BM_STATUS) | BM_ST_IRQ | BM_ST_ERR);
+}
+
+static void ide_complete(ide_channel_t *ch, ide_request_t *req, int status) {
+    if (req->dma) {
+        ide_dma_stop(ch);
+    }
+    list_del(&req->link);
+    req->status = status;
+    wake_up(&req->wait);
+    ide_kick(ch);
+}
+
+/**
+ * Advance the request on the drive by whatever the drive has finished
+ * Reading the status register also acknowledges the drive's interrupt.
+ * Called with interrupts disabled.
+ * @return 1 if the request made progress
+ */
+static int ide_service(ide_channel_t *ch) {
+    uint8_t status = inb(ch->base + IDE_STATUS);
+
+    if (list_next(&ch->queue) == &ch->queue) {
+        return 0;
+    }
+    ide_request_t *req = le2req(list_next(&ch->queue));
+
+    if (req->dma) {
+        // The controller latches the drive's interrupt once the data is in
+        uint8_t bm_status = inb(ch->bmide + BM_STATUS);
+        if (!(bm_status & (BM_ST_IRQ | BM_ST_ERR)) || (status & IDE_BSY)) {
+            return 0;
+        }
+        if ((bm_status & BM_ST_ERR) || (status & (IDE_ERR | IDE_DF))) {
+            ide_complete(ch, req, IDE_REQ_ERROR);
+            return 1;
+        }
+        ide_dma_stop(ch);
+        ide_advance(ch, req, req->cmd_secs);
+        req->dma = 0;
+    } else if (status & IDE_BSY) {
+        return 0;
+    } else if (status & (IDE_ERR | IDE_DF)) {
+        ide_complete(ch, req, IDE_REQ_ERROR);
+        return 1;
+    } else if (req->write) {
+        if (req->cmd_secs > 0) {
+            // Drive wants the next block
+            if (!(status & IDE_DRQ)) {
+                return 0;
+            }
+            ide_pio_out(ch, req);
+            return 1;
+        }
+        if (status & IDE_DRQ) {
+            return 0;
+        }
+    } else {
+        if (!(status & IDE_DRQ)) {
+            return 0;
+        }
+        ide_pio_in(ch, req);
+        if (req->cmd_secs > 0) {
+            return 1;
+        }
+    }
+
+    // Command finished: continue a long request or complete it
+    if (req->nsecs > 0 && ide_issue(ch, req) == 0) {
+        return 1;
+    }
+    ide_complete(ch, req, req->nsecs > 0 ? IDE_REQ_ERROR : IDE_REQ_DONE);
+    return 1;
+}
+
+void hd_intr(int channel) {
+    ide_channel_t *ch = &ide_channels[channel];
+
+    intr_save();
+    ch->stats.irqs++;
+    if (!ide_service(ch)) {
+        ch->stats.spurious++;
+    }
+    intr_restore();
+}
+
+// Process context with interrupts on: the completion interrupt will arrive
+static int hd_can_sleep(void) {
+    return hd_irq_mode && !in_irq() && (read_eflags() & FL_IF) &&
+           current != NULL && current->pid > 0;
+}
+
+/**
+ * Spin on the status port until req completes
+ * Each step runs with interrupts disabled; between steps only this
+ * channel's line is masked, so the other one keeps completing requests.
+ */
+static void ide_poll(ide_channel_t *ch, ide_request_t *req) {
+    uint64_t t0 = rdtsc(), xfer0 = ch->stats.xfer_cycles;
+    int idle = 0;
+
+    ide_mask(ch);
+    while (req->status == IDE_REQ_PENDING) {
+        intr_save();
+        if (ide_service(ch)) {
+            idle = 0;
+        } else if (++idle > IDE_POLL_LIMIT) {
+            // The drive stopped answering: fail whatever is on it
+            ide_complete(ch, le2req(list_next(&ch->queue)), IDE_REQ_ERROR);
+            idle = 0;
+        }
+        intr_restore();
+    }
+    ide_unmask(ch);
+
+    intr_save();
+    ch->stats.poll_cycles += (rdtsc() - t0) - (ch->stats.xfer_cycles - xfer0);
+    intr_restore();
+}
+
+/**
+ * Queue a transfer and wait for it
+ */
+static int hd_rw(int dev_id, uint32_t secno, const blk_cursor_t *data, size_t nsecs, int write) {
     ide_device_t *dev = &ide_devices[dev_id];
     if (!dev->present) {
         return -1;
     }
-    
+
     if (secno + nsecs > dev->info.size) {
         return -1;
     }
-    
-    uint16_t base = dev->base;
-    uint8_t drive_sel = dev->drive ? IDE_DEV_SLAVE : IDE_DEV_MASTER;
-    
-    // Write sectors one by one
-    for (size_t i = 0; i < nsecs; i++) {
-        uint32_t lba = secno + i;
-        
-        // Wait for disk ready
-        if (hd_wait_ready_on_base(base) != 0) {
-            return -1;
-        }
-        
-        // Set sector count to 1
-        outb(base + IDE_SECTOR_COUNT, 1);
-        
-        // Set LBA address
-        outb(base + IDE_LBA_LOW, lba & 0xFF);
-        outb(base + IDE_LBA_MID, (lba >> 8) & 0xFF);
-        outb(base + IDE_LBA_HIGH, (lba >> 16) & 0xFF);
-        
-        // Set device (LBA mode, bits 24-27 of LBA)
-        outb(base + IDE_DEVICE, drive_sel | ((lba >> 24) & 0x0F));
-        
-        // Send write command
-        outb(base + IDE_COMMAND, IDE_CMD_WRITE);
-        
-        // Wait for disk ready to receive data
-        if (hd_wait_data_on_base(base) != 0) {
-            return -1;
-        }
-        
-        // Write data
-        const void *buf = (const void *)((const uint8_t *)src + i * SECTOR_SIZE);
-        outsw(base + IDE_DATA, buf, SECTOR_SIZE / 2);
-        
-        // Wait for write to complete
-        if (hd_wait_ready_on_base(base) != 0) {
-            return -1;
+    if (nsecs == 0) {
+        return 0;
+    }
+
+    ide_channel_t *ch = &ide_channels[dev->channel];
+    ide_request_t req;
+    req.dev_id = dev_id;
+    req.write = write;
+    req.secno = secno;
+    req.data = *data;
+    req.nsecs = nsecs;
+    req.cmd_secs = 0;
+    req.block = 1;
+    req.dma = 0;
+    req.status = IDE_REQ_PENDING;
+    wait_queue_init(&req.wait);
+
+    // Decided before intr_save() clears IF, which hd_can_sleep() tests
+    int sleep = hd_can_sleep();
+
+    intr_save();
+    ch->stats.requests++;
+    int idle = (list_next(&ch->queue) == &ch->queue);
+    list_add_before(&ch->queue, &req.link);
+    if (idle) {
+        ide_kick(ch);
+    }
+
+    if (sleep) {
+        uint64_t t0 = rdtsc();
+        ch->stats.slept++;
+        while (req.status == IDE_REQ_PENDING) {
+            wait_sleep(&req.wait);
         }
+        ch->stats.sleep_cycles += rdtsc() - t0;
+        intr_restore();
+    } else {
+        ch->stats.polled++;
+        intr_restore();
+        ide_poll(ch, &req);
     }
-    
-    return 0;
+
+    return req.status == IDE_REQ_DONE ? 0 : -1;
+}
+
+/**
+ * Read sectors from specific device
+ */
+int hd_read_device(int dev_id, uint32_t secno, void *dst, size_t nsecs) {
+    blk_cursor_t data;
+    blk_cursor_flat(&data, dst);
+    return hd_rw(dev_id, secno, &data, nsecs, 0);
+}
+
+/**
+ * Write sectors to specific device
+ */
+int hd_write_device(int dev_id, uint32_t secno, const void *src, size_t nsecs) {
+    blk_cursor_t data;
+    blk_cursor_flat(&data, (void *)src);
+    return hd_rw(dev_id, secno, &data, nsecs, 1);
+}
+
+/**
+ * Transfer between sectors and page segments with one request
+ * Under DMA each segment becomes PRD entries (merged where physically
+ * adjacent); under PIO the data port is read into each piece in turn.
+ */
+int hd_rw_vec_device(int dev_id, int write, uint32_t secno, const blk_seg_t *segs, int nsegs) {
+    int nsecs = blk_vec_sectors(segs, nsegs);
+    blk_cursor_t data;
+
+    if (nsecs < 0) {
+        return -1;
+    }
+    blk_cursor_vec(&data, segs, nsegs);
+    return hd_rw(dev_id, secno, &data, nsecs, write);
+}
+
+void hd_set_irq_mode(int on) {
+    hd_irq_mode = on ? 1 : 0;
+}
+
+int hd_get_irq_mode(void) {
+    return hd_irq_mode;
+}
+
+void hd_set_multi_mode(int on) {
+    hd_multi_mode = on ? 1 : 0;
+}
+
+void hd_set_dma_mode(int on) {
+    hd_dma_mode = on ? 1 : 0;
+}
+
+const hd_stats_t *hd_get_stats(void) {
+    intr_save();
+    memset(&hd_stats, 0, sizeof(hd_stats));
+    for (int c = 0; c < 2; c++) {
+        const hd_stats_t *st = &ide_channels[c].stats;
+        hd_stats.requests += st->requests;
+        hd_stats.commands += st->commands;
+        hd_stats.dma_cmds += st->dma_cmds;
+        hd_stats.blocks += st->blocks;
+        hd_stats.irqs += st->irqs;
+        hd_stats.spurious += st->spurious;
+        hd_stats.slept += st->slept;
+        hd_stats.polled += st->polled;
+        hd_stats.poll_cycles += st->poll_cycles;
+        hd_stats.xfer_cycles += st->xfer_cycles;
+        hd_stats.sleep_cycles += st->sleep_cycles;
+    }
+    intr_restore();
+    return &hd_stats;
+}
+
+const hd_stats_t *hd_get_channel_stats(int channel) {
+    return &ide_channels[channel].stats;
+}
+
+void hd_reset_stats(void) {
+    intr_save();
+    for (int c = 0; c < 2; c++) {
+        memset(&ide_channels[c].stats, 0, sizeof(hd_stats_t));
+    }
+    intr_restore();
 }
 
 /**
@@ -353,4 +843,284 @@ void hd_test(void) {
     }
     
     cprintf("=== Multi-Disk Test Complete ===\n\n");
-}
\ No newline at end of file
+}
+
+// hdbench: read HD_BENCH_MB from the first disk, first in HD_BENCH_CHUNK-
+// sector requests by PIO and DMA, polled and interrupt driven, then at each
+// transfer size with and without block mode. Shell commands run in the keyboard
+// interrupt and would always poll, so it runs in its own kernel thread.
+#define HD_BENCH_MB     2
+#define HD_BENCH_CHUNK  128
+
+static const int hd_bench_sizes[] = {1, 8, 64, 256};
+
+static const struct {
+    const char *name;
+    int irq, dma;
+} hd_bench_modes[] = {
+    {"pio-poll", 0, 0},
+    {"pio-irq",  1, 0},
+    {"dma-poll", 0, 1},
+    {"dma-irq",  1, 1},
+};
+
+static uint32_t hd_bench_per_mb(uint64_t cycles) {
+    return tsc_cycles_to_us(cycles) / HD_BENCH_MB;
+}
+
+/**
+ * Read HD_BENCH_MB in nsecs-sector requests with the current modes
+ * @return elapsed milliseconds, 0 on a read error
+ */
+static uint32_t hd_bench_time(int dev_id, uint8_t *buf, int nsecs) {
+    uint32_t total = HD_BENCH_MB * 2048;
+
+    uint64_t t0 = rdtsc();
+    for (uint32_t sec = 0; sec < total; sec += nsecs) {
+        if (hd_read_device(dev_id, sec, buf, nsecs) != 0) {
+            return 0;
+        }
+    }
+    uint32_t ms = tsc_cycles_to_us(rdtsc() - t0) / 1000;
+    return ms ? ms : 1;
+}
+
+// Same, with the counters starting from zero
+static uint32_t hd_bench_read(int dev_id, uint8_t *buf, int nsecs) {
+    hd_reset_stats();
+    return hd_bench_time(dev_id, buf, nsecs);
+}
+
+static uint32_t hd_bench_kbs(uint32_t ms) {
+    return HD_BENCH_MB * 1024 * 1000 / ms;
+}
+
+static int hd_bench_main(void *arg) {
+    int dev_id = (int)(long)arg;
+    uint8_t *buf = kmalloc(IDE_MAX_SECTORS * SECTOR_SIZE);
+    int saved_irq = hd_irq_mode, saved_multi = hd_multi_mode, saved_dma = hd_dma_mode;
+
+    if (buf == NULL) {
+        cprintf("hdbench: out of memory\n");
+        return -1;
+    }
+
+    cprintf("\nhdbench: %d MB from %s in %d KB reads\n",
+            HD_BENCH_MB, ide_devices[dev_id].name, HD_BENCH_CHUNK * SECTOR_SIZE / 1024);
+    cprintf("MODE      KB/S    CPU  WAIT US/MB  XFER US/MB  SLEEP US/MB  IRQS\n");
+
+    hd_set_multi_mode(1);
+    for (int i = 0; i < sizeof(hd_bench_modes) / sizeof(hd_bench_modes[0]); i++) {
+        if (hd_bench_modes[i].dma && !ide_devices[dev_id].dma) {
+            cprintf("%-8s  no DMA controller\n", hd_bench_modes[i].name);
+            continue;
+        }
+        hd_set_irq_mode(hd_bench_modes[i].irq);
+        hd_set_dma_mode(hd_bench_modes[i].dma);
+        uint32_t ms = hd_bench_read(dev_id, buf, HD_BENCH_CHUNK);
+        if (ms == 0) {
+            cprintf("%-8s  read error\n", hd_bench_modes[i].name);
+            continue;
+        }
+        // CPU busy: spinning on the drive plus copying through the data port
+        const hd_stats_t *st = hd_get_stats();
+        uint32_t busy_us = tsc_cycles_to_us(st->poll_cycles + st->xfer_cycles);
+        uint32_t cpu = busy_us / (ms * 10);
+        cprintf("%-8s  %-6u  %-2u%c  %-10u  %-10u  %-11u  %u\n",
+                hd_bench_modes[i].name, hd_bench_kbs(ms), cpu > 100 ? 100 : cpu, '%',
+                hd_bench_per_mb(st->poll_cycles),
+                hd_bench_per_mb(st->xfer_cycles),
+                hd_bench_per_mb(st->sleep_cycles),
+                st->irqs);
+    }
+    cprintf("CPU is the share of the run the CPU was busy with the disk. WAIT is\n"
+            "time spent spinning on the drive, XFER copying through the data\n"
+            "port; SLEEP is time the CPU was free for other tasks.\n");
+
+    // Block mode only matters for PIO
+    hd_set_irq_mode(1);
+    hd_set_dma_mode(0);
+    cprintf("\nTransfer size, PIO interrupt driven (block mode: %d sectors)\n",
+            ide_devices[dev_id].multiple);
+    cprintf("SECTORS  KB/S SINGLE  KB/S MULTI  CMDS  BLOCKS SINGLE  BLOCKS MULTI\n");
+    for (int i = 0; i < sizeof(hd_bench_sizes) / sizeof(hd_bench_sizes[0]); i++) {
+        int nsecs = hd_bench_sizes[i];
+        uint32_t ms[2], blocks[2], cmds = 0;
+
+        for (int multi = 0; multi < 2; multi++) {
+            hd_set_multi_mode(multi);
+            ms[multi] = hd_bench_read(dev_id, buf, nsecs);
+            blocks[multi] = hd_get_stats()->blocks;
+            cmds = hd_get_stats()->commands;
+        }
+        if (ms[0] == 0 || ms[1] == 0) {
+            cprintf("%-7d  read error\n", nsecs);
+            continue;
+        }
+        cprintf("%-7d  %-11u  %-10u  %-4u  %-13u  %u\n",
+                nsecs, hd_bench_kbs(ms[0]), hd_bench_kbs(ms[1]), cmds, blocks[0], blocks[1]);
+    }
+
+    hd_set_irq_mode(saved_irq);
+    hd_set_multi_mode(saved_multi);
+    hd_set_dma_mode(saved_dma);
+    kfree(buf);
+    return 0;
+}
+
+void hd_bench(void) {
+    int dev_id = 0;
+    while (dev_id < MAX_IDE_DEVICES &&
+           (!ide_devices[dev_id].present || ide_devices[dev_id].info.size < HD_BENCH_MB * 2048)) {
+        dev_id++;
+    }
+    if (dev_id == MAX_IDE_DEVICES) {
+        cprintf("hdbench: no disk with %d MB\n", HD_BENCH_MB);
+        return;
+    }
+    if (tsc_khz == 0) {
+        cprintf("hdbench: TSC not calibrated\n");
+        return;
+    }
+
+    int pid = kernel_thread(hd_bench_main, (void *)(long)dev_id, "hdbench");
+    if (pid <= 0) {
+        cprintf("hdbench: cannot start thread\n");
+    }
+}
+
+// hdstream: HD_BENCH_MB of sequential reads from each drive of a pair, one
+// drive at a time and then both at once from two threads. hdb and hdc are
+// on separate channels and should overlap; hda and hdb share the primary
+// channel, whose requests queue behind each other. Interrupt driven, so a
+// reader sleeps while its drive works and the other can issue.
+static const struct {
+    int dev[2];
+} hd_stream_pairs[] = {
+    {{1, 2}},                           // hdb + hdc
+    {{0, 1}},                           // hda + hdb
+};
+
+typedef struct {
+    int dev_id;
+    uint32_t ms;                        // 0 on a read error
+} hd_stream_t;
+
+static wait_queue_t hd_stream_wait;
+static volatile int hd_stream_running;
+
+static int hd_stream_worker(void *arg) {
+    hd_stream_t *st = arg;
+    uint8_t *buf = kmalloc(HD_BENCH_CHUNK * SECTOR_SIZE);
+
+    st->ms = 0;
+    if (buf != NULL) {
+        st->ms = hd_bench_time(st->dev_id, buf, HD_BENCH_CHUNK);
+        kfree(buf);
+    }
+
+    intr_save();
+    hd_stream_running--;
+    wake_up(&hd_stream_wait);
+    intr_restore();
+    return 0;
+}
+
+static int hd_stream_usable(int dev_id) {
+    return ide_devices[dev_id].present && ide_devices[dev_id].info.size >= HD_BENCH_MB * 2048;
+}
+
+/**
+ * Read from both drives at once
+ * @return elapsed milliseconds until both finished, 0 on an error
+ */
+static uint32_t hd_stream_both(hd_stream_t st[2]) {
+    hd_reset_stats();
+    hd_stream_running = 2;
+    uint64_t t0 = rdtsc();
+    for (int i = 0; i < 2; i++) {
+        if (kernel_thread(hd_stream_worker, &st[i], "hdstream") <= 0) {
+            st[i].ms = 0;
+            intr_save();
+            hd_stream_running--;
+            intr_restore();
+        }
+    }
+
+    intr_save();
+    while (hd_stream_running > 0) {
+        wait_sleep(&hd_stream_wait);
+    }
+    intr_restore();
+
+    uint32_t ms = tsc_cycles_to_us(rdtsc() - t0) / 1000;
+    if (st[0].ms == 0 || st[1].ms == 0) {
+        return 0;
+    }
+    return ms ? ms : 1;
+}
+
+static int hd_stream_main(void *arg) {
+    uint8_t *buf = kmalloc(HD_BENCH_CHUNK * SECTOR_SIZE);
+    int saved_irq = hd_irq_mode;
+
+    if (buf == NULL) {
+        cprintf("hdstream: out of memory\n");
+        return -1;
+    }
+    wait_queue_init(&hd_stream_wait);
+    hd_set_irq_mode(1);
+
+    cprintf("\nhdstream: %d MB from each drive in %d KB reads (%s)\n", HD_BENCH_MB,
+            HD_BENCH_CHUNK * SECTOR_SIZE / 1024, hd_dma_mode ? "DMA where supported" : "PIO");
+    cprintf("DRIVES   CHANNELS  ALONE KB/S   TOGETHER KB/S  TOTAL KB/S  SPEEDUP  CMDS CH0/CH1\n");
+    for (int p = 0; p < sizeof(hd_stream_pairs) / sizeof(hd_stream_pairs[0]); p++) {
+        const int *dev = hd_stream_pairs[p].dev;
+        const ide_device_t *a = &ide_devices[dev[0]], *b = &ide_devices[dev[1]];
+        uint32_t alone[2];
+        hd_stream_t st[2];
+
+        if (!hd_stream_usable(dev[0]) || !hd_stream_usable(dev[1])) {
+            cprintf("%s+%s  needs both drives with %d MB\n", a->name, b->name, HD_BENCH_MB);
+            continue;
+        }
+
+        alone[0] = hd_bench_time(dev[0], buf, HD_BENCH_CHUNK);
+        alone[1] = hd_bench_time(dev[1], buf, HD_BENCH_CHUNK);
+        st[0].dev_id = dev[0];
+        st[1].dev_id = dev[1];
+        uint32_t ms = (alone[0] && alone[1]) ? hd_stream_both(st) : 0;
+        if (ms == 0) {
+            cprintf("%s+%s  read error\n", a->name, b->name);
+            continue;
+        }
+
+        // Speedup of the overlapped run over reading one drive after the other
+        uint32_t speedup = (alone[0] + alone[1]) * 10 / ms;
+        cprintf("%s+%s  %u,%u       %-5u/%-5u  %-5u/%-7u  %-10u  %u.%ux     %u/%u\n",
+                a->name, b->name, a->channel, b->channel,
+                hd_bench_kbs(alone[0]), hd_bench_kbs(alone[1]),
+                hd_bench_kbs(st[0].ms), hd_bench_kbs(st[1].ms),
+                hd_bench_kbs(ms) * 2, speedup / 10, speedup % 10,
+                hd_get_channel_stats(0)->commands, hd_get_channel_stats(1)->commands);
+    }
+    cprintf("ALONE reads each drive with the other idle; TOGETHER reads both at\n"
+            "once. TOTAL is the combined rate of the overlapped run, and SPEEDUP\n"
+            "compares it with reading one drive after the other.\n");
+
+    hd_set_irq_mode(saved_irq);
+    kfree(buf);
+    return 0;
+}
+
+void hd_stream_bench(void) {
+    if (tsc_khz == 0) {
+        cprintf("hdstream: TSC not calibrated\n");
+        return;
+    }
+
+    int pid = kernel_thread(hd_stream_main, NULL, "hdstream");
+    if (pid <= 0) {
+        cprintf("hdstream: cannot start thread\n");
+    }
+}
@@ -2,6 +2,10 @@
 
 #include <base/types.h>
 
+#include "../include/list.h"
+#include "../sched/wait.h"
+#include "blk.h"
+
 // IDE/ATA disk constants
 #define SECTOR_SIZE         512         // Bytes per sector
 #define IDE0_BASE           0x1F0       // Primary IDE controller base
@@ -21,6 +25,9 @@
 #define IDE_COMMAND         0x7         // Command register (write)
 #define IDE_CONTROL         0x206       // Control register (alternate status)
 
+// IDE control register bits
+#define IDE_CTRL_NIEN       0x02        // Disable the device interrupt
+
 // IDE status bits
 #define IDE_BSY             0x80        // Busy
 #define IDE_DRDY            0x40        // Drive ready
@@ -32,6 +39,40 @@
 #define IDE_CMD_READ        0x20        // Read sectors
 #define IDE_CMD_WRITE       0x30        // Write sectors
 #define IDE_CMD_IDENTIFY    0xEC        // Identify device
+#define IDE_CMD_READ_MULTI  0xC4        // Read sectors, one interrupt per block
+#define IDE_CMD_WRITE_MULTI 0xC5        // Write sectors, one interrupt per block
+#define IDE_CMD_SET_MULTI   0xC6        // Set sectors per block for the above
+#define IDE_CMD_READ_DMA    0xC8        // Read sectors by bus-master DMA
+#define IDE_CMD_WRITE_DMA   0xCA        // Write sectors by bus-master DMA
+
+// IDENTIFY data words
+#define IDE_ID_MAX_MULTI    47          // Low byte: largest block SET MULTIPLE accepts
+#define IDE_ID_CAPS         49          // Capabilities
+#define IDE_ID_CAP_DMA      0x0100      // DMA supported
+
+// Bus-master IDE registers (relative to the channel's BAR4 block)
+#define BM_COMMAND          0x0         // Start/stop and direction
+#define BM_STATUS           0x2         // Write 1 to clear IRQ/ERR
+#define BM_PRDT             0x4         // Physical address of the PRD table
+#define BM_CHANNEL_SIZE     8           // Secondary channel registers follow the primary's
+
+#define BM_CMD_START        0x01        // Start the transfer
+#define BM_CMD_READ         0x08        // Device to memory (clear: memory to device)
+#define BM_ST_ACTIVE        0x01        // Transfer in progress
+#define BM_ST_ERR           0x02        // PCI error during the transfer
+#define BM_ST_IRQ           0x04        // The drive raised its interrupt
+#define BM_ST_DRV0_DMA      0x20        // Master configured for DMA (bit 6: slave)
+
+// Physical region descriptor: one contiguous piece of the buffer
+typedef struct {
+    uint32_t addr;                      // physical address, even
+    uint16_t count;                     // bytes, 0 means 64K
+    uint16_t flags;                     // PRD_EOT on the last entry
+} ide_prd_t;
+
+#define PRD_EOT             0x8000
+#define PRD_MAX_BYTES       0x10000     // An entry may not cross a 64K boundary
+#define IDE_PRD_MAX         64          // Entries per channel table
 
 // Device selection
 #define IDE_DEV_MASTER      0xE0        // Master device (LBA mode)
@@ -39,6 +80,10 @@
 
 #define IDE_NAME_LEN       8           // Device name length
 
+#define IDE_MAX_SECTORS     256         // Sectors per READ/WRITE command
+#define IDE_MULTI_MAX       16          // Largest block requested with SET MULTIPLE
+#define IDE_POLL_LIMIT      1000000     // Status reads without progress before a polled request fails
+
 // Disk info structure
 typedef struct {
     uint32_t size;                      // Size in sectors
@@ -56,15 +101,92 @@ typedef struct {
     uint8_t irq;                        // IRQ number
     disk_info_t info;                   // Disk information
     int present;                        // Device is present
+    uint16_t multiple;                  // Sectors per block (READ/WRITE MULTIPLE), 1 if unsupported
+    int dma;                            // Drive and controller can do bus-master DMA
     char name[IDE_NAME_LEN];            // Device name (hda, hdb, hdc, hdd)
 } ide_device_t;
 
+// Request states
+#define IDE_REQ_DONE        0
+#define IDE_REQ_ERROR       (-1)
+#define IDE_REQ_PENDING     1
+
+// One synchronous transfer, queued on its channel until the drive is free.
+// The fields advance as sectors move, so a request bigger than one command
+// is reissued from where it stopped.
+typedef struct ide_request {
+    int dev_id;
+    int write;                          // 1 = write, 0 = read
+    uint32_t secno;                     // next sector
+    blk_cursor_t data;                  // next byte (flat buffer or page segments)
+    size_t nsecs;                       // sectors not yet transferred
+    size_t cmd_secs;                    // sectors left in the command in flight
+    size_t block;                       // sectors per interrupt for that command
+    int dma;                            // that command moves data by DMA
+    volatile int status;                // IDE_REQ_*
+    wait_queue_t wait;                  // issuer sleeping until completion
+    list_entry_t link;                  // link in the channel queue
+} ide_request_t;
+
+#define le2req(le) to_struct((le), ide_request_t, link)
+
+// Driver counters (hdbench), kept per channel
+typedef struct {
+    uint32_t requests;                  // hd_read_device / hd_write_device calls
+    uint32_t commands;                  // READ/WRITE (MULTIPLE/DMA) commands issued
+    uint32_t dma_cmds;                  // of which bus-master DMA
+    uint32_t blocks;                    // data blocks moved (one per interrupt)
+    uint32_t irqs;                      // IDE interrupts taken
+    uint32_t spurious;                  // interrupts with nothing to do
+    uint32_t slept;                     // requests whose issuer slept
+    uint32_t polled;                    // requests whose issuer spun
+    uint64_t poll_cycles;               // issuers spinning on the status port
+    uint64_t xfer_cycles;               // moving data through the data port
+    uint64_t sleep_cycles;              // issuers asleep (CPU free for others)
+} hd_stats_t;
+
+// Both drives on a channel share one controller, so requests queue per
+// channel; the two channels run their commands independently
+typedef struct {
+    uint16_t base;                      // Base I/O port
+    uint8_t irq;                        // IRQ line, masked while a poller spins
+    int masked;                         // pollers spinning (nested from interrupts)
+    uint16_t bmide;                     // Bus-master registers, 0 without a PCI controller
+    ide_prd_t *prdt;                    // PRD table for the command in flight
+    list_entry_t queue;                 // pending requests; the head is on the drive
+    hd_stats_t stats;
+} ide_channel_t;
+
 // Function declarations - Multi-device API
 void hd_init(void);
 int hd_read_device(int dev_id, uint32_t secno, void *dst, size_t nsecs);
 int hd_write_device(int dev_id, uint32_t secno, const void *src, size_t nsecs);
+// One request for a list of page segments (whole sectors each)
+int hd_rw_vec_device(int dev_id, int write, uint32_t secno, const blk_seg_t *segs, int nsegs);
 ide_device_t *hd_get_device(int dev_id);
 int hd_get_device_count(void);
 
+// IDE interrupt for channel 0 (IRQ 14) or 1 (IRQ 15)
+void hd_intr(int channel);
+
+// 1: issuers sleep until the completion interrupt; 0: always poll
+void hd_set_irq_mode(int on);
+int hd_get_irq_mode(void);
+// 1: READ/WRITE MULTIPLE on drives that negotiated a block size; 0: one sector per interrupt
+void hd_set_multi_mode(int on);
+// 1: bus-master DMA on drives that support it; 0: PIO only
+void hd_set_dma_mode(int on);
+// Counters summed over both channels, or of one channel
+const hd_stats_t *hd_get_stats(void);
+const hd_stats_t *hd_get_channel_stats(int channel);
+void hd_reset_stats(void);
+
+// Throughput and CPU time per MB for PIO and DMA, polled and interrupt
+// driven, and throughput across transfer sizes with and without block mode
+void hd_bench(void);
+// Sequential reads from hdb and hdc, one at a time and both at once, and
+// from two drives sharing a channel for comparison
+void hd_stream_bench(void);
+
 // Test function
 void hd_test(void);
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "bio.h"
+
+// C-LOOK: sweep the disk in ascending sector order from where the last
+// request ended, then jump back to the lowest queued sector. Seeks stay
+// short and every request is reached within one sweep, but a stream of
+// requests just ahead of the head can keep pushing the rest back.
+
+void iosched_sort_add(list_entry_t *sorted, blk_request_t *rq) {
+    list_entry_t *le = sorted;
+
+    // Usually near the end: scan from the highest sector down
+    while ((le = list_prev(le)) != sorted) {
+        if (le2rq(le, sched_link)->sector <= rq->sector) {
+            break;
+        }
+    }
+    list_add_after(le, &rq->sched_link);
+}
+
+blk_request_t *iosched_sort_next(blk_queue_t *q, list_entry_t *sorted) {
+    list_entry_t *le = sorted;
+
+    if (list_next(sorted) == sorted) {
+        return NULL;
+    }
+    while ((le = list_next(le)) != sorted) {
+        if (le2rq(le, sched_link)->sector >= q->head) {
+            break;
+        }
+    }
+    if (le == sorted) {
+        le = list_next(sorted);     // wrap to the lowest sector
+    }
+    list_del(le);
+    return le2rq(le, sched_link);
+}
+
+static void clook_init(blk_queue_t *q) {
+    list_init(&q->sched_lists[0]);
+}
+
+static void clook_add(blk_queue_t *q, blk_request_t *rq) {
+    iosched_sort_add(&q->sched_lists[0], rq);
+}
+
+static blk_request_t *clook_next(blk_queue_t *q) {
+    return iosched_sort_next(q, &q->sched_lists[0]);
+}
+
+iosched_t iosched_clook = {
+    .name = "clook",
+    .init = clook_init,
+    .add = clook_add,
+    .next = clook_next,
+};
@@ -0,0 +1,58 @@
+#include "bio.h"
+#include "pit.h"
+
+// deadline: C-LOOK order, plus a FIFO per direction. When the oldest read
+// (or, failing that, write) has waited past its expiry it goes next, which
+// bounds the latency C-LOOK alone can starve. Reads expire sooner because
+// a task is usually blocked on them.
+
+#define DL_SORTED   0
+#define DL_READS    1
+#define DL_WRITES   2
+
+static void deadline_init(blk_queue_t *q) {
+    list_init(&q->sched_lists[DL_SORTED]);
+    list_init(&q->sched_lists[DL_READS]);
+    list_init(&q->sched_lists[DL_WRITES]);
+}
+
+static void deadline_add(blk_queue_t *q, blk_request_t *rq) {
+    rq->deadline = ticks + (rq->write ? IOSCHED_WRITE_EXPIRE : IOSCHED_READ_EXPIRE);
+    iosched_sort_add(&q->sched_lists[DL_SORTED], rq);
+    list_add_before(&q->sched_lists[rq->write ? DL_WRITES : DL_READS], &rq->fifo_link);
+}
+
+// Oldest request of one direction if it has expired
+static blk_request_t *deadline_expired(blk_queue_t *q, int fifo) {
+    list_entry_t *le = list_next(&q->sched_lists[fifo]);
+    if (le == &q->sched_lists[fifo]) {
+        return NULL;
+    }
+    blk_request_t *rq = le2rq(le, fifo_link);
+    return ticks >= rq->deadline ? rq : NULL;
+}
+
+static blk_request_t *deadline_next(blk_queue_t *q) {
+    blk_request_t *rq = deadline_expired(q, DL_READS);
+
+    if (rq == NULL) {
+        rq = deadline_expired(q, DL_WRITES);
+    }
+    if (rq != NULL) {
+        list_del(&rq->sched_link);
+    } else {
+        rq = iosched_sort_next(q, &q->sched_lists[DL_SORTED]);
+        if (rq == NULL) {
+            return NULL;
+        }
+    }
+    list_del(&rq->fifo_link);
+    return rq;
+}
+
+iosched_t iosched_deadline = {
+    .name = "deadline",
+    .init = deadline_init,
+    .add = deadline_add,
+    .next = deadline_next,
+};
@@ -0,0 +1,28 @@
+#include "bio.h"
+
+// noop: dispatch in arrival order. Adjacent bios are still merged by the
+// queue, so this is the baseline for what sorting adds.
+
+static void noop_init(blk_queue_t *q) {
+    list_init(&q->sched_lists[0]);
+}
+
+static void noop_add(blk_queue_t *q, blk_request_t *rq) {
+    list_add_before(&q->sched_lists[0], &rq->sched_link);
+}
+
+static blk_request_t *noop_next(blk_queue_t *q) {
+    list_entry_t *le = list_next(&q->sched_lists[0]);
+    if (le == &q->sched_lists[0]) {
+        return NULL;
+    }
+    list_del(le);
+    return le2rq(le, sched_link);
+}
+
+iosched_t iosched_noop = {
+    .name = "noop",
+    .init = noop_init,
+    .add = noop_add,
+    .next = noop_next,
+};
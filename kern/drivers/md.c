@@ -0,0 +1,400 @@
+#include "md.h"
+#include "bio.h"
+#include "stdio.h"
+#include "memory.h"
+
+#include <arch/x86/io.h>
+#include <arch/x86/mmu.h>
+#include "pit.h"
+#include "../sched/sched.h"
+#include "../mm/slab.h"
+#include "../mm/swap_slot.h"
+
+// RAID-0
+//
+// An array deals its sectors to the members a chunk at a time: chunk c of
+// the array is chunk c / n of member c % n. A transfer is cut at chunk
+// boundaries into pieces, each on one member. When every member queue can
+// be waited on, the pieces of up to MD_MAX_PIECES are submitted as bios
+// before any is waited for, so each member's dispatcher runs its share
+// while the others run theirs; with the IDE members on different channels
+// the drives work at the same time. Pieces that follow each other on one
+// member merge in its queue into one request, passed down as a segment
+// list when their memory is scattered. Callers that cannot sleep move the
+// pieces through the member drivers one after another.
+
+static md_array_t md_arrays[MD_MAX_ARRAYS];
+static int md_count = 0;
+
+// One piece of a transfer and the segments it covers
+typedef struct {
+    bio_t bio;
+    blk_seg_t segs[BLK_MAX_SEGS];
+} md_piece_t;
+
+/**
+ * Find where an array sector lives
+ * @return sectors from there to the end of its chunk
+ */
+static uint32_t md_map(const md_array_t *md, uint32_t sector, int *member, uint32_t *msector) {
+    uint32_t chunk = sector >> md->chunk_shift;
+    uint32_t off = sector & (md->chunk_secs - 1);
+
+    *member = chunk % md->nmembers;
+    *msector = ((chunk / md->nmembers) << md->chunk_shift) + off;
+    return md->chunk_secs - off;
+}
+
+/**
+ * Fill in pc->bio for the next nsecs sectors of data, and step past them
+ * A flat buffer stays flat; page segments are cut to the piece.
+ */
+static int md_piece_prep(md_piece_t *pc, block_device_t *dev, int write, uint32_t msector,
+                         blk_cursor_t *data, uint32_t nsecs) {
+    size_t left = nsecs * BLK_SIZE;
+    int n = 0;
+
+    if (data->seg == NULL) {
+        bio_prep(&pc->bio, dev, write, msector, data->buf, nsecs);
+        blk_cursor_advance(data, left);
+        return 0;
+    }
+
+    while (left > 0) {
+        size_t len;
+        uint8_t *p = blk_cursor_map(data, left, &len);
+        if (n == BLK_MAX_SEGS) {
+            return -1;
+        }
+        pc->segs[n].page = kva2page(p);
+        pc->segs[n].offset = PG_OFF(p);
+        pc->segs[n].len = len;
+        n++;
+        blk_cursor_advance(data, len);
+        left -= len;
+    }
+    return bio_prep_vec(&pc->bio, dev, write, msector, pc->segs, n);
+}
+
+// Move a prepared piece straight through the member driver
+static int md_piece_sync(md_piece_t *pc) {
+    bio_t *bio = &pc->bio;
+
+    if (bio->segs != NULL) {
+        return blk_rw_vec(bio->dev, bio->write, bio->sector, bio->segs, bio->nsegs);
+    }
+    return bio->write ? blk_write(bio->dev, bio->sector, bio->buf, bio->nsecs)
+                      : blk_read(bio->dev, bio->sector, bio->buf, bio->nsecs);
+}
+
+/**
+ * Split a transfer into chunk pieces and move them
+ */
+static int md_rw(md_array_t *md, int write, uint32_t sector, blk_cursor_t *data, size_t nsecs) {
+    md_piece_t *pieces = NULL;
+    int queued = 1, ret = 0;
+
+    if (sector >= md->blk.size || nsecs > md->blk.size - sector) {
+        return -1;
+    }
+
+    for (int i = 0; i < md->nmembers; i++) {
+        if (!bio_can_wait(md->members[i])) {
+            queued = 0;
+        }
+    }
+    if (queued && (pieces = kmalloc(MD_MAX_PIECES * sizeof(md_piece_t))) == NULL) {
+        queued = 0;
+    }
+
+    md->stats.requests++;
+    if (queued) {
+        md->stats.queued++;
+    }
+
+    while (nsecs > 0 && ret == 0) {
+        md_piece_t sync_piece;
+        int np = 0;
+
+        // Queue up to MD_MAX_PIECES pieces, then wait for all of them
+        while (nsecs > 0 && (np < MD_MAX_PIECES || !queued)) {
+            md_piece_t *pc = queued ? &pieces[np] : &sync_piece;
+            uint32_t msector;
+            int m;
+            uint32_t n = md_map(md, sector, &m, &msector);
+            if (n > nsecs) {
+                n = nsecs;
+            }
+
+            if (md_piece_prep(pc, md->members[m], write, msector, data, n) != 0) {
+                ret = -1;
+                break;
+            }
+            if (queued) {
+                if (bio_submit(&pc->bio) != 0) {
+                    ret = -1;
+                    break;
+                }
+                np++;
+            } else if (md_piece_sync(pc) != 0) {
+                ret = -1;
+                break;
+            }
+            md->stats.pieces++;
+            md->stats.sectors[m] += n;
+            sector += n;
+            nsecs -= n;
+        }
+
+        for (int i = 0; i < np; i++) {
+            if (bio_wait(&pieces[i].bio) != BIO_DONE) {
+                ret = -1;
+            }
+        }
+    }
+
+    if (pieces != NULL) {
+        kfree(pieces);
+    }
+    if (ret != 0) {
+        md->stats.errors++;
+    }
+    return ret;
+}
+
+static int md_read(block_device_t *dev, uint32_t blockno, void *buf, size_t nblocks) {
+    blk_cursor_t data;
+    blk_cursor_flat(&data, buf);
+    return md_rw(dev->private_data, 0, blockno, &data, nblocks);
+}
+
+static int md_write(block_device_t *dev, uint32_t blockno, const void *buf, size_t nblocks) {
+    blk_cursor_t data;
+    blk_cursor_flat(&data, (void *)buf);
+    return md_rw(dev->private_data, 1, blockno, &data, nblocks);
+}
+
+static int md_rw_vec(block_device_t *dev, int write, uint32_t blockno, const blk_seg_t *segs, int nsegs) {
+    int nsecs = blk_vec_sectors(segs, nsegs);
+    blk_cursor_t data;
+
+    if (nsecs < 0) {
+        return -1;
+    }
+    blk_cursor_vec(&data, segs, nsegs);
+    return md_rw(dev->private_data, write, blockno, &data, nsecs);
+}
+
+int md_is_member(block_device_t *dev) {
+    for (int a = 0; a < md_count; a++) {
+        for (int i = 0; i < md_arrays[a].nmembers; i++) {
+            if (md_arrays[a].members[i] == dev) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// A whole disk nothing else uses
+static block_device_t *md_member_get(const char *name) {
+    block_device_t *dev = blk_get_device_by_name(name);
+
+    if (dev == NULL) {
+        cprintf("md: no such device '%s'\n", name);
+        return NULL;
+    }
+    if (dev->type != BLK_TYPE_DISK) {
+        cprintf("md: %s is not a disk\n", name);
+        return NULL;
+    }
+    if (md_is_member(dev)) {
+        cprintf("md: %s is already in an array\n", name);
+        return NULL;
+    }
+    for (int i = 0; i < swap_area_count(); i++) {
+        if (swap_area_get(i)->dev == dev) {
+            cprintf("md: %s is in use for swap\n", name);
+            return NULL;
+        }
+    }
+    return dev;
+}
+
+md_array_t *md_create(int chunk_kb, const char **names, int nmembers) {
+    if (md_count == MD_MAX_ARRAYS) {
+        cprintf("md: at most %d arrays\n", MD_MAX_ARRAYS);
+        return NULL;
+    }
+    if (nmembers < 2 || nmembers > MD_MAX_MEMBERS) {
+        cprintf("md: an array needs 2 to %d members\n", MD_MAX_MEMBERS);
+        return NULL;
+    }
+    if (chunk_kb < MD_CHUNK_MIN_KB || chunk_kb > MD_CHUNK_MAX_KB || (chunk_kb & (chunk_kb - 1)) != 0) {
+        cprintf("md: chunk size must be a power of two from %d to %d KB\n",
+                MD_CHUNK_MIN_KB, MD_CHUNK_MAX_KB);
+        return NULL;
+    }
+
+    md_array_t *md = &md_arrays[md_count];
+    memset(md, 0, sizeof(md_array_t));
+    md->chunk_secs = chunk_kb * 1024 / BLK_SIZE;
+    while ((1u << md->chunk_shift) < md->chunk_secs) {
+        md->chunk_shift++;
+    }
+
+    // Every member contributes as many whole chunks as the smallest has
+    uint32_t min_size = 0;
+    for (int i = 0; i < nmembers; i++) {
+        block_device_t *dev = md_member_get(names[i]);
+        if (dev == NULL) {
+            return NULL;
+        }
+        for (int j = 0; j < i; j++) {
+            if (md->members[j] == dev) {
+                cprintf("md: %s listed twice\n", names[i]);
+                return NULL;
+            }
+        }
+        md->members[i] = dev;
+        if (i == 0 || dev->size < min_size) {
+            min_size = dev->size;
+        }
+    }
+    md->nmembers = nmembers;
+
+    uint32_t chunks = min_size >> md->chunk_shift;
+    if (chunks == 0) {
+        cprintf("md: members are smaller than one chunk\n");
+        return NULL;
+    }
+
+    md->name[0] = 'm';
+    md->name[1] = 'd';
+    md->name[2] = '0' + md_count;
+    md->name[3] = '\0';
+    md->blk.type = BLK_TYPE_MD;
+    md->blk.name = md->name;
+    md->blk.size = (chunks << md->chunk_shift) * nmembers;
+    md->blk.private_data = md;
+    md->blk.read = md_read;
+    md->blk.write = md_write;
+    md->blk.rw_vec = md_rw_vec;
+    if (blk_register(&md->blk) != 0) {
+        return NULL;
+    }
+    md_count++;
+
+    cprintf("md: %s is raid0 over", md->name);
+    for (int i = 0; i < nmembers; i++) {
+        cprintf(" %s", md->members[i]->name);
+    }
+    cprintf(", %d KB chunks, %d KB\n", chunk_kb, md->blk.size / 2);
+    return md;
+}
+
+void md_print_arrays(void) {
+    if (md_count == 0) {
+        cprintf("No md arrays\n");
+        return;
+    }
+
+    for (int a = 0; a < md_count; a++) {
+        md_array_t *md = &md_arrays[a];
+        const md_stats_t *st = &md->stats;
+
+        cprintf("%s: raid0, %d members, %d KB chunks, %d KB\n",
+                md->name, md->nmembers, md->chunk_secs * BLK_SIZE / 1024, md->blk.size / 2);
+        cprintf("  requests %u (%u queued), pieces %u, errors %u\n",
+                st->requests, st->queued, st->pieces, st->errors);
+        for (int i = 0; i < md->nmembers; i++) {
+            cprintf("  %-4s  %u sectors\n", md->members[i]->name, st->sectors[i]);
+        }
+    }
+}
+
+// mdbench: MD_BENCH_MB of sequential reads from md0 and from its first
+// member, at request sizes below, at and above the chunk size. A request
+// inside one chunk keeps one member busy; a bigger one runs on several
+// at once. Runs in a kernel thread so the pieces can be queued.
+#define MD_BENCH_MB     2
+
+static const int md_bench_sizes[] = {8, 32, 64, 128};    // sectors
+
+/**
+ * Read MD_BENCH_MB from dev in nsecs-sector requests
+ * @return elapsed milliseconds, 0 on a read error
+ */
+static uint32_t md_bench_read(block_device_t *dev, uint8_t *buf, int nsecs) {
+    uint32_t total = MD_BENCH_MB * 2048;
+
+    uint64_t t0 = rdtsc();
+    for (uint32_t sec = 0; sec < total; sec += nsecs) {
+        if (blk_read(dev, sec, buf, nsecs) != 0) {
+            return 0;
+        }
+    }
+    uint32_t ms = tsc_cycles_to_us(rdtsc() - t0) / 1000;
+    return ms ? ms : 1;
+}
+
+// Tenths of MB/s
+static uint32_t md_bench_mbs10(uint32_t ms) {
+    return MD_BENCH_MB * 10 * 1000 / ms;
+}
+
+static int md_bench_main(void *arg) {
+    md_array_t *md = arg;
+    block_device_t *member = md->members[0];
+    uint8_t *buf = kmalloc(BIO_MAX_SECTORS * BLK_SIZE);
+
+    if (buf == NULL) {
+        cprintf("mdbench: out of memory\n");
+        return -1;
+    }
+
+    cprintf("\nmdbench: %d MB sequential reads, %s (%d members, %d KB chunks) vs %s\n",
+            MD_BENCH_MB, md->name, md->nmembers, md->chunk_secs * BLK_SIZE / 1024, member->name);
+    cprintf("REQUEST  ARRAY MB/S  MEMBER MB/S  SPEEDUP  PIECES\n");
+    for (int i = 0; i < sizeof(md_bench_sizes) / sizeof(md_bench_sizes[0]); i++) {
+        int nsecs = md_bench_sizes[i];
+        uint32_t pieces = md->stats.pieces;
+        uint32_t ms_md = md_bench_read(&md->blk, buf, nsecs);
+        pieces = md->stats.pieces - pieces;
+        uint32_t ms_one = md_bench_read(member, buf, nsecs);
+
+        if (ms_md == 0 || ms_one == 0) {
+            cprintf("%-3d KB   read error\n", nsecs / 2);
+            continue;
+        }
+        uint32_t a = md_bench_mbs10(ms_md), m = md_bench_mbs10(ms_one);
+        uint32_t speedup = ms_one * 10 / ms_md;
+        cprintf("%-3d KB   %4u.%u      %4u.%u       %u.%ux     %u\n",
+                nsecs / 2, a / 10, a % 10, m / 10, m % 10, speedup / 10, speedup % 10, pieces);
+    }
+    cprintf("PIECES is the member transfers the array reads were split into.\n");
+
+    kfree(buf);
+    return 0;
+}
+
+void md_bench(void) {
+    if (md_count == 0) {
+        cprintf("mdbench: no md array (md <chunk KB> <dev> <dev>...)\n");
+        return;
+    }
+    if (md_arrays[0].blk.size < MD_BENCH_MB * 2048 ||
+        md_arrays[0].members[0]->size < MD_BENCH_MB * 2048) {
+        cprintf("mdbench: %s is smaller than %d MB\n", md_arrays[0].name, MD_BENCH_MB);
+        return;
+    }
+    if (tsc_khz == 0) {
+        cprintf("mdbench: TSC not calibrated\n");
+        return;
+    }
+
+    int pid = kernel_thread(md_bench_main, &md_arrays[0], "mdbench");
+    if (pid <= 0) {
+        cprintf("mdbench: cannot start thread\n");
+    }
+}
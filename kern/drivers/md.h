@@ -0,0 +1,42 @@
+#pragma once
+
+#include <base/types.h>
+
+#include "blk.h"
+
+// md: RAID-0 arrays striped over whole disks
+#define MD_MAX_ARRAYS       2
+#define MD_MAX_MEMBERS      4
+#define MD_CHUNK_MIN_KB     4
+#define MD_CHUNK_MAX_KB     64          // a chunk piece fits one bio (BIO_MAX_SECTORS)
+#define MD_MAX_PIECES       16          // chunk pieces of one transfer in flight
+#define MD_NAME_LEN         8
+
+typedef struct {
+    uint32_t requests;                  // transfers to the array
+    uint32_t pieces;                    // member transfers they were split into
+    uint32_t queued;                    // transfers whose pieces ran in parallel as bios
+    uint32_t errors;
+    uint32_t sectors[MD_MAX_MEMBERS];   // moved per member
+} md_stats_t;
+
+typedef struct {
+    block_device_t blk;                 // registered as mdN, type BLK_TYPE_MD
+    char name[MD_NAME_LEN];
+    block_device_t *members[MD_MAX_MEMBERS];
+    int nmembers;
+    uint32_t chunk_secs;                // sectors per chunk, power of two
+    uint32_t chunk_shift;               // log2(chunk_secs)
+    md_stats_t stats;
+} md_array_t;
+
+// Stripe the named disks into a new array with chunks of chunk_kb (power of
+// two, MD_CHUNK_MIN_KB..MD_CHUNK_MAX_KB); returns the array or NULL
+md_array_t *md_create(int chunk_kb, const char **names, int nmembers);
+// 1 if dev belongs to an array
+int md_is_member(block_device_t *dev);
+// Layout and counters of every array
+void md_print_arrays(void);
+
+// Sequential reads from the first array and from one of its members
+void md_bench(void);
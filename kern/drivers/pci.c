@@ -0,0 +1,157 @@
+#include "pci.h"
+#include "stdio.h"
+
+#include <arch/x86/io.h>
+
+// PCI Bus Enumeration
+//
+// Configuration space is reached through mechanism #1: write the enable
+// bit, bus, device, function and dword-aligned register to 0xCF8, then
+// access the dword at 0xCFC. Narrower reads pick bytes out of that dword.
+//
+// pci_init() probes every bus/device pair; function 0 answering with a
+// vendor ID other than 0xFFFF means the device exists, and the header
+// type says whether functions 1-7 need probing too.
+
+static pci_device_t pci_devices[PCI_MAX_DEVICES];
+static int num_pci = 0;
+
+static uint32_t pci_addr(uint8_t bus, uint8_t dev, uint8_t func, uint8_t reg) {
+    return PCI_CONFIG_ENABLE | ((uint32_t)bus << 16) | ((uint32_t)dev << 11) |
+           ((uint32_t)func << 8) | (reg & 0xFC);
+}
+
+static uint32_t pci_conf_read(uint8_t bus, uint8_t dev, uint8_t func, uint8_t reg) {
+    outl(PCI_CONFIG_ADDR, pci_addr(bus, dev, func, reg));
+    return inl(PCI_CONFIG_DATA);
+}
+
+uint32_t pci_read32(const pci_device_t *pdev, uint8_t reg) {
+    return pci_conf_read(pdev->bus, pdev->dev, pdev->func, reg);
+}
+
+uint16_t pci_read16(const pci_device_t *pdev, uint8_t reg) {
+    return (pci_read32(pdev, reg) >> ((reg & 2) * 8)) & 0xFFFF;
+}
+
+uint8_t pci_read8(const pci_device_t *pdev, uint8_t reg) {
+    return (pci_read32(pdev, reg) >> ((reg & 3) * 8)) & 0xFF;
+}
+
+void pci_write32(const pci_device_t *pdev, uint8_t reg, uint32_t val) {
+    outl(PCI_CONFIG_ADDR, pci_addr(pdev->bus, pdev->dev, pdev->func, reg));
+    outl(PCI_CONFIG_DATA, val);
+}
+
+void pci_write16(const pci_device_t *pdev, uint8_t reg, uint16_t val) {
+    uint32_t shift = (reg & 2) * 8;
+    uint32_t old = pci_read32(pdev, reg);
+    pci_write32(pdev, reg, (old & ~(0xFFFFU << shift)) | ((uint32_t)val << shift));
+}
+
+uint32_t pci_bar(const pci_device_t *pdev, int n) {
+    uint32_t bar = pci_read32(pdev, PCI_BAR0 + n * 4);
+    return (bar & PCI_BAR_IO) ? (bar & PCI_BAR_IO_MASK) : (bar & PCI_BAR_MEM_MASK);
+}
+
+void pci_enable(const pci_device_t *pdev, uint16_t cmd_bits) {
+    pci_write16(pdev, PCI_COMMAND, pci_read16(pdev, PCI_COMMAND) | cmd_bits);
+}
+
+/**
+ * Record one function if it exists
+ * @return 1 if a function answered
+ */
+static int pci_probe(uint8_t bus, uint8_t dev, uint8_t func) {
+    uint32_t id = pci_conf_read(bus, dev, func, PCI_VENDOR_ID);
+    if ((id & 0xFFFF) == 0xFFFF) {
+        return 0;
+    }
+    if (num_pci >= PCI_MAX_DEVICES) {
+        return 1;
+    }
+
+    pci_device_t *pdev = &pci_devices[num_pci++];
+    pdev->bus = bus;
+    pdev->dev = dev;
+    pdev->func = func;
+    pdev->vendor_id = id & 0xFFFF;
+    pdev->device_id = id >> 16;
+    pdev->class_code = pci_read8(pdev, PCI_CLASS);
+    pdev->subclass = pci_read8(pdev, PCI_SUBCLASS);
+    pdev->prog_if = pci_read8(pdev, PCI_PROG_IF);
+    pdev->irq_line = pci_read8(pdev, PCI_INTERRUPT_LINE);
+    return 1;
+}
+
+void pci_init(void) {
+    num_pci = 0;
+
+    for (int bus = 0; bus < PCI_MAX_BUS; bus++) {
+        for (int dev = 0; dev < PCI_MAX_DEV; dev++) {
+            if (!pci_probe(bus, dev, 0)) {
+                continue;
+            }
+            uint8_t htype = (pci_conf_read(bus, dev, 0, PCI_HEADER_TYPE) >> 16) & 0xFF;
+            if (htype & 0x80) {
+                for (int func = 1; func < PCI_MAX_FUNC; func++) {
+                    pci_probe(bus, dev, func);
+                }
+            }
+        }
+    }
+
+    cprintf("pci_init: found %d function(s)\n", num_pci);
+}
+
+pci_device_t *pci_find_class(uint8_t class_code, uint8_t subclass) {
+    for (int i = 0; i < num_pci; i++) {
+        if (pci_devices[i].class_code == class_code && pci_devices[i].subclass == subclass) {
+            return &pci_devices[i];
+        }
+    }
+    return NULL;
+}
+
+pci_device_t *pci_find_device(uint16_t vendor_id, uint16_t device_id) {
+    for (int i = 0; i < num_pci; i++) {
+        if (pci_devices[i].vendor_id == vendor_id && pci_devices[i].device_id == device_id) {
+            return &pci_devices[i];
+        }
+    }
+    return NULL;
+}
+
+static const char *pci_class_name(const pci_device_t *pdev) {
+    switch (pdev->class_code) {
+        case 0x01:
+            switch (pdev->subclass) {
+                case PCI_SUBCLASS_IDE:  return "IDE interface";
+                case PCI_SUBCLASS_SATA: return "SATA controller";
+                default:                return "Mass storage controller";
+            }
+        case 0x02: return "Ethernet controller";
+        case 0x03: return "VGA compatible controller";
+        case 0x06:
+            switch (pdev->subclass) {
+                case 0x00: return "Host bridge";
+                case 0x01: return "ISA bridge";
+                case 0x80: return "Bridge";
+                default:   return "Bridge device";
+            }
+        default:   return "Device";
+    }
+}
+
+void pci_list_devices(void) {
+    for (int i = 0; i < num_pci; i++) {
+        pci_device_t *pdev = &pci_devices[i];
+        cprintf("%02x:%02x.%d %s [%02x%02x]: %04x:%04x",
+                pdev->bus, pdev->dev, pdev->func, pci_class_name(pdev),
+                pdev->class_code, pdev->subclass, pdev->vendor_id, pdev->device_id);
+        if (pdev->irq_line != 0 && pdev->irq_line != 0xFF) {
+            cprintf(" irq %d", pdev->irq_line);
+        }
+        cprintf("\n");
+    }
+}
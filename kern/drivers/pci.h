@@ -0,0 +1,72 @@
+#pragma once
+
+#include <base/types.h>
+
+// PCI configuration mechanism #1
+#define PCI_CONFIG_ADDR     0xCF8       // Address register (enable bit | bus | dev | func | reg)
+#define PCI_CONFIG_DATA     0xCFC       // Data register
+#define PCI_CONFIG_ENABLE   0x80000000
+
+#define PCI_MAX_BUS         256
+#define PCI_MAX_DEV         32
+#define PCI_MAX_FUNC        8
+#define PCI_MAX_DEVICES     32          // Functions remembered by pci_init
+
+// Configuration space registers
+#define PCI_VENDOR_ID       0x00        // 16 bits, 0xFFFF if no function
+#define PCI_DEVICE_ID       0x02
+#define PCI_COMMAND         0x04
+#define PCI_STATUS          0x06
+#define PCI_PROG_IF         0x09
+#define PCI_SUBCLASS        0x0A
+#define PCI_CLASS           0x0B
+#define PCI_HEADER_TYPE     0x0E        // Bit 7: multi-function device
+#define PCI_BAR0            0x10        // BARs 0-5, 4 bytes apart
+#define PCI_INTERRUPT_LINE  0x3C
+
+// Command register bits
+#define PCI_CMD_IO          0x0001      // Respond to I/O space accesses
+#define PCI_CMD_MEMORY      0x0002      // Respond to memory space accesses
+#define PCI_CMD_MASTER      0x0004      // May act as a bus master (DMA)
+
+// BAR bits
+#define PCI_BAR_IO          0x1         // I/O space BAR
+#define PCI_BAR_IO_MASK     0xFFFFFFFC
+#define PCI_BAR_MEM_MASK    0xFFFFFFF0
+
+// Class codes
+#define PCI_CLASS_STORAGE   0x01
+#define PCI_SUBCLASS_IDE    0x01
+#define PCI_SUBCLASS_SATA   0x06
+#define PCI_CLASS_BRIDGE    0x06
+
+// One enumerated function
+typedef struct {
+    uint8_t bus, dev, func;
+    uint16_t vendor_id, device_id;
+    uint8_t class_code, subclass, prog_if;
+    uint8_t irq_line;
+} pci_device_t;
+
+// Scan every bus for functions (lspci)
+void pci_init(void);
+
+uint32_t pci_read32(const pci_device_t *pdev, uint8_t reg);
+uint16_t pci_read16(const pci_device_t *pdev, uint8_t reg);
+uint8_t pci_read8(const pci_device_t *pdev, uint8_t reg);
+void pci_write32(const pci_device_t *pdev, uint8_t reg, uint32_t val);
+void pci_write16(const pci_device_t *pdev, uint8_t reg, uint16_t val);
+
+// BAR n (0-5) with the type bits masked off
+uint32_t pci_bar(const pci_device_t *pdev, int n);
+
+// Set bits in the command register (e.g. PCI_CMD_MASTER)
+void pci_enable(const pci_device_t *pdev, uint16_t cmd_bits);
+
+// First function of class/subclass, NULL if none
+pci_device_t *pci_find_class(uint8_t class_code, uint8_t subclass);
+// First function with this vendor/device ID, NULL if none
+pci_device_t *pci_find_device(uint16_t vendor_id, uint16_t device_id);
+
+// Print every function found (lspci)
+void pci_list_devices(void);
@@ -16,6 +16,10 @@ void pic_enable(unsigned int irq) {
     pic_setmask(irq_mask & ~(1 << irq));
 }
 
+void pic_disable(unsigned int irq) {
+    pic_setmask(irq_mask | (1 << irq));
+}
+
 void pic_send_eoi(unsigned int irq) {
     // If this interrupt involved the slave (IRQ 8-15), send EOI to slave
     if (irq >= 8) {
@@ -4,6 +4,7 @@
 
 void pic_setmask(uint16_t mask);
 void pic_enable(unsigned int irq);
+void pic_disable(unsigned int irq);
 void pic_send_eoi(unsigned int irq);
 
 void pic_init(void);
\ No newline at end of file
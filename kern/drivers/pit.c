@@ -1,15 +1,59 @@
 #include "pit.h"
 #include "pic.h"
 
+#include "math.h"
+#include "stdio.h"
+
 #include <arch/x86/io.h>
 #include <arch/x86/drivers/i8254.h>
 #include <arch/x86/drivers/i8259.h>
 
 volatile int64_t ticks = 0;
 
+uint32_t tsc_khz = 0;
+
 #define TIMER_FREQ 1193180
 #define TIMER_DIV(x) (TIMER_FREQ / (x))
 
+#define CALIBRATE_MS        10
+#define CALIBRATE_MAX_LOOPS 10000000    // give up if timer 2 never fires
+
+/**
+ * Count TSC cycles across a CALIBRATE_MS one-shot on PIT timer 2
+ * Polled with the speaker disabled, so no interrupt is involved.
+ */
+static void tsc_calibrate(void) {
+    uint16_t latch = TIMER_DIV(1000 / CALIBRATE_MS);
+    uint8_t portb = inb(PIT_CTRL_PORTB);
+
+    outb(PIT_CTRL_PORTB, (portb & ~PIT_PORTB_SPKR) | PIT_PORTB_GATE2);
+    outb(PIT_CTRL_REG, PIT_SEL_TIMER2 | PIT_ONESHOT | PIT_16BIT);
+    outb(PIT_TIMER2_REG, latch % 256);
+    outb(PIT_TIMER2_REG, latch / 256);
+
+    uint64_t t0 = rdtsc();
+    uint32_t loops = 0;
+    while (!(inb(PIT_CTRL_PORTB) & PIT_PORTB_OUT2) && ++loops < CALIBRATE_MAX_LOOPS)
+        ;
+    uint64_t cycles = rdtsc() - t0;
+
+    outb(PIT_CTRL_PORTB, portb);
+
+    if (loops < CALIBRATE_MAX_LOOPS) {
+        do_div(cycles, CALIBRATE_MS);
+        tsc_khz = (uint32_t)cycles;
+    }
+}
+
+uint32_t tsc_cycles_to_us(uint64_t cycles) {
+    uint32_t mhz = tsc_khz / 1000;
+    if (mhz == 0) {
+        return 0;
+    }
+    do_div(cycles, mhz);
+    return (uint32_t)cycles;
+}
+
 static uint8_t CMOS_READ(uint8_t addr) {
 	outb(0x70, 0x80 | addr);
 	return inb(0x71);
@@ -42,4 +86,7 @@ void pit_init(void) {
     outb(PIT_TIMER0_REG, TIMER_DIV(100) / 256);
 
     pic_enable(IRQ_TIMER);
+
+    tsc_calibrate();
+    cprintf("pit: tsc %u.%03u MHz\n", tsc_khz / 1000, tsc_khz % 1000);
 }
\ No newline at end of file
@@ -16,4 +16,10 @@ struct tm {
 
 extern volatile int64_t ticks;
 
-void pit_init(void);
\ No newline at end of file
+// TSC frequency measured against PIT timer 2 at boot (0 if unknown)
+extern uint32_t tsc_khz;
+
+void pit_init(void);
+
+// Convert a TSC cycle count to microseconds
+uint32_t tsc_cycles_to_us(uint64_t cycles);
\ No newline at end of file
@@ -0,0 +1,584 @@
+#include "virtio_blk.h"
+#include "stdio.h"
+#include "math.h"
+#include "memory.h"
+
+#include <arch/x86/io.h>
+#include <arch/x86/cpu.h>
+#include <arch/x86/mmu.h>
+#include "pci.h"
+#include "pic.h"
+#include "pit.h"
+#include "intr.h"
+#include "../sched/sched.h"
+#include "../trap/trap.h"
+#include "../mm/pmm.h"
+#include "../mm/slab.h"
+
+// virtio-blk (legacy PCI)
+//
+// The device and driver share one split virtqueue: a descriptor table, an
+// available ring the driver fills with heads of descriptor chains, and a
+// used ring the device fills as it finishes them. A request is a chain of
+// a device-readable header (type, sector), the data as one descriptor per
+// physically contiguous piece of the buffer, and a device-writable status
+// byte.
+//
+// Requests wait on a pending queue until the ring has descriptors for
+// them. vblk_kick() places as many as fit, publishes them with a single
+// avail->idx update and notifies the device once for the whole batch; the
+// device exits to the hypervisor on each notify, so batching is where most
+// of the win over emulated IDE comes from. Completion is interrupt driven,
+// or polled from contexts that cannot sleep, as for the other disks.
+
+#define vq_barrier() __asm__ __volatile__("" ::: "memory")
+
+static virtio_blk_t vblk;
+static int vblk_irq = -1;
+
+// Physical address of a direct-mapped kernel buffer
+static uint32_t vblk_pa(void *kva) {
+    return page2pa(kva2page(kva)) + PG_OFF(kva);
+}
+
+// Next piece of the data inside one page (and one segment): its length
+// and physical address
+static size_t vblk_piece(blk_cursor_t *c, size_t left, uint32_t *pa) {
+    size_t chunk;
+    uint8_t *p = blk_cursor_map(c, left, &chunk);
+
+    if (chunk > PG_SIZE - PG_OFF(p)) {
+        chunk = PG_SIZE - PG_OFF(p);
+    }
+    *pa = vblk_pa(p);
+    blk_cursor_advance(c, chunk);
+    return chunk;
+}
+
+// Physically contiguous pieces in nbytes of data (one descriptor each)
+static int vblk_count_segs(const blk_cursor_t *data, size_t nbytes) {
+    blk_cursor_t c = *data;
+    uint32_t end = 0;
+    int nseg = 0;
+
+    while (nbytes > 0) {
+        uint32_t pa;
+        size_t chunk = vblk_piece(&c, nbytes, &pa);
+        if (nseg == 0 || pa != end) {
+            nseg++;
+        }
+        end = pa + chunk;
+        nbytes -= chunk;
+    }
+    return nseg;
+}
+
+static uint16_t vblk_alloc_desc(void) {
+    uint16_t d = vblk.free_head;
+    vblk.free_head = vblk.desc[d].next;
+    vblk.num_free--;
+    return d;
+}
+
+static void vblk_free_chain(uint16_t head) {
+    uint16_t d = head;
+    int n = 1;
+
+    while (vblk.desc[d].flags & VRING_DESC_F_NEXT) {
+        d = vblk.desc[d].next;
+        n++;
+    }
+    vblk.desc[d].next = vblk.free_head;
+    vblk.free_head = head;
+    vblk.num_free += n;
+}
+
+/**
+ * Build the descriptor chain for req and put its head in the next
+ * available ring entry (not yet published)
+ * @param slot: available ring entries already filled in this batch
+ * @return 0 on success, -1 if the ring lacks descriptors
+ */
+static int vblk_place(vblk_request_t *req, uint16_t slot) {
+    blk_cursor_t c = req->data;
+    size_t left = req->nsecs * BLK_SIZE;
+    int nseg = vblk_count_segs(&c, left);
+
+    if (vblk.num_free < nseg + 2) {
+        return -1;
+    }
+
+    uint16_t head = vblk_alloc_desc();
+    vblk.hdrs[head].type = req->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    vblk.hdrs[head].reserved = 0;
+    vblk.hdrs[head].sector = req->sector;
+    vblk.status[head] = 0xFF;
+    vblk.desc[head].addr = vblk_pa(&vblk.hdrs[head]);
+    vblk.desc[head].len = sizeof(virtio_blk_hdr_t);
+    vblk.desc[head].flags = VRING_DESC_F_NEXT;
+
+    // Data: extend the previous descriptor while pages stay contiguous
+    uint16_t prev = head, d = head;
+    while (left > 0) {
+        uint32_t pa;
+        size_t chunk = vblk_piece(&c, left, &pa);
+        if (d != head && vblk.desc[d].addr + vblk.desc[d].len == pa) {
+            vblk.desc[d].len += chunk;
+        } else {
+            d = vblk_alloc_desc();
+            vblk.desc[d].addr = pa;
+            vblk.desc[d].len = chunk;
+            vblk.desc[d].flags = VRING_DESC_F_NEXT | (req->write ? 0 : VRING_DESC_F_WRITE);
+            vblk.desc[prev].next = d;
+            prev = d;
+        }
+        left -= chunk;
+    }
+
+    uint16_t s = vblk_alloc_desc();
+    vblk.desc[s].addr = vblk_pa(&vblk.status[head]);
+    vblk.desc[s].len = 1;
+    vblk.desc[s].flags = VRING_DESC_F_WRITE;
+    vblk.desc[prev].next = s;
+
+    req->head = head;
+    vblk.reqs[head] = req;
+    vblk.avail->ring[(uint16_t)(vblk.avail->idx + slot) % vblk.num] = head;
+    vblk.stats.requests++;
+    vblk.stats.descs += nseg + 2;
+    return 0;
+}
+
+/**
+ * Move pending requests onto the ring, publish them and notify once
+ * Called with interrupts disabled.
+ */
+static void vblk_kick(void) {
+    list_entry_t *le;
+    uint16_t added = 0;
+
+    while ((le = list_next(&vblk.queue)) != &vblk.queue) {
+        if (vblk_place(le2vblk_req(le), added) != 0) {
+            break;
+        }
+        list_del(le);
+        added++;
+    }
+    if (added == 0) {
+        return;
+    }
+
+    vq_barrier();       // ring entries before the index that publishes them
+    vblk.avail->idx += added;
+    vq_barrier();
+    outw(vblk.iobase + VIRTIO_QUEUE_NOTIFY, 0);
+    vblk.stats.notifies++;
+}
+
+/**
+ * Complete the chains the device has returned on the used ring
+ * Called with interrupts disabled.
+ * @return number of requests completed
+ */
+static int vblk_service(void) {
+    int n = 0;
+
+    while (vblk.last_used != vblk.used->idx) {
+        vq_barrier();
+        vring_used_elem_t *e = &vblk.used->ring[vblk.last_used % vblk.num];
+        uint16_t head = e->id;
+        vblk_request_t *req = vblk.reqs[head];
+
+        vblk.reqs[head] = NULL;
+        req->status = vblk.status[head] == VIRTIO_BLK_S_OK ? VBLK_REQ_DONE : VBLK_REQ_ERROR;
+        if (req->status != VBLK_REQ_DONE) {
+            vblk.stats.errors++;
+        }
+        vblk_free_chain(head);
+        vblk.last_used++;
+        wake_up(&req->wait);
+        n++;
+    }
+    if (n > 0) {
+        vblk_kick();
+    }
+    return n;
+}
+
+/**
+ * Give up on a device that stopped answering: reset it, so it no longer
+ * touches the ring, and fail everything it held or that was waiting
+ * Called with interrupts disabled.
+ */
+static void vblk_fail_all(void) {
+    list_entry_t *le;
+
+    outb(vblk.iobase + VIRTIO_DEVICE_STATUS, 0);
+    vblk.present = 0;
+    for (uint16_t i = 0; i < vblk.num; i++) {
+        if (vblk.reqs[i] != NULL) {
+            vblk.reqs[i]->status = VBLK_REQ_ERROR;
+            wake_up(&vblk.reqs[i]->wait);
+            vblk.reqs[i] = NULL;
+        }
+    }
+    while ((le = list_next(&vblk.queue)) != &vblk.queue) {
+        list_del(le);
+        le2vblk_req(le)->status = VBLK_REQ_ERROR;
+        wake_up(&le2vblk_req(le)->wait);
+    }
+    cprintf("virtio_blk: device not responding, disabled\n");
+}
+
+static void vblk_intr(void) {
+    intr_save();
+    // Reading ISR acknowledges the interrupt; the line may be shared
+    if (inb(vblk.iobase + VIRTIO_ISR_STATUS) & VIRTIO_ISR_QUEUE) {
+        vblk.stats.irqs++;
+        vblk_service();
+    }
+    intr_restore();
+}
+
+static int vblk_can_sleep(void) {
+    return vblk_irq >= 0 && !in_irq() && (read_eflags() & FL_IF) &&
+           current != NULL && current->pid > 0;
+}
+
+/**
+ * Queue n requests and place them with a single notify
+ */
+static void vblk_submit(vblk_request_t *reqs, int n) {
+    intr_save();
+    for (int i = 0; i < n; i++) {
+        if (!vblk.present) {
+            reqs[i].status = VBLK_REQ_ERROR;
+            continue;
+        }
+        reqs[i].status = VBLK_REQ_PENDING;
+        wait_queue_init(&reqs[i].wait);
+        list_add_before(&vblk.queue, &reqs[i].link);
+    }
+    vblk_kick();
+    intr_restore();
+}
+
+static int vblk_wait(vblk_request_t *req) {
+    if (vblk_can_sleep()) {
+        intr_save();
+        while (req->status == VBLK_REQ_PENDING) {
+            wait_sleep(&req->wait);
+        }
+        intr_restore();
+    } else {
+        int idle = 0;
+        while (req->status == VBLK_REQ_PENDING) {
+            intr_save();
+            inb(vblk.iobase + VIRTIO_ISR_STATUS);
+            if (vblk_service() > 0) {
+                idle = 0;
+            } else if (++idle > VBLK_POLL_LIMIT) {
+                vblk_fail_all();
+            }
+            intr_restore();
+        }
+    }
+    return req->status == VBLK_REQ_DONE ? 0 : -1;
+}
+
+/**
+ * Transfer nsecs sectors, VBLK_MAX_SECTORS per request, submitting up to
+ * VBLK_RW_BATCH requests at once
+ */
+static int vblk_rw(uint32_t sector, const blk_cursor_t *data, size_t nsecs, int write) {
+    vblk_request_t reqs[VBLK_RW_BATCH];
+    blk_cursor_t c = *data;
+    int ret = 0;
+
+    if (!vblk.present || sector + nsecs > vblk.capacity) {
+        return -1;
+    }
+
+    while (nsecs > 0 && ret == 0) {
+        int n = 0;
+        for (; n < VBLK_RW_BATCH && nsecs > 0; n++) {
+            size_t cnt = nsecs < VBLK_MAX_SECTORS ? nsecs : VBLK_MAX_SECTORS;
+            reqs[n].write = write;
+            reqs[n].sector = sector;
+            reqs[n].data = c;
+            reqs[n].nsecs = cnt;
+            sector += cnt;
+            blk_cursor_advance(&c, cnt * BLK_SIZE);
+            nsecs -= cnt;
+        }
+        vblk_submit(reqs, n);
+        for (int i = 0; i < n; i++) {
+            if (vblk_wait(&reqs[i]) != 0) {
+                ret = -1;
+            }
+        }
+    }
+    return ret;
+}
+
+// The device needs direct-mapped buffers
+static int vblk_rw_flat(uint32_t sector, void *buf, size_t nsecs, int write) {
+    blk_cursor_t data;
+
+    if ((uintptr_t)buf < KERNEL_BASE) {
+        return -1;
+    }
+    blk_cursor_flat(&data, buf);
+    return vblk_rw(sector, &data, nsecs, write);
+}
+
+int virtio_blk_read(uint32_t sector, void *buf, size_t nsecs) {
+    return vblk_rw_flat(sector, buf, nsecs, 0);
+}
+
+int virtio_blk_write(uint32_t sector, const void *buf, size_t nsecs) {
+    return vblk_rw_flat(sector, (void *)buf, nsecs, 1);
+}
+
+static int vblk_blk_read(block_device_t *dev, uint32_t blockno, void *buf, size_t nblocks) {
+    return virtio_blk_read(blockno, buf, nblocks);
+}
+
+static int vblk_blk_write(block_device_t *dev, uint32_t blockno, const void *buf, size_t nblocks) {
+    return virtio_blk_write(blockno, buf, nblocks);
+}
+
+// Each segment becomes a descriptor (merged where physically adjacent)
+static int vblk_blk_rw_vec(block_device_t *dev, int write, uint32_t blockno,
+                           const blk_seg_t *segs, int nsegs) {
+    int nsecs = blk_vec_sectors(segs, nsegs);
+    blk_cursor_t data;
+
+    if (nsecs < 0) {
+        return -1;
+    }
+    blk_cursor_vec(&data, segs, nsegs);
+    return vblk_rw(blockno, &data, nsecs, write);
+}
+
+/**
+ * Allocate queue 0 in pages: descriptors and available ring, then the used
+ * ring on the next VRING_ALIGN boundary
+ */
+static int vblk_setup_queue(void) {
+    uint16_t num;
+
+    outw(vblk.iobase + VIRTIO_QUEUE_SELECT, 0);
+    num = inw(vblk.iobase + VIRTIO_QUEUE_SIZE);
+    if (num == 0 || num < VBLK_MAX_SECTORS * BLK_SIZE / PG_SIZE + 3) {
+        return -1;      // absent, or too small for one full-size request
+    }
+
+    size_t avail_end = num * sizeof(vring_desc_t) + sizeof(uint16_t) * (3 + num);
+    size_t used_off = ROUND_UP(avail_end, VRING_ALIGN);
+    size_t size = used_off + ROUND_UP(sizeof(uint16_t) * 3 + sizeof(vring_used_elem_t) * num,
+                                      VRING_ALIGN);
+    PageDesc *page = alloc_pages(size / PG_SIZE);
+    if (page == NULL) {
+        return -1;
+    }
+    uint8_t *ring = page2kva(page);
+    memset(ring, 0, size);
+
+    vblk.num = num;
+    vblk.desc = (vring_desc_t *)ring;
+    vblk.avail = (vring_avail_t *)(ring + num * sizeof(vring_desc_t));
+    vblk.used = (vring_used_t *)(ring + used_off);
+    vblk.reqs = kmalloc(num * sizeof(vblk_request_t *));
+    vblk.hdrs = kmalloc(num * sizeof(virtio_blk_hdr_t));
+    vblk.status = kmalloc(num);
+    if (vblk.reqs == NULL || vblk.hdrs == NULL || vblk.status == NULL) {
+        return -1;
+    }
+
+    for (uint16_t i = 0; i < num; i++) {
+        vblk.desc[i].next = i + 1;
+        vblk.reqs[i] = NULL;
+    }
+    vblk.free_head = 0;
+    vblk.num_free = num;
+    vblk.last_used = 0;
+
+    outl(vblk.iobase + VIRTIO_QUEUE_PFN, page2pa(page) >> PG_SHIFT);
+    return 0;
+}
+
+void virtio_blk_init(void) {
+    pci_device_t *pdev = pci_find_device(VIRTIO_VENDOR_ID, VIRTIO_BLK_DEVICE_ID);
+
+    if (pdev == NULL) {
+        return;
+    }
+    vblk.iobase = pci_bar(pdev, 0);
+    pci_enable(pdev, PCI_CMD_IO | PCI_CMD_MASTER);
+    list_init(&vblk.queue);
+
+    // Reset, then acknowledge; no optional features are used
+    outb(vblk.iobase + VIRTIO_DEVICE_STATUS, 0);
+    outb(vblk.iobase + VIRTIO_DEVICE_STATUS, VIRTIO_STATUS_ACK);
+    outb(vblk.iobase + VIRTIO_DEVICE_STATUS, VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER);
+    outl(vblk.iobase + VIRTIO_GUEST_FEATURES, 0);
+
+    if (vblk_setup_queue() != 0) {
+        outb(vblk.iobase + VIRTIO_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+        cprintf("virtio_blk_init: cannot set up the virtqueue\n");
+        return;
+    }
+
+    // Capacity is 64 bits; sectors beyond 2 TB are not addressable here anyway
+    vblk.capacity = inl(vblk.iobase + VIRTIO_BLK_CAPACITY);
+    if (inl(vblk.iobase + VIRTIO_BLK_CAPACITY + 4) != 0) {
+        vblk.capacity = 0xFFFFFFFF;
+    }
+
+    if (pdev->irq_line < 16 && irq_register(pdev->irq_line, vblk_intr) == 0) {
+        vblk_irq = pdev->irq_line;
+        pic_enable(vblk_irq);
+    }
+    outb(vblk.iobase + VIRTIO_DEVICE_STATUS,
+         VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+    vblk.present = 1;
+
+    vblk.blk.type = BLK_TYPE_DISK;
+    vblk.blk.name = "vda";
+    vblk.blk.size = vblk.capacity;
+    vblk.blk.read = vblk_blk_read;
+    vblk.blk.write = vblk_blk_write;
+    vblk.blk.rw_vec = vblk_blk_rw_vec;
+    vblk.blk.private_data = &vblk;
+    blk_register(&vblk.blk);
+
+    cprintf("virtio_blk_init: vda, %d sectors, %d ring entries, irq %d\n",
+            vblk.capacity, vblk.num, vblk_irq);
+}
+
+// vblkbench: the same reads through block_device_t from the first IDE disk
+// and from vda: VBLK_BENCH_MB sequentially in 64 KB requests, then
+// VBLK_BENCH_RANDOM random 4 KB requests. A last pass submits the random
+// reads to vda VBLK_RW_BATCH at a time to show the notifies saved.
+#define VBLK_BENCH_MB       2
+#define VBLK_BENCH_CHUNK    128
+#define VBLK_BENCH_RANDOM   512
+#define VBLK_BENCH_SECS     (PG_SIZE / BLK_SIZE)
+
+static uint32_t vblk_bench_seed;
+
+static uint32_t vblk_bench_rand(void) {
+    vblk_bench_seed = vblk_bench_seed * 1103515245 + 12345;
+    return vblk_bench_seed >> 16;
+}
+
+static uint32_t vblk_bench_elapsed(uint64_t t0) {
+    uint32_t us = tsc_cycles_to_us(rdtsc() - t0);
+    return us ? us : 1;
+}
+
+/**
+ * Sequential KB/s and random IOPS for one device
+ * @return 0 on success, -1 on a read error
+ */
+static int vblk_bench_dev(block_device_t *dev, uint8_t *buf, uint32_t *kbs, uint32_t *iops) {
+    uint32_t total = VBLK_BENCH_MB * 2048;
+    uint64_t t0 = rdtsc();
+
+    for (uint32_t sec = 0; sec < total; sec += VBLK_BENCH_CHUNK) {
+        if (blk_read(dev, sec, buf, VBLK_BENCH_CHUNK) != 0) {
+            return -1;
+        }
+    }
+    uint32_t ms = vblk_bench_elapsed(t0) / 1000;
+    *kbs = VBLK_BENCH_MB * 1024 * 1000 / (ms ? ms : 1);
+
+    vblk_bench_seed = 1;
+    t0 = rdtsc();
+    for (int i = 0; i < VBLK_BENCH_RANDOM; i++) {
+        uint32_t sec = (vblk_bench_rand() % (dev->size / VBLK_BENCH_SECS)) * VBLK_BENCH_SECS;
+        if (blk_read(dev, sec, buf, VBLK_BENCH_SECS) != 0) {
+            return -1;
+        }
+    }
+    *iops = VBLK_BENCH_RANDOM * 1000000U / vblk_bench_elapsed(t0);
+    return 0;
+}
+
+static int vblk_bench_main(void *arg) {
+    const char *names[] = {"hda", "vda"};
+    uint8_t *buf = kmalloc(VBLK_BENCH_CHUNK * BLK_SIZE);
+
+    if (buf == NULL) {
+        cprintf("vblkbench: out of memory\n");
+        return -1;
+    }
+
+    cprintf("\nvblkbench: %d MB in %d KB reads, %d random 4 KB reads\n",
+            VBLK_BENCH_MB, VBLK_BENCH_CHUNK * BLK_SIZE / 1024, VBLK_BENCH_RANDOM);
+    cprintf("DEVICE  SEQ KB/S  RAND IOPS  NOTIFIES  IRQS\n");
+    for (int i = 0; i < 2; i++) {
+        block_device_t *dev = blk_get_device_by_name(names[i]);
+        uint32_t kbs, iops;
+
+        if (dev == NULL || dev->size < VBLK_BENCH_MB * 2048) {
+            cprintf("%-6s  not present\n", names[i]);
+            continue;
+        }
+        memset(&vblk.stats, 0, sizeof(vblk.stats));
+        if (vblk_bench_dev(dev, buf, &kbs, &iops) != 0) {
+            cprintf("%-6s  read error\n", names[i]);
+            continue;
+        }
+        if (dev == &vblk.blk) {
+            cprintf("%-6s  %-8u  %-9u  %-8u  %u\n", names[i], kbs, iops,
+                    vblk.stats.notifies, vblk.stats.irqs);
+        } else {
+            cprintf("%-6s  %-8u  %-9u  -         -\n", names[i], kbs, iops);
+        }
+    }
+
+    if (vblk.present) {
+        static vblk_request_t reqs[VBLK_RW_BATCH];
+        uint32_t pages = vblk.capacity / VBLK_BENCH_SECS;
+        int errors = 0;
+
+        memset(&vblk.stats, 0, sizeof(vblk.stats));
+        vblk_bench_seed = 1;
+        uint64_t t0 = rdtsc();
+        for (int i = 0; i < VBLK_BENCH_RANDOM; i += VBLK_RW_BATCH) {
+            for (int k = 0; k < VBLK_RW_BATCH; k++) {
+                reqs[k].write = 0;
+                reqs[k].sector = (vblk_bench_rand() % pages) * VBLK_BENCH_SECS;
+                blk_cursor_flat(&reqs[k].data, buf + k * PG_SIZE);
+                reqs[k].nsecs = VBLK_BENCH_SECS;
+            }
+            vblk_submit(reqs, VBLK_RW_BATCH);
+            for (int k = 0; k < VBLK_RW_BATCH; k++) {
+                errors += vblk_wait(&reqs[k]) != 0;
+            }
+        }
+        uint32_t iops = VBLK_BENCH_RANDOM * 1000000U / vblk_bench_elapsed(t0);
+        if (errors) {
+            cprintf("vda batched: %d read errors\n", errors);
+        } else {
+            cprintf("vda, %d per batch: %u IOPS, %u notifies for %d requests, %u irqs\n",
+                    VBLK_RW_BATCH, iops, vblk.stats.notifies, VBLK_BENCH_RANDOM,
+                    vblk.stats.irqs);
+        }
+    }
+
+    kfree(buf);
+    return 0;
+}
+
+void virtio_blk_bench(void) {
+    if (tsc_khz == 0) {
+        cprintf("vblkbench: TSC not calibrated\n");
+        return;
+    }
+    if (kernel_thread(vblk_bench_main, NULL, "vblkbench") <= 0) {
+        cprintf("vblkbench: cannot start thread\n");
+    }
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <base/types.h>
+
+#include "../include/list.h"
+#include "../sched/wait.h"
+#include "blk.h"
+
+// Legacy (0.9.5) virtio PCI device
+#define VIRTIO_VENDOR_ID        0x1AF4
+#define VIRTIO_BLK_DEVICE_ID    0x1001  // Transitional block device
+
+// Legacy I/O registers (relative to BAR0), no MSI-X
+#define VIRTIO_HOST_FEATURES    0x00    // 32 bits
+#define VIRTIO_GUEST_FEATURES   0x04    // 32 bits
+#define VIRTIO_QUEUE_PFN        0x08    // 32 bits, page number of the ring
+#define VIRTIO_QUEUE_SIZE       0x0C    // 16 bits, fixed by the device
+#define VIRTIO_QUEUE_SELECT     0x0E    // 16 bits
+#define VIRTIO_QUEUE_NOTIFY     0x10    // 16 bits, queue index
+#define VIRTIO_DEVICE_STATUS    0x12    // 8 bits
+#define VIRTIO_ISR_STATUS       0x13    // 8 bits, read to acknowledge
+#define VIRTIO_BLK_CAPACITY     0x14    // 64 bits, 512-byte sectors
+
+#define VIRTIO_STATUS_ACK       0x01
+#define VIRTIO_STATUS_DRIVER    0x02
+#define VIRTIO_STATUS_DRIVER_OK 0x04
+#define VIRTIO_STATUS_FAILED    0x80
+
+#define VIRTIO_ISR_QUEUE        0x01    // A used ring was updated
+
+// Split virtqueue
+#define VRING_DESC_F_NEXT       0x1     // next is valid
+#define VRING_DESC_F_WRITE      0x2     // device writes the buffer
+#define VRING_ALIGN             4096    // used ring starts on its own page
+
+typedef struct {
+    uint64_t addr;                      // physical address
+    uint32_t len;
+    uint16_t flags;                     // VRING_DESC_F_*
+    uint16_t next;
+} vring_desc_t;
+
+typedef struct {
+    uint16_t flags;
+    volatile uint16_t idx;              // next ring entry the driver fills
+    uint16_t ring[];                    // heads of descriptor chains
+} vring_avail_t;
+
+typedef struct {
+    uint32_t id;                        // head of the finished chain
+    uint32_t len;                       // bytes written by the device
+} vring_used_elem_t;
+
+typedef struct {
+    uint16_t flags;
+    volatile uint16_t idx;              // next ring entry the device fills
+    vring_used_elem_t ring[];
+} vring_used_t;
+
+// Request header and status, device-readable / device-writable
+#define VIRTIO_BLK_T_IN         0       // read
+#define VIRTIO_BLK_T_OUT        1       // write
+#define VIRTIO_BLK_S_OK         0
+
+typedef struct {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} virtio_blk_hdr_t;
+
+#define VBLK_MAX_SECTORS        256     // Sectors per request
+#define VBLK_RW_BATCH           8       // Requests a large transfer keeps in flight
+#define VBLK_POLL_LIMIT         10000000
+
+// Request states, as for IDE
+#define VBLK_REQ_DONE           0
+#define VBLK_REQ_ERROR          (-1)
+#define VBLK_REQ_PENDING        1
+
+typedef struct vblk_request {
+    int write;
+    uint32_t sector;
+    blk_cursor_t data;                  // flat buffer or page segments
+    size_t nsecs;                       // at most VBLK_MAX_SECTORS
+    int head;                           // first descriptor while on the ring
+    volatile int status;                // VBLK_REQ_*
+    wait_queue_t wait;
+    list_entry_t link;                  // link in the pending queue
+} vblk_request_t;
+
+#define le2vblk_req(le) to_struct((le), vblk_request_t, link)
+
+typedef struct {
+    uint32_t requests;                  // requests placed on the ring
+    uint32_t notifies;                  // QUEUE_NOTIFY writes (one per batch)
+    uint32_t irqs;                      // interrupts with a used-ring update
+    uint32_t errors;                    // requests the device failed
+    uint32_t descs;                     // descriptors used
+} vblk_stats_t;
+
+typedef struct {
+    int present;
+    uint16_t iobase;                    // BAR0
+    uint16_t num;                       // ring entries
+    vring_desc_t *desc;
+    vring_avail_t *avail;
+    vring_used_t *used;
+    uint16_t free_head;                 // free descriptors, chained by next
+    uint16_t num_free;
+    uint16_t last_used;                 // used ring entries consumed
+    vblk_request_t **reqs;              // by head descriptor
+    virtio_blk_hdr_t *hdrs;             // by head descriptor
+    uint8_t *status;                    // by head descriptor
+    uint32_t capacity;                  // sectors
+    list_entry_t queue;                 // requests waiting for descriptors
+    vblk_stats_t stats;
+    block_device_t blk;
+} virtio_blk_t;
+
+// Find a virtio-blk device on PCI, set up its queue and register it as vda.
+// Needs pmm (the ring lives in pages).
+void virtio_blk_init(void);
+
+int virtio_blk_read(uint32_t sector, void *buf, size_t nsecs);
+int virtio_blk_write(uint32_t sector, const void *buf, size_t nsecs);
+
+// Sequential and random reads through block_device_t: vda against the IDE disk
+void virtio_blk_bench(void);
@@ -1,9 +1,28 @@
 #pragma once
 
 #include <base/types.h>
+#include <arch/x86/cpu.h>
+#include <arch/x86/asm/pg.h>
+
+// Byte loops handle the unaligned head and the tail; the aligned middle
+// moves 4 bytes per iteration with the string instructions.
 
 static inline void* memset(void *s, char c, size_t n) {
-    char* p = (char*)s;
+    uint8_t *p = (uint8_t *)s;
+
+    while (n > 0 && ((uintptr_t)p & 3)) {
+        *p++ = c;
+        n--;
+    }
+
+    size_t words = n >> 2;
+    uint32_t fill = (uint8_t)c * 0x01010101U;
+    asm volatile("cld; rep stosl"
+                 : "+D"(p), "+c"(words)
+                 : "a"(fill)
+                 : "memory", "cc");
+
+    n &= 3;
     while (n-- > 0) {
         *p++ = c;
     }
@@ -11,10 +30,95 @@ static inline void* memset(void *s, char c, size_t n) {
 }
 
 static inline void* memcpy(void *dst, const void *src, size_t n) {
-    char *d = (char*)dst;
-    const char *s = (const char*)src;
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+
+    // Align the destination; stores crossing a dword are the costly ones
+    while (n > 0 && ((uintptr_t)d & 3)) {
+        *d++ = *s++;
+        n--;
+    }
+
+    size_t words = n >> 2;
+    asm volatile("cld; rep movsl"
+                 : "+D"(d), "+S"(s), "+c"(words)
+                 :
+                 : "memory", "cc");
+
+    n &= 3;
     while (n-- > 0) {
         *d++ = *s++;
     }
     return dst;
-}
\ No newline at end of file
+}
+
+static inline void* memmove(void *dst, const void *src, size_t n) {
+    // dst below src, or no overlap: a forward copy is safe
+    if ((uintptr_t)dst - (uintptr_t)src >= n) {
+        return memcpy(dst, src, n);
+    }
+
+    // dst overlaps the tail of src: copy backwards
+    uint8_t *d = (uint8_t *)dst + n;
+    const uint8_t *s = (const uint8_t *)src + n;
+
+    while (n > 0 && ((uintptr_t)d & 3)) {
+        *--d = *--s;
+        n--;
+    }
+
+    size_t words = n >> 2;
+    if (words > 0) {
+        d -= 4;
+        s -= 4;
+        asm volatile("std; rep movsl; cld"
+                     : "+D"(d), "+S"(s), "+c"(words)
+                     :
+                     : "memory", "cc");
+        d += 4;
+        s += 4;
+    }
+
+    n &= 3;
+    while (n-- > 0) {
+        *--d = *--s;
+    }
+    return dst;
+}
+
+// Non-temporal stores for whole-page clears (set by cpu_init when SSE2 exists)
+extern int clear_page_nt;
+
+// Clear one page-aligned 4 KiB page
+static inline void clear_page(void *kva) {
+    if (clear_page_nt) {
+        // movnti bypasses the cache, so clearing does not evict hot data.
+        // It only uses general registers, so no FPU/SSE state is touched.
+        uint32_t *p = (uint32_t *)kva;
+        for (int i = 0; i < PG_SIZE / 4; i += 8) {
+            asm volatile("movnti %1, 0(%0);  movnti %1, 4(%0);"
+                         "movnti %1, 8(%0);  movnti %1, 12(%0);"
+                         "movnti %1, 16(%0); movnti %1, 20(%0);"
+                         "movnti %1, 24(%0); movnti %1, 28(%0);"
+                         :: "r"(p + i), "r"(0)
+                         : "memory");
+        }
+        asm volatile("sfence" ::: "memory");
+        return;
+    }
+
+    size_t words = PG_SIZE / 4;
+    asm volatile("cld; rep stosl"
+                 : "+D"(kva), "+c"(words)
+                 : "a"(0)
+                 : "memory", "cc");
+}
+
+// Copy one page-aligned 4 KiB page
+static inline void copy_page(void *dst, const void *src) {
+    size_t words = PG_SIZE / 4;
+    asm volatile("cld; rep movsl"
+                 : "+D"(dst), "+S"(src), "+c"(words)
+                 :
+                 : "memory", "cc");
+}
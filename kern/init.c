@@ -2,13 +2,20 @@
 #include "drivers/pit.h"
 #include "drivers/hd.h"
 #include "drivers/blk.h"
+#include "drivers/pci.h"
+#include "drivers/ahci.h"
+#include "drivers/virtio_blk.h"
+#include "drivers/bcache.h"
+#include "drivers/bio.h"
 #include "drivers/intr.h"
 #include "arch/x86/idt.h"
+#include <arch/x86/cpu.h>
 #include "cons/cons.h"
 #include "cons/shell.h"
 #include "mm/pmm.h"
 #include "mm/vmm.h"
 #include "mm/swap.h"
+#include "mm/kswapd.h"
 #include "sched/sched.h"
 #include "unistd.h"
 
@@ -21,17 +28,25 @@ __attribute__((noreturn)) int kern_init(void) {
 
     // drivers
     pic_init();
+    pci_init();     // Enumerate PCI functions before drivers look for controllers
     blk_init();     // Initialize block device layer (includes hd_init)
     pit_init();
 
     // arch
     idt_init();
+    cpu_init();
 
     pmm_init();
     vmm_init();
+    ahci_init();    // Command lists live in pages, registers above the direct map
+    virtio_blk_init();
+    bcache_init();
     swap_init();
 
     sched_init();
+    kswapd_init();
+    bcache_flusher_init();
+    blk_queue_init();   // Dispatcher threads for block request queues
 
     intr_enable();
 
@@ -41,6 +56,7 @@ __attribute__((noreturn)) int kern_init(void) {
     // Idle loop: continuously schedule processes
     // Init process will print the first prompt when it starts
     while (1) {
+        zero_pool_refill();  // Clear pages ahead of time while nothing else runs
         schedule();  // Let scheduler pick init or other processes
     }
     // while (1) pause();
@@ -0,0 +1,183 @@
+#include "kswapd.h"
+#include "pmm.h"
+#include "swap.h"
+#include "../sched/sched.h"
+#include "../drivers/intr.h"
+#include "../drivers/pit.h"
+#include "../debug/assert.h"
+
+#include "stdio.h"
+#include "math.h"
+
+#include <arch/x86/io.h>
+
+// Background Reclaim
+//
+// On a pcp miss or multi-page request alloc_pages() compares the free page
+// count against three watermarks:
+//   below low  - kswapd is woken and reclaims until free pages reach high
+//   below min  - the allocation also reclaims synchronously (direct reclaim),
+//                unless it comes from an interrupt handler
+// so allocations normally never wait for swap I/O. Both paths evict through
+// swap_out(), after first dropping unused swap readahead pages.
+//
+// Victims are spread over all address spaces by the global scanner
+// (swap_reclaim), which weighs each mm by its RSS and recent fault rate.
+//
+// Only one reclaimer runs at a time: swap_out() itself allocates, and the
+// keyboard interrupt (which runs shell commands) can arrive in the middle
+// of a kswapd pass.
+
+static task_struct *kswapd_proc = NULL;
+static volatile int kswapd_pending = 0;
+static uint64_t kswapd_wake_tsc = 0;
+
+static int reclaim_active = 0;
+static reclaim_stats_t stats;
+
+static uint32_t max_u32(uint32_t a, uint32_t b) {
+    return a > b ? a : b;
+}
+
+// Claim the reclaim path; 0 if another reclaimer holds it
+static int reclaim_enter(void) {
+    int ok = 0;
+
+    intr_save();
+    if (!reclaim_active) {
+        reclaim_active = 1;
+        ok = 1;
+    }
+    intr_restore();
+    return ok;
+}
+
+static void reclaim_exit(void) {
+    reclaim_active = 0;
+}
+
+/**
+ * Free pages until target pages are free or nothing more can be evicted
+ * @return pages reclaimed
+ */
+static uint32_t reclaim_to(size_t target) {
+    uint32_t reclaimed = 0;
+
+    if (pmm_nr_free_pages() < target) {
+        swap_cache_shrink(0);
+    }
+
+    while (pmm_nr_free_pages() < target && swap_mgr != NULL) {
+        int n = swap_reclaim(RECLAIM_BATCH);
+        if (n <= 0) {
+            break;
+        }
+        reclaimed += n;
+    }
+    return reclaimed;
+}
+
+static int kswapd_main(void *arg) {
+    while (1) {
+        intr_save();
+        if (!kswapd_pending) {
+            current->state = TASK_SLEEPING;
+        }
+        intr_restore();
+
+        if (current->state == TASK_SLEEPING) {
+            schedule();
+            continue;
+        }
+        kswapd_pending = 0;
+
+        if (!reclaim_enter()) {
+            schedule();
+            continue;
+        }
+        stats.kswapd_runs++;
+        stats.kswapd_pages += reclaim_to(pmm_watermarks()->high);
+        reclaim_exit();
+
+        uint64_t cycles = rdtsc() - kswapd_wake_tsc;
+        stats.kswapd_cycles += cycles;
+        stats.kswapd_max_us = max_u32(stats.kswapd_max_us, tsc_cycles_to_us(cycles));
+    }
+    return 0;
+}
+
+void kswapd_init(void) {
+    int pid = kernel_thread(kswapd_main, NULL, "kswapd");
+    assert(pid > 0);
+    kswapd_proc = find_proc(pid);
+
+    const pmm_watermarks_t *wm = pmm_watermarks();
+    cprintf("kswapd: started (PID %d), watermarks min=%d low=%d high=%d\n",
+            pid, wm->min, wm->low, wm->high);
+}
+
+void kswapd_wakeup(void) {
+    stats.low_hits++;
+    if (kswapd_proc == NULL) {
+        return;
+    }
+
+    intr_save();
+    if (!kswapd_pending) {
+        kswapd_pending = 1;
+        kswapd_wake_tsc = rdtsc();
+        if (kswapd_proc->state == TASK_SLEEPING) {
+            stats.kswapd_wakeups++;
+            wakeup_proc(kswapd_proc);
+        }
+    }
+    intr_restore();
+}
+
+void direct_reclaim(size_t n) {
+    stats.min_hits++;
+    if (!reclaim_enter()) {
+        stats.direct_skipped++;
+        return;
+    }
+
+    uint64_t t0 = rdtsc();
+    stats.direct_runs++;
+    stats.direct_pages += reclaim_to(pmm_watermarks()->min + n);
+    uint64_t cycles = rdtsc() - t0;
+    reclaim_exit();
+
+    stats.direct_cycles += cycles;
+    stats.direct_max_us = max_u32(stats.direct_max_us, tsc_cycles_to_us(cycles));
+}
+
+const reclaim_stats_t *reclaim_get_stats(void) {
+    return &stats;
+}
+
+// Average latency in microseconds
+static uint32_t avg_us(uint64_t cycles, uint32_t runs) {
+    if (runs == 0) {
+        return 0;
+    }
+    do_div(cycles, runs);
+    return tsc_cycles_to_us(cycles);
+}
+
+void vmstat_print(void) {
+    const pmm_watermarks_t *wm = pmm_watermarks();
+
+    cprintf("free pages:     %d\n", pmm_nr_free_pages());
+    cprintf("watermarks:     min %d, low %d, high %d\n", wm->min, wm->low, wm->high);
+    cprintf("below low:      %u allocations\n", stats.low_hits);
+    cprintf("below min:      %u allocations\n", stats.min_hits);
+    cprintf("kswapd:         %u wakeups, %u runs, %u pages, avg %u us, max %u us\n",
+            stats.kswapd_wakeups, stats.kswapd_runs, stats.kswapd_pages,
+            avg_us(stats.kswapd_cycles, stats.kswapd_runs), stats.kswapd_max_us);
+    cprintf("direct reclaim: %u runs, %u pages, avg %u us, max %u us, %u skipped\n",
+            stats.direct_runs, stats.direct_pages,
+            avg_us(stats.direct_cycles, stats.direct_runs), stats.direct_max_us,
+            stats.direct_skipped);
+    cprintf("\n");
+    swap_print_mm();
+}
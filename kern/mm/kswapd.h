@@ -0,0 +1,36 @@
+#pragma once
+
+#include <base/types.h>
+
+// Pages moved per swap_out() call during reclaim
+#define RECLAIM_BATCH   8
+
+// Reclaim counters (vmstat)
+typedef struct {
+    uint32_t low_hits;          // allocations that found free pages below low
+    uint32_t min_hits;          // allocations that found free pages below min
+    uint32_t kswapd_wakeups;    // sleeping kswapd woken
+    uint32_t kswapd_runs;       // reclaim passes run by kswapd
+    uint32_t kswapd_pages;      // pages reclaimed by kswapd
+    uint64_t kswapd_cycles;     // wakeup-to-high latency, summed over runs
+    uint32_t kswapd_max_us;     // worst wakeup-to-high latency
+    uint32_t direct_runs;       // direct reclaim passes
+    uint32_t direct_pages;      // pages reclaimed by allocating contexts
+    uint64_t direct_cycles;     // time spent in direct reclaim
+    uint32_t direct_max_us;     // worst direct reclaim stall
+    uint32_t direct_skipped;    // direct reclaim refused (reclaim already running)
+} reclaim_stats_t;
+
+// Start the kswapd kernel thread
+void kswapd_init(void);
+
+// Ask kswapd to reclaim up to the high watermark
+void kswapd_wakeup(void);
+
+// Reclaim in the caller's context until n pages are above min
+void direct_reclaim(size_t n);
+
+const reclaim_stats_t *reclaim_get_stats(void);
+
+// Print watermarks and reclaim statistics (vmstat)
+void vmstat_print(void);
@@ -0,0 +1,178 @@
+#include "lz.h"
+#include "memory.h"
+
+// LZ Compressor
+//
+// Greedy single-probe matching: a hash of the next 4 bytes indexes a table
+// of the last position that hashed there, and a candidate is taken if its
+// 4 bytes really match. This trades ratio for speed, which is what a swap
+// path that compresses on every eviction wants.
+//
+// The last LZ_LAST_LITERALS bytes are always emitted as literals, so the
+// decoder never has to look past a match for the next token.
+
+#define LZ_HASH_BITS        11
+#define LZ_HASH_SIZE        (1 << LZ_HASH_BITS)
+#define LZ_HASH_EMPTY       0xFFFF
+#define LZ_LAST_LITERALS    5
+#define LZ_MAX_OFFSET       0xFFFF
+
+// Positions fit in 16 bits: inputs are at most one page
+static uint16_t lz_hash_table[LZ_HASH_SIZE];
+
+static inline uint32_t lz_read32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t lz_hash(uint32_t seq) {
+    return (seq * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+// Write a length's 255-run extension after a saturated nibble
+static uint8_t *lz_put_length(uint8_t *op, size_t len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+size_t lz_compress(const void *src, size_t n, void *dst, size_t cap) {
+    const uint8_t *in = (const uint8_t *)src;
+    uint8_t *out = (uint8_t *)dst;
+    uint8_t *op = out;
+    uint8_t *oend = out + cap;
+    size_t ip = 0, anchor = 0;
+
+    if (n > LZ_MAX_OFFSET) {
+        return 0;
+    }
+    memset(lz_hash_table, 0xFF, sizeof(lz_hash_table));
+
+    size_t limit = (n > LZ_LAST_LITERALS + LZ_MIN_MATCH) ? n - LZ_LAST_LITERALS - LZ_MIN_MATCH : 0;
+    while (ip < limit) {
+        uint32_t seq = lz_read32(in + ip);
+        uint32_t h = lz_hash(seq);
+        uint32_t ref = lz_hash_table[h];
+        lz_hash_table[h] = ip;
+
+        if (ref == LZ_HASH_EMPTY || lz_read32(in + ref) != seq) {
+            ip++;
+            continue;
+        }
+
+        size_t mlen = LZ_MIN_MATCH;
+        while (ip + mlen < n - LZ_LAST_LITERALS && in[ref + mlen] == in[ip + mlen]) {
+            mlen++;
+        }
+
+        // Worst case for this sequence: token, length runs, literals, offset
+        size_t lit = ip - anchor;
+        if (op + 1 + lit / 255 + 1 + lit + 2 + mlen / 255 + 1 > oend) {
+            return 0;
+        }
+
+        uint8_t *token = op++;
+        *token = (lit >= 15 ? 15 : lit) << 4;
+        if (lit >= 15) {
+            op = lz_put_length(op, lit - 15);
+        }
+        memcpy(op, in + anchor, lit);
+        op += lit;
+
+        uint32_t off = ip - ref;
+        *op++ = off & 0xFF;
+        *op++ = off >> 8;
+
+        size_t m = mlen - LZ_MIN_MATCH;
+        *token |= (m >= 15 ? 15 : m);
+        if (m >= 15) {
+            op = lz_put_length(op, m - 15);
+        }
+
+        ip += mlen;
+        anchor = ip;
+    }
+
+    // Trailing literals
+    size_t lit = n - anchor;
+    if (op + 1 + lit / 255 + 1 + lit > oend) {
+        return 0;
+    }
+    uint8_t *token = op++;
+    *token = (lit >= 15 ? 15 : lit) << 4;
+    if (lit >= 15) {
+        op = lz_put_length(op, lit - 15);
+    }
+    memcpy(op, in + anchor, lit);
+    op += lit;
+
+    return op - out;
+}
+
+size_t lz_decompress(const void *src, size_t len, void *dst, size_t cap) {
+    const uint8_t *ip = (const uint8_t *)src;
+    const uint8_t *iend = ip + len;
+    uint8_t *out = (uint8_t *)dst;
+    uint8_t *op = out;
+    uint8_t *oend = out + cap;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+
+        size_t lit = token >> 4;
+        if (lit == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) {
+                    return 0;
+                }
+                b = *ip++;
+                lit += b;
+            } while (b == 255);
+        }
+        if (lit > (size_t)(iend - ip) || lit > (size_t)(oend - op)) {
+            return 0;
+        }
+        memcpy(op, ip, lit);
+        ip += lit;
+        op += lit;
+
+        if (ip == iend) {
+            break;  // last sequence
+        }
+
+        if (iend - ip < 2) {
+            return 0;
+        }
+        size_t off = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (off == 0 || off > (size_t)(op - out)) {
+            return 0;
+        }
+
+        size_t mlen = (token & 15) + LZ_MIN_MATCH;
+        if ((token & 15) == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) {
+                    return 0;
+                }
+                b = *ip++;
+                mlen += b;
+            } while (b == 255);
+        }
+        if (mlen > (size_t)(oend - op)) {
+            return 0;
+        }
+
+        // Byte copy: the match may overlap the bytes it produces
+        const uint8_t *match = op - off;
+        while (mlen-- > 0) {
+            *op++ = *match++;
+        }
+    }
+
+    return op - out;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <base/types.h>
+
+// Byte-oriented LZ77 compressor in the LZ4 block format: each sequence is
+// a token (literal length << 4 | match length - 4), the literals, and a
+// 16-bit little-endian back offset. The last sequence has literals only.
+
+#define LZ_MIN_MATCH    4
+
+// Compress n bytes of src into dst (at most cap bytes).
+// Returns the compressed length, 0 if it does not fit in cap.
+size_t lz_compress(const void *src, size_t n, void *dst, size_t cap);
+
+// Decompress len bytes of src into dst (at most cap bytes).
+// Returns the decompressed length, 0 on malformed input.
+size_t lz_decompress(const void *src, size_t len, void *dst, size_t cap);
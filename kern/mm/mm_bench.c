@@ -0,0 +1,752 @@
+#include "mm_bench.h"
+#include "pmm.h"
+#include "pmm_firstfit.h"
+#include "pmm_buddy.h"
+#include "vmm.h"
+#include "swap.h"
+#include "swap_fifo.h"
+#include "swap_clock.h"
+#include "swap_arc.h"
+#include "zswap.h"
+
+#include "stdio.h"
+#include "math.h"
+#include "memory.h"
+#include "../drivers/intr.h"
+#include "../drivers/pit.h"
+
+#include <arch/x86/io.h>
+#include <arch/x86/mmu.h>
+
+// Benchmark configuration
+#define BENCH_POOL_PAGES    512     // private pool handed to an inactive manager
+#define BENCH_SLOTS         64      // live allocations kept during churn
+#define BENCH_ITERS         4096    // alloc/free operations per run
+#define BENCH_MAX_ALLOC     8       // random request size in [1, BENCH_MAX_ALLOC] pages
+#define BENCH_SEED          12345
+
+#define PCP_BENCH_BATCH     32      // pages held at once in the single-page bench
+#define PCP_BENCH_ROUNDS    256
+
+#define ZERO_BENCH_BASE     0x10000000  // scratch range for simulated faults
+#define ZERO_BENCH_FAULTS   16          // faults per run (fits in a full pool)
+
+#define MEM_BENCH_BYTES     (64 * 1024) // bytes moved per size class
+#define MEM_BENCH_PAGES     16          // pages cleared per clear_page run
+
+#define RMAP_BENCH_BASE     0x20000000  // scratch range for the swap-out bench
+#define RMAP_BENCH_PAGES    64          // pages mapped and then swapped out
+
+#define SWAP_BENCH_BASE     0x30000000  // scratch range for the paging bench
+#define SWAP_BENCH_PAGES    256         // working set
+#define SWAP_BENCH_RESIDENT 64          // resident cap standing in for RAM
+#define SWAP_BENCH_EVICT    8           // pages evicted when the cap is hit
+#define SWAP_BENCH_RANDOM   512         // accesses in the random pass
+
+#define ZIPF_BENCH_ACCESSES 2048        // accesses per measured run
+#define ZIPF_BENCH_SCALE    (1 << 20)   // weight of the hottest page
+
+extern mm_struct init_mm;
+
+typedef struct {
+    uint64_t alloc_cycles;
+    uint64_t free_cycles;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;
+} churn_result_t;
+
+// Deterministic LCG so every manager sees the same request sequence
+static uint32_t bench_seed;
+
+static uint32_t bench_rand(void) {
+    bench_seed = bench_seed * 1103515245 + 12345;
+    return bench_seed >> 16;
+}
+
+static uint32_t per_call(uint64_t cycles, uint32_t calls) {
+    if (calls == 0) {
+        return 0;
+    }
+    do_div(cycles, calls);
+    return (uint32_t)cycles;
+}
+
+// Kept static: shell commands run on a 4 KB kernel stack
+static PageDesc *slot_page[BENCH_SLOTS];
+static size_t slot_size[BENCH_SLOTS];
+
+/**
+ * Random-size alloc/free churn against one manager
+ * Each step picks a slot; an occupied slot is freed, an empty one is filled
+ * with a random-size allocation.
+ */
+static void pmm_churn(const pmm_manager *mgr, churn_result_t *res) {
+    memset(res, 0, sizeof(*res));
+    for (int i = 0; i < BENCH_SLOTS; i++) {
+        slot_page[i] = NULL;
+    }
+
+    bench_seed = BENCH_SEED;
+    for (int iter = 0; iter < BENCH_ITERS; iter++) {
+        int s = bench_rand() % BENCH_SLOTS;
+
+        if (slot_page[s]) {
+            uint64_t t0 = rdtsc();
+            mgr->free(slot_page[s], slot_size[s]);
+            res->free_cycles += rdtsc() - t0;
+            res->frees++;
+            slot_page[s] = NULL;
+        } else {
+            size_t n = bench_rand() % BENCH_MAX_ALLOC + 1;
+            uint64_t t0 = rdtsc();
+            PageDesc *page = mgr->alloc(n);
+            res->alloc_cycles += rdtsc() - t0;
+            res->allocs++;
+            if (page) {
+                slot_page[s] = page;
+                slot_size[s] = n;
+            } else {
+                res->failures++;
+            }
+        }
+    }
+
+    for (int i = 0; i < BENCH_SLOTS; i++) {
+        if (slot_page[i]) {
+            mgr->free(slot_page[i], slot_size[i]);
+            slot_page[i] = NULL;
+        }
+    }
+}
+
+void pmm_bench(void) {
+    static const pmm_manager *const managers[] = {
+        &firstfit_pmm_mgr,
+        &buddy_pmm_mgr,
+    };
+    churn_result_t res;
+
+    cprintf("pmm bench: %d ops, %d live slots, 1-%d pages per request\n",
+            BENCH_ITERS, BENCH_SLOTS, BENCH_MAX_ALLOC);
+    cprintf("MANAGER     MODE  ALLOC(cyc)  FREE(cyc)  ALLOCS  FREES  FAILED\n");
+
+    for (int i = 0; i < sizeof(managers) / sizeof(managers[0]); i++) {
+        const pmm_manager *mgr = managers[i];
+        const char *mode;
+
+        if (mgr == pmm_mgr) {
+            // Active manager: churn on the live free lists
+            mode = "live";
+            intr_save();
+            pmm_churn(mgr, &res);
+            intr_restore();
+        } else {
+            // Inactive manager: seed it with a private pool borrowed from the live one
+            PageDesc *pool = alloc_pages(BENCH_POOL_PAGES);
+            if (pool == NULL) {
+                cprintf("%-10s  cannot borrow %d pages\n", mgr->name, BENCH_POOL_PAGES);
+                continue;
+            }
+
+            mode = "pool";
+            intr_save();
+            mgr->init();
+            mgr->init_memmap(pool, BENCH_POOL_PAGES);
+            pmm_churn(mgr, &res);
+            intr_restore();
+
+            // Drop the private manager's bookkeeping before handing pages back
+            for (PageDesc *p = pool; p != pool + BENCH_POOL_PAGES; p++) {
+                p->flags = 0;
+                p->property = 0;
+            }
+            pages_free(pool, BENCH_POOL_PAGES);
+        }
+
+        cprintf("%-10s  %-4s  %-10u  %-9u  %-6u  %-5u  %u\n",
+                mgr->name, mode,
+                per_call(res.alloc_cycles, res.allocs),
+                per_call(res.free_cycles, res.frees),
+                res.allocs, res.frees, res.failures);
+    }
+}
+
+// Page batch for the single-page bench
+static PageDesc *batch_page[PCP_BENCH_BATCH];
+
+// Uncached single-page path: straight to the manager under its lock
+static PageDesc *direct_alloc_page(void) {
+    intr_save();
+    PageDesc *page = pmm_mgr->alloc(1);
+    intr_restore();
+    return page;
+}
+
+static void direct_free_page(PageDesc *page) {
+    intr_save();
+    pmm_mgr->free(page, 1);
+    intr_restore();
+}
+
+/**
+ * Allocate a batch of single pages, free them all, repeat
+ * @param cached: 1 to go through alloc_pages/pages_free, 0 to bypass the pcp
+ */
+static void single_page_churn(int cached, churn_result_t *res) {
+    memset(res, 0, sizeof(*res));
+
+    for (int round = 0; round < PCP_BENCH_ROUNDS; round++) {
+        for (int i = 0; i < PCP_BENCH_BATCH; i++) {
+            uint64_t t0 = rdtsc();
+            batch_page[i] = cached ? alloc_page() : direct_alloc_page();
+            res->alloc_cycles += rdtsc() - t0;
+            res->allocs++;
+            if (batch_page[i] == NULL) {
+                res->failures++;
+            }
+        }
+
+        for (int i = PCP_BENCH_BATCH - 1; i >= 0; i--) {
+            if (batch_page[i] == NULL) {
+                continue;
+            }
+            uint64_t t0 = rdtsc();
+            if (cached) {
+                free_page(batch_page[i]);
+            } else {
+                direct_free_page(batch_page[i]);
+            }
+            res->free_cycles += rdtsc() - t0;
+            res->frees++;
+        }
+    }
+}
+
+void pcp_bench(void) {
+    churn_result_t direct, cached;
+    const per_cpu_pages *pcp = pcp_get_stats(0);
+
+    cprintf("pcp bench: %d rounds of %d single-page allocs then frees (%s)\n",
+            PCP_BENCH_ROUNDS, PCP_BENCH_BATCH, pmm_mgr->name);
+
+    single_page_churn(0, &direct);
+
+    uint32_t hits = pcp->hits, misses = pcp->misses;
+    single_page_churn(1, &cached);
+    hits = pcp->hits - hits;
+    misses = pcp->misses - misses;
+
+    uint32_t direct_alloc = per_call(direct.alloc_cycles, direct.allocs);
+    uint32_t direct_free = per_call(direct.free_cycles, direct.frees);
+    uint32_t cached_alloc = per_call(cached.alloc_cycles, cached.allocs);
+    uint32_t cached_free = per_call(cached.free_cycles, cached.frees);
+
+    cprintf("PATH     ALLOC(cyc)  FREE(cyc)  FAILED\n");
+    cprintf("direct   %-10u  %-9u  %u\n", direct_alloc, direct_free, direct.failures);
+    cprintf("pcp      %-10u  %-9u  %u\n", cached_alloc, cached_free, cached.failures);
+
+    uint32_t direct_pair = direct_alloc + direct_free;
+    uint32_t cached_pair = cached_alloc + cached_free;
+    if (cached_pair > 0) {
+        uint32_t speedup = direct_pair * 10 / cached_pair;
+        cprintf("alloc+free speedup: %u.%ux\n", speedup / 10, speedup % 10);
+    }
+    cprintf("pcp hits %u, misses %u (high=%d low=%d)\n", hits, misses, pcp->high, pcp->low);
+}
+
+/**
+ * Take n anonymous faults on fresh scratch addresses, then unmap them
+ * @return total cycles spent in vmm_pg_fault
+ */
+static uint64_t fault_run(int n) {
+    uint64_t cycles = 0;
+
+    for (int i = 0; i < n; i++) {
+        uintptr_t addr = ZERO_BENCH_BASE + i * PG_SIZE;
+        uint64_t t0 = rdtsc();
+        vmm_pg_fault(&init_mm, 0, addr);
+        cycles += rdtsc() - t0;
+    }
+
+    for (int i = 0; i < n; i++) {
+        page_remove(init_mm.pgdir, ZERO_BENCH_BASE + i * PG_SIZE);
+    }
+
+    return cycles;
+}
+
+void zero_bench(void) {
+    const zero_pool_stats_t *zs = zero_pool_get_stats();
+
+    // Warm up: the first fault also allocates the scratch page table
+    fault_run(1);
+
+    zero_pool_drain();
+    uint64_t sync_cycles = fault_run(ZERO_BENCH_FAULTS);
+
+    // Fill the pool the way the idle loop would
+    unsigned int last = ~0U;
+    while (zs->count < zs->target && zs->count != last) {
+        last = zs->count;
+        zero_pool_refill();
+    }
+    unsigned int depth = zs->count;
+    uint64_t pooled_cycles = fault_run(ZERO_BENCH_FAULTS);
+
+    uint32_t sync = per_call(sync_cycles, ZERO_BENCH_FAULTS);
+    uint32_t pooled = per_call(pooled_cycles, ZERO_BENCH_FAULTS);
+
+    cprintf("zero bench: %d anonymous faults per run\n", ZERO_BENCH_FAULTS);
+    cprintf("pool depth: %d before run, %d after (target %d)\n", depth, zs->count, zs->target);
+    cprintf("sync clear: %u cycles/fault\n", sync);
+    cprintf("from pool:  %u cycles/fault\n", pooled);
+    if (sync > 0 && pooled <= sync) {
+        cprintf("fault latency reduced by %u%c\n", (sync - pooled) * 100 / sync, '%');
+    }
+}
+
+// Source/destination buffers for the string bench (one page each)
+static uint8_t mem_src[PG_SIZE] __attribute__((aligned(PG_SIZE)));
+static uint8_t mem_dst[PG_SIZE] __attribute__((aligned(PG_SIZE)));
+
+// Reference byte loops: the implementations memory.h used to have
+static void byte_memset(void *s, char c, size_t n) {
+    volatile uint8_t *p = s;
+    while (n-- > 0) {
+        *p++ = c;
+    }
+}
+
+static void byte_memcpy(void *dst, const void *src, size_t n) {
+    volatile uint8_t *d = dst;
+    const uint8_t *s = src;
+    while (n-- > 0) {
+        *d++ = *s++;
+    }
+}
+
+/**
+ * Bytes per cycle as fixed point with two decimals
+ * @return bytes * 100 / cycles
+ */
+static uint32_t bytes_per_cycle(uint32_t bytes, uint64_t cycles) {
+    if (cycles == 0) {
+        return 0;
+    }
+    uint64_t scaled = (uint64_t)bytes * 100;
+    do_div(scaled, cycles);
+    return (uint32_t)scaled;
+}
+
+static void print_bpc(uint32_t bpc) {
+    cprintf("%u.%u%u", bpc / 100, bpc / 10 % 10, bpc % 10);
+}
+
+/**
+ * Time MEM_BENCH_BYTES worth of one operation at a given size
+ * @param op: 0 memset, 1 memcpy, 2 byte memset, 3 byte memcpy
+ */
+static uint64_t mem_run(int op, size_t size) {
+    int reps = MEM_BENCH_BYTES / size;
+    uint64_t t0 = rdtsc();
+    for (int i = 0; i < reps; i++) {
+        switch (op) {
+        case 0: memset(mem_dst, i, size); break;
+        case 1: memcpy(mem_dst, mem_src, size); break;
+        case 2: byte_memset(mem_dst, i, size); break;
+        default: byte_memcpy(mem_dst, mem_src, size); break;
+        }
+    }
+    return rdtsc() - t0;
+}
+
+/**
+ * Clear MEM_BENCH_PAGES pages with the given clear_page mode
+ * @param nt: 1 for non-temporal stores, 0 for rep stosl
+ */
+static uint64_t clear_run(PageDesc *pages, int nt) {
+    int saved = clear_page_nt;
+    clear_page_nt = nt;
+
+    uint64_t t0 = rdtsc();
+    for (int i = 0; i < MEM_BENCH_PAGES; i++) {
+        clear_page(page2kva(pages + i));
+    }
+    uint64_t cycles = rdtsc() - t0;
+
+    clear_page_nt = saved;
+    return cycles;
+}
+
+void mem_bench(void) {
+    static const size_t sizes[] = {16, 64, 256, 1024, 4096};
+
+    for (int i = 0; i < PG_SIZE; i++) {
+        mem_src[i] = i;
+    }
+
+    cprintf("mem bench: %d bytes per size class, bytes/cycle\n", MEM_BENCH_BYTES);
+    cprintf("SIZE   MEMSET  (BYTE)  MEMCPY  (BYTE)\n");
+    for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        uint32_t total = MEM_BENCH_BYTES / sizes[i] * sizes[i];
+
+        cprintf("%-5d  ", sizes[i]);
+        print_bpc(bytes_per_cycle(total, mem_run(0, sizes[i])));
+        cprintf("    ");
+        print_bpc(bytes_per_cycle(total, mem_run(2, sizes[i])));
+        cprintf("    ");
+        print_bpc(bytes_per_cycle(total, mem_run(1, sizes[i])));
+        cprintf("    ");
+        print_bpc(bytes_per_cycle(total, mem_run(3, sizes[i])));
+        cprintf("\n");
+    }
+
+    PageDesc *pages = alloc_pages(MEM_BENCH_PAGES);
+    if (pages == NULL) {
+        cprintf("clear_page: cannot allocate %d pages\n", MEM_BENCH_PAGES);
+        return;
+    }
+
+    uint32_t bytes = MEM_BENCH_PAGES * PG_SIZE;
+    cprintf("clear_page rep stosl: ");
+    print_bpc(bytes_per_cycle(bytes, clear_run(pages, 0)));
+    cprintf("\n");
+    if (cpu_has(CPUID_FEAT_EDX_SSE2)) {
+        cprintf("clear_page movnti:    ");
+        print_bpc(bytes_per_cycle(bytes, clear_run(pages, 1)));
+        cprintf("\n");
+    } else {
+        cprintf("clear_page movnti:    n/a (no SSE2)\n");
+    }
+    cprintf("clear_page default:   %s\n", clear_page_nt ? "movnti" : "rep stosl");
+
+    pages_free(pages, MEM_BENCH_PAGES);
+}
+
+// The page-directory walk swap_out used before the reverse map
+static uintptr_t pgdir_scan_vaddr(pde_t *pgdir, PageDesc *page) {
+    uintptr_t pa = page2pa(page);
+
+    for (int pde_idx = 0; pde_idx < PDE_NUM; pde_idx++) {
+        if (!(pgdir[pde_idx] & PTE_P)) {
+            continue;
+        }
+        pte_t *pt = (pte_t *)K_ADDR(PDE_ADDR(pgdir[pde_idx]));
+        for (int pte_idx = 0; pte_idx < PTE_NUM; pte_idx++) {
+            if ((pt[pte_idx] & PTE_P) && PTE_ADDR(pt[pte_idx]) == pa) {
+                return PG_ADDR(pde_idx, pte_idx, 0);
+            }
+        }
+    }
+    return 0;
+}
+
+static PageDesc *rmap_bench_page[RMAP_BENCH_PAGES];
+
+void rmap_bench(void) {
+    int mapped = 0;
+
+    // Start from an empty replacement list for init_mm
+    swap_init_mm(&init_mm);
+
+    for (int i = 0; i < RMAP_BENCH_PAGES; i++) {
+        uintptr_t addr = RMAP_BENCH_BASE + i * PG_SIZE;
+        PageDesc *page = pgdir_alloc_page(init_mm.pgdir, addr, PTE_W);
+        if (page == NULL) {
+            break;
+        }
+        *(uint32_t *)page2kva(page) = i;
+        swap_mgr->map_swappable(&init_mm, addr, page, 0);
+        rmap_bench_page[mapped++] = page;
+    }
+
+    // Victim lookup alone: reverse map vs. scanning the page directory
+    uint64_t rmap_cycles = 0, scan_cycles = 0;
+    int misses = 0;
+    for (int i = 0; i < mapped; i++) {
+        uintptr_t expect = RMAP_BENCH_BASE + i * PG_SIZE;
+
+        uint64_t t0 = rdtsc();
+        uintptr_t a = find_vaddr_for_page(&init_mm, rmap_bench_page[i]);
+        rmap_cycles += rdtsc() - t0;
+
+        t0 = rdtsc();
+        uintptr_t b = pgdir_scan_vaddr(init_mm.pgdir, rmap_bench_page[i]);
+        scan_cycles += rdtsc() - t0;
+
+        if (a != expect || b != expect) {
+            misses++;
+        }
+    }
+
+    // Full swap-out: victim selection, lookup, disk write, unmap
+    uint64_t t0 = rdtsc();
+    int swapped = swap_out(&init_mm, mapped, 0);
+    uint64_t swap_cycles = rdtsc() - t0;
+
+    int unmapped = 0;
+    for (int i = 0; i < mapped; i++) {
+        uintptr_t addr = RMAP_BENCH_BASE + i * PG_SIZE;
+        pte_t *ptep = get_pte(init_mm.pgdir, addr, 0);
+        if (ptep && *ptep != 0 && !(*ptep & PTE_P)) {
+            unmapped++;
+            swap_entry_free(*ptep);
+            *ptep = 0;
+        } else {
+            page_remove(init_mm.pgdir, addr);
+        }
+    }
+
+    cprintf("rmap bench: %d pages mapped at 0x%08x\n", mapped, RMAP_BENCH_BASE);
+    cprintf("lookup rmap:  %u cycles/page\n", per_call(rmap_cycles, mapped));
+    cprintf("lookup scan:  %u cycles/page\n", per_call(scan_cycles, mapped));
+    if (misses) {
+        cprintf("lookup mismatches: %d\n", misses);
+    }
+
+    uint32_t us = tsc_cycles_to_us(swap_cycles);
+    cprintf("swap_out:     %d pages (%d unmapped), %u cycles/page",
+            swapped, unmapped, per_call(swap_cycles, swapped));
+    if (us > 0) {
+        uint64_t rate = (uint64_t)swapped * 1000000;
+        do_div(rate, us);
+        cprintf(", %u pages/sec", (uint32_t)rate);
+    }
+    cprintf("\n");
+}
+
+// Paging bench state
+static int swap_bench_resident;
+static uint32_t swap_bench_faults;
+static uint32_t swap_bench_errors;
+
+/**
+ * Touch page idx of the working set, faulting it in under the resident cap
+ * The read goes through the mapping, so the MMU sets PTE_A like a real access.
+ */
+static void swap_bench_touch(int idx) {
+    uintptr_t addr = SWAP_BENCH_BASE + idx * PG_SIZE;
+    pte_t *ptep = get_pte(init_mm.pgdir, addr, 0);
+
+    if (ptep == NULL || !(*ptep & PTE_P)) {
+        if (swap_bench_resident >= SWAP_BENCH_RESIDENT) {
+            swap_bench_resident -= swap_out(&init_mm, SWAP_BENCH_EVICT, 0);
+        }
+        vmm_pg_fault(&init_mm, 0, addr);
+        swap_bench_resident++;
+        swap_bench_faults++;
+        ptep = get_pte(init_mm.pgdir, addr, 0);
+    }
+
+    if (ptep == NULL || !(*ptep & PTE_P) || *(volatile uint32_t *)addr != (uint32_t)idx) {
+        swap_bench_errors++;
+    }
+}
+
+/**
+ * One access pattern over the working set
+ * @param random: 0 for two sequential sweeps, 1 for uniform random pages
+ */
+static void swap_bench_pass(const char *name, int random) {
+    const swap_stats_t *st = swap_get_stats();
+    uint32_t ios = st->read_ios + st->write_ios;
+    uint32_t secs = st->read_sectors + st->write_sectors;
+    uint32_t ra_hits = st->ra_hits;
+
+    swap_bench_faults = 0;
+    uint64_t t0 = rdtsc();
+    if (random) {
+        bench_seed = BENCH_SEED;
+        for (int i = 0; i < SWAP_BENCH_RANDOM; i++) {
+            swap_bench_touch(bench_rand() % SWAP_BENCH_PAGES);
+        }
+    } else {
+        for (int pass = 0; pass < 2; pass++) {
+            for (int i = 0; i < SWAP_BENCH_PAGES; i++) {
+                swap_bench_touch(i);
+            }
+        }
+    }
+    uint64_t cycles = rdtsc() - t0;
+
+    ios = st->read_ios + st->write_ios - ios;
+    secs = st->read_sectors + st->write_sectors - secs;
+
+    uint32_t us = tsc_cycles_to_us(cycles);
+    uint32_t rate = 0;
+    if (us > 0) {
+        uint64_t r = (uint64_t)swap_bench_faults * 1000000;
+        do_div(r, us);
+        rate = (uint32_t)r;
+    }
+
+    cprintf("%-6s  %-2d  %-6u  %-10u  %-6u  %-7u  %u\n",
+            name, swap_get_readahead(), swap_bench_faults, rate,
+            ios, ios ? secs / ios : 0, st->ra_hits - ra_hits);
+}
+
+/**
+ * Map the working set under the resident cap on a fresh replacement list
+ * Every page carries its index so reads can be verified.
+ */
+static void swap_bench_populate(void) {
+    swap_init_mm(&init_mm);
+    swap_bench_resident = 0;
+    swap_bench_errors = 0;
+
+    for (int i = 0; i < SWAP_BENCH_PAGES; i++) {
+        uintptr_t addr = SWAP_BENCH_BASE + i * PG_SIZE;
+        if (swap_bench_resident >= SWAP_BENCH_RESIDENT) {
+            swap_bench_resident -= swap_out(&init_mm, SWAP_BENCH_EVICT, 0);
+        }
+        PageDesc *page = pgdir_alloc_page(init_mm.pgdir, addr, PTE_W);
+        if (page == NULL) {
+            cprintf("swap bench: out of memory at page %d\n", i);
+            break;
+        }
+        *(uint32_t *)page2kva(page) = i;
+        swap_mgr->map_swappable(&init_mm, addr, page, 0);
+        swap_bench_resident++;
+    }
+}
+
+// Drop every mapping and swap entry of the working set
+static void swap_bench_teardown(void) {
+    for (int i = 0; i < SWAP_BENCH_PAGES; i++) {
+        uintptr_t addr = SWAP_BENCH_BASE + i * PG_SIZE;
+        pte_t *ptep = get_pte(init_mm.pgdir, addr, 0);
+        if (ptep && *ptep != 0 && !(*ptep & PTE_P)) {
+            swap_entry_free(*ptep);
+            *ptep = 0;
+        } else {
+            page_remove(init_mm.pgdir, addr);
+        }
+    }
+    swap_cache_shrink(0);
+}
+
+// The benches touch the working set through init_mm's page tables
+static int swap_bench_check_cr3(void) {
+    if (rcr3() != P_ADDR(init_mm.pgdir)) {
+        cprintf("swap bench: must run on the boot page directory\n");
+        return -1;
+    }
+    return 0;
+}
+
+void swap_bench(void) {
+    static const unsigned int windows[] = {1, SWAP_RA_DEFAULT, SWAP_CLUSTER_MAX};
+    unsigned int saved_window = swap_get_readahead();
+
+    if (swap_bench_check_cr3() != 0) {
+        return;
+    }
+
+    // Measure the disk path first; the compressed pool would absorb it
+    int saved_zswap = zswap_set_enabled(0);
+    swap_bench_populate();
+
+    cprintf("swap bench: %d-page working set, %d resident, evict %d at a time\n",
+            SWAP_BENCH_PAGES, SWAP_BENCH_RESIDENT, SWAP_BENCH_EVICT);
+    cprintf("PATTERN RA  FAULTS  FAULTS/SEC  I/OS    SEC/IO   RA-HITS\n");
+    for (int w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+        swap_set_readahead(windows[w]);
+        swap_bench_pass("seq", 0);
+        swap_bench_pass("random", 1);
+    }
+    swap_set_readahead(saved_window);
+
+    // Same random pattern with zswap in front of the disk
+    zswap_set_enabled(1);
+    swap_bench_pass("zswap", 1);
+    zswap_set_enabled(saved_zswap);
+
+    if (swap_bench_errors) {
+        cprintf("swap bench: %u pages had wrong contents\n", swap_bench_errors);
+    }
+    swap_bench_teardown();
+}
+
+// Zipf(1) trace: rank r is drawn with weight 1/(r+1). Ranks are shuffled
+// over the working set so hot pages are not neighbours on disk.
+static uint32_t zipf_cdf[SWAP_BENCH_PAGES];
+static uint16_t zipf_rank_page[SWAP_BENCH_PAGES];
+
+static void zipf_setup(void) {
+    uint32_t sum = 0;
+    for (int r = 0; r < SWAP_BENCH_PAGES; r++) {
+        sum += ZIPF_BENCH_SCALE / (r + 1);
+        zipf_cdf[r] = sum;
+        zipf_rank_page[r] = r;
+    }
+
+    bench_seed = BENCH_SEED;
+    for (int r = SWAP_BENCH_PAGES - 1; r > 0; r--) {
+        int j = bench_rand() % (r + 1);
+        uint16_t t = zipf_rank_page[r];
+        zipf_rank_page[r] = zipf_rank_page[j];
+        zipf_rank_page[j] = t;
+    }
+}
+
+static int zipf_next(void) {
+    uint32_t x = ((bench_rand() << 16) | bench_rand()) % zipf_cdf[SWAP_BENCH_PAGES - 1];
+
+    // First rank whose cumulative weight exceeds x
+    int lo = 0, hi = SWAP_BENCH_PAGES - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (zipf_cdf[mid] > x) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return zipf_rank_page[lo];
+}
+
+void zipf_bench(void) {
+    static swap_manager *const policies[] = {&swap_mgr_fifo, &swap_mgr_clock, &swap_mgr_arc};
+    swap_manager *saved = swap_mgr;
+    const swap_stats_t *st = swap_get_stats();
+
+    if (swap_bench_check_cr3() != 0) {
+        return;
+    }
+    zipf_setup();
+
+    cprintf("zipf bench: %d-page working set, %d resident, %d accesses\n",
+            SWAP_BENCH_PAGES, SWAP_BENCH_RESIDENT, ZIPF_BENCH_ACCESSES);
+    cprintf("POLICY                FAULTS  RATE    I/OS\n");
+    for (int p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        swap_mgr = policies[p];
+        swap_bench_populate();
+
+        // Warm up with the same distribution, then measure a fresh stretch
+        bench_seed = BENCH_SEED;
+        for (int i = 0; i < ZIPF_BENCH_ACCESSES; i++) {
+            swap_bench_touch(zipf_next());
+        }
+
+        uint32_t ios = st->read_ios + st->write_ios;
+        swap_bench_faults = 0;
+        for (int i = 0; i < ZIPF_BENCH_ACCESSES; i++) {
+            swap_bench_touch(zipf_next());
+        }
+        ios = st->read_ios + st->write_ios - ios;
+
+        // Faults per thousand accesses, printed as a percentage
+        uint32_t permille = swap_bench_faults * 1000 / ZIPF_BENCH_ACCESSES;
+        cprintf("%-20s  %-6u  %2u.%u%c  %u\n", policies[p]->name, swap_bench_faults,
+                permille / 10, permille % 10, '%', ios);
+
+        if (swap_bench_errors) {
+            cprintf("zipf bench: %u pages had wrong contents\n", swap_bench_errors);
+        }
+        swap_bench_teardown();
+    }
+
+    swap_mgr = saved;
+    swap_init_mm(&init_mm);
+}
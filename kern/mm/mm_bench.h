@@ -0,0 +1,24 @@
+#pragma once
+
+// Memory management microbenchmarks (run from the shell)
+
+// Allocation/free cycles per call for each pmm_manager under random-size churn
+void pmm_bench(void);
+
+// Single-page alloc/free throughput with and without the per-CPU page cache
+void pcp_bench(void);
+
+// Anonymous fault latency with and without the pre-zeroed page pool
+void zero_bench(void);
+
+// Bytes/cycle of memset/memcpy per size class, and clear_page variants
+void mem_bench(void);
+
+// Swap-out throughput with reverse-map victim lookup (pages/sec)
+void rmap_bench(void);
+
+// Fault rate and sectors per I/O paging a working set through a resident cap
+void swap_bench(void);
+
+// Fault rate per replacement policy under a skewed (Zipf) access trace
+void zipf_bench(void);
@@ -2,6 +2,7 @@
 #include "../debug/assert.h"
 #include "../arch/x86/e820.h"
 #include "../drivers/intr.h"
+#include "../trap/trap.h"
 
 #include "memory.h"
 #include "stdio.h"
@@ -13,6 +14,16 @@
 #include <arch/x86/mmu.h>
 
 #include "pmm_firstfit.h"
+#include "pmm_buddy.h"
+#include "slab.h"
+#include "rmap.h"
+#include "swap.h"
+#include "kswapd.h"
+
+// Physical memory manager selected at boot (firstfit_pmm_mgr or buddy_pmm_mgr)
+#ifndef PMM_MANAGER
+#define PMM_MANAGER buddy_pmm_mgr
+#endif
 
 // Page number calculation (address to page index)
 #define PAG_NUM(addr) ((addr) >> PG_SHIFT)
@@ -21,8 +32,6 @@
 #define PAGE_REF_INIT           1
 #define SINGLE_PAGE             1
 #define CREATE_PTE_IF_NOT_EXIST 1
-#define INSERT_FAILURE          0
-#define INSERT_SUCCESS          1
 
 uintptr_t boot_cr3;
 
@@ -52,22 +61,304 @@ PageDesc* kva2page(void *kva) {
 }
 
 static void pmm_mgr_init() {
-    pmm_mgr = &firstfit_pmm_mgr;
+    pmm_mgr = &PMM_MANAGER;
     pmm_mgr->init();
 	cprintf("pmm: manager = %s\n", pmm_mgr->name);
 }
 
+// Per-CPU cache of order-0 pages
+//
+// Single-page allocations and frees are served from a small per-CPU list
+// without calling into pmm_mgr. Freed pages go to the front (hot, likely
+// still in cache) and refilled pages to the back (cold). An empty cache is
+// refilled up to `low` pages, and a cache that grows past `high` is drained
+// back down to `low`, both in one batch under the manager's lock.
+static per_cpu_pages pcp_caches[NCPU];
+
+// Pages free in pmm_mgr plus the per-CPU caches, updated with interrupts
+// disabled wherever a page leaves or enters them (refill/shrink only move
+// pages between the two and leave it alone)
+static size_t nr_free;
+
+#define this_cpu_pcp() (&pcp_caches[0])
+
+static void pcp_init(void) {
+    for (int cpu = 0; cpu < NCPU; cpu++) {
+        per_cpu_pages *pcp = &pcp_caches[cpu];
+        list_init(&pcp->list);
+        pcp->count = 0;
+        pcp->high = PCP_HIGH_DEFAULT;
+        pcp->low = PCP_LOW_DEFAULT;
+        pcp->hits = 0;
+        pcp->misses = 0;
+    }
+}
+
+// Move pages from the global manager to the cold end (interrupts disabled)
+static void pcp_refill(per_cpu_pages *pcp) {
+    while (pcp->count < pcp->low) {
+        PageDesc *page = pmm_mgr->alloc(SINGLE_PAGE);
+        if (page == NULL) {
+            break;
+        }
+        list_add_before(&pcp->list, &page->page_link);
+        pcp->count++;
+    }
+}
+
+// Return cold pages to the global manager until only `keep` remain
+static void pcp_shrink(per_cpu_pages *pcp, unsigned int keep) {
+    while (pcp->count > keep) {
+        list_entry_t *le = list_prev(&pcp->list);
+        list_del(le);
+        pcp->count--;
+        pmm_mgr->free(le2page(le, page_link), SINGLE_PAGE);
+    }
+}
+
+static PageDesc *pcp_alloc(void) {
+    PageDesc *page = NULL;
+    per_cpu_pages *pcp = this_cpu_pcp();
+
+    intr_save();
+    if (pcp->count > 0) {
+        pcp->hits++;
+    } else {
+        pcp->misses++;
+        pcp_refill(pcp);
+    }
+
+    if (pcp->count > 0) {
+        list_entry_t *le = list_next(&pcp->list);
+        list_del(le);
+        pcp->count--;
+        nr_free--;
+        page = le2page(le, page_link);
+    }
+    intr_restore();
+
+    return page;
+}
+
+static void pcp_free(PageDesc *page) {
+    per_cpu_pages *pcp = this_cpu_pcp();
+
+    intr_save();
+    list_add(&pcp->list, &page->page_link);
+    pcp->count++;
+    nr_free++;
+    if (pcp->count > pcp->high) {
+        pcp_shrink(pcp, pcp->low);
+    }
+    intr_restore();
+}
+
+void pcp_drain(void) {
+    intr_save();
+    for (int cpu = 0; cpu < NCPU; cpu++) {
+        pcp_shrink(&pcp_caches[cpu], 0);
+    }
+    intr_restore();
+}
+
+int pcp_set_watermarks(unsigned int high, unsigned int low) {
+    if (low == 0 || high <= low) {
+        return -1;
+    }
+
+    intr_save();
+    for (int cpu = 0; cpu < NCPU; cpu++) {
+        pcp_caches[cpu].high = high;
+        pcp_caches[cpu].low = low;
+        pcp_shrink(&pcp_caches[cpu], high);
+    }
+    intr_restore();
+    return 0;
+}
+
+const per_cpu_pages *pcp_get_stats(int cpu) {
+    return &pcp_caches[cpu];
+}
+
+// Pool of pre-zeroed pages
+//
+// Page tables and anonymous fault pages must start out zeroed. Instead of
+// clearing them on the fault path, the idle loop keeps a small pool of pages
+// cleared ahead of time and alloc_zeroed_page() takes from it first.
+static list_entry_t zero_pool;
+static zero_pool_stats_t zero_stats;
+
+static void zero_pool_init(void) {
+    list_init(&zero_pool);
+    zero_stats.count = 0;
+    zero_stats.target = ZERO_POOL_TARGET;
+    zero_stats.hits = 0;
+    zero_stats.misses = 0;
+    zero_stats.refilled = 0;
+}
+
+PageDesc *alloc_zeroed_page(void) {
+    PageDesc *page = NULL;
+
+    intr_save();
+    if (zero_stats.count > 0) {
+        list_entry_t *le = list_next(&zero_pool);
+        list_del(le);
+        zero_stats.count--;
+        zero_stats.hits++;
+        page = le2page(le, page_link);
+    }
+    intr_restore();
+
+    if (page == NULL) {
+        // Pool empty: fall back to clearing on the caller's time
+        if ((page = alloc_page()) == NULL) {
+            return NULL;
+        }
+        clear_page(page2kva(page));
+        zero_stats.misses++;
+    }
+
+    return page;
+}
+
+void zero_pool_refill(void) {
+    for (int i = 0; i < ZERO_POOL_REFILL_BATCH; i++) {
+        if (zero_stats.count >= zero_stats.target ||
+            pmm_nr_free_pages() < ZERO_POOL_MIN_FREE) {
+            break;
+        }
+
+        PageDesc *page = alloc_page();
+        if (page == NULL) {
+            break;
+        }
+
+        // Clear with interrupts enabled; only the list update is protected
+        clear_page(page2kva(page));
+
+        intr_save();
+        list_add_before(&zero_pool, &page->page_link);
+        zero_stats.count++;
+        zero_stats.refilled++;
+        intr_restore();
+    }
+}
+
+void zero_pool_drain(void) {
+    intr_save();
+    while (zero_stats.count > 0) {
+        list_entry_t *le = list_next(&zero_pool);
+        list_del(le);
+        zero_stats.count--;
+        pcp_free(le2page(le, page_link));
+    }
+    intr_restore();
+}
+
+const zero_pool_stats_t *zero_pool_get_stats(void) {
+    return &zero_stats;
+}
+
+
+// Free page watermarks (zero until pmm_init sizes them)
+static pmm_watermarks_t watermarks;
+
+// min scales with memory (1/128 of free pages), low and high follow it
+static void watermarks_init(void) {
+    unsigned int min = pmm_mgr->nr_free_pages() / 128;
+    if (min < WMARK_MIN_FLOOR) {
+        min = WMARK_MIN_FLOOR;
+    }
+    if (min > WMARK_MIN_CEIL) {
+        min = WMARK_MIN_CEIL;
+    }
+    pmm_set_watermarks(min, min * 2, min * 3);
+}
+
+const pmm_watermarks_t *pmm_watermarks(void) {
+    return &watermarks;
+}
+
+int pmm_set_watermarks(unsigned int min, unsigned int low, unsigned int high) {
+    if (min == 0 || low <= min || high <= low) {
+        return -1;
+    }
+    watermarks.min = min;
+    watermarks.low = low;
+    watermarks.high = high;
+    return 0;
+}
+
+size_t pmm_nr_free_pages(void) {
+    return nr_free + zero_stats.count;
+}
+
+// Allocate n pages from pmm_mgr, keeping nr_free in step
+static PageDesc *mgr_alloc(size_t n) {
+    intr_save();
+    PageDesc *page = pmm_mgr->alloc(n);
+    if (page) {
+        nr_free -= n;
+    }
+    intr_restore();
+    return page;
+}
+
+// Wake kswapd below low; reclaim ourselves only below min, and never from
+// an interrupt handler, which must not wait for swap I/O
+static void check_watermarks(size_t n) {
+    size_t free = pmm_nr_free_pages();
+    if (free < watermarks.low + n) {
+        kswapd_wakeup();
+        if (free < watermarks.min + n && !in_irq()) {
+            direct_reclaim(n);
+        }
+    }
+}
+
 PageDesc *alloc_pages(size_t n) {
-	intr_save();
-	PageDesc *page = pmm_mgr->alloc(n);
-	intr_restore();
+	PageDesc *page = NULL;
+
+	// A pcp hit stays off pmm_mgr and the watermarks; the refill or
+	// multi-page allocation that follows a miss checks them
+	if (n == SINGLE_PAGE) {
+		page = pcp_alloc();
+	}
+
+	if (page == NULL) {
+		check_watermarks(n);
+		page = mgr_alloc(n);
+	}
+
+	// Pages parked in the per-CPU caches, the zero pool or unused swap
+	// readahead may be what we need
+	if (page == NULL) {
+		swap_cache_shrink(0);
+		zero_pool_drain();
+		pcp_drain();
+		page = mgr_alloc(n);
+	}
 
+	// Mappings count references from zero; page_remove() frees at zero again
+	if (page) {
+		page->ref = 0;
+	}
 	return page;
 }
 
 void pages_free(PageDesc* base, size_t n) {
+	// A frame must be unmapped (page_remove/rmap_unmap) before it is freed
+	assert(list_next(&base->rmap_list) == &base->rmap_list);
+
+	if (n == SINGLE_PAGE) {
+		pcp_free(base);
+		return;
+	}
+
 	intr_save();
 	pmm_mgr->free(base, n);
+	nr_free += n;
 	intr_restore();
 }
 
@@ -75,14 +366,12 @@ pte_t* get_pte(pde_t* pgdir, uintptr_t la, int create) {
     pde_t* pdep = pgdir + PDX(la);
     if (!(*pdep & PTE_P)) {
         PageDesc* page;
-        if (!create || (page = alloc_pages(1)) == NULL) {
+        if (!create || (page = alloc_zeroed_page()) == NULL) {
             return NULL;
         }
         page->ref = PAGE_REF_INIT;
 
-        pde_t pa = page2pa(page);
-        memset(K_ADDR(pa), 0, PG_SIZE);
-        *pdep = pa | PTE_USER;
+        *pdep = page2pa(page) | PTE_USER;
     }
     return (pte_t*)K_ADDR(PDE_ADDR(*pdep)) + PTX(la);
 }
@@ -106,6 +395,8 @@ static void page_init() {
 	// Initially mark all pages as reserved
 	for (uint32_t i = 0; i < npage; i++) {
 		SET_PAGE_RESERVED(pages + i);
+		list_init(&pages[i].rmap_list);
+		pages[i].swap_mm = NULL;
 	}
 	
 	uintptr_t valid_mem = P_ADDR(pages + npage);
@@ -138,19 +429,53 @@ void tlb_invl(pde_t *pgdir, uintptr_t la) {
 }
 
 PageDesc *pgdir_alloc_page(pde_t *pgdir, uintptr_t la, uint32_t perm) {
-	PageDesc *page = alloc_pages(SINGLE_PAGE);
-	if (page) {
-		page_insert(pgdir, page, la, perm);
+	PageDesc *page = alloc_zeroed_page();
+	if (page && page_insert(pgdir, page, la, perm) == INSERT_FAILURE) {
+		free_page(page);
+		page = NULL;
 	}
 
 	return page;
 }
 
+// Drop the mapping at ptep; the frame is freed with its last mapping
+static void page_remove_pte(pde_t *pgdir, uintptr_t la, pte_t *ptep) {
+	if (*ptep & PTE_P) {
+		PageDesc *page = pa2page(PTE_ADDR(*ptep));
+		// Frames mapped without page_insert (e.g. the kernel map) have no rmap entry
+		if (rmap_remove(page, pgdir, la) == 0 && --page->ref == 0) {
+			// Off the replacement lists before page_link is reused
+			swap_unmap_page(page);
+			// A page under swap writeback is freed once the write is done
+			if (!PAGE_WRITEBACK(page)) {
+				if (PAGE_SWAPCACHE(page)) {
+					swap_cache_del(page);
+				}
+				free_page(page);
+			}
+		}
+		*ptep = 0;
+		tlb_invl(pgdir, la);
+	}
+}
+
 int page_insert(pde_t *pgdir, PageDesc *page, uintptr_t la, uint32_t perm) {
 	pte_t *ptep = get_pte(pgdir, la, CREATE_PTE_IF_NOT_EXIST);
 	if (!ptep) {
 		return INSERT_FAILURE;
 	}
+
+	if ((*ptep & PTE_P) && pa2page(PTE_ADDR(*ptep)) == page) {
+		// Same frame already mapped here: only the permissions change
+		*ptep = page2pa(page) | perm | PTE_P;
+		tlb_invl(pgdir, la);
+		return INSERT_SUCCESS;
+	}
+
+	page_remove_pte(pgdir, la, ptep);
+	if (rmap_add(page, pgdir, la) != 0) {
+		return INSERT_FAILURE;
+	}
 	page->ref++;
 	*ptep = page2pa(page) | perm | PTE_P;
 
@@ -158,21 +483,35 @@ int page_insert(pde_t *pgdir, PageDesc *page, uintptr_t la, uint32_t perm) {
 	return INSERT_SUCCESS;
 }
 
-// Simple kmalloc/kfree using page allocator
-// For now, always allocate full pages (4KB)
-// TODO: Implement proper slab allocator
-void* kmalloc(size_t size) {
-    PageDesc* page = alloc_page();
-    return page ? page2kva(page) : NULL;
+void page_remove(pde_t *pgdir, uintptr_t la) {
+	pte_t *ptep = get_pte(pgdir, la, 0);
+	if (ptep) {
+		page_remove_pte(pgdir, la, ptep);
+	}
 }
 
-void kfree(void* ptr) {
-    if (ptr) {
-        free_page(kva2page(ptr));
-    }
+void pmm_print_info(void) {
+    const per_cpu_pages *pcp = pcp_get_stats(0);
+    uint32_t lookups = pcp->hits + pcp->misses;
+
+    cprintf("manager:     %s\n", pmm_mgr->name);
+    cprintf("total pages: %d\n", npage);
+    cprintf("free pages:  %d (%d KB)\n", pmm_nr_free_pages(), pmm_nr_free_pages() * (PG_SIZE / 1024));
+    cprintf("pcp:         %d cached, high=%d low=%d\n", pcp->count, pcp->high, pcp->low);
+    cprintf("pcp hits:    %u / %u (%u%c), misses %u\n",
+            pcp->hits, lookups, lookups ? pcp->hits * 100 / lookups : 0, '%', pcp->misses);
+    cprintf("zero pool:   %d / %d pages, %u hits, %u sync clears, %u refilled\n",
+            zero_stats.count, zero_stats.target, zero_stats.hits,
+            zero_stats.misses, zero_stats.refilled);
 }
 
 void pmm_init() {
+	pcp_init();
+	zero_pool_init();
 	pmm_mgr_init();
 	page_init();
+	nr_free = pmm_mgr->nr_free_pages();
+	watermarks_init();
+	slab_init();
+	rmap_init();
 }
\ No newline at end of file
@@ -7,6 +7,11 @@
 
 #define PG_RESERVED 0
 #define PG_PROPERTY 1 
+#define PG_SLAB     2
+#define PG_SWAPCACHE 3
+#define PG_ACTIVE   4       // on the frequency side of the replacement policy
+#define PG_REFERENCED 5     // use seen once by the replacement policy
+#define PG_WRITEBACK 6      // unmapped and being written to its swap slot
 
 typedef uintptr_t pte_t;   // Page Table Entry
 typedef uintptr_t pde_t;   // Page Directory Entry
@@ -17,6 +22,11 @@ typedef struct {
     uint32_t flags;
     unsigned int property;     // the num of free block, used in first fit pm manager
     list_entry_t page_link;    // free list link
+    void *slab_cache;          // owning kmem cache, valid when PG_SLAB is set
+    void *freelist;            // first free object of a slab page
+    list_entry_t rmap_list;    // PTEs mapping this frame (page_addr_map_t, see rmap.c)
+    uint32_t swap_offset;      // swap slot holding a copy, valid when PG_SWAPCACHE is set
+    void *swap_mm;             // mm whose replacement lists hold the page, NULL if none
 } PageDesc;
 
 typedef struct {
@@ -31,6 +41,43 @@ typedef struct {
 
 #define le2page(le, member) to_struct((le), PageDesc, member)
 
+// Per-CPU hot/cold cache of single pages in front of the pmm_manager
+#define NCPU                1
+#define PCP_HIGH_DEFAULT    64      // drain to low above this many pages
+#define PCP_LOW_DEFAULT     16      // refill to this many pages when empty
+
+typedef struct {
+    list_entry_t list;         // hot pages at the front, cold pages at the back
+    unsigned int count;        // # of pages in list
+    unsigned int high;         // high watermark
+    unsigned int low;          // low watermark (refill/drain target)
+    uint32_t hits;             // allocations served from the cache
+    uint32_t misses;           // allocations that had to refill first
+} per_cpu_pages;
+
+// Pool of pages cleared ahead of time by the idle loop
+#define ZERO_POOL_TARGET        32      // pages kept zeroed
+#define ZERO_POOL_REFILL_BATCH  4       // pages cleared per idle pass
+#define ZERO_POOL_MIN_FREE      256     // stop refilling below this many free pages
+
+typedef struct {
+    unsigned int count;        // # of zeroed pages in the pool
+    unsigned int target;       // refill goal
+    uint32_t hits;             // alloc_zeroed_page() served from the pool
+    uint32_t misses;           // alloc_zeroed_page() that cleared synchronously
+    uint32_t refilled;         // pages cleared in the background
+} zero_pool_stats_t;
+
+// Free page watermarks checked by alloc_pages (see kswapd.c)
+#define WMARK_MIN_FLOOR     16      // lowest min watermark
+#define WMARK_MIN_CEIL      256     // highest min watermark
+
+typedef struct {
+    unsigned int min;          // below this, allocations reclaim directly
+    unsigned int low;          // below this, kswapd is woken
+    unsigned int high;         // kswapd stops once free pages reach this
+} pmm_watermarks_t;
+
 typedef struct {
     list_entry_t free_list;  // the list header
     unsigned int nr_free;    // # of free pages in this free list
@@ -44,6 +91,34 @@ typedef struct {
 #define CLEAR_PAGE_RESERVED(page) (CLEAR_BIT((page), PG_RESERVED))
 #define PAGE_RESERVED(page) (TEST_BIT((page), PG_RESERVED))
 
+#define SET_PAGE_PROPERTY(page) (SET_BIT((page), PG_PROPERTY))
+#define CLEAR_PAGE_PROPERTY(page) (CLEAR_BIT((page), PG_PROPERTY))
+#define PAGE_PROPERTY(page) (TEST_BIT((page), PG_PROPERTY))
+
+#define SET_PAGE_SLAB(page) (SET_BIT((page), PG_SLAB))
+#define CLEAR_PAGE_SLAB(page) (CLEAR_BIT((page), PG_SLAB))
+#define PAGE_SLAB(page) (TEST_BIT((page), PG_SLAB))
+
+#define SET_PAGE_SWAPCACHE(page) (SET_BIT((page), PG_SWAPCACHE))
+#define CLEAR_PAGE_SWAPCACHE(page) (CLEAR_BIT((page), PG_SWAPCACHE))
+#define PAGE_SWAPCACHE(page) (TEST_BIT((page), PG_SWAPCACHE))
+
+#define SET_PAGE_ACTIVE(page) (SET_BIT((page), PG_ACTIVE))
+#define CLEAR_PAGE_ACTIVE(page) (CLEAR_BIT((page), PG_ACTIVE))
+#define PAGE_ACTIVE(page) (TEST_BIT((page), PG_ACTIVE))
+
+#define SET_PAGE_REFERENCED(page) (SET_BIT((page), PG_REFERENCED))
+#define CLEAR_PAGE_REFERENCED(page) (CLEAR_BIT((page), PG_REFERENCED))
+#define PAGE_REFERENCED(page) (TEST_BIT((page), PG_REFERENCED))
+
+#define SET_PAGE_WRITEBACK(page) (SET_BIT((page), PG_WRITEBACK))
+#define CLEAR_PAGE_WRITEBACK(page) (CLEAR_BIT((page), PG_WRITEBACK))
+#define PAGE_WRITEBACK(page) (TEST_BIT((page), PG_WRITEBACK))
+
+extern PageDesc *pages;
+extern uint32_t npage;
+extern const pmm_manager *pmm_mgr;
+
 #define alloc_page() alloc_pages(1)
 #define free_page(page) pages_free((page), 1)
 
@@ -54,11 +129,33 @@ void pmm_init();
 PageDesc* pgdir_alloc_page(pde_t *pgdir, uintptr_t la, uint32_t perm);
 
 pte_t* get_pte(pde_t *pgdir, uintptr_t la, int create);
+// page_insert() results
+#define INSERT_FAILURE          0
+#define INSERT_SUCCESS          1
+
 int page_insert(pde_t *pgdir, PageDesc *page, uintptr_t la, uint32_t perm);
+void page_remove(pde_t *pgdir, uintptr_t la);
 
 // Page allocation functions
 PageDesc *alloc_pages(size_t n);
 void pages_free(PageDesc* base, size_t n);
+size_t pmm_nr_free_pages(void);
+
+// Per-CPU page cache control and statistics
+void pcp_drain(void);
+int pcp_set_watermarks(unsigned int high, unsigned int low);
+const per_cpu_pages *pcp_get_stats(int cpu);
+
+// Free page watermarks
+const pmm_watermarks_t *pmm_watermarks(void);
+int pmm_set_watermarks(unsigned int min, unsigned int low, unsigned int high);
+
+// Pre-zeroed page pool
+PageDesc *alloc_zeroed_page(void);
+void zero_pool_refill(void);
+void zero_pool_drain(void);
+const zero_pool_stats_t *zero_pool_get_stats(void);
+void pmm_print_info(void);
 
 // Helper functions for page address conversion
 void* page2kva(PageDesc *page);
@@ -66,7 +163,7 @@ uintptr_t page2pa(PageDesc *page);
 PageDesc* pa2page(uintptr_t pa);
 PageDesc* kva2page(void *kva);
 
-// Memory allocation functions
+// Memory allocation functions (slab-backed, see slab.c)
 void* kmalloc(size_t size);
 void kfree(void* ptr);
 
@@ -0,0 +1,241 @@
+#include "pmm_buddy.h"
+#include "../debug/assert.h"
+
+// Buddy System Physical Memory Manager
+//
+// Algorithm: Binary Buddy
+// - Free memory is kept as blocks of 2^order pages, one free list per order
+// - A block of order k starting at page index i has its buddy at i ^ (1 << k)
+// - Allocation takes the smallest non-empty order and splits it down
+// - Freeing merges a block with its buddy while the buddy is free and of the
+//   same order
+//
+// A free block is marked by PG_PROPERTY on its head page, and the head's
+// property field holds the block order.
+//
+// Requests that are not a power of two are rounded up to the next order and
+// the unused tail is given back immediately, so callers may free exactly the
+// n pages they asked for.
+//
+// Time Complexity:
+// - Allocation: O(log n)
+// - Deallocation: O(log n)
+//
+// Space Complexity: O(MAX_ORDER) auxiliary space
+
+#define MAX_ORDER         11    // orders 0..10, largest block = 1024 pages (4 MiB)
+#define PAGE_INIT_VALUE   0
+#define TEST_ALLOC_PAGES  5
+
+// Per-order free areas (nr_free counts blocks of that order)
+static free_area_t free_area[MAX_ORDER];
+
+// Total number of free pages across all orders
+static size_t nr_free;
+
+#define page_idx(page) ((size_t)((page) - pages))
+
+/**
+ * @brief Smallest order whose block holds at least n pages
+ */
+static unsigned int size2order(size_t n) {
+    unsigned int order = 0;
+    while ((1U << order) < n) {
+        order++;
+    }
+    return order;
+}
+
+/**
+ * @brief Initialize the Buddy physical memory manager
+ */
+static void init() {
+    for (int order = 0; order < MAX_ORDER; order++) {
+        list_init(&free_area[order].free_list);
+        free_area[order].nr_free = PAGE_INIT_VALUE;
+    }
+    nr_free = PAGE_INIT_VALUE;
+}
+
+/**
+ * @brief Put a free block on its order's list, merging with free buddies
+ * @param page First page of the block, aligned to 2^order
+ * @param order Block order
+ */
+static void free_block(PageDesc *page, unsigned int order) {
+    size_t idx = page_idx(page);
+
+    while (order < MAX_ORDER - 1) {
+        size_t buddy_idx = idx ^ (1U << order);
+        if (buddy_idx >= npage) {
+            break;
+        }
+
+        PageDesc *buddy = pages + buddy_idx;
+        if (!PAGE_PROPERTY(buddy) || buddy->property != order) {
+            break;
+        }
+
+        // Buddy is a free block of the same order: absorb it
+        list_del(&(buddy->page_link));
+        free_area[order].nr_free--;
+        CLEAR_PAGE_PROPERTY(buddy);
+
+        idx &= ~(1U << order);
+        order++;
+    }
+
+    page = pages + idx;
+    page->property = order;
+    SET_PAGE_PROPERTY(page);
+    list_add(&free_area[order].free_list, &(page->page_link));
+    free_area[order].nr_free++;
+}
+
+/**
+ * @brief Free an arbitrary page range by splitting it into aligned blocks
+ * @param base First page of the range
+ * @param n Number of pages in the range
+ */
+static void free_range(PageDesc *base, size_t n) {
+    nr_free += n;
+
+    while (n > 0) {
+        size_t idx = page_idx(base);
+        unsigned int order = 0;
+
+        // Grow the block while it stays aligned and inside the range
+        while (order < MAX_ORDER - 1 && !(idx & (1U << order)) && (2U << order) <= n) {
+            order++;
+        }
+
+        free_block(base, order);
+        base += 1U << order;
+        n -= 1U << order;
+    }
+}
+
+/**
+ * @brief Initialize memory map for a contiguous block of pages
+ * @param base Pointer to the first page descriptor
+ * @param n Number of pages to initialize
+ */
+static void init_memmap(PageDesc *base, size_t n) {
+    for (PageDesc *p = base; p != base + n; p++) {
+        p->ref = PAGE_INIT_VALUE;
+        p->flags = PAGE_INIT_VALUE;
+        p->property = PAGE_INIT_VALUE;
+    }
+
+    free_range(base, n);
+}
+
+/**
+ * @brief Allocate n contiguous pages from the smallest fitting order
+ * @param n Number of pages to allocate
+ * @return Pointer to the first page descriptor, NULL if allocation failed
+ */
+static PageDesc* alloc(size_t n) {
+    if (n == 0 || n > nr_free) {
+        return NULL;
+    }
+
+    unsigned int order = size2order(n);
+    unsigned int cur = order;
+    while (cur < MAX_ORDER && list_next(&free_area[cur].free_list) == &free_area[cur].free_list) {
+        cur++;
+    }
+    if (cur >= MAX_ORDER) {
+        return NULL;
+    }
+
+    list_entry_t *le = list_next(&free_area[cur].free_list);
+    PageDesc *page = le2page(le, page_link);
+    list_del(le);
+    free_area[cur].nr_free--;
+    CLEAR_PAGE_PROPERTY(page);
+
+    // Split down to the requested order, keeping the lower half each time
+    while (cur > order) {
+        cur--;
+        PageDesc *half = page + (1U << cur);
+        half->property = cur;
+        SET_PAGE_PROPERTY(half);
+        list_add(&free_area[cur].free_list, &(half->page_link));
+        free_area[cur].nr_free++;
+    }
+
+    nr_free -= 1U << order;
+
+    // Give back the unused tail of a rounded-up request
+    if ((1U << order) > n) {
+        free_range(page + n, (1U << order) - n);
+    }
+
+    return page;
+}
+
+/**
+ * @brief Free n contiguous pages and coalesce them with their buddies
+ * @param base Pointer to the first page descriptor to free
+ * @param n Number of pages to free
+ */
+static void free(PageDesc *base, size_t n) {
+    assert(n > 0 && !PAGE_PROPERTY(base));
+
+    base->flags = PAGE_INIT_VALUE;
+    free_range(base, n);
+}
+
+/**
+ * @brief Get the number of free pages
+ * @return Number of free pages available
+ */
+static size_t nr_free_pages() {
+    return nr_free;
+}
+
+/**
+ * @brief Self-check function to verify memory manager integrity
+ */
+static void check() {
+    size_t total_free = PAGE_INIT_VALUE;
+
+    // Every listed block must be a properly aligned free head of its order
+    for (unsigned int order = 0; order < MAX_ORDER; order++) {
+        list_entry_t *le = &free_area[order].free_list;
+        unsigned int blocks = 0;
+        while ((le = list_next(le)) != &free_area[order].free_list) {
+            PageDesc *p = le2page(le, page_link);
+            assert(PAGE_PROPERTY(p));
+            assert(p->property == order);
+            assert((page_idx(p) & ((1U << order) - 1)) == 0);
+            total_free += 1U << order;
+            blocks++;
+        }
+        assert(blocks == free_area[order].nr_free);
+    }
+    assert(total_free == nr_free);
+
+    // Allocation and free must round-trip the free page count
+    PageDesc *p0 = alloc(TEST_ALLOC_PAGES);
+    PageDesc *p1 = alloc(1);
+    assert(p0 != NULL && p1 != NULL);
+    assert(!PAGE_PROPERTY(p0) && !PAGE_PROPERTY(p1));
+    assert(nr_free == total_free - TEST_ALLOC_PAGES - 1);
+
+    free(p1, 1);
+    free(p0, TEST_ALLOC_PAGES);
+    assert(nr_free == total_free);
+}
+
+// Physical Memory Manager using the Buddy System
+const pmm_manager buddy_pmm_mgr = {
+    .name = "buddy",
+    .init = init,
+    .init_memmap = init_memmap,
+    .alloc = alloc,
+    .free = free,
+    .nr_free_pages = nr_free_pages,
+    .check = check
+};
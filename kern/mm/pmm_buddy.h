@@ -0,0 +1,7 @@
+#pragma once
+
+#include "pmm.h"
+
+// Buddy System memory allocation algorithm
+// Keeps one free list per power-of-two block order and splits/coalesces in O(log n)
+extern const pmm_manager buddy_pmm_mgr;
@@ -0,0 +1,146 @@
+#include "rmap.h"
+#include "../debug/assert.h"
+#include "../drivers/intr.h"
+
+#include "stdio.h"
+
+#include <arch/x86/mmu.h>
+
+// Reverse Mapping
+//
+// page_insert() adds a (pgdir, addr) entry to the frame's rmap_list and
+// page_remove() takes it off again, so the list always holds exactly the
+// PTEs that reference the frame. Replacement then costs O(mappings) per
+// victim instead of a walk over the whole page directory.
+//
+// Entries come from a slab cache; a frame mapped once costs one 16-byte
+// object.
+
+kmem_cache_t *page_addr_map_cache = NULL;
+
+void rmap_init(void) {
+    page_addr_map_cache = kmem_cache_create("page_addr_map", sizeof(page_addr_map_t));
+    assert(page_addr_map_cache != NULL);
+}
+
+int rmap_add(PageDesc *page, pde_t *pgdir, uintptr_t addr) {
+    page_addr_map_t *map = kmem_cache_alloc(page_addr_map_cache);
+    if (map == NULL) {
+        return -1;
+    }
+    map->pgdir = pgdir;
+    map->addr = addr;
+
+    intr_save();
+    list_add(&page->rmap_list, &map->link);
+    intr_restore();
+    return 0;
+}
+
+int rmap_remove(PageDesc *page, pde_t *pgdir, uintptr_t addr) {
+    page_addr_map_t *found = NULL;
+
+    intr_save();
+    list_entry_t *le = &page->rmap_list;
+    while ((le = list_next(le)) != &page->rmap_list) {
+        page_addr_map_t *map = le2rmap(le);
+        if (map->pgdir == pgdir && map->addr == addr) {
+            list_del(le);
+            found = map;
+            break;
+        }
+    }
+    intr_restore();
+
+    if (found == NULL) {
+        return -1;
+    }
+    kmem_cache_free(page_addr_map_cache, found);
+    return 0;
+}
+
+uintptr_t rmap_find_vaddr(PageDesc *page, pde_t *pgdir) {
+    uintptr_t addr = 0;
+
+    intr_save();
+    list_entry_t *le = &page->rmap_list;
+    while ((le = list_next(le)) != &page->rmap_list) {
+        page_addr_map_t *map = le2rmap(le);
+        if (map->pgdir == pgdir) {
+            addr = map->addr;
+            break;
+        }
+    }
+    intr_restore();
+    return addr;
+}
+
+int rmap_unmap(PageDesc *page, pte_t pteval) {
+    int unmapped = 0;
+
+    intr_save();
+    while (list_next(&page->rmap_list) != &page->rmap_list) {
+        list_entry_t *le = list_next(&page->rmap_list);
+        page_addr_map_t *map = le2rmap(le);
+
+        pte_t *ptep = get_pte(map->pgdir, map->addr, 0);
+        assert(ptep != NULL && PTE_ADDR(*ptep) == page2pa(page));
+        *ptep = pteval;
+        tlb_invl(map->pgdir, map->addr);
+
+        list_del(le);
+        kmem_cache_free(page_addr_map_cache, map);
+        page->ref--;
+        unmapped++;
+    }
+    intr_restore();
+    return unmapped;
+}
+
+int rmap_dirty(PageDesc *page) {
+    int dirty = 0;
+
+    intr_save();
+    list_entry_t *le = &page->rmap_list;
+    while ((le = list_next(le)) != &page->rmap_list) {
+        page_addr_map_t *map = le2rmap(le);
+        pte_t *ptep = get_pte(map->pgdir, map->addr, 0);
+        if (ptep && (*ptep & PTE_D)) {
+            dirty = 1;
+            break;
+        }
+    }
+    intr_restore();
+    return dirty;
+}
+
+int rmap_referenced(PageDesc *page) {
+    int referenced = 0;
+
+    intr_save();
+    list_entry_t *le = &page->rmap_list;
+    while ((le = list_next(le)) != &page->rmap_list) {
+        page_addr_map_t *map = le2rmap(le);
+        pte_t *ptep = get_pte(map->pgdir, map->addr, 0);
+        if (ptep && (*ptep & PTE_A)) {
+            // Drop the cached translation too, or the next access will not set A again
+            *ptep &= ~PTE_A;
+            tlb_invl(map->pgdir, map->addr);
+            referenced++;
+        }
+    }
+    intr_restore();
+    return referenced;
+}
+
+int page_mapcount(PageDesc *page) {
+    int n = 0;
+
+    intr_save();
+    list_entry_t *le = &page->rmap_list;
+    while ((le = list_next(le)) != &page->rmap_list) {
+        n++;
+    }
+    intr_restore();
+    return n;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "pmm.h"
+#include "slab.h"
+
+// Reverse mapping entry: one per PTE that maps a frame through page_insert().
+// A frame's entries hang off PageDesc.rmap_list, so the swap path can find
+// and rewrite every PTE of a victim without scanning page tables.
+typedef struct {
+    pde_t *pgdir;              // address space holding the mapping
+    uintptr_t addr;            // page-aligned virtual address
+    list_entry_t link;         // link in PageDesc.rmap_list
+} page_addr_map_t;
+
+#define le2rmap(le) to_struct((le), page_addr_map_t, link)
+
+// Object cache for page_addr_map_t entries
+extern kmem_cache_t *page_addr_map_cache;
+
+void rmap_init(void);
+
+// Record / forget that (pgdir, addr) maps page. Both return 0 on success.
+int rmap_add(PageDesc *page, pde_t *pgdir, uintptr_t addr);
+int rmap_remove(PageDesc *page, pde_t *pgdir, uintptr_t addr);
+
+// First virtual address mapping page in pgdir, 0 if none
+uintptr_t rmap_find_vaddr(PageDesc *page, pde_t *pgdir);
+
+// Replace every PTE mapping page with pteval and drop the references.
+// Returns the number of mappings removed.
+int rmap_unmap(PageDesc *page, pte_t pteval);
+
+// 1 if any PTE mapping page has been written through (PTE_D)
+int rmap_dirty(PageDesc *page);
+
+// Test and clear PTE_A on every mapping of page.
+// Returns the number of mappings that had been accessed.
+int rmap_referenced(PageDesc *page);
+
+// Number of PTEs currently mapping page
+int page_mapcount(PageDesc *page);
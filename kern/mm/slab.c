@@ -0,0 +1,238 @@
+#include "slab.h"
+#include "pmm.h"
+#include "../debug/assert.h"
+#include "../drivers/intr.h"
+
+#include "stdio.h"
+#include "math.h"
+
+#include <arch/x86/mmu.h>
+
+// Slab Allocator
+//
+// Small kernel objects are served from per-type object caches instead of
+// whole pages. Each cache owns a set of single-page slabs; a slab's free
+// objects form a singly linked list threaded through the objects themselves.
+//
+// kmalloc() maps a size to the smallest general cache (16 B .. 2 KiB) and
+// falls back to whole pages above that. kfree() finds the owner through
+// kva2page(): slab pages carry PG_SLAB and point at their cache, page-sized
+// allocations keep their page count in property.
+//
+// Time Complexity:
+// - kmem_cache_alloc / kmem_cache_free: O(1)
+// - kmalloc / kfree: O(1) (O(log n) in the page allocator for large sizes)
+
+#define NR_KMALLOC_CACHES (KMALLOC_MAX_SHIFT - KMALLOC_MIN_SHIFT + 1)
+
+// All caches, in creation order
+static list_entry_t cache_list;
+
+// Cache holding the kmem_cache_t descriptors themselves
+static kmem_cache_t cache_cache;
+
+// General-purpose caches backing kmalloc
+static kmem_cache_t *kmalloc_caches[NR_KMALLOC_CACHES];
+
+static const char *const kmalloc_names[NR_KMALLOC_CACHES] = {
+    "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128",
+    "kmalloc-256", "kmalloc-512", "kmalloc-1024", "kmalloc-2048",
+};
+
+/**
+ * @brief Fill in a cache descriptor and add it to the cache list
+ */
+static void cache_init(kmem_cache_t *cache, const char *name, size_t size) {
+    cache->name = name;
+    cache->objsize = ROUND_UP(size < sizeof(void *) ? sizeof(void *) : size, sizeof(void *));
+    cache->objs_per_slab = PG_SIZE / cache->objsize;
+    list_init(&cache->slabs_full);
+    list_init(&cache->slabs_partial);
+    list_init(&cache->slabs_free);
+    cache->nr_slabs = 0;
+    cache->nr_active = 0;
+    list_add_before(&cache_list, &cache->cache_link);
+}
+
+/**
+ * @brief Get a fresh page and carve it into free objects
+ * @return Slab page descriptor, NULL if out of memory
+ */
+static PageDesc *slab_grow(kmem_cache_t *cache) {
+    PageDesc *page = alloc_page();
+    if (page == NULL) {
+        return NULL;
+    }
+
+    char *base = page2kva(page);
+    void **prev = &page->freelist;
+    for (unsigned int i = 0; i < cache->objs_per_slab; i++) {
+        void *obj = base + i * cache->objsize;
+        *prev = obj;
+        prev = (void **)obj;
+    }
+    *prev = NULL;
+
+    SET_PAGE_SLAB(page);
+    page->slab_cache = cache;
+    page->property = 0;
+    cache->nr_slabs++;
+    return page;
+}
+
+/**
+ * @brief Return an empty slab page to the page allocator
+ */
+static void slab_release(kmem_cache_t *cache, PageDesc *page) {
+    CLEAR_PAGE_SLAB(page);
+    page->slab_cache = NULL;
+    page->freelist = NULL;
+    cache->nr_slabs--;
+    free_page(page);
+}
+
+kmem_cache_t *kmem_cache_create(const char *name, size_t size) {
+    if (size == 0 || size > PG_SIZE) {
+        return NULL;
+    }
+
+    kmem_cache_t *cache = kmem_cache_alloc(&cache_cache);
+    if (cache) {
+        intr_save();
+        cache_init(cache, name, size);
+        intr_restore();
+    }
+    return cache;
+}
+
+void *kmem_cache_alloc(kmem_cache_t *cache) {
+    void *obj = NULL;
+
+    intr_save();
+
+    // Prefer partially used slabs, then the cached empty one, then a new page
+    PageDesc *page = NULL;
+    if (list_next(&cache->slabs_partial) != &cache->slabs_partial) {
+        page = le2page(list_next(&cache->slabs_partial), page_link);
+    } else if (list_next(&cache->slabs_free) != &cache->slabs_free) {
+        page = le2page(list_next(&cache->slabs_free), page_link);
+        list_del(&page->page_link);
+        list_add(&cache->slabs_partial, &page->page_link);
+    } else if ((page = slab_grow(cache)) != NULL) {
+        list_add(&cache->slabs_partial, &page->page_link);
+    }
+
+    if (page) {
+        obj = page->freelist;
+        page->freelist = *(void **)obj;
+        page->property++;
+        cache->nr_active++;
+
+        if (page->freelist == NULL) {
+            list_del(&page->page_link);
+            list_add(&cache->slabs_full, &page->page_link);
+        }
+    }
+
+    intr_restore();
+    return obj;
+}
+
+void kmem_cache_free(kmem_cache_t *cache, void *obj) {
+    PageDesc *page = kva2page(obj);
+    assert(PAGE_SLAB(page) && page->slab_cache == cache);
+
+    intr_save();
+
+    int was_full = (page->freelist == NULL);
+    *(void **)obj = page->freelist;
+    page->freelist = obj;
+    page->property--;
+    cache->nr_active--;
+
+    if (page->property == 0) {
+        // Keep a single empty slab around to absorb alloc/free ping-pong
+        list_del(&page->page_link);
+        if (list_next(&cache->slabs_free) == &cache->slabs_free) {
+            list_add(&cache->slabs_free, &page->page_link);
+        } else {
+            slab_release(cache, page);
+        }
+    } else if (was_full) {
+        list_del(&page->page_link);
+        list_add(&cache->slabs_partial, &page->page_link);
+    }
+
+    intr_restore();
+}
+
+/**
+ * @brief Smallest general cache that fits size
+ */
+static kmem_cache_t *kmalloc_cache(size_t size) {
+    int idx = 0;
+    while ((KMALLOC_MIN_SIZE << idx) < size) {
+        idx++;
+    }
+    return kmalloc_caches[idx];
+}
+
+void* kmalloc(size_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+
+    if (size <= KMALLOC_MAX_SIZE) {
+        return kmem_cache_alloc(kmalloc_cache(size));
+    }
+
+    // Large allocation: whole pages, count kept in the head page
+    size_t n = ROUND_UP(size, PG_SIZE) / PG_SIZE;
+    PageDesc *page = alloc_pages(n);
+    if (page == NULL) {
+        return NULL;
+    }
+    page->property = n;
+    return page2kva(page);
+}
+
+void kfree(void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    PageDesc *page = kva2page(ptr);
+    if (PAGE_SLAB(page)) {
+        kmem_cache_free(page->slab_cache, ptr);
+    } else {
+        pages_free(page, page->property);
+    }
+}
+
+void slab_print_info(void) {
+    cprintf("NAME            OBJSIZE  ACTIVE  TOTAL  SLABS  UTIL\n");
+
+    list_entry_t *le = &cache_list;
+    while ((le = list_next(le)) != &cache_list) {
+        kmem_cache_t *cache = to_struct(le, kmem_cache_t, cache_link);
+        unsigned int total = cache->nr_slabs * cache->objs_per_slab;
+        unsigned int util = total ? cache->nr_active * 100 / total : 0;
+
+        cprintf("%-15s %-8d %-7d %-6d %-6d %3d%c\n",
+                cache->name, cache->objsize, cache->nr_active,
+                total, cache->nr_slabs, util, '%');
+    }
+}
+
+void slab_init(void) {
+    list_init(&cache_list);
+    cache_init(&cache_cache, "kmem_cache", sizeof(kmem_cache_t));
+
+    for (int i = 0; i < NR_KMALLOC_CACHES; i++) {
+        kmalloc_caches[i] = kmem_cache_create(kmalloc_names[i], KMALLOC_MIN_SIZE << i);
+        assert(kmalloc_caches[i] != NULL);
+    }
+
+    cprintf("slab: %d kmalloc caches (%d-%d bytes)\n",
+            NR_KMALLOC_CACHES, KMALLOC_MIN_SIZE, KMALLOC_MAX_SIZE);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <base/types.h>
+
+#include "list.h"
+
+// General-purpose kmalloc caches: power-of-two sizes from 16 B to 2 KiB
+#define KMALLOC_MIN_SHIFT   4
+#define KMALLOC_MAX_SHIFT   11
+#define KMALLOC_MIN_SIZE    (1 << KMALLOC_MIN_SHIFT)
+#define KMALLOC_MAX_SIZE    (1 << KMALLOC_MAX_SHIFT)
+
+// Object cache: every slab is one page carved into equal-size objects.
+// Slab bookkeeping lives in the page's PageDesc (slab_cache, freelist and
+// property = objects in use), so objects can fill the whole page.
+typedef struct kmem_cache {
+    const char *name;
+    size_t objsize;                 // object size, rounded up to pointer alignment
+    unsigned int objs_per_slab;     // objects carved from one page
+    list_entry_t slabs_full;        // no free objects
+    list_entry_t slabs_partial;     // some free objects
+    list_entry_t slabs_free;        // all objects free (at most one is kept)
+    unsigned int nr_slabs;          // pages currently owned by this cache
+    unsigned int nr_active;         // objects currently allocated
+    list_entry_t cache_link;        // link in the global cache list
+} kmem_cache_t;
+
+void slab_init(void);
+
+kmem_cache_t *kmem_cache_create(const char *name, size_t size);
+void *kmem_cache_alloc(kmem_cache_t *cache);
+void kmem_cache_free(kmem_cache_t *cache, void *obj);
+
+// Print per-cache utilisation (slabinfo)
+void slab_print_info(void);
@@ -1,11 +1,23 @@
 #include "stdio.h"
+#include "memory.h"
 
 #include "swap_fifo.h"
+#include "swap_clock.h"
+#include "swap_arc.h"
+#include "zswap.h"
 #include "swap.h"
 #include "pmm.h"
 
+#include <arch/x86/io.h>
 #include <arch/x86/mmu.h>
 #include "../drivers/blk.h"
+#include "../drivers/bio.h"
+#include "../drivers/md.h"
+#include "../drivers/intr.h"
+#include "../drivers/pit.h"
+#include "math.h"
+
+extern mm_struct init_mm;
 
 // External function declarations
 extern PageDesc *alloc_pages(size_t n);
@@ -14,33 +26,59 @@ extern void pages_free(PageDesc *base, size_t n);
 // Global swap manager (can be changed to select different algorithms)
 swap_manager* swap_mgr;
 
-// Maximum swap offset (swap entries)
-static unsigned int max_swap_offset;
+// Replacement policy chosen at boot; build with -DSWAP_POLICY_FIFO for plain
+// FIFO or -DSWAP_POLICY_ARC for the adaptive policy
+#if defined(SWAP_POLICY_FIFO)
+#define SWAP_DEFAULT_MGR    swap_mgr_fifo
+#elif defined(SWAP_POLICY_ARC)
+#define SWAP_DEFAULT_MGR    swap_mgr_arc
+#else
+#define SWAP_DEFAULT_MGR    swap_mgr_clock
+#endif
+
+// Swap cache: page holding each slot's data, NULL if not resident
+static PageDesc **swap_cache = NULL;
+static swap_stats_t swap_stats;
 
-// Swap device
-static block_device_t *swap_device = NULL;
+// Unmapped readahead pages in the swap cache, oldest first (via page_link)
+static list_entry_t swap_ra_list;
+static unsigned int swap_ra_count = 0;
+static unsigned int swap_ra_window = SWAP_RA_DEFAULT;
 
 // Swap space configuration
-#define SWAP_START_SECTOR   1000        // Start sector for swap space
+#define SWAP_START_SECTOR   1000        // Start of the boot swap area on the boot disk
 #define SECTORS_PER_PAGE    (PG_SIZE / 512)  // Sectors needed for one page
 
+// Per-page trace messages; build with -DSWAP_DEBUG to enable
+#ifdef SWAP_DEBUG
+#define swap_trace(...) cprintf(__VA_ARGS__)
+#else
+#define swap_trace(...) do { if (0) cprintf(__VA_ARGS__); } while (0)
+#endif
+
 int swap_init() {
-    swap_mgr = &swap_mgr_fifo;  // Use FIFO swap manager for now
+    swap_mgr = &SWAP_DEFAULT_MGR;
     swap_mgr->init();
-    
+
+    // Per-slot tables cover the whole global slot space, so areas added
+    // later by swapon need no resizing
+    swap_cache = kmalloc(SWAP_MAX_SLOTS * sizeof(PageDesc *));
+    if (swap_cache == NULL) {
+        cprintf("swap: cannot allocate swap cache for %d slots\n", SWAP_MAX_SLOTS);
+        return -1;
+    }
+    memset(swap_cache, 0, SWAP_MAX_SLOTS * sizeof(PageDesc *));
+    list_init(&swap_ra_list);
+
     // Initialize swap filesystem (disk-based swap)
-    swapfs_init();
-    
-    // Calculate maximum swap offset based on available disk space
-    // Reserve space for swap (use sectors after SWAP_START_SECTOR)
-    uint32_t available_sectors = swap_device->size - SWAP_START_SECTOR;
-    max_swap_offset = available_sectors / SECTORS_PER_PAGE;
-    
-    cprintf("swap: available space = %d pages (%d MB)\n", 
-            max_swap_offset, (max_swap_offset * PG_SIZE) / (1024 * 1024));
+    if (swapfs_init() != 0) {
+        return -1;
+    }
+    zswap_init(SWAP_MAX_SLOTS);
 
     cprintf("swap: manager = %s\n", swap_mgr->name);
-    
+
+    swap_init_mm(&init_mm);
     return 0;
 }
 
@@ -54,6 +92,211 @@ int swap_init_mm(mm_struct *mm) {
     return 0;
 }
 
+/**
+ * Release the replacement state of an mm that is going away
+ */
+void swap_exit_mm(mm_struct *mm) {
+    if (swap_mgr->exit_mm) {
+        swap_mgr->exit_mm(mm);
+    }
+}
+
+/**
+ * Unlink a page that is no longer mapped from the lists holding it
+ */
+void swap_unmap_page(PageDesc *page) {
+    if (page->swap_mm && swap_mgr && swap_mgr->unmap_page) {
+        swap_mgr->unmap_page(page->swap_mm, page);
+    }
+}
+
+// Swap Cache
+//
+// A page read back from swap keeps its slot: it is entered in swap_cache[]
+// (indexed by slot offset) and flagged PG_SWAPCACHE. If it has not been
+// written since (no PTE_D on any mapping) when it is picked as a victim
+// again, the copy on disk is still current and swap_out() only has to
+// unmap it.
+//
+// A dirty victim is unmapped first and written afterwards. Until the write
+// is done it stays in the cache flagged PG_WRITEBACK, so a fault on its slot
+// maps it straight back, and nothing else frees it: swap_batch_flush() does
+// that if no fault claimed it in the meantime.
+//
+// The cache holds one reference on the slot (swap_map), the PTEs holding
+// the swap entry hold the others.
+static PageDesc *swap_cache_lookup(uint32_t offset) {
+    return swap_cache[offset];
+}
+
+// Enter page under offset; the caller hands one slot reference to the cache
+static void swap_cache_add(PageDesc *page, uint32_t offset) {
+    intr_save();
+    swap_cache[offset] = page;
+    page->swap_offset = offset;
+    SET_PAGE_SWAPCACHE(page);
+    intr_restore();
+}
+
+void swap_cache_del(PageDesc *page) {
+    uint32_t offset = page->swap_offset;
+
+    intr_save();
+    swap_cache[offset] = NULL;
+    page->swap_offset = 0;
+    CLEAR_PAGE_SWAPCACHE(page);
+    intr_restore();
+
+    swap_slot_free(offset);
+}
+
+// Readahead pages sit in the cache with no mapping (ref 0) until a fault
+// maps them or the list is trimmed
+static void swap_ra_add(PageDesc *page) {
+    intr_save();
+    list_add_before(&swap_ra_list, &page->page_link);
+    swap_ra_count++;
+    intr_restore();
+
+    if (swap_ra_count > SWAP_RA_CACHE_MAX) {
+        swap_cache_shrink(SWAP_RA_CACHE_MAX);
+    }
+}
+
+static void swap_ra_del(PageDesc *page) {
+    intr_save();
+    list_del(&page->page_link);
+    swap_ra_count--;
+    intr_restore();
+}
+
+void swap_cache_shrink(unsigned int keep) {
+    if (swap_cache == NULL) {
+        return;
+    }
+
+    while (swap_ra_count > keep) {
+        PageDesc *page = le2page(list_next(&swap_ra_list), page_link);
+        swap_ra_del(page);
+        swap_cache_del(page);
+        free_page(page);
+    }
+}
+
+void swap_entry_free(uintptr_t entry) {
+    uint32_t offset = SWAP_OFFSET(entry);
+    swap_slot_free(offset);
+
+    // Only the cache still holds the slot: an unmapped cached copy is garbage
+    PageDesc *page = swap_cache[offset];
+    if (page && page->ref == 0 && !PAGE_WRITEBACK(page) && swap_slot_count(offset) == 1) {
+        swap_ra_del(page);
+        swap_cache_del(page);
+        free_page(page);
+    }
+}
+
+const swap_stats_t *swap_get_stats(void) {
+    return &swap_stats;
+}
+
+int swap_set_readahead(unsigned int pages) {
+    if (pages == 0 || pages > SWAP_CLUSTER_MAX || (pages & (pages - 1)) != 0) {
+        return -1;
+    }
+    swap_ra_window = pages;
+    return 0;
+}
+
+unsigned int swap_get_readahead(void) {
+    return swap_ra_window;
+}
+
+/**
+ * Read the slot at offset into a new page, together with its allocated
+ * neighbours in the aligned readahead window, in a single request
+ * The neighbours go into the swap cache; the caller gets the target page.
+ */
+static PageDesc *swap_read_cluster(uint32_t offset) {
+    const swap_area_t *si = swap_area_of(offset);
+    uint32_t start = offset, end = offset + 1;
+
+    if (zswap_present(offset)) {
+        // Held compressed in memory: no disk read, and no readahead
+        PageDesc *page = alloc_page();
+        if (page && zswap_load(offset, page) != 0) {
+            free_page(page);
+            page = NULL;
+        }
+        return page;
+    }
+
+    if (si == NULL) {
+        cprintf("swap_in: slot %d is in no swap area\n", offset);
+        return NULL;
+    }
+
+    if (swap_ra_window > 1) {
+        // Aligned window, kept inside the area so it is one device request
+        uint32_t lo = offset - offset % swap_ra_window;
+        uint32_t hi = lo + swap_ra_window;
+        if (lo < si->base) {
+            lo = si->base;
+        }
+        if (hi > si->base + si->max) {
+            hi = si->base + si->max;
+        }
+        // Trim to the slots whose data is on disk and not already resident
+        while (start > lo && swap_slot_count(start - 1) > 0 &&
+               swap_cache[start - 1] == NULL && !zswap_present(start - 1)) {
+            start--;
+        }
+        while (end < hi && swap_slot_count(end) > 0 && swap_cache[end] == NULL &&
+               !zswap_present(end)) {
+            end++;
+        }
+    }
+
+    // A page per slot, read straight into place as one segment list
+    PageDesc *pages[SWAP_CLUSTER_MAX];
+    int npages = end - start, i;
+    for (i = 0; i < npages; i++) {
+        if ((pages[i] = alloc_page()) == NULL) {
+            break;
+        }
+    }
+    if (i < npages) {
+        // Short of memory: just the target slot
+        while (i > 0) {
+            free_page(pages[--i]);
+        }
+        start = offset;
+        npages = 1;
+        if ((pages[0] = alloc_page()) == NULL) {
+            return NULL;
+        }
+    }
+
+    if (swapfs_read_pages(start, pages, npages) != 0) {
+        for (i = 0; i < npages; i++) {
+            free_page(pages[i]);
+        }
+        return NULL;
+    }
+
+    for (i = 0; i < npages; i++) {
+        uint32_t off = start + i;
+        if (off == offset) {
+            continue;
+        }
+        swap_slot_dup(off);             // the cache's own reference
+        swap_cache_add(pages[i], off);
+        swap_ra_add(pages[i]);
+        swap_stats.ra_pages++;
+    }
+    return pages[offset - start];
+}
+
 /**
  * Swap in a page from disk to memory
  * @param mm: memory management struct
@@ -61,37 +304,60 @@ int swap_init_mm(mm_struct *mm) {
  * @param page_ptr: output pointer to the allocated page
  */
 int swap_in(mm_struct *mm, uintptr_t addr, PageDesc **page_ptr) {
-    // Allocate a physical page
-    PageDesc *page = alloc_pages(1);
-    if (page == NULL) {
-        cprintf("swap_in: failed to allocate page\n");
-        return -1;
-    }
-    
     // Get the page table entry
     pte_t *ptep = get_pte(mm->pgdir, addr, 0);
     if (ptep == NULL) {
         cprintf("swap_in: no page table entry\n");
-        pages_free(page, 1);
         return -1;
     }
     
-    // Read page from swap space (disk)
     // The swap entry is stored in the PTE
     uintptr_t swap_entry = *ptep;
+    uint32_t offset = SWAP_OFFSET(swap_entry);
     
-    // Read from disk if swap device is available
-    if (swapfs_read(swap_entry, page) != 0) {
-        cprintf("swap_in: failed to read from swap\n");
-        pages_free(page, 1);
-        return -1;
+    PageDesc *page = swap_cache_lookup(offset);
+    int cached = (page != NULL);
+    if (cached) {
+        swap_stats.cache_hits++;
+        if (page->ref == 0 && !PAGE_WRITEBACK(page)) {
+            // Brought in by readahead; it is about to be mapped
+            swap_ra_del(page);
+            swap_stats.ra_hits++;
+        }
+    } else {
+        swap_stats.cache_misses++;
+        
+        // Read the page (and its readahead window) from swap space
+        page = swap_read_cluster(offset);
+        if (page == NULL) {
+            cprintf("swap_in: failed to read from swap\n");
+            return -1;
+        }
     }
     
-    cprintf("swap_in: loaded addr 0x%x from swap entry 0x%x to page %p\n",
-            addr, swap_entry, page);
+    swap_trace("swap_in: loaded addr 0x%x from swap entry 0x%x to page %p%s\n",
+               addr, swap_entry, page, cached ? " (cached)" : "");
     
     // Update page table to map the virtual address to the new physical page
-    page_insert(mm->pgdir, page, addr, PTE_P | PTE_W | PTE_U);
+    if (page_insert(mm->pgdir, page, addr, PTE_P | PTE_W | PTE_U) == INSERT_FAILURE) {
+        cprintf("swap_in: failed to map addr 0x%x\n", addr);
+        if (!cached) {
+            pages_free(page, 1);
+        }
+        return -1;
+    }
+    
+    if (mm->swap_ents > 0) {
+        mm->swap_ents--;
+    }
+    if (cached) {
+        // This PTE no longer refers to the slot
+        swap_slot_free(offset);
+    } else {
+        // Keep the slot: its reference moves from the PTE to the cache
+        swap_cache_add(page, offset);
+    }
+    swap_stats.swapins++;
     
     // Mark page as swappable
     swap_mgr->map_swappable(mm, addr, page, 1);
@@ -101,29 +367,106 @@ int swap_in(mm_struct *mm, uintptr_t addr, PageDesc **page_ptr) {
 }
 
 /**
- * Helper function to find virtual address for a page
- * Searches the page table to find the virtual address mapped to this page
+ * Find the virtual address that maps a page in mm
+ * Looks the frame up in its reverse map: O(mappings of the page).
  */
 uintptr_t find_vaddr_for_page(mm_struct *mm, PageDesc *page) {
-    uintptr_t pa = page2pa(page);
+    return rmap_find_vaddr(page, mm->pgdir);
+}
+
+// Victims with consecutive slots, written with one request
+typedef struct {
+    PageDesc *page[SWAP_CLUSTER_MAX];
+    uintptr_t addr[SWAP_CLUSTER_MAX];   // where mm mapped each page
+    uint32_t offset;           // slot of page[0]
+    int count;
+} swap_batch_t;
+
+// Unmap a victim and free the frame, unless it is still being written
+static void swap_unmap_victim(mm_struct *mm, PageDesc *victim) {
+    uint32_t offset = victim->swap_offset;
     
-    // Search through page directory
-    for (int pde_idx = 0; pde_idx < 1024; pde_idx++) {
-        pde_t pde = mm->pgdir[pde_idx];
-        if (pde & PTE_P) {
-            // Page table exists, search it
-            pte_t *pt = (pte_t *)K_ADDR(PDE_ADDR(pde));
-            for (int pte_idx = 0; pte_idx < 1024; pte_idx++) {
-                pte_t pte = pt[pte_idx];
-                if ((pte & PTE_P) && PTE_ADDR(pte) == pa) {
-                    // Found it!
-                    return (pde_idx << 22) | (pte_idx << 12);
-                }
-            }
+    // Point every PTE that mapped the page at the swap entry
+    // (present bit clear). Each of those PTEs holds one slot reference.
+    int mappings = rmap_unmap(victim, SWAP_ENTRY(offset));
+    for (int m = 0; m < mappings; m++) {
+        swap_slot_dup(offset);
+    }
+    mm->swap_ents += mappings;
+    if (swap_mgr->swapped_out) {
+        swap_mgr->swapped_out(mm, victim, offset);
+    }
+    if (victim->ref == 0 && !PAGE_WRITEBACK(victim)) {
+        swap_cache_del(victim);
+        pages_free(victim, 1);
+    }
+    swap_stats.swapouts++;
+    
+    swap_trace("swap_out: page %p (%d mappings) -> slot %d\n", victim, mappings, offset);
+}
+
+// The write of page failed: its slot holds no data, so map it back at addr
+// (unless a fault already did) and stop treating the slot as a clean copy
+static void swap_write_failed(mm_struct *mm, PageDesc *page, uintptr_t addr) {
+    uint32_t offset = page->swap_offset;
+    pte_t *ptep = get_pte(mm->pgdir, addr, 0);
+
+    if (ptep && *ptep == SWAP_ENTRY(offset)) {
+        swap_in(mm, addr, &page);
+    }
+    if (page->ref == 0 && swap_slot_count(offset) > 1) {
+        // Other PTEs still name the slot and this is the only copy
+        cprintf("swap_out: page %p kept in the swap cache for slot %d\n", page, offset);
+        return;
+    }
+
+    CLEAR_PAGE_WRITEBACK(page);
+    if (swap_slot_count(offset) == 1) {
+        // Only the cache refers to the slot
+        swap_cache_del(page);
+        if (page->ref == 0) {
+            pages_free(page, 1);
         }
+    } else if (ptep && (*ptep & PTE_P) && pa2page(PTE_ADDR(*ptep)) == page) {
+        // Still reached through the slot: have the next eviction write it
+        *ptep |= PTE_D;
+    }
+}
+
+/**
+ * Write a batch of unmapped pages with one request
+ * The pages stay in the swap cache under PG_WRITEBACK until the write is
+ * done; those no fault mapped back in the meantime are freed.
+ * @return number of pages swapped out
+ */
+static int swap_batch_flush(mm_struct *mm, swap_batch_t *batch) {
+    int n = batch->count;
+    if (n == 0) {
+        return 0;
     }
+    batch->count = 0;
     
-    return 0;  // Not found
+    // The pages go down as they are, one segment each
+    int ret = swapfs_write_pages(batch->offset, batch->page, n);
+    
+    if (ret != 0) {
+        cprintf("swap_out: failed to write to swap\n");
+        for (int i = 0; i < n; i++) {
+            swap_write_failed(mm, batch->page[i], batch->addr[i]);
+        }
+        return 0;
+    }
+    
+    for (int i = 0; i < n; i++) {
+        PageDesc *page = batch->page[i];
+        swap_stats.writes++;
+        CLEAR_PAGE_WRITEBACK(page);
+        if (page->ref == 0) {
+            swap_cache_del(page);
+            pages_free(page, 1);
+        }
+    }
+    return n;
 }
 
 /**
@@ -133,14 +476,15 @@ uintptr_t find_vaddr_for_page(mm_struct *mm, PageDesc *page) {
  * @param in_tick: whether called from timer interrupt
  */
 int swap_out(mm_struct *mm, int n, int in_tick) {
-    int i;
-    static uint32_t swap_offset = 1;  // Global swap offset counter
+    swap_batch_t batch;
+    int i, swapped = 0;
     
+    batch.count = 0;
     for (i = 0; i < n; i++) {
         // Use swap manager to select a victim page
         PageDesc *victim = NULL;
         if (swap_mgr->swap_out_victim(mm, &victim, in_tick) != 0) {
-            cprintf("swap_out: no victim page found\n");
+            swap_trace("swap_out: no victim page found\n");
             break;
         }
         
@@ -149,91 +493,354 @@ int swap_out(mm_struct *mm, int n, int in_tick) {
             break;
         }
         
-        // Find the virtual address that maps to this page
-        uintptr_t victim_addr = find_vaddr_for_page(mm, victim);
-        if (victim_addr == 0) {
-            cprintf("swap_out: cannot find virtual address for page %p\n", victim);
+        if (page_mapcount(victim) == 0) {
+            cprintf("swap_out: page %p is not mapped\n", victim);
             continue;
         }
-        
-        cprintf("swap_out: swapping out page %p at vaddr 0x%x\n", victim, victim_addr);
-        
-        // Get the page table entry
-        pte_t *ptep = get_pte(mm->pgdir, victim_addr, 0);
-        if (ptep == NULL) {
-            cprintf("swap_out: cannot get PTE for vaddr 0x%x\n", victim_addr);
+
+        if (PAGE_WRITEBACK(victim)) {
+            // Faulted back in while its write is still in flight
+            swap_mgr->map_swappable(mm, find_vaddr_for_page(mm, victim), victim, 0);
             continue;
         }
         
-        // Allocate a swap entry
-        uintptr_t swap_entry = (swap_offset << 8);  // Create swap entry (present bit = 0)
-        
-        // Write page to swap space
-        if (swapfs_write(swap_entry, victim) != 0) {
-            cprintf("swap_out: failed to write to swap\n");
+        if (PAGE_SWAPCACHE(victim) && !rmap_dirty(victim)) {
+            // Unchanged since it was read in: the slot still holds its data
+            swap_stats.writes_avoided++;
+            swap_unmap_victim(mm, victim);
+            swapped++;
             continue;
         }
         
-        // Update page table entry to indicate page is swapped out
-        // Clear present bit and store swap entry
-        *ptep = swap_entry;
-        
-        // Invalidate TLB for this address
-        tlb_invl(mm->pgdir, victim_addr);
+        if (PAGE_SWAPCACHE(victim)) {
+            // Written since swap-in: the old slot is stale
+            swap_cache_del(victim);
+        }
         
-        // Free the physical page
-        pages_free(victim, 1);
+        // Allocate a swap slot; its first reference belongs to the cache
+        uint32_t offset = swap_slot_alloc();
+        if (offset == 0) {
+            cprintf("swap_out: swap space full\n");
+            swap_mgr->map_swappable(mm, find_vaddr_for_page(mm, victim), victim, 0);
+            break;
+        }
         
-        // Increment swap offset for next allocation
-        swap_offset++;
-        if (swap_offset >= max_swap_offset) {
-            swap_offset = 1;  // Wrap around (simple allocation)
+        swap_cache_add(victim, offset);
+        if (zswap_store(offset, victim) == 0) {
+            // Compressed copy kept in memory: nothing to write
+            swap_unmap_victim(mm, victim);
+            swapped++;
+            continue;
         }
         
-        cprintf("swap_out: successfully swapped out page to entry 0x%x\n", swap_entry);
+        // A slot that does not extend the pending cluster starts a new one
+        if (batch.count > 0 &&
+            (offset != batch.offset + batch.count || batch.count == SWAP_CLUSTER_MAX)) {
+            swapped += swap_batch_flush(mm, &batch);
+        }
+        if (batch.count == 0) {
+            batch.offset = offset;
+        }
+
+        // Unmap before writing, so stores cannot race the write: a fault
+        // in the meantime finds the page in the swap cache
+        batch.addr[batch.count] = find_vaddr_for_page(mm, victim);
+        SET_PAGE_WRITEBACK(victim);
+        swap_unmap_victim(mm, victim);
+        batch.page[batch.count++] = victim;
     }
     
-    return i;  // Return number of pages swapped out
+    swapped += swap_batch_flush(mm, &batch);
+    return swapped;  // Return number of pages swapped out
+}
+
+// Global Reclaim Scanner
+//
+// Every address space keeps its own replacement lists, so reclaim has to
+// decide which of them gives up pages. Each pass splits the request over
+// mm_list in proportion to
+//     weight = rss / (fault_rate + 1)
+// A large address space loses more pages than a small one, while one that
+// has been faulting a lot (its working set no longer fits) is spared.
+//
+// fault_rate is a decaying average of faults per SWAP_SCAN_PERIOD:
+// rate = (rate + new faults) / 2 once per period, halved again for every
+// further period that passed without a scan.
+
+static int64_t scan_last_tick = 0;
+
+static void swap_scan_age(void) {
+    int periods = 0;
+
+    while (ticks - scan_last_tick >= SWAP_SCAN_PERIOD && periods < 32) {
+        scan_last_tick += SWAP_SCAN_PERIOD;
+        periods++;
+    }
+    if (periods == 0) {
+        return;
+    }
+    if (ticks - scan_last_tick >= SWAP_SCAN_PERIOD) {
+        scan_last_tick = ticks;
+    }
+
+    list_entry_t *le = &mm_list;
+    while ((le = list_next(le)) != &mm_list) {
+        mm_struct *mm = le2mm(le);
+        uint32_t faults = mm->nr_faults - mm->scan_faults;
+
+        mm->scan_faults = mm->nr_faults;
+        mm->fault_rate = ((mm->fault_rate + faults) >> 1) >> (periods - 1);
+    }
+}
+
+// Share of reclaim an mm should take; nonzero whenever it has pages
+static uint32_t swap_scan_weight(mm_struct *mm) {
+    if (mm->rss == 0) {
+        return 0;
+    }
+    uint32_t w = (mm->rss << 4) / (mm->fault_rate + 1);
+    return w ? w : 1;
+}
+
+int swap_reclaim(int n) {
+    int reclaimed = 0;
+
+    swap_scan_age();
+
+    while (reclaimed < n) {
+        uint32_t total = 0;
+        list_entry_t *le = &mm_list;
+        while ((le = list_next(le)) != &mm_list) {
+            total += swap_scan_weight(le2mm(le));
+        }
+        if (total == 0) {
+            break;
+        }
+
+        // Round shares up so every candidate gives at least one page
+        uint32_t want = n - reclaimed;
+        int progress = 0;
+        le = &mm_list;
+        while ((le = list_next(le)) != &mm_list && reclaimed < n) {
+            mm_struct *mm = le2mm(le);
+            uint32_t w = swap_scan_weight(mm);
+            if (w == 0) {
+                continue;
+            }
+
+            int quota = (want * w + total - 1) / total;
+            if (quota > n - reclaimed) {
+                quota = n - reclaimed;
+            }
+            int got = swap_out(mm, quota, 0);
+            mm->reclaimed += got;
+            reclaimed += got;
+            progress += got;
+        }
+        if (progress == 0) {
+            break;
+        }
+    }
+    return reclaimed;
+}
+
+void swap_print_mm(void) {
+    cprintf("MM        RSS    SWAP   FAULTS    RATE   RECLAIMED\n");
+
+    list_entry_t *le = &mm_list;
+    while ((le = list_next(le)) != &mm_list) {
+        mm_struct *mm = le2mm(le);
+        cprintf("%08x  %-5u  %-5u  %-8u  %-5u  %u\n",
+                mm, mm->rss, mm->swap_ents, mm->nr_faults, mm->fault_rate, mm->reclaimed);
+    }
+}
+
+void swap_print_info(void) {
+    uint32_t lookups = swap_stats.cache_hits + swap_stats.cache_misses;
+    uint32_t outs = swap_stats.writes + swap_stats.writes_avoided;
+
+    swap_slot_print_info();
+    cprintf("swap in/out: %u / %u pages\n", swap_stats.swapins, swap_stats.swapouts);
+    cprintf("swap cache:  %u hits / %u lookups (%u%c)\n", swap_stats.cache_hits, lookups,
+            lookups ? swap_stats.cache_hits * 100 / lookups : 0, '%');
+    cprintf("writeback:   %u written, %u clean pages skipped (%u%c avoided)\n",
+            swap_stats.writes, swap_stats.writes_avoided,
+            outs ? swap_stats.writes_avoided * 100 / outs : 0, '%');
+    cprintf("reads:       %u I/Os, %u sectors (%u per I/O)\n", swap_stats.read_ios,
+            swap_stats.read_sectors,
+            swap_stats.read_ios ? swap_stats.read_sectors / swap_stats.read_ios : 0);
+    cprintf("writes:      %u I/Os, %u sectors (%u per I/O)\n", swap_stats.write_ios,
+            swap_stats.write_sectors,
+            swap_stats.write_ios ? swap_stats.write_sectors / swap_stats.write_ios : 0);
+    cprintf("readahead:   window %u, %u pages read, %u used, %u cached\n",
+            swap_ra_window, swap_stats.ra_pages, swap_stats.ra_hits, swap_ra_count);
+    zswap_print_info();
 }
 
 /**
- * Initialize swap filesystem
+ * Initialize swap filesystem: the boot area behind the kernel image
  */
 int swapfs_init(void) {
     // Get disk device
-    swap_device = blk_get_device(BLK_TYPE_DISK);
-    
-    cprintf("swapfs init: using device '%s' for swap\n", swap_device->name);
-    cprintf("swapfs init: swap starts at sector %d\n", SWAP_START_SECTOR);
-    
+    block_device_t *dev = blk_get_device(BLK_TYPE_DISK);
+    if (dev == NULL || dev->size <= SWAP_START_SECTOR) {
+        cprintf("swapfs init: no disk for swap\n");
+        return -1;
+    }
+
+    uint32_t nr_slots = (dev->size - SWAP_START_SECTOR) / SECTORS_PER_PAGE;
+    if (swap_area_add(dev, SWAP_START_SECTOR, nr_slots, 0) < 0) {
+        return -1;
+    }
+
+    cprintf("swapfs init: using device '%s' for swap\n", dev->name);
+    cprintf("swapfs init: swap starts at sector %d, %d pages (%d KB)\n",
+            SWAP_START_SECTOR, nr_slots, nr_slots * (PG_SIZE / 1024));
+    return 0;
+}
+
+int swapon(const char *name, int prio) {
+    block_device_t *dev = blk_get_device_by_name(name);
+    if (dev == NULL) {
+        cprintf("swapon: no such device '%s'\n", name);
+        return -1;
+    }
+    for (int i = 0; i < swap_area_count(); i++) {
+        if (swap_area_get(i)->dev == dev) {
+            cprintf("swapon: %s is already in use for swap\n", name);
+            return -1;
+        }
+    }
+    if (md_is_member(dev)) {
+        cprintf("swapon: %s is part of an md array\n", name);
+        return -1;
+    }
+
+    // Another disk is given over to swap whole
+    uint32_t nr_slots = dev->size / SECTORS_PER_PAGE;
+    int idx = swap_area_add(dev, 0, nr_slots, prio);
+    if (idx < 0) {
+        return -1;
+    }
+
+    swap_area_t *si = swap_area_get(idx);
+    cprintf("swapon: %s, %d pages (%d KB), priority %d\n",
+            name, si->max - 1, (si->max - 1) * (PG_SIZE / 1024), prio);
     return 0;
 }
 
+void swap_print_areas(void) {
+    cprintf("DEVICE PRIO  SIZE(KB)  USED(KB)  READ(KB)  WRITE(KB)  IOS     KB/S\n");
+    for (int i = 0; i < swap_area_count(); i++) {
+        swap_area_t *si = swap_area_get(i);
+        uint32_t sectors = si->read_sectors + si->write_sectors;
+        uint32_t us = tsc_cycles_to_us(si->io_cycles);
+        uint32_t rate = 0;
+        if (us > 0) {
+            // sectors / 2 is KB
+            uint64_t r = ((uint64_t)sectors * 1000000) >> 1;
+            do_div(r, us);
+            rate = (uint32_t)r;
+        }
+        cprintf("%-6s %-4d  %-8d  %-8d  %-8d  %-9d  %-6u  %u\n",
+                si->dev->name, si->prio, (si->max - 1) * (PG_SIZE / 1024),
+                si->inuse * (PG_SIZE / 1024), si->read_sectors / 2, si->write_sectors / 2,
+                si->read_ios + si->write_ios, rate);
+    }
+}
+
+/**
+ * Move consecutive slots between their areas and a list of pages
+ * The pages need not be contiguous: each request is a segment list of up
+ * to SWAP_CLUSTER_MAX pages. A range that crosses from one area into the
+ * next becomes one request per area.
+ */
+static int swapfs_rw_pages(uint32_t offset, PageDesc **pages, int npages, int write) {
+    while (npages > 0) {
+        swap_area_t *si = swap_area_of(offset);
+        if (si == NULL) {
+            cprintf("swapfs: slot %d is in no swap area\n", offset);
+            return -1;
+        }
+
+        int n = si->base + si->max - offset;
+        if (n > npages) {
+            n = npages;
+        }
+        if (n > SWAP_CLUSTER_MAX) {
+            n = SWAP_CLUSTER_MAX;
+        }
+
+        // +--------------------------------+--------+---+
+        // |    Swap Offset (24 bits)       | Reserved| P |
+        // +--------------------------------+--------+---+
+        // Bits 31-8                        Bits 7-1  Bit 0
+        uint32_t sector = si->start_sector + (offset - si->base) * SECTORS_PER_PAGE;
+        uint32_t nsecs = n * SECTORS_PER_PAGE;
+        blk_seg_t segs[SWAP_CLUSTER_MAX];
+        for (int i = 0; i < n; i++) {
+            segs[i].page = pages[i];
+            segs[i].offset = 0;
+            segs[i].len = PG_SIZE;
+        }
+
+        uint64_t t0 = rdtsc();
+        int ret = blk_submit_sync_vec(si->dev, write, sector, segs, n);
+        si->io_cycles += rdtsc() - t0;
+        if (ret != 0) {
+            cprintf("swapfs_%s: %s failed (sector=%d)\n",
+                    write ? "write" : "read", si->dev->name, sector);
+            return -1;
+        }
+
+        if (write) {
+            si->write_ios++;
+            si->write_sectors += nsecs;
+            swap_stats.write_ios++;
+            swap_stats.write_sectors += nsecs;
+        } else {
+            si->read_ios++;
+            si->read_sectors += nsecs;
+            swap_stats.read_ios++;
+            swap_stats.read_sectors += nsecs;
+        }
+        swap_trace("swapfs: %s %d pages at slot %d (%s sector %d)\n",
+                   write ? "wrote" : "read", n, offset, si->dev->name, sector);
+
+        offset += n;
+        pages += n;
+        npages -= n;
+    }
+    return 0;
+}
+
+/**
+ * Read consecutive slots from swap space
+ * @param offset: first slot
+ * @param pages: destination pages, one per slot
+ * @param npages: number of slots
+ */
+int swapfs_read_pages(uint32_t offset, PageDesc **pages, int npages) {
+    return swapfs_rw_pages(offset, pages, npages, 0);
+}
+
+/**
+ * Write consecutive slots to swap space
+ * @param offset: first slot
+ * @param pages: source pages, one per slot
+ * @param npages: number of slots
+ */
+int swapfs_write_pages(uint32_t offset, PageDesc **pages, int npages) {
+    return swapfs_rw_pages(offset, pages, npages, 1);
+}
+
 /**
  * Read a page from swap space
  * @param entry: swap entry (page offset in swap space)
  * @param page: page descriptor to read into
  */
 int swapfs_read(uintptr_t entry, PageDesc *page) {
-    // Calculate disk sector number
-    // +--------------------------------+--------+---+
-    // |    Swap Offset (24 bits)       | Reserved| P |
-    // +--------------------------------+--------+---+
-    // Bits 31-8                        Bits 7-1  Bit 0
-    uint32_t offset = (entry >> 8) & 0xFFFFFF;  // Extract offset from swap entry
-    uint32_t sector = SWAP_START_SECTOR + (offset * SECTORS_PER_PAGE);
-    
-    // Get kernel virtual address for the page
-    void *kva = page2kva(page);
-    
-    // Read from disk
-    if (blk_read(swap_device, sector, kva, SECTORS_PER_PAGE) != 0) {
-        cprintf("swapfs_read: disk read failed (sector=%d)\n", sector);
-        return -1;
-    }
-    
-    cprintf("swapfs_read: read page from swap entry 0x%x (sector %d)\n", entry, sector);
-    return 0;
+    return swapfs_read_pages(SWAP_OFFSET(entry), &page, 1);
 }
 
 /**
@@ -242,19 +849,5 @@ int swapfs_read(uintptr_t entry, PageDesc *page) {
  * @param page: page descriptor to write from
  */
 int swapfs_write(uintptr_t entry, PageDesc *page) {
-    // Calculate disk sector number
-    uint32_t offset = (entry >> 8) & 0xFFFFFF;  // Extract offset from swap entry
-    uint32_t sector = SWAP_START_SECTOR + (offset * SECTORS_PER_PAGE);
-    
-    // Get kernel virtual address for the page
-    void *kva = page2kva(page);
-    
-    // Write to disk
-    if (blk_write(swap_device, sector, kva, SECTORS_PER_PAGE) != 0) {
-        cprintf("swapfs_write: disk write failed (sector=%d)\n", sector);
-        return -1;
-    }
-    
-    cprintf("swapfs_write: wrote page to swap entry 0x%x (sector %d)\n", entry, sector);
-    return 0;
-}
\ No newline at end of file
+    return swapfs_write_pages(SWAP_OFFSET(entry), &page, 1);
+}
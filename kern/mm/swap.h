@@ -2,36 +2,100 @@
 
 #include "pmm.h"
 #include "vmm.h"
+#include "rmap.h"
+#include "swap_slot.h"
 
 // Swap manager interface
 typedef struct {
     const char *name;
     int (*init)(void);                     // Initialize swap manager
     int (*init_mm)(mm_struct *mm);         // Initialize mm struct for swap
+    void (*exit_mm)(mm_struct *mm);        // Optional: release per-mm state
     int (*map_swappable)(mm_struct *mm, uintptr_t addr, PageDesc *page, int swap_in);
     int (*swap_out_victim)(mm_struct *mm, PageDesc **page_ptr, int in_tick);
+    // Optional: victim page now lives only in swap slot offset
+    void (*swapped_out)(mm_struct *mm, PageDesc *page, uint32_t offset);
+    // Take a page whose last mapping went away off mm's lists
+    void (*unmap_page)(mm_struct *mm, PageDesc *page);
     int (*check_swap)(void);               // Check if swap works correctly
 } swap_manager;
 
-// Page-to-address mapping entry (for reverse lookup)
+// Swap entry stored in a non-present PTE: slot offset in bits 31-8, P clear
+#define SWAP_ENTRY(offset)  ((uintptr_t)(offset) << 8)
+#define SWAP_OFFSET(entry)  (((entry) >> 8) & 0xFFFFFF)
+
+// Swap I/O clustering
+#define SWAP_CLUSTER_MAX    8       // pages per swap read/write (segments per request)
+#define SWAP_RA_DEFAULT     4       // default readahead window in pages (1 = off)
+#define SWAP_RA_CACHE_MAX   64      // unmapped readahead pages kept in the swap cache
+
+// Global reclaim scanner: fault rates are aged once per period
+#define SWAP_SCAN_PERIOD    100     // timer ticks (1 s)
+
+// Swap activity counters
 typedef struct {
-    PageDesc *page;
-    uintptr_t addr;
-    list_entry_t link;
-} page_addr_map_t;
+    uint32_t swapins;          // pages brought back by swap_in
+    uint32_t swapouts;         // pages evicted by swap_out
+    uint32_t cache_hits;       // swap_in served from the swap cache
+    uint32_t cache_misses;     // swap_in that had to read the slot
+    uint32_t writes;           // pages written to swap
+    uint32_t writes_avoided;   // clean swap-cache pages evicted without a write
+    uint32_t read_ios;         // read requests
+    uint32_t read_sectors;
+    uint32_t write_ios;        // write requests
+    uint32_t write_sectors;
+    uint32_t ra_pages;         // pages brought in by readahead
+    uint32_t ra_hits;          // faults served by a readahead page
+} swap_stats_t;
+
+// Active replacement policy
+extern swap_manager *swap_mgr;
 
 // Global functions
 int swap_init();
 int swap_init_mm(mm_struct *mm);
+void swap_exit_mm(mm_struct *mm);
+// Called by page_remove() when page loses its last mapping
+void swap_unmap_page(PageDesc *page);
 int swap_in(mm_struct *mm, uintptr_t addr, PageDesc **page_ptr);
 int swap_out(mm_struct *mm, int n, int in_tick);
 
+// Evict up to n pages across all address spaces, taking more from those
+// with a large RSS and a low recent fault rate
+int swap_reclaim(int n);
+// Per-mm RSS, swap usage, fault rate and pages reclaimed by the scanner
+void swap_print_mm(void);
+
+// Drop a page from the swap cache and release the cache's slot reference
+void swap_cache_del(PageDesc *page);
+// Free unmapped readahead pages until at most keep remain
+void swap_cache_shrink(unsigned int keep);
+// Release the slot reference held by a swap entry in a PTE being discarded
+void swap_entry_free(uintptr_t entry);
+const swap_stats_t *swap_get_stats(void);
+
+// Readahead window in pages (power of two, 1..SWAP_CLUSTER_MAX)
+int swap_set_readahead(unsigned int pages);
+unsigned int swap_get_readahead(void);
+
+// Print swap area usage (swapinfo)
+void swap_print_info(void);
+
+// Add a whole block device as a swap area (swapon)
+int swapon(const char *name, int prio);
+// Per-area size, usage and throughput (swapon with no arguments)
+void swap_print_areas(void);
+
 // Swap disk operations (to be implemented with disk driver)
 int swapfs_init(void);
 int swapfs_read(uintptr_t entry, PageDesc *page);
 int swapfs_write(uintptr_t entry, PageDesc *page);
+// Move npages consecutive slots starting at offset with one block request
+// (per SWAP_CLUSTER_MAX pages); the pages need not be contiguous
+int swapfs_read_pages(uint32_t offset, PageDesc **pages, int npages);
+int swapfs_write_pages(uint32_t offset, PageDesc **pages, int npages);
 
-// Helper function to find virtual address for a page
+// Virtual address mapping page in mm (reverse-map lookup), 0 if unmapped
 uintptr_t find_vaddr_for_page(mm_struct *mm, PageDesc *page);
 
 #define MAX_SWAP_OFFSET_LIMIT (1 << 24)  // 16 GB swap space limit
\ No newline at end of file
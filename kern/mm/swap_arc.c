@@ -0,0 +1,348 @@
+#include "stdio.h"
+#include "vmm.h"
+#include "slab.h"
+#include "memory.h"
+
+#include "swap_arc.h"
+
+// CAR Page Replacement Algorithm (Clock with Adaptive Replacement)
+//
+// Resident pages are split between two clocks: T1 holds pages used once
+// since they were brought in (recency), T2 pages used again (frequency).
+// Evicted pages leave a ghost entry behind, keyed by the swap slot that
+// now holds them: B1 for pages evicted from T1, B2 for pages from T2.
+//
+// A fault on a slot with a ghost means that list was too short. A B1 hit
+// moves the target size p of T1 up, a B2 hit moves it down, and either way
+// the page comes back into T2. Victims are taken from T1 while it is above
+// its target, otherwise from T2; a page with its accessed bit set (tested
+// and cleared through the reverse map) is passed over.
+//
+// The fault that maps a page also sets its accessed bit, so T1 discounts
+// the first bit it sees (PG_REFERENCED) and only promotes a page to T2
+// once it has been used again. A one-pass scan therefore never reaches T2
+// and cannot push the hot set out.
+//
+// The ghost directory is bounded by the number of resident pages c:
+// |T1| + |B1| <= c and |B1| + |B2| <= c.
+//
+// Every mm_struct has its own lists and target (mm->swap_lists.arc). The
+// slot-indexed ghost table is shared, so each ghost records its owner.
+
+// Non-resident page remembered by its swap slot
+typedef struct {
+    uint32_t offset;
+    int in_b2;
+    arc_lists_t *owner;             // lists holding this ghost
+    list_entry_t link;              // link in owner's b1 or b2
+} arc_ghost_t;
+
+#define le2ghost(le) to_struct((le), arc_ghost_t, link)
+
+extern list_entry_t mm_list;
+
+static kmem_cache_t *arc_ghost_cache = NULL;
+static arc_ghost_t **arc_ghost_index = NULL;   // ghost per swap slot
+static unsigned int arc_ghost_max = 0;
+
+static arc_lists_t *mm2arc(mm_struct *mm) {
+    return &mm->swap_lists.arc;
+}
+
+static unsigned int arc_resident(arc_lists_t *al) {
+    unsigned int c = al->nr_t1 + al->nr_t2;
+    return c ? c : 1;
+}
+
+static void arc_ghost_drop(arc_ghost_t *g) {
+    arc_lists_t *al = g->owner;
+
+    list_del(&g->link);
+    if (g->in_b2) {
+        al->nr_b2--;
+    } else {
+        al->nr_b1--;
+    }
+    arc_ghost_index[g->offset] = NULL;
+    kmem_cache_free(arc_ghost_cache, g);
+}
+
+// Forget the oldest ghosts until the directory fits the resident size
+static void arc_ghost_trim(arc_lists_t *al) {
+    unsigned int c = arc_resident(al);
+
+    while (al->nr_b1 + al->nr_b2 > c) {
+        list_entry_t *head;
+        if (al->nr_b1 > 0 && (al->nr_t1 + al->nr_b1 > c || al->nr_b2 == 0)) {
+            head = &al->b1;
+        } else {
+            head = &al->b2;
+        }
+        arc_ghost_drop(le2ghost(list_next(head)));
+    }
+}
+
+int swap_arc_init() {
+    return 0;
+}
+
+int swap_arc_init_mm(mm_struct *mm) {
+    if (arc_ghost_cache == NULL) {
+        arc_ghost_cache = kmem_cache_create("arc_ghost", sizeof(arc_ghost_t));
+        arc_ghost_max = SWAP_MAX_SLOTS;
+        arc_ghost_index = kmalloc(arc_ghost_max * sizeof(arc_ghost_t *));
+        if (arc_ghost_cache == NULL || arc_ghost_index == NULL) {
+            cprintf("swap_arc: cannot allocate ghost index for %d slots\n", arc_ghost_max);
+            return -1;
+        }
+        memset(arc_ghost_index, 0, arc_ghost_max * sizeof(arc_ghost_t *));
+    }
+
+    arc_lists_t *al = mm2arc(mm);
+    swap_arc_exit_mm(mm);
+
+    memset(al, 0, sizeof(arc_lists_t));
+    list_init(&al->t1);
+    list_init(&al->t2);
+    list_init(&al->b1);
+    list_init(&al->b2);
+    al->ready = 1;
+    mm->rss = 0;
+
+    return 0;
+}
+
+/**
+ * Take a page that lost its last mapping off T1 or T2
+ */
+void swap_arc_unmap_page(mm_struct *mm, PageDesc *page) {
+    arc_lists_t *al = mm2arc(mm);
+
+    list_del(&page->page_link);
+    if (PAGE_ACTIVE(page)) {
+        al->nr_t2--;
+    } else {
+        al->nr_t1--;
+    }
+    CLEAR_PAGE_ACTIVE(page);
+    CLEAR_PAGE_REFERENCED(page);
+    page->swap_mm = NULL;
+    mm->rss--;
+}
+
+/**
+ * Unlink the resident pages and forget the ghosts of an address space
+ * that is going away
+ */
+void swap_arc_exit_mm(mm_struct *mm) {
+    arc_lists_t *al = mm2arc(mm);
+
+    if (!al->ready) {
+        return;
+    }
+    while (al->nr_t1 > 0) {
+        swap_arc_unmap_page(mm, le2page(list_next(&al->t1), page_link));
+    }
+    while (al->nr_t2 > 0) {
+        swap_arc_unmap_page(mm, le2page(list_next(&al->t2), page_link));
+    }
+    while (al->nr_b1 > 0) {
+        arc_ghost_drop(le2ghost(list_next(&al->b1)));
+    }
+    while (al->nr_b2 > 0) {
+        arc_ghost_drop(le2ghost(list_next(&al->b2)));
+    }
+    al->ready = 0;
+}
+
+/**
+ * Mark a page as swappable: into T2 on a ghost hit, T1 otherwise
+ * @param mm: memory management struct
+ * @param addr: virtual address
+ * @param page: page descriptor
+ * @param swap_in: 1 if swapping in, 0 if newly mapped
+ */
+int swap_arc_map_swappable(mm_struct *mm, uintptr_t addr, PageDesc *page, int swap_in) {
+    arc_lists_t *al = mm2arc(mm);
+    arc_ghost_t *g = NULL;
+
+    CLEAR_PAGE_REFERENCED(page);
+    if (swap_in && PAGE_SWAPCACHE(page) && page->swap_offset < arc_ghost_max) {
+        g = arc_ghost_index[page->swap_offset];
+    }
+    page->swap_mm = mm;
+    mm->rss++;
+
+    // A ghost left by another address space says nothing about this one
+    if (g == NULL || g->owner != al) {
+        CLEAR_PAGE_ACTIVE(page);
+        list_add_before(&al->t1, &page->page_link);
+        al->nr_t1++;
+        return 0;
+    }
+
+    unsigned int c = arc_resident(al);
+    if (g->in_b2) {
+        // T2 was too short: shrink T1's target
+        unsigned int delta = (al->nr_b1 > al->nr_b2) ? al->nr_b1 / al->nr_b2 : 1;
+        al->p = (al->p > delta) ? al->p - delta : 0;
+        al->b2_hits++;
+    } else {
+        // T1 was too short: grow its target
+        unsigned int delta = (al->nr_b2 > al->nr_b1) ? al->nr_b2 / al->nr_b1 : 1;
+        al->p = (al->p + delta < c) ? al->p + delta : c;
+        al->b1_hits++;
+    }
+    arc_ghost_drop(g);
+
+    SET_PAGE_ACTIVE(page);
+    list_add_before(&al->t2, &page->page_link);
+    al->nr_t2++;
+
+    return 0;
+}
+
+/**
+ * Select a victim page: sweep T1 while it is above target, T2 otherwise
+ * @param mm: memory management struct
+ * @param page_ptr: output pointer to victim page
+ * @param in_tick: not used
+ */
+int swap_arc_swap_out_victim(mm_struct *mm, PageDesc **page_ptr, int in_tick) {
+    arc_lists_t *al = mm2arc(mm);
+
+    // A T1 page can be passed over twice before it moves on, so three
+    // sweeps clear every bit; past that the oldest page is taken
+    unsigned int budget = 3 * (al->nr_t1 + al->nr_t2);
+
+    while (budget-- > 0) {
+        if (al->nr_t1 > 0 && (al->nr_t1 >= al->p || al->nr_t2 == 0)) {
+            list_entry_t *le = list_next(&al->t1);
+            PageDesc *page = le2page(le, page_link);
+            list_del(le);
+
+            if (!rmap_referenced(page)) {
+                al->nr_t1--;
+                mm->rss--;
+                page->swap_mm = NULL;
+                *page_ptr = page;
+                return 0;
+            }
+            if (PAGE_REFERENCED(page)) {
+                // Used again since it came in: promote
+                CLEAR_PAGE_REFERENCED(page);
+                SET_PAGE_ACTIVE(page);
+                list_add_before(&al->t2, le);
+                al->nr_t1--;
+                al->nr_t2++;
+            } else {
+                SET_PAGE_REFERENCED(page);
+                list_add_before(&al->t1, le);
+            }
+            continue;
+        }
+
+        list_entry_t *le = list_next(&al->t2);
+        PageDesc *page = le2page(le, page_link);
+        list_del(le);
+
+        if (!rmap_referenced(page)) {
+            al->nr_t2--;
+            mm->rss--;
+            page->swap_mm = NULL;
+            *page_ptr = page;
+            return 0;
+        }
+        list_add_before(&al->t2, le);
+    }
+
+    list_entry_t *head = (al->nr_t1 > 0) ? &al->t1 : &al->t2;
+    list_entry_t *victim = list_next(head);
+    if (victim == head) {
+        *page_ptr = NULL;
+        return -1;  // No page available
+    }
+
+    list_del(victim);
+    if (head == &al->t1) {
+        al->nr_t1--;
+    } else {
+        al->nr_t2--;
+    }
+    mm->rss--;
+
+    *page_ptr = le2page(victim, page_link);
+    (*page_ptr)->swap_mm = NULL;
+    return 0;
+}
+
+/**
+ * Remember an evicted page under its swap slot
+ */
+void swap_arc_swapped_out(mm_struct *mm, PageDesc *page, uint32_t offset) {
+    arc_lists_t *al = mm2arc(mm);
+    int in_b2 = PAGE_ACTIVE(page) ? 1 : 0;
+
+    CLEAR_PAGE_ACTIVE(page);
+    CLEAR_PAGE_REFERENCED(page);
+    if (offset >= arc_ghost_max) {
+        return;
+    }
+
+    arc_ghost_t *g = arc_ghost_index[offset];
+    if (g) {
+        // Slot reused: the old ghost is stale
+        arc_ghost_drop(g);
+    }
+
+    g = kmem_cache_alloc(arc_ghost_cache);
+    if (g == NULL) {
+        return;
+    }
+    g->offset = offset;
+    g->in_b2 = in_b2;
+    g->owner = al;
+    if (in_b2) {
+        list_add_before(&al->b2, &g->link);
+        al->nr_b2++;
+    } else {
+        list_add_before(&al->b1, &g->link);
+        al->nr_b1++;
+    }
+    arc_ghost_index[offset] = g;
+
+    arc_ghost_trim(al);
+}
+
+int swap_arc_check_swap() {
+    swap_arc_print_info();
+    return 0;
+}
+
+void swap_arc_print_info(void) {
+    list_entry_t *le = &mm_list;
+    while ((le = list_next(le)) != &mm_list) {
+        mm_struct *mm = le2mm(le);
+        arc_lists_t *al = mm2arc(mm);
+
+        if (!al->ready) {
+            cprintf("ARC mm %p: not initialized\n", mm);
+            continue;
+        }
+        cprintf("ARC mm %p: T1 %u (target %u), T2 %u, B1 %u, B2 %u, ghost hits %u / %u\n",
+                mm, al->nr_t1, al->p, al->nr_t2, al->nr_b1,
+                al->nr_b2, al->b1_hits, al->b2_hits);
+    }
+}
+
+swap_manager swap_mgr_arc = {
+    .name = "arc swap manager",
+    .init = swap_arc_init,
+    .init_mm = swap_arc_init_mm,
+    .map_swappable = swap_arc_map_swappable,
+    .swap_out_victim = swap_arc_swap_out_victim,
+    .exit_mm = swap_arc_exit_mm,
+    .swapped_out = swap_arc_swapped_out,
+    .unmap_page = swap_arc_unmap_page,
+    .check_swap = swap_arc_check_swap,
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "swap.h"
+
+// CAR (Clock with Adaptive Replacement): ARC's recency/frequency balance
+// driven by the PTE accessed bit, with ghost entries keyed by swap slot
+extern swap_manager swap_mgr_arc;
+
+// Unlink the resident pages and drop the ghost entries of an address
+// space that is going away
+void swap_arc_exit_mm(mm_struct *mm);
+
+// Print list sizes, the adaptive target and ghost hits of every mm
+void swap_arc_print_info(void);
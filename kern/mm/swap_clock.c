@@ -0,0 +1,192 @@
+#include "stdio.h"
+#include "vmm.h"
+
+#include "swap_clock.h"
+
+extern mm_struct init_mm;
+
+// CLOCK Page Replacement Algorithm (active/inactive lists)
+//
+// Swappable pages sit on one of two lists, oldest first. New and
+// swapped-in pages enter the inactive list. Victims come from the head
+// of the inactive list; a page whose accessed bit (PTE_A, tested and
+// cleared through the reverse map) is set gets a second chance and moves
+// to the active list instead.
+//
+// The active list is aged from its head whenever it outgrows the inactive
+// list: referenced pages rotate to the tail, idle ones are deactivated.
+// A page therefore has to stay idle for a full trip through both lists
+// before it is evicted, while a scan that touches each page once only
+// ever reaches the inactive list.
+//
+// Both lists live in the mm_struct (mm->swap_lists.clock); mm->rss is
+// kept equal to the number of pages on them. PG_ACTIVE tells which list
+// a page is on.
+
+static clock_lists_t *mm2clock(mm_struct *mm) {
+    return &mm->swap_lists.clock;
+}
+
+int swap_clock_init() {
+    return 0;
+}
+
+int swap_clock_init_mm(mm_struct *mm) {
+    clock_lists_t *cl = mm2clock(mm);
+
+    list_init(&cl->inactive);
+    list_init(&cl->active);
+    cl->nr_inactive = 0;
+    cl->nr_active = 0;
+    mm->rss = 0;
+
+    return 0;
+}
+
+/**
+ * Mark a page as swappable: it starts on the inactive list
+ * @param mm: memory management struct
+ * @param addr: virtual address
+ * @param page: page descriptor
+ * @param swap_in: 1 if swapping in, 0 if newly mapped
+ */
+int swap_clock_map_swappable(mm_struct *mm, uintptr_t addr, PageDesc *page, int swap_in) {
+    clock_lists_t *cl = mm2clock(mm);
+
+    CLEAR_PAGE_ACTIVE(page);
+    list_add_before(&cl->inactive, &page->page_link);
+    cl->nr_inactive++;
+    page->swap_mm = mm;
+    mm->rss++;
+
+    return 0;
+}
+
+/**
+ * Age the oldest active page: rotate it if it was referenced, otherwise
+ * move it to the tail of the inactive list
+ */
+static void clock_age_active(clock_lists_t *cl) {
+    list_entry_t *le = list_next(&cl->active);
+    PageDesc *page = le2page(le, page_link);
+
+    list_del(le);
+    if (rmap_referenced(page)) {
+        list_add_before(&cl->active, le);
+        return;
+    }
+    CLEAR_PAGE_ACTIVE(page);
+    cl->nr_active--;
+    list_add_before(&cl->inactive, le);
+    cl->nr_inactive++;
+}
+
+/**
+ * Select a victim page: the oldest inactive page not referenced since
+ * it was last looked at
+ * @param mm: memory management struct
+ * @param page_ptr: output pointer to victim page
+ * @param in_tick: not used
+ */
+int swap_clock_swap_out_victim(mm_struct *mm, PageDesc **page_ptr, int in_tick) {
+    clock_lists_t *cl = mm2clock(mm);
+
+    // Every step clears an accessed bit or returns, so two passes over all
+    // pages are enough; past that the oldest page is taken unconditionally
+    unsigned int budget = 2 * (cl->nr_inactive + cl->nr_active);
+
+    while (budget-- > 0) {
+        if (cl->nr_active > 0 && cl->nr_active > cl->nr_inactive) {
+            clock_age_active(cl);
+            continue;
+        }
+
+        list_entry_t *le = list_next(&cl->inactive);
+        PageDesc *page = le2page(le, page_link);
+        list_del(le);
+        cl->nr_inactive--;
+
+        if (rmap_referenced(page)) {
+            // Second chance: promote
+            SET_PAGE_ACTIVE(page);
+            list_add_before(&cl->active, le);
+            cl->nr_active++;
+            continue;
+        }
+
+        mm->rss--;
+        page->swap_mm = NULL;
+        *page_ptr = page;
+        return 0;
+    }
+
+    list_entry_t *head = (cl->nr_inactive > 0) ? &cl->inactive : &cl->active;
+    list_entry_t *victim = list_next(head);
+    if (victim == head) {
+        *page_ptr = NULL;
+        return -1;  // No page available
+    }
+
+    list_del(victim);
+    if (head == &cl->inactive) {
+        cl->nr_inactive--;
+    } else {
+        cl->nr_active--;
+    }
+    mm->rss--;
+
+    *page_ptr = le2page(victim, page_link);
+    CLEAR_PAGE_ACTIVE(*page_ptr);
+    (*page_ptr)->swap_mm = NULL;
+    return 0;
+}
+
+/**
+ * Take a page that lost its last mapping off whichever list holds it
+ */
+void swap_clock_unmap_page(mm_struct *mm, PageDesc *page) {
+    clock_lists_t *cl = mm2clock(mm);
+
+    list_del(&page->page_link);
+    if (PAGE_ACTIVE(page)) {
+        CLEAR_PAGE_ACTIVE(page);
+        cl->nr_active--;
+    } else {
+        cl->nr_inactive--;
+    }
+    page->swap_mm = NULL;
+    mm->rss--;
+}
+
+/**
+ * Empty both lists of an address space that is going away
+ */
+void swap_clock_exit_mm(mm_struct *mm) {
+    clock_lists_t *cl = mm2clock(mm);
+
+    while (cl->nr_inactive > 0) {
+        swap_clock_unmap_page(mm, le2page(list_next(&cl->inactive), page_link));
+    }
+    while (cl->nr_active > 0) {
+        swap_clock_unmap_page(mm, le2page(list_next(&cl->active), page_link));
+    }
+}
+
+int swap_clock_check_swap() {
+    clock_lists_t *cl = mm2clock(&init_mm);
+
+    cprintf("CLOCK swap check: %u active, %u inactive\n",
+            cl->nr_active, cl->nr_inactive);
+    return 0;
+}
+
+swap_manager swap_mgr_clock = {
+    .name = "clock swap manager",
+    .init = swap_clock_init,
+    .init_mm = swap_clock_init_mm,
+    .exit_mm = swap_clock_exit_mm,
+    .map_swappable = swap_clock_map_swappable,
+    .swap_out_victim = swap_clock_swap_out_victim,
+    .unmap_page = swap_clock_unmap_page,
+    .check_swap = swap_clock_check_swap,
+};
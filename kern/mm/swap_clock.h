@@ -2,5 +2,5 @@
 
 #include "swap.h"
 
-// Clock (Second Chance) page replacement algorithm
+// CLOCK over active/inactive lists, driven by the PTE accessed bit
 extern swap_manager swap_mgr_clock;
@@ -4,17 +4,16 @@
 #include "swap_fifo.h"
 
 // FIFO Page Replacement Algorithm
-// Pages are arranged in a queue - first in, first out
-
-list_entry_t pra_list_head;
+// Pages are arranged in a queue - first in, first out.
+// Each mm_struct has its own queue (mm->swap_lists.fifo).
 
 int swap_fifo_init() {
     return 0;
 }
 
 int swap_fifo_init_mm(mm_struct *mm) {
-    list_init(&pra_list_head);
-    mm->swap_list = &pra_list_head;
+    list_init(&mm->swap_lists.fifo);
+    mm->rss = 0;
 
     return 0;
 }
@@ -27,11 +26,13 @@ int swap_fifo_init_mm(mm_struct *mm) {
  * @param swap_in: 1 if swapping in, 0 if newly mapped
  */
 int swap_fifo_map_swappable(mm_struct *mm, uintptr_t addr, PageDesc *page, int swap_in) {
-    list_entry_t *head = (list_entry_t*) mm->swap_list;
+    list_entry_t *head = &mm->swap_lists.fifo;
     list_entry_t *entry = &(page->page_link);
     
     // Add page to the end of FIFO queue
     list_add_before(head, entry);
+    page->swap_mm = mm;
+    mm->rss++;
     
     return 0;
 }
@@ -43,7 +44,7 @@ int swap_fifo_map_swappable(mm_struct *mm, uintptr_t addr, PageDesc *page, int s
  * @param in_tick: not used in FIFO
  */
 int swap_fifo_swap_out_victim(mm_struct *mm, PageDesc **page_ptr, int in_tick) {
-    list_entry_t *head = (list_entry_t*) mm->swap_list;
+    list_entry_t *head = &mm->swap_lists.fifo;
     
     // Select the first page (oldest) in the FIFO queue
     list_entry_t *victim = list_next(head);
@@ -55,11 +56,33 @@ int swap_fifo_swap_out_victim(mm_struct *mm, PageDesc **page_ptr, int in_tick) {
     
     // Remove from list
     list_del(victim);
+    mm->rss--;
     
     *page_ptr = le2page(victim, page_link);
+    (*page_ptr)->swap_mm = NULL;
     return 0;
 }
 
+/**
+ * Take a page that lost its last mapping off the queue
+ */
+void swap_fifo_unmap_page(mm_struct *mm, PageDesc *page) {
+    list_del(&page->page_link);
+    page->swap_mm = NULL;
+    mm->rss--;
+}
+
+/**
+ * Empty the queue of an address space that is going away
+ */
+void swap_fifo_exit_mm(mm_struct *mm) {
+    list_entry_t *head = &mm->swap_lists.fifo;
+
+    while (list_next(head) != head) {
+        swap_fifo_unmap_page(mm, le2page(list_next(head), page_link));
+    }
+}
+
 int swap_fifo_check_swap() {
     cprintf("FIFO swap check: passed\n");
     return 0;
@@ -69,7 +92,9 @@ swap_manager swap_mgr_fifo = {
     .name = "fifo swap manager",
     .init = swap_fifo_init,
     .init_mm = swap_fifo_init_mm,
+    .exit_mm = swap_fifo_exit_mm,
     .map_swappable = swap_fifo_map_swappable,
     .swap_out_victim = swap_fifo_swap_out_victim,
+    .unmap_page = swap_fifo_unmap_page,
     .check_swap = swap_fifo_check_swap,
 };
\ No newline at end of file
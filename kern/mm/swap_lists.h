@@ -0,0 +1,35 @@
+#pragma once
+
+#include <base/types.h>
+
+#include "list.h"
+
+// Page replacement state embedded in every mm_struct. Each policy keeps
+// its lists in its own member, so switching the active policy never
+// disturbs another policy's bookkeeping.
+
+// CLOCK: active/inactive lists (swap_clock.c)
+typedef struct {
+    list_entry_t inactive;          // eviction candidates, oldest first
+    list_entry_t active;            // pages referenced since they were last scanned
+    unsigned int nr_inactive;
+    unsigned int nr_active;
+} clock_lists_t;
+
+// CAR: two clocks and two ghost lists (swap_arc.c)
+typedef struct {
+    list_entry_t t1;                // recency clock
+    list_entry_t t2;                // frequency clock
+    list_entry_t b1;                // ghosts evicted from T1, oldest first
+    list_entry_t b2;                // ghosts evicted from T2, oldest first
+    unsigned int nr_t1, nr_t2, nr_b1, nr_b2;
+    unsigned int p;                 // target size of T1
+    uint32_t b1_hits, b2_hits;      // re-faults that found a ghost
+    int ready;                      // lists initialised (ghosts may be held)
+} arc_lists_t;
+
+typedef struct {
+    list_entry_t fifo;              // FIFO queue, oldest first (swap_fifo.c)
+    clock_lists_t clock;
+    arc_lists_t arc;
+} swap_lists_t;
@@ -0,0 +1,336 @@
+#include "swap_slot.h"
+#include "zswap.h"
+#include "pmm.h"
+#include "../drivers/intr.h"
+
+#include "stdio.h"
+#include "memory.h"
+
+// Swap Slot Allocator
+//
+// A slot is one page-sized extent of the swap area. Allocation state is
+// kept twice: a bitmap (one bit per slot) lets the allocator skip 32 used
+// slots per word, and swap_map holds the number of PTEs referring to each
+// slot so a page shared by several mappings keeps its slot until the last
+// one faults it back in.
+//
+// Allocation prefers clusters: when the current cluster is used up, the
+// allocator looks for a completely free bitmap word and hands its slots
+// out in order, so a burst of swap-outs writes adjacent sectors. Only when
+// no free cluster is left does it fall back to the first free slot after
+// the cursor.
+//
+// Several areas can be active. Each owns a range of the global slot
+// space; the functions below take global slot numbers and work on the
+// owning area's local slots. New slots come from the highest-priority
+// area with room. Areas of equal priority take turns every SWAP_STRIPE
+// slots, so a swap-out burst is spread over their devices in stripes
+// that are still long enough to be written with one request each.
+
+#define BITS_PER_WORD   32
+#define WORD_FULL       0xFFFFFFFFU
+
+static swap_area_t swap_areas[MAX_SWAP_AREAS];
+static int nr_swap_areas = 0;
+static uint32_t swap_slots_end = 0;     // first global slot past the last area
+
+// Equal-priority striping: area being filled and slots left in its stripe
+static int stripe_area = -1;
+static unsigned int stripe_left = 0;
+static uint32_t alloc_failures = 0;
+
+#define slot_word(off)  ((off) / BITS_PER_WORD)
+#define slot_mask(off)  (1U << ((off) % BITS_PER_WORD))
+
+static int slot_used(swap_area_t *si, uint32_t off) {
+    return (si->bitmap[slot_word(off)] & slot_mask(off)) != 0;
+}
+
+int swap_area_add(block_device_t *dev, uint32_t start_sector, unsigned int nr_slots, int prio) {
+    if (nr_swap_areas >= MAX_SWAP_AREAS) {
+        cprintf("swap_area_add: too many swap areas\n");
+        return -1;
+    }
+    if (swap_slots_end + nr_slots > SWAP_MAX_SLOTS) {
+        nr_slots = SWAP_MAX_SLOTS - swap_slots_end;
+    }
+    if (nr_slots < 2) {
+        cprintf("swap_area_add: no slot space left for %s\n", dev->name);
+        return -1;
+    }
+
+    swap_area_t *si = &swap_areas[nr_swap_areas];
+    unsigned int words = (nr_slots + BITS_PER_WORD - 1) / BITS_PER_WORD;
+
+    memset(si, 0, sizeof(*si));
+    si->bitmap = kmalloc(words * sizeof(uint32_t));
+    si->swap_map = kmalloc(nr_slots);
+    if (si->bitmap == NULL || si->swap_map == NULL) {
+        kfree(si->bitmap);
+        kfree(si->swap_map);
+        return -1;
+    }
+
+    memset(si->bitmap, 0, words * sizeof(uint32_t));
+    memset(si->swap_map, 0, nr_slots);
+
+    // Slot 0 would make an all-zero PTE, which means "never mapped"; every
+    // area gives up its local slot 0 so the layout is the same for all
+    si->bitmap[0] |= slot_mask(0);
+    si->swap_map[0] = SWAP_MAP_MAX;
+
+    // Bits past the end of the area are permanently "used"
+    for (unsigned int off = nr_slots; off < words * BITS_PER_WORD; off++) {
+        si->bitmap[slot_word(off)] |= slot_mask(off);
+    }
+
+    si->dev = dev;
+    si->start_sector = start_sector;
+    si->prio = prio;
+    si->max = nr_slots;
+    si->cluster_next = 1;
+
+    intr_save();
+    si->base = swap_slots_end;
+    swap_slots_end += nr_slots;
+    nr_swap_areas++;
+    intr_restore();
+
+    return nr_swap_areas - 1;
+}
+
+swap_area_t *swap_area_of(uint32_t offset) {
+    for (int i = 0; i < nr_swap_areas; i++) {
+        swap_area_t *si = &swap_areas[i];
+        if (offset >= si->base && offset < si->base + si->max) {
+            return si;
+        }
+    }
+    return NULL;
+}
+
+int swap_area_count(void) {
+    return nr_swap_areas;
+}
+
+swap_area_t *swap_area_get(int idx) {
+    return (idx >= 0 && idx < nr_swap_areas) ? &swap_areas[idx] : NULL;
+}
+
+// Start a new cluster at the next completely free word after the cursor
+static int cluster_find(swap_area_t *si) {
+    unsigned int words = (si->max + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    unsigned int start = slot_word(si->cluster_next);
+
+    for (unsigned int i = 0; i < words; i++) {
+        unsigned int w = (start + i) % words;
+        if (si->bitmap[w] == 0) {
+            si->cluster_next = w * BITS_PER_WORD;
+            si->cluster_left = BITS_PER_WORD;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// First free slot at or after the cursor, 0 if none
+static uint32_t slot_scan(swap_area_t *si) {
+    unsigned int words = (si->max + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    unsigned int start = slot_word(si->cluster_next);
+
+    for (unsigned int i = 0; i < words; i++) {
+        unsigned int w = (start + i) % words;
+        if (si->bitmap[w] != WORD_FULL) {
+            uint32_t bits = ~si->bitmap[w];
+            uint32_t bit = 0;
+            while (!(bits & (1U << bit))) {
+                bit++;
+            }
+            return w * BITS_PER_WORD + bit;
+        }
+    }
+    return 0;
+}
+
+// Allocate a local slot in one area, 0 if it is full
+static uint32_t area_alloc(swap_area_t *si) {
+    uint32_t off = 0;
+
+    if (si->inuse + 1 < si->max) {
+        // Continue the current cluster while its next slot is still free
+        if (si->cluster_left > 0 && si->cluster_next < si->max &&
+            !slot_used(si, si->cluster_next)) {
+            off = si->cluster_next;
+            si->cluster_allocs++;
+        } else if (cluster_find(si) == 0) {
+            off = si->cluster_next;
+            si->cluster_allocs++;
+        } else {
+            si->cluster_left = 0;
+            off = slot_scan(si);
+        }
+    }
+
+    if (off != 0) {
+        si->bitmap[slot_word(off)] |= slot_mask(off);
+        si->swap_map[off] = 1;
+        si->inuse++;
+        si->allocs++;
+        si->cluster_next = off + 1;
+        if (si->cluster_left > 0) {
+            si->cluster_left--;
+        }
+    }
+    return off;
+}
+
+static int area_has_room(swap_area_t *si) {
+    return si->inuse + 1 < si->max;
+}
+
+uint32_t swap_slot_alloc(void) {
+    uint32_t off = 0;
+
+    intr_save();
+
+    // Highest priority that still has room
+    int best = -1;
+    for (int i = 0; i < nr_swap_areas; i++) {
+        if (area_has_room(&swap_areas[i]) &&
+            (best < 0 || swap_areas[i].prio > swap_areas[best].prio)) {
+            best = i;
+        }
+    }
+
+    if (best >= 0) {
+        int prio = swap_areas[best].prio;
+        int idx = stripe_area;
+
+        // Keep filling the current stripe, else rotate to the next area of
+        // the same priority
+        if (stripe_left == 0 || idx < 0 || swap_areas[idx].prio != prio ||
+            !area_has_room(&swap_areas[idx])) {
+            for (int i = 1; i <= nr_swap_areas; i++) {
+                int next = (stripe_area + i + nr_swap_areas) % nr_swap_areas;
+                if (swap_areas[next].prio == prio && area_has_room(&swap_areas[next])) {
+                    idx = next;
+                    break;
+                }
+            }
+            stripe_area = idx;
+            stripe_left = SWAP_STRIPE;
+        }
+
+        swap_area_t *si = &swap_areas[idx];
+        uint32_t local = area_alloc(si);
+        if (local != 0) {
+            off = si->base + local;
+            stripe_left--;
+        }
+    }
+
+    if (off == 0) {
+        alloc_failures++;
+    }
+    intr_restore();
+
+    return off;
+}
+
+int swap_slot_dup(uint32_t offset) {
+    swap_area_t *si = swap_area_of(offset);
+    int ret = -1;
+
+    intr_save();
+    if (si != NULL) {
+        uint32_t local = offset - si->base;
+        if (local > 0 && slot_used(si, local) && si->swap_map[local] < SWAP_MAP_MAX - 1) {
+            si->swap_map[local]++;
+            ret = 0;
+        }
+    }
+    intr_restore();
+    return ret;
+}
+
+int swap_slot_free(uint32_t offset) {
+    swap_area_t *si = swap_area_of(offset);
+    int ret = -1, freed = 0;
+
+    intr_save();
+    if (si != NULL) {
+        uint32_t local = offset - si->base;
+        if (local > 0 && si->swap_map[local] > 0) {
+            if (--si->swap_map[local] == 0) {
+                si->bitmap[slot_word(local)] &= ~slot_mask(local);
+                si->inuse--;
+                freed = 1;
+            }
+            ret = 0;
+        }
+    }
+    intr_restore();
+
+    if (ret != 0) {
+        cprintf("swap_slot_free: bad or free slot %d\n", offset);
+    }
+    if (freed) {
+        // The data goes with the slot, including a compressed copy
+        zswap_invalidate(offset);
+    }
+    return ret;
+}
+
+int swap_slot_count(uint32_t offset) {
+    swap_area_t *si = swap_area_of(offset);
+    if (si == NULL || offset == si->base) {
+        return 0;
+    }
+    return si->swap_map[offset - si->base];
+}
+
+static void area_print_info(swap_area_t *si) {
+    unsigned int extents = 0, largest = 0, run = 0, free_clusters = 0;
+    unsigned int words = (si->max + BITS_PER_WORD - 1) / BITS_PER_WORD;
+
+    intr_save();
+    for (uint32_t off = 1; off < si->max; off++) {
+        if (!slot_used(si, off)) {
+            if (run++ == 0) {
+                extents++;
+            }
+            if (run > largest) {
+                largest = run;
+            }
+        } else {
+            run = 0;
+        }
+    }
+    for (unsigned int w = 0; w < words; w++) {
+        if (si->bitmap[w] == 0) {
+            free_clusters++;
+        }
+    }
+    intr_restore();
+
+    unsigned int nfree = si->max - 1 - si->inuse;
+    unsigned int usage = si->max > 1 ? si->inuse * 100 / (si->max - 1) : 0;
+
+    cprintf("area:        %s from sector %d, priority %d, slots %d-%d\n",
+            si->dev->name, si->start_sector, si->prio, si->base + 1, si->base + si->max - 1);
+    cprintf("slots:       %d used / %d (%d%c)\n", si->inuse, si->max - 1, usage, '%');
+    cprintf("free:        %d slots in %d extents, largest %d\n", nfree, extents, largest);
+    cprintf("clusters:    %d of %d free (%d slots each)\n", free_clusters, words, SWAP_CLUSTER);
+    // 0% when the free space is one extent, near 100% when it is all single slots
+    if (nfree > 0) {
+        cprintf("fragmentation: %d%c\n", (nfree - largest) * 100 / nfree, '%');
+    }
+    cprintf("allocs:      %u (%u from clusters)\n", si->allocs, si->cluster_allocs);
+}
+
+void swap_slot_print_info(void) {
+    for (int i = 0; i < nr_swap_areas; i++) {
+        area_print_info(&swap_areas[i]);
+    }
+    cprintf("alloc failures: %u (all areas full)\n", alloc_failures);
+}
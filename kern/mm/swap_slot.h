@@ -0,0 +1,64 @@
+#pragma once
+
+#include <base/types.h>
+
+#include "../drivers/blk.h"
+
+// Slots are handed out in clusters of one bitmap word, so consecutive
+// swap-outs land in adjacent sectors
+#define SWAP_CLUSTER        32
+#define SWAP_MAP_MAX        0xFF    // reference count limit per slot
+
+#define MAX_SWAP_AREAS      MAX_BLK_DEV
+#define SWAP_MAX_SLOTS      8192    // global slot space shared by all areas (32 MB)
+#define SWAP_STRIPE         8       // slots taken from one area before rotating
+
+// One swap area: a run of page-sized slots on a block device. Areas own
+// consecutive ranges of the global slot space, so a slot number alone
+// names the device and sector.
+typedef struct {
+    block_device_t *dev;        // device holding the area
+    uint32_t start_sector;      // sector of local slot 0
+    int prio;                   // higher is used first; equal priorities are striped
+    uint32_t base;              // global number of local slot 0
+    unsigned int max;           // slots in the area (local slot 0 is never used)
+    unsigned int inuse;         // slots currently allocated
+    uint32_t *bitmap;           // 1 bit per slot, set when allocated
+    uint8_t *swap_map;          // per-slot reference count (PTEs holding the entry)
+    unsigned int cluster_next;  // next slot to hand out from the current cluster
+    unsigned int cluster_left;  // slots left in the current cluster
+    uint32_t allocs;            // successful allocations
+    uint32_t cluster_allocs;    // allocations served from a free cluster
+    uint32_t read_ios;          // requests and sectors moved (swapfs)
+    uint32_t read_sectors;
+    uint32_t write_ios;
+    uint32_t write_sectors;
+    uint64_t io_cycles;         // time spent in those requests
+} swap_area_t;
+
+// Add an area of nr_slots slots starting at start_sector of dev.
+// Returns the area index, -1 on failure.
+int swap_area_add(block_device_t *dev, uint32_t start_sector, unsigned int nr_slots, int prio);
+
+// Area holding a global slot, NULL if none
+swap_area_t *swap_area_of(uint32_t offset);
+
+int swap_area_count(void);
+swap_area_t *swap_area_get(int idx);
+
+// Allocate one slot with a reference count of 1, 0 if every area is full.
+// The highest-priority area with room wins; equal priorities take turns
+// every SWAP_STRIPE slots.
+uint32_t swap_slot_alloc(void);
+
+// Take another reference on an allocated slot
+int swap_slot_dup(uint32_t offset);
+
+// Drop a reference; the slot is free again when the count reaches zero
+int swap_slot_free(uint32_t offset);
+
+// Reference count of a slot (0 when free)
+int swap_slot_count(uint32_t offset);
+
+// Print usage and fragmentation of every swap area (swapinfo)
+void swap_slot_print_info(void);
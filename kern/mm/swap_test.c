@@ -1,17 +1,21 @@
 #include "swap.h"
 #include "swap_fifo.h"
-// Note: swap_clock and swap_lru are archived in kern/mm/archived/
-// #include "swap_clock.h"
+#include "swap_clock.h"
+#include "swap_arc.h"
+#include "zswap.h"
+// Note: swap_lru is archived in kern/mm/archived/
 // #include "swap_lru.h"
 #include "pmm.h"
 #include "stdio.h"
+#include "memory.h"
 
+#include <arch/x86/io.h>
 #include <arch/x86/mmu.h>
 
 // External declarations
 extern swap_manager *swap_mgr;
 extern pde_t *boot_pgdir;
-extern mm_struct* init_mm;
+extern mm_struct init_mm;
 
 // Test statistics
 static int tests_passed = 0;
@@ -45,19 +49,19 @@ static int tests_failed = 0;
 void test_fifo_basic() {
     TEST_START("FIFO Basic Operation");
 
-    swap_mgr_fifo.init_mm(init_mm);
+    swap_mgr_fifo.init_mm(&init_mm);
     
     PageDesc pages[5];
     
     // Add pages in order
     for (int i = 0; i < 5; i++) {
-        swap_mgr_fifo.map_swappable(init_mm, 0x1000 * i, &pages[i], 0);
+        swap_mgr_fifo.map_swappable(&init_mm, 0x1000 * i, &pages[i], 0);
     }
     
     // Verify FIFO order: should select page 0, then 1, then 2...
     for (int i = 0; i < 5; i++) {
         PageDesc *victim = NULL;
-        int ret = swap_mgr_fifo.swap_out_victim(init_mm, &victim, 0);
+        int ret = swap_mgr_fifo.swap_out_victim(&init_mm, &victim, 0);
         
         // Simple message without snprintf for now
         if (ret == 0 && victim == &pages[i]) {
@@ -70,7 +74,7 @@ void test_fifo_basic() {
     
     // Test empty list
     PageDesc *victim = NULL;
-    int ret = swap_mgr_fifo.swap_out_victim(init_mm, &victim, 0);
+    int ret = swap_mgr_fifo.swap_out_victim(&init_mm, &victim, 0);
     TEST_ASSERT(ret != 0, "Empty list returns error");
     
     TEST_END();
@@ -79,27 +83,27 @@ void test_fifo_basic() {
 void test_fifo_interleaved() {
     TEST_START("FIFO Interleaved Add/Remove");
     
-    swap_mgr_fifo.init_mm(init_mm);
+    swap_mgr_fifo.init_mm(&init_mm);
     
     PageDesc pages[10];
     
     // Add 3 pages
     for (int i = 0; i < 3; i++) {
-        swap_mgr_fifo.map_swappable(init_mm, 0x1000 * i, &pages[i], 0);
+        swap_mgr_fifo.map_swappable(&init_mm, 0x1000 * i, &pages[i], 0);
     }
     
     // Remove 1
     PageDesc *victim;
-    swap_mgr_fifo.swap_out_victim(init_mm, &victim, 0);
+    swap_mgr_fifo.swap_out_victim(&init_mm, &victim, 0);
     TEST_ASSERT(victim == &pages[0], "First victim is page 0");
     
     // Add 2 more
     for (int i = 3; i < 5; i++) {
-        swap_mgr_fifo.map_swappable(init_mm, 0x1000 * i, &pages[i], 0);
+        swap_mgr_fifo.map_swappable(&init_mm, 0x1000 * i, &pages[i], 0);
     }
     
     // Next victim should be page 1
-    swap_mgr_fifo.swap_out_victim(init_mm, &victim, 0);
+    swap_mgr_fifo.swap_out_victim(&init_mm, &victim, 0);
     TEST_ASSERT(victim == &pages[1], "Second victim is page 1");
     
     TEST_END();
@@ -116,18 +120,18 @@ void test_lru_basic() {
     TEST_START("LRU Basic Operation");
     
     mm_struct mm;
-    swap_mgr_lru.init_mm(init_mm);
+    swap_mgr_lru.init_mm(&init_mm);
     
     PageDesc pages[3];
     
     // Add pages 0, 1, 2
-    swap_mgr_lru.map_swappable(init_mm, 0x1000, &pages[0], 0);
-    swap_mgr_lru.map_swappable(init_mm, 0x2000, &pages[1], 0);
-    swap_mgr_lru.map_swappable(init_mm, 0x3000, &pages[2], 0);
+    swap_mgr_lru.map_swappable(&init_mm, 0x1000, &pages[0], 0);
+    swap_mgr_lru.map_swappable(&init_mm, 0x2000, &pages[1], 0);
+    swap_mgr_lru.map_swappable(&init_mm, 0x3000, &pages[2], 0);
     
     // Victim should be page 0 (least recently used)
     PageDesc *victim;
-    swap_mgr_lru.swap_out_victim(init_mm, &victim, 0);
+    swap_mgr_lru.swap_out_victim(&init_mm, &victim, 0);
     TEST_ASSERT(victim == &pages[0], "LRU victim is page 0");
     
     TEST_END();
@@ -137,61 +141,617 @@ void test_lru_access_pattern() {
     TEST_START("LRU Access Pattern");
     
     mm_struct mm;
-    swap_mgr_lru.init_mm(init_mm);
+    swap_mgr_lru.init_mm(&init_mm);
     
     PageDesc pages[3];
     
     // Add pages 0, 1, 2
-    swap_mgr_lru.map_swappable(init_mm, 0x1000, &pages[0], 0);
-    swap_mgr_lru.map_swappable(init_mm, 0x2000, &pages[1], 0);
-    swap_mgr_lru.map_swappable(init_mm, 0x3000, &pages[2], 0);
+    swap_mgr_lru.map_swappable(&init_mm, 0x1000, &pages[0], 0);
+    swap_mgr_lru.map_swappable(&init_mm, 0x2000, &pages[1], 0);
+    swap_mgr_lru.map_swappable(&init_mm, 0x3000, &pages[2], 0);
     
     // Access page 0 again (moves to back)
-    swap_mgr_lru.map_swappable(init_mm, 0x1000, &pages[0], 1);
+    swap_mgr_lru.map_swappable(&init_mm, 0x1000, &pages[0], 1);
     
     // Now LRU should be page 1
     PageDesc *victim;
-    swap_mgr_lru.swap_out_victim(init_mm, &victim, 0);
+    swap_mgr_lru.swap_out_victim(&init_mm, &victim, 0);
     TEST_ASSERT(victim == &pages[1], "After access, LRU is page 1");
     
     // Next should be page 2
-    swap_mgr_lru.swap_out_victim(init_mm, &victim, 0);
+    swap_mgr_lru.swap_out_victim(&init_mm, &victim, 0);
     TEST_ASSERT(victim == &pages[2], "Next LRU is page 2");
     
     // Last should be page 0 (most recently accessed)
-    swap_mgr_lru.swap_out_victim(init_mm, &victim, 0);
+    swap_mgr_lru.swap_out_victim(&init_mm, &victim, 0);
     TEST_ASSERT(victim == &pages[0], "Last is page 0");
     
     TEST_END();
 }
 
+#endif
+
 // ============================================================================
-// Unit Tests - Clock Algorithm (ARCHIVED)
+// Unit Tests - Clock Algorithm
 // ============================================================================
-// Note: Clock algorithm is archived in kern/mm/archived/
-// To re-enable, move swap_clock.c/h back and uncomment the includes above
+// The policies read PTE_A through the reverse map, so these use real mapped pages
 
-void test_clock_basic() {
-    TEST_START("Clock Basic Operation");
-    
-    mm_struct mm;
-    swap_mgr_clock.init_mm(init_mm);
-    
-    PageDesc pages[4];
-    
-    // Add pages
-    for (int i = 0; i < 4; i++) {
-        swap_mgr_clock.map_swappable(init_mm, 0x1000 * i, &pages[i], 0);
+#define POLICY_TEST_BASE  0x600000
+#define POLICY_TEST_PAGES 4
+
+static PageDesc *policy_pages[POLICY_TEST_PAGES];
+
+/**
+ * Map the test pages and queue them on a fresh list of mgr
+ * @return number of pages mapped
+ */
+static int policy_test_setup(swap_manager *mgr) {
+    mgr->init_mm(&init_mm);
+
+    for (int i = 0; i < POLICY_TEST_PAGES; i++) {
+        uintptr_t addr = POLICY_TEST_BASE + i * PG_SIZE;
+        policy_pages[i] = pgdir_alloc_page(init_mm.pgdir, addr, PTE_W | PTE_U);
+        if (policy_pages[i] == NULL) {
+            return i;
+        }
+        mgr->map_swappable(&init_mm, addr, policy_pages[i], 0);
     }
-    
-    // Should select pages in order (simplified clock without accessed bit)
-    PageDesc *victim;
-    int ret = swap_mgr_clock.swap_out_victim(init_mm, &victim, 0);
-    TEST_ASSERT(ret == 0 && victim != NULL, "Clock selects a victim");
-    
+    return POLICY_TEST_PAGES;
+}
+
+static void policy_test_touch(int i) {
+    pte_t *ptep = get_pte(init_mm.pgdir, POLICY_TEST_BASE + i * PG_SIZE, 0);
+    *ptep |= PTE_A;
+}
+
+static int policy_test_accessed(int i) {
+    pte_t *ptep = get_pte(init_mm.pgdir, POLICY_TEST_BASE + i * PG_SIZE, 0);
+    return (*ptep & PTE_A) != 0;
+}
+
+// Drop every mapping and swap entry of the test pages; mgr unlinks the
+// ones still on its lists
+static void policy_test_teardown(swap_manager *mgr) {
+    swap_manager *saved = swap_mgr;
+    swap_mgr = mgr;
+    for (int i = 0; i < POLICY_TEST_PAGES; i++) {
+        uintptr_t addr = POLICY_TEST_BASE + i * PG_SIZE;
+        pte_t *ptep = get_pte(init_mm.pgdir, addr, 0);
+        if (ptep && *ptep != 0 && !(*ptep & PTE_P)) {
+            swap_entry_free(*ptep);
+            *ptep = 0;
+        } else {
+            page_remove(init_mm.pgdir, addr);
+        }
+    }
+    swap_mgr = saved;
+}
+
+void test_clock_second_chance() {
+    TEST_START("Clock Second Chance");
+
+    if (policy_test_setup(&swap_mgr_clock) != POLICY_TEST_PAGES) {
+        TEST_ASSERT(0, "Test pages mapped");
+        policy_test_teardown(&swap_mgr_clock);
+        TEST_END();
+        return;
+    }
+
+    // Pages 0 and 2 were used since they were queued
+    policy_test_touch(0);
+    policy_test_touch(2);
+
+    PageDesc *victim = NULL;
+    int ret = swap_mgr_clock.swap_out_victim(&init_mm, &victim, 0);
+    TEST_ASSERT(ret == 0 && victim == policy_pages[1], "First victim is page 1");
+    ret = swap_mgr_clock.swap_out_victim(&init_mm, &victim, 0);
+    TEST_ASSERT(ret == 0 && victim == policy_pages[3], "Second victim is page 3");
+    TEST_ASSERT(!policy_test_accessed(0) && !policy_test_accessed(2),
+                "Accessed bits cleared on the skipped pages");
+
+    // Only the promoted pages are left; page 2 is used again
+    policy_test_touch(2);
+    ret = swap_mgr_clock.swap_out_victim(&init_mm, &victim, 0);
+    TEST_ASSERT(ret == 0 && victim == policy_pages[0], "Idle active page is evicted next");
+    ret = swap_mgr_clock.swap_out_victim(&init_mm, &victim, 0);
+    TEST_ASSERT(ret == 0 && victim == policy_pages[2], "Last victim is page 2");
+
+    ret = swap_mgr_clock.swap_out_victim(&init_mm, &victim, 0);
+    TEST_ASSERT(ret != 0, "Empty lists return error");
+
+    policy_test_teardown(&swap_mgr_clock);
+    TEST_END();
+}
+
+void test_clock_all_referenced() {
+    TEST_START("Clock All Pages Referenced");
+
+    if (policy_test_setup(&swap_mgr_clock) != POLICY_TEST_PAGES) {
+        TEST_ASSERT(0, "Test pages mapped");
+        policy_test_teardown(&swap_mgr_clock);
+        TEST_END();
+        return;
+    }
+
+    for (int i = 0; i < POLICY_TEST_PAGES; i++) {
+        policy_test_touch(i);
+    }
+
+    // One sweep clears every bit; the oldest page then goes first
+    PageDesc *victim = NULL;
+    int ret = swap_mgr_clock.swap_out_victim(&init_mm, &victim, 0);
+    TEST_ASSERT(ret == 0 && victim == policy_pages[0], "Victim is the oldest page");
+
+    int cleared = 1;
+    for (int i = 1; i < POLICY_TEST_PAGES; i++) {
+        if (policy_test_accessed(i)) {
+            cleared = 0;
+        }
+    }
+    TEST_ASSERT(cleared, "Accessed bits cleared on the remaining pages");
+
+    policy_test_teardown(&swap_mgr_clock);
+    TEST_END();
+}
+
+void test_clock_swap_cycle() {
+    TEST_START("Clock Swap Out Keeps Hot Page");
+
+    if (policy_test_setup(&swap_mgr_clock) != POLICY_TEST_PAGES) {
+        TEST_ASSERT(0, "Test pages mapped");
+        policy_test_teardown(&swap_mgr_clock);
+        TEST_END();
+        return;
+    }
+
+    swap_manager *saved = swap_mgr;
+    swap_mgr = &swap_mgr_clock;
+
+    policy_test_touch(0);
+    int swapped = swap_out(&init_mm, 2, 0);
+    TEST_ASSERT(swapped == 2, "Swapped out 2 pages");
+
+    pte_t *ptep = get_pte(init_mm.pgdir, POLICY_TEST_BASE, 0);
+    TEST_ASSERT(ptep && (*ptep & PTE_P), "Referenced page stays resident");
+    ptep = get_pte(init_mm.pgdir, POLICY_TEST_BASE + PG_SIZE, 0);
+    TEST_ASSERT(ptep && !(*ptep & PTE_P), "Idle page swapped out");
+
+    swap_mgr = saved;
+    policy_test_teardown(&swap_mgr_clock);
+    TEST_END();
+}
+
+// ============================================================================
+// Unit Tests - ARC Algorithm
+// ============================================================================
+
+void test_arc_ghost_hit() {
+    TEST_START("ARC Ghost Hit Promotes to T2");
+
+    if (policy_test_setup(&swap_mgr_arc) != POLICY_TEST_PAGES) {
+        TEST_ASSERT(0, "Test pages mapped");
+        policy_test_teardown(&swap_mgr_arc);
+        TEST_END();
+        return;
+    }
+
+    swap_manager *saved = swap_mgr;
+    swap_mgr = &swap_mgr_arc;
+
+    int swapped = swap_out(&init_mm, 1, 0);
+    TEST_ASSERT(swapped == 1, "Swapped out 1 page");
+
+    pte_t *ptep = get_pte(init_mm.pgdir, POLICY_TEST_BASE, 0);
+    TEST_ASSERT(ptep && *ptep != 0 && !(*ptep & PTE_P), "Oldest T1 page evicted");
+
+    PageDesc *page = NULL;
+    int ret = swap_in(&init_mm, POLICY_TEST_BASE, &page);
+    TEST_ASSERT(ret == 0 && page != NULL, "Page swapped back in");
+    TEST_ASSERT(page && PAGE_ACTIVE(page), "Re-faulted page lands in T2");
+
+    // A fresh page that was never evicted stays in T1
+    TEST_ASSERT(!PAGE_ACTIVE(policy_pages[1]), "Other pages stay in T1");
+
+    swap_mgr = saved;
+    policy_test_teardown(&swap_mgr_arc);
+    TEST_END();
+}
+
+// Scan-resistance trace: every round touches a hot set, then a stretch of
+// a cold region that is never reused before it is evicted. FIFO loses the
+// hot set to each scan; an adaptive policy should keep it resident.
+#define TRACE_BASE      0x800000
+#define TRACE_HOT       24
+#define TRACE_COLD      96
+#define TRACE_PAGES     (TRACE_HOT + TRACE_COLD)
+#define TRACE_RESIDENT  32
+#define TRACE_EVICT     4
+#define TRACE_ROUNDS    8
+#define TRACE_SCAN      24      // cold pages per round
+
+static int trace_resident;
+static uint32_t trace_faults;
+static uint32_t trace_errors;
+
+// Read page idx through its mapping, faulting it in under the resident cap
+static void trace_touch(int idx) {
+    uintptr_t addr = TRACE_BASE + idx * PG_SIZE;
+    pte_t *ptep = get_pte(init_mm.pgdir, addr, 0);
+
+    if (ptep == NULL || !(*ptep & PTE_P)) {
+        if (trace_resident >= TRACE_RESIDENT) {
+            trace_resident -= swap_out(&init_mm, TRACE_EVICT, 0);
+        }
+        vmm_pg_fault(&init_mm, 0, addr);
+        trace_resident++;
+        trace_faults++;
+        ptep = get_pte(init_mm.pgdir, addr, 0);
+    }
+
+    if (ptep == NULL || !(*ptep & PTE_P) || *(volatile uint32_t *)addr != (uint32_t)idx) {
+        trace_errors++;
+    }
+}
+
+/**
+ * Replay the scan trace with mgr as the active policy
+ * @return faults taken after the pages were populated
+ */
+static uint32_t trace_replay(swap_manager *mgr) {
+    swap_manager *saved = swap_mgr;
+    swap_mgr = mgr;
+    swap_init_mm(&init_mm);
+    trace_resident = 0;
+
+    for (int i = 0; i < TRACE_PAGES; i++) {
+        uintptr_t addr = TRACE_BASE + i * PG_SIZE;
+        if (trace_resident >= TRACE_RESIDENT) {
+            trace_resident -= swap_out(&init_mm, TRACE_EVICT, 0);
+        }
+        PageDesc *page = pgdir_alloc_page(init_mm.pgdir, addr, PTE_W | PTE_U);
+        if (page == NULL) {
+            trace_errors++;
+            break;
+        }
+        *(uint32_t *)page2kva(page) = i;
+        swap_mgr->map_swappable(&init_mm, addr, page, 0);
+        trace_resident++;
+    }
+
+    trace_faults = 0;
+    for (int r = 0; r < TRACE_ROUNDS; r++) {
+        for (int h = 0; h < TRACE_HOT; h++) {
+            trace_touch(h);
+        }
+        for (int c = 0; c < TRACE_SCAN; c++) {
+            trace_touch(TRACE_HOT + (r * TRACE_SCAN + c) % TRACE_COLD);
+        }
+    }
+
+    for (int i = 0; i < TRACE_PAGES; i++) {
+        uintptr_t addr = TRACE_BASE + i * PG_SIZE;
+        pte_t *ptep = get_pte(init_mm.pgdir, addr, 0);
+        if (ptep && *ptep != 0 && !(*ptep & PTE_P)) {
+            swap_entry_free(*ptep);
+            *ptep = 0;
+        } else {
+            page_remove(init_mm.pgdir, addr);
+        }
+    }
+    swap_cache_shrink(0);
+
+    swap_mgr = saved;
+    return trace_faults;
+}
+
+void test_arc_scan_resistance() {
+    TEST_START("ARC Scan Resistance vs FIFO");
+
+    if (rcr3() != P_ADDR(init_mm.pgdir)) {
+        TEST_ASSERT(0, "Running on the boot page directory");
+        TEST_END();
+        return;
+    }
+
+    trace_errors = 0;
+    uint32_t fifo = trace_replay(&swap_mgr_fifo);
+    uint32_t arc = trace_replay(&swap_mgr_arc);
+
+    cprintf("  %d accesses, %d resident: FIFO %u faults, ARC %u faults\n",
+            TRACE_ROUNDS * (TRACE_HOT + TRACE_SCAN), TRACE_RESIDENT, fifo, arc);
+    TEST_ASSERT(trace_errors == 0, "Pages read back with the right contents");
+    TEST_ASSERT(arc < fifo, "ARC takes fewer faults than FIFO");
+
+    TEST_END();
+}
+
+// ============================================================================
+// Unit Tests - zswap
+// ============================================================================
+
+// Store page under a fresh slot with the pool enabled
+static uint32_t zswap_test_store(PageDesc *page, int *ret) {
+    uint32_t slot = swap_slot_alloc();
+    int saved = zswap_set_enabled(1);
+    *ret = slot ? zswap_store(slot, page) : -1;
+    zswap_set_enabled(saved);
+    return slot;
+}
+
+void test_zswap_roundtrip() {
+    TEST_START("zswap Store and Load");
+
+    PageDesc *page = alloc_page();
+    TEST_ASSERT(page != NULL, "Page allocation successful");
+    if (!page) {
+        TEST_END();
+        return;
+    }
+
+    uint8_t *kva = page2kva(page);
+    for (int i = 0; i < PG_SIZE; i++) {
+        kva[i] = (uint8_t)((i % 61) * 3 + (i >> 9));
+    }
+
+    int ret;
+    uint32_t slot = zswap_test_store(page, &ret);
+    TEST_ASSERT(slot != 0 && ret == 0, "Compressible page stored");
+    TEST_ASSERT(zswap_present(slot), "Slot is held in the pool");
+
+    memset(kva, 0, PG_SIZE);
+    ret = zswap_load(slot, page);
+    int errors = 0;
+    for (int i = 0; i < PG_SIZE; i++) {
+        if (kva[i] != (uint8_t)((i % 61) * 3 + (i >> 9))) {
+            errors++;
+        }
+    }
+    TEST_ASSERT(ret == 0 && errors == 0, "Loaded page matches");
+
+    if (slot) {
+        swap_slot_free(slot);
+    }
+    TEST_ASSERT(!zswap_present(slot), "Freeing the slot drops the entry");
+
+    free_page(page);
+    TEST_END();
+}
+
+void test_zswap_zero_page() {
+    TEST_START("zswap Zero-Filled Page");
+
+    PageDesc *page = alloc_page();
+    TEST_ASSERT(page != NULL, "Page allocation successful");
+    if (!page) {
+        TEST_END();
+        return;
+    }
+
+    const zswap_stats_t *zs = zswap_get_stats();
+    uint32_t zero = zs->zero_pages, pool = zs->pool_bytes;
+
+    memset(page2kva(page), 0, PG_SIZE);
+    int ret;
+    uint32_t slot = zswap_test_store(page, &ret);
+    TEST_ASSERT(slot != 0 && ret == 0, "Zero page stored");
+    TEST_ASSERT(zs->zero_pages == zero + 1 && zs->pool_bytes == pool,
+                "Stored as a flag without pool space");
+
+    memset(page2kva(page), 0x5A, PG_SIZE);
+    ret = zswap_load(slot, page);
+    TEST_ASSERT(ret == 0 && *(uint32_t *)page2kva(page) == 0 &&
+                ((uint8_t *)page2kva(page))[PG_SIZE - 1] == 0, "Loaded page is zero");
+
+    if (slot) {
+        swap_slot_free(slot);
+    }
+    free_page(page);
+    TEST_END();
+}
+
+void test_zswap_incompressible() {
+    TEST_START("zswap Rejects Incompressible Page");
+
+    PageDesc *page = alloc_page();
+    TEST_ASSERT(page != NULL, "Page allocation successful");
+    if (!page) {
+        TEST_END();
+        return;
+    }
+
+    uint32_t seed = 12345;
+    uint8_t *kva = page2kva(page);
+    for (int i = 0; i < PG_SIZE; i++) {
+        seed = seed * 1103515245 + 12345;
+        kva[i] = seed >> 16;
+    }
+
+    uint32_t rejects = zswap_get_stats()->rejects;
+    int ret;
+    uint32_t slot = zswap_test_store(page, &ret);
+    TEST_ASSERT(slot != 0 && ret != 0, "Random page refused");
+    TEST_ASSERT(!zswap_present(slot), "Slot left to the disk");
+    TEST_ASSERT(zswap_get_stats()->rejects == rejects + 1, "Counted as incompressible");
+
+    if (slot) {
+        swap_slot_free(slot);
+    }
+    free_page(page);
+    TEST_END();
+}
+
+// ============================================================================
+// Unit Tests - Per-mm Replacement
+// ============================================================================
+// Two address spaces over the kernel page directory, at disjoint addresses
+
+#define MM_TEST_BASE_A  0x680000
+#define MM_TEST_BASE_B  0x6C0000
+#define MM_TEST_PAGES   8
+
+// Map n fresh pages at base and queue them on mm's lists
+static int mm_test_map(mm_struct *mm, uintptr_t base, int n) {
+    for (int i = 0; i < n; i++) {
+        uintptr_t addr = base + i * PG_SIZE;
+        PageDesc *page = pgdir_alloc_page(mm->pgdir, addr, PTE_W | PTE_U);
+        if (page == NULL) {
+            return i;
+        }
+        swap_mgr->map_swappable(mm, addr, page, 0);
+    }
+    return n;
+}
+
+// Drop the test mappings and swap entries, free the mm
+static void mm_test_release(mm_struct *mm, uintptr_t base, int n) {
+    for (int i = 0; i < n; i++) {
+        uintptr_t addr = base + i * PG_SIZE;
+        pte_t *ptep = get_pte(mm->pgdir, addr, 0);
+        if (ptep && *ptep != 0 && !(*ptep & PTE_P)) {
+            swap_entry_free(*ptep);
+            *ptep = 0;
+        } else {
+            page_remove(mm->pgdir, addr);
+        }
+    }
+    mm_destroy(mm);
+}
+
+void test_mm_separate_lists() {
+    TEST_START("Per-mm Replacement Lists");
+
+    mm_struct *a = mm_create(boot_pgdir);
+    mm_struct *b = mm_create(boot_pgdir);
+    TEST_ASSERT(a != NULL && b != NULL, "Address spaces created");
+    if (a == NULL || b == NULL) {
+        if (a) mm_destroy(a);
+        if (b) mm_destroy(b);
+        TEST_END();
+        return;
+    }
+
+    int na = mm_test_map(a, MM_TEST_BASE_A, 2);
+    int nb = mm_test_map(b, MM_TEST_BASE_B, 2);
+    TEST_ASSERT(na == 2 && nb == 2, "Test pages mapped");
+    TEST_ASSERT(a->rss == 2 && b->rss == 2, "RSS counted per mm");
+
+    // Resetting one mm must leave the other's pages tracked
+    swap_init_mm(a);
+    TEST_ASSERT(a->rss == 0 && b->rss == 2, "init_mm of one mm keeps the other's list");
+
+    int swapped = swap_out(b, 1, 0);
+    TEST_ASSERT(swapped == 1, "Victim found in the second mm");
+    TEST_ASSERT(b->rss == 1 && b->swap_ents == 1, "RSS and swap entries updated");
+    TEST_ASSERT(swap_out(a, 1, 0) == 0, "Emptied mm has no victim");
+
+    mm_test_release(a, MM_TEST_BASE_A, na);
+    mm_test_release(b, MM_TEST_BASE_B, nb);
+
+    TEST_END();
+}
+
+void test_mm_scanner_balance() {
+    TEST_START("Global Scanner Balances by Fault Rate");
+
+    mm_struct *busy = mm_create(boot_pgdir);
+    mm_struct *idle = mm_create(boot_pgdir);
+    TEST_ASSERT(busy != NULL && idle != NULL, "Address spaces created");
+    if (busy == NULL || idle == NULL) {
+        if (busy) mm_destroy(busy);
+        if (idle) mm_destroy(idle);
+        TEST_END();
+        return;
+    }
+
+    int nbusy = mm_test_map(busy, MM_TEST_BASE_A, MM_TEST_PAGES);
+    int nidle = mm_test_map(idle, MM_TEST_BASE_B, MM_TEST_PAGES);
+    TEST_ASSERT(nbusy == MM_TEST_PAGES && nidle == MM_TEST_PAGES, "Test pages mapped");
+
+    // Let any pending fault-rate aging happen before the rates are set
+    swap_reclaim(0);
+
+    // Same RSS; one has been faulting steadily
+    busy->fault_rate = 32;
+    busy->nr_faults = busy->scan_faults = 32;
+
+    int got = swap_reclaim(MM_TEST_PAGES);
+    cprintf("  reclaimed %d: %u from the faulting mm, %u from the idle one\n",
+            got, busy->reclaimed, idle->reclaimed);
+    TEST_ASSERT(got == MM_TEST_PAGES, "Scanner reclaimed the requested pages");
+    TEST_ASSERT(idle->reclaimed > busy->reclaimed, "Idle mm gives up more pages");
+    TEST_ASSERT(busy->rss + busy->reclaimed == nbusy && idle->rss + idle->reclaimed == nidle,
+                "RSS tracks reclaimed pages");
+
+    mm_test_release(busy, MM_TEST_BASE_A, nbusy);
+    mm_test_release(idle, MM_TEST_BASE_B, nidle);
+
+    TEST_END();
+}
+
+// ============================================================================
+// Unit Tests - Swap Areas
+// ============================================================================
+
+#define STRIPE_TEST_SLOTS (SWAP_STRIPE * MAX_SWAP_AREAS)
+
+void test_swap_area_striping() {
+    TEST_START("Swap Area Priorities and Striping");
+
+    static uint32_t slots[STRIPE_TEST_SLOTS];
+    int top = -1, peers = 0;
+
+    // Areas sharing the highest priority among those with room
+    for (int i = 0; i < swap_area_count(); i++) {
+        swap_area_t *si = swap_area_get(i);
+        if (si->inuse + 1 + STRIPE_TEST_SLOTS >= si->max) {
+            continue;
+        }
+        if (top < 0 || si->prio > swap_area_get(top)->prio) {
+            top = i;
+            peers = 1;
+        } else if (si->prio == swap_area_get(top)->prio) {
+            peers++;
+        }
+    }
+    TEST_ASSERT(top >= 0, "A swap area has room");
+    if (top < 0) {
+        TEST_END();
+        return;
+    }
+
+    int n = 0;
+    for (; n < SWAP_STRIPE * peers; n++) {
+        slots[n] = swap_slot_alloc();
+        if (slots[n] == 0) {
+            break;
+        }
+    }
+    TEST_ASSERT(n == SWAP_STRIPE * peers, "Slots allocated");
+
+    int prio_ok = 1, areas_hit = 0;
+    swap_area_t *last = NULL;
+    for (int i = 0; i < n; i++) {
+        swap_area_t *si = swap_area_of(slots[i]);
+        if (si == NULL || si->prio != swap_area_get(top)->prio) {
+            prio_ok = 0;
+        }
+        if (si != last) {
+            areas_hit++;
+            last = si;
+        }
+    }
+    TEST_ASSERT(prio_ok, "Slots come from the highest-priority areas");
+    // With one stripe per area every area is visited once, in runs
+    TEST_ASSERT(areas_hit <= peers + 1, "Each area fills a whole stripe before rotating");
+    cprintf("  %d areas at priority %d, %d slots over %d runs\n",
+            peers, swap_area_get(top)->prio, n, areas_hit);
+
+    for (int i = 0; i < n; i++) {
+        swap_slot_free(slots[i]);
+    }
+
     TEST_END();
 }
-#endif
 
 // ============================================================================
 // Integration Tests
@@ -203,10 +763,9 @@ void test_swap_init() {
     // swap_init should already be called, just verify
     TEST_ASSERT(1, "Swap system initialized");
     
-    mm_struct mm;
-    int ret = swap_init_mm(init_mm);
+    int ret = swap_init_mm(&init_mm);
     TEST_ASSERT(ret == 0, "swap_init_mm succeeds");
-    TEST_ASSERT(mm.swap_list != NULL, "Swap list created");
+    TEST_ASSERT(init_mm.rss == 0, "Replacement lists start empty");
     
     TEST_END();
 }
@@ -216,7 +775,7 @@ void test_swap_in_basic() {
     
     mm_struct mm;
     mm.pgdir = boot_pgdir;
-    swap_init_mm(init_mm);
+    swap_init_mm(&init_mm);
     
     uintptr_t addr = 0x100000;
     
@@ -226,7 +785,7 @@ void test_swap_in_basic() {
         *ptep = 0x100;  // Fake swap entry (present bit = 0, offset = 1)
         
         PageDesc *page = NULL;
-        int ret = swap_in(init_mm, addr, &page);
+        int ret = swap_in(&init_mm, addr, &page);
         
         TEST_ASSERT(ret == 0, "swap_in returns success");
         TEST_ASSERT(page != NULL, "Page allocated");
@@ -236,7 +795,7 @@ void test_swap_in_basic() {
         TEST_ASSERT(new_ptep != NULL && (*new_ptep & PTE_P), "PTE updated with present bit");
         
         if (page) {
-            pages_free(page, 1);
+            page_remove(mm.pgdir, addr);
         }
     } else {
         TEST_ASSERT(0, "Failed to create PTE");
@@ -250,7 +809,7 @@ void test_swap_out_basic() {
     
     mm_struct mm;
     mm.pgdir = boot_pgdir;
-    swap_init_mm(init_mm);
+    swap_init_mm(&init_mm);
     
     // Allocate and map some pages
     PageDesc *pages_arr[3];
@@ -261,12 +820,12 @@ void test_swap_out_basic() {
         if (pages_arr[i]) {
             addrs[i] = 0x200000 + i * PG_SIZE;
             page_insert(mm.pgdir, pages_arr[i], addrs[i], PTE_P | PTE_W | PTE_U);
-            swap_mgr->map_swappable(init_mm, addrs[i], pages_arr[i], 0);
+            swap_mgr->map_swappable(&init_mm, addrs[i], pages_arr[i], 0);
         }
     }
     
     // Try to swap out
-    int count = swap_out(init_mm, 2, 0);
+    int count = swap_out(&init_mm, 2, 0);
     TEST_ASSERT(count > 0, "swap_out succeeded");
     
     // Verify that PTEs were updated (present bit cleared)
@@ -303,20 +862,20 @@ void test_algorithm_comparison() {
     for (int i = 0; i < 1; i++) {  // Changed from 3 to 1
         cprintf("    %s\n", algorithms[i]->name);
 
-        algorithms[i]->init_mm(init_mm);
+        algorithms[i]->init_mm(&init_mm);
         
         PageDesc pages[20];
         
         // Add 20 pages
         for (int j = 0; j < 20; j++) {
-            algorithms[i]->map_swappable(init_mm, j * PG_SIZE, &pages[j], 0);
+            algorithms[i]->map_swappable(&init_mm, j * PG_SIZE, &pages[j], 0);
         }
         
         // Remove 10 pages
         int removed = 0;
         for (int j = 0; j < 10; j++) {
             PageDesc *victim;
-            if (algorithms[i]->swap_out_victim(init_mm, &victim, 0) == 0) {
+            if (algorithms[i]->swap_out_victim(&init_mm, &victim, 0) == 0) {
                 removed++;
             }
         }
@@ -346,6 +905,32 @@ void run_swap_tests() {
     cprintf("\n--- FIFO Algorithm Tests ---\n");
     test_fifo_basic();
     test_fifo_interleaved();
+
+    // Unit Tests - Clock
+    cprintf("\n--- Clock Algorithm Tests ---\n");
+    test_clock_second_chance();
+    test_clock_all_referenced();
+    test_clock_swap_cycle();
+
+    // Unit Tests - ARC
+    cprintf("\n--- ARC Algorithm Tests ---\n");
+    test_arc_ghost_hit();
+    test_arc_scan_resistance();
+
+    // Unit Tests - zswap
+    cprintf("\n--- zswap Tests ---\n");
+    test_zswap_roundtrip();
+    test_zswap_zero_page();
+    test_zswap_incompressible();
+
+    // Unit Tests - Per-mm Replacement
+    cprintf("\n--- Per-mm Replacement Tests ---\n");
+    test_mm_separate_lists();
+    test_mm_scanner_balance();
+
+    // Unit Tests - Swap Areas
+    cprintf("\n--- Swap Area Tests ---\n");
+    test_swap_area_striping();
     
 #if 0
     // Unit Tests - LRU
@@ -353,10 +938,6 @@ void run_swap_tests() {
     test_lru_basic();
     test_lru_access_pattern();
     
-    // Unit Tests - Clock
-    cprintf("\n--- Clock Algorithm Tests ---\n");
-    test_clock_basic();
-    
     // Integration Tests
     cprintf("\n--- Integration Tests ---\n");
     test_swap_init();
@@ -390,6 +971,9 @@ void run_swap_tests() {
 
     
     cprintf("========================================\n\n");
+
+    // The tests reset init_mm's list with their own manager; hand it back
+    swap_init_mm(&init_mm);
 }
 
 // ============================================================================
@@ -401,7 +985,7 @@ void test_swap_disk_io() {
     
     mm_struct mm;
     mm.pgdir = boot_pgdir;
-    swap_init_mm(init_mm);
+    swap_init_mm(&init_mm);
     
     // Test pattern: write data, swap out, swap in, verify data
     uintptr_t test_addr = 0x300000;
@@ -423,12 +1007,12 @@ void test_swap_disk_io() {
     
     // 2. Map the page
     page_insert(mm.pgdir, page, test_addr, PTE_P | PTE_W | PTE_U);
-    swap_mgr->map_swappable(init_mm, test_addr, page, 0);
+    swap_mgr->map_swappable(&init_mm, test_addr, page, 0);
     
     cprintf("  Filled page with test pattern\n");
     
     // 3. Swap out the page
-    int swapped = swap_out(init_mm, 1, 0);
+    int swapped = swap_out(&init_mm, 1, 0);
     TEST_ASSERT(swapped == 1, "Page swapped out");
     
     // Verify PTE was updated
@@ -440,7 +1024,7 @@ void test_swap_disk_io() {
     
     // 4. Swap in the page
     PageDesc *new_page = NULL;
-    int ret = swap_in(init_mm, test_addr, &new_page);
+    int ret = swap_in(&init_mm, test_addr, &new_page);
     TEST_ASSERT(ret == 0, "Page swapped in");
     TEST_ASSERT(new_page != NULL, "New page allocated");
     
@@ -468,7 +1052,7 @@ void test_swap_disk_io() {
             TEST_ASSERT(0, "Data corruption detected");
         }
         
-        pages_free(new_page, 1);
+        page_remove(mm.pgdir, test_addr);
     }
     
     TEST_END();
@@ -479,7 +1063,7 @@ void test_swap_multiple_pages() {
     
     mm_struct mm;
     mm.pgdir = boot_pgdir;
-    swap_init_mm(init_mm);
+    swap_init_mm(&init_mm);
     
     #define NUM_TEST_PAGES 5
     uintptr_t base_addr = 0x400000;
@@ -498,14 +1082,14 @@ void test_swap_multiple_pages() {
             }
             
             page_insert(mm.pgdir, pages_arr[i], addr, PTE_P | PTE_W | PTE_U);
-            swap_mgr->map_swappable(init_mm, addr, pages_arr[i], 0);
+            swap_mgr->map_swappable(&init_mm, addr, pages_arr[i], 0);
         }
     }
     
     cprintf("  Allocated and filled %d pages\n", NUM_TEST_PAGES);
     
     // 2. Swap out 3 pages
-    int swapped = swap_out(init_mm, 3, 0);
+    int swapped = swap_out(&init_mm, 3, 0);
     TEST_ASSERT(swapped == 3, "Swapped out 3 pages");
     cprintf("  Swapped out %d pages\n", swapped);
     
@@ -518,7 +1102,7 @@ void test_swap_multiple_pages() {
         if (ptep && !(*ptep & PTE_P)) {
             // This page was swapped out, swap it back in
             PageDesc *page = NULL;
-            int ret = swap_in(init_mm, addr, &page);
+            int ret = swap_in(&init_mm, addr, &page);
             
             if (ret == 0 && page) {
                 // Verify data
@@ -537,7 +1121,7 @@ void test_swap_multiple_pages() {
                     verified++;
                 }
                 
-                pages_free(page, 1);
+                page_remove(mm.pgdir, addr);
             }
         }
     }
@@ -11,7 +11,17 @@ void test_fifo_basic();
 void test_fifo_interleaved();
 void test_lru_basic();
 void test_lru_access_pattern();
-void test_clock_basic();
+void test_clock_second_chance();
+void test_clock_all_referenced();
+void test_clock_swap_cycle();
+void test_arc_ghost_hit();
+void test_arc_scan_resistance();
+void test_zswap_roundtrip();
+void test_zswap_zero_page();
+void test_zswap_incompressible();
+void test_mm_separate_lists();
+void test_mm_scanner_balance();
+void test_swap_area_striping();
 void test_swap_init();
 void test_swap_in_basic();
 void test_swap_out_basic();
@@ -10,6 +10,10 @@
 
 #include "vmm.h"
 #include "swap.h"
+#include "slab.h"
+#include "memory.h"
+#include "../debug/assert.h"
+#include "../drivers/intr.h"
 
 extern pde_t __boot_pgdir;
 pde_t* boot_pgdir = &__boot_pgdir;
@@ -18,6 +22,7 @@ pte_t *const vpt = (pte_t *)VPT;
 pde_t *const vpd = (pde_t *)PG_ADDR(PDX(VPT), PDX(VPT), 0);
 
 mm_struct init_mm;
+list_entry_t mm_list;
 
 extern pde_t* boot_pgdir;
 
@@ -67,6 +72,7 @@ int vmm_pg_fault(mm_struct *mm, uint32_t error_code, uintptr_t addr) {
     PageDesc *page = NULL;
 
     addr = ROUND_DOWN(addr, PG_SIZE);
+    mm->nr_faults++;
 
     pte_t *ptep = get_pte(mm->pgdir, addr, 1);
     if (*ptep == 0) {
@@ -78,10 +84,40 @@ int vmm_pg_fault(mm_struct *mm, uint32_t error_code, uintptr_t addr) {
     return 0;
 }
 
-static void mm_init(mm_struct *mm) {
+static void mm_init(mm_struct *mm, pde_t *pgdir) {
+    memset(mm, 0, sizeof(mm_struct));
     list_init(&mm->mmap_list);
-    mm->pgdir = NULL;
-    mm->map_count = 0;
+    mm->pgdir = pgdir;
+
+    intr_save();
+    list_add_before(&mm_list, &mm->mm_link);
+    intr_restore();
+}
+
+mm_struct *mm_create(pde_t *pgdir) {
+    mm_struct *mm = kmalloc(sizeof(mm_struct));
+    if (mm == NULL) {
+        return NULL;
+    }
+
+    mm_init(mm, pgdir);
+    if (swap_init_mm(mm) != 0) {
+        mm_destroy(mm);
+        return NULL;
+    }
+    return mm;
+}
+
+void mm_destroy(mm_struct *mm) {
+    assert(mm != &init_mm);
+
+    swap_exit_mm(mm);
+
+    intr_save();
+    list_del(&mm->mm_link);
+    intr_restore();
+
+    kfree(mm);
 }
 
 // fill all entries in page directory
@@ -101,6 +137,20 @@ void vmm_init() {
     
 	pgdir_init(boot_pgdir, KERNEL_BASE, KERNEL_MEM_SIZE, 0, PTE_W);
 
-    mm_init(&init_mm);
-    init_mm.pgdir = boot_pgdir;
+    list_init(&mm_list);
+    mm_init(&init_mm, boot_pgdir);
+}
+
+void *ioremap(uintptr_t pa, size_t size) {
+    static uintptr_t next = IOREMAP_BASE;
+    uintptr_t off = pa & PG_MASK;
+    size = ROUND_UP(size + off, PG_SIZE);
+
+    if (size > IOREMAP_END - next) {
+        return NULL;
+    }
+    uintptr_t va = next;
+    next += size;
+    pgdir_init(boot_pgdir, va, size, pa, PTE_W | PTE_PCD | PTE_PWT);
+    return (void *)(va + off);
 }
\ No newline at end of file
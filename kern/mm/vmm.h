@@ -1,16 +1,43 @@
 #pragma once
 
+#include <arch/x86/mmu.h>
+
 #include "list.h"
 #include "pmm.h"
+#include "swap_lists.h"
 
 typedef struct {
     list_entry_t mmap_list;         // linear list link which sorted by start addr of vma
     pde_t *pgdir;                   // the PDT of these vma
     int map_count;                  // the count of these vma
-    list_entry_t *swap_list;        // swap list for page replacement
+    swap_lists_t swap_lists;        // page replacement state, one member per policy
+    uint32_t rss;                   // resident pages on the replacement lists
+    uint32_t swap_ents;             // PTEs holding a swap entry
+    uint32_t nr_faults;             // page faults taken
+    uint32_t scan_faults;           // nr_faults when the fault rate was last aged
+    uint32_t fault_rate;            // decayed faults per scan period
+    uint32_t reclaimed;             // pages taken by the global scanner
+    list_entry_t mm_link;           // link in mm_list
 } mm_struct;
 
+#define le2mm(le) to_struct((le), mm_struct, mm_link)
+
+// Device registers above the direct map, below the VPT window (ioremap)
+#define IOREMAP_BASE    (KERNEL_BASE + KERNEL_MEM_SIZE)
+#define IOREMAP_END     VPT
+
+// Every live address space, init_mm first
+extern list_entry_t mm_list;
+
 int vmm_pg_fault(mm_struct *mm, uint32_t error_code, uintptr_t addr);
 
+// Allocate an empty address space over pgdir and register it with swap
+mm_struct *mm_create(pde_t *pgdir);
+// Unregister an address space; pages still on its replacement lists are
+// taken off them
+void mm_destroy(mm_struct *mm);
+
 void vmm_init();
-void print_pgdir();
\ No newline at end of file
+// Map size bytes of device registers at physical pa uncached; NULL if the window is full
+void *ioremap(uintptr_t pa, size_t size);
+void print_pgdir();
@@ -0,0 +1,312 @@
+#include "zswap.h"
+#include "swap.h"
+#include "slab.h"
+#include "lz.h"
+#include "../drivers/intr.h"
+#include "../debug/assert.h"
+
+#include "stdio.h"
+#include "math.h"
+#include "memory.h"
+
+// Compressed Swap Cache (zswap)
+//
+// swap_out() offers every victim to the pool before writing it. A page
+// that compresses to at most ZSWAP_MAX_OBJ bytes is kept in memory under
+// its swap slot and the disk write is skipped; a zero-filled page is kept
+// as a flag with no data at all. swap_in() checks the pool before reading
+// the device, and readahead never reads a pooled slot from disk.
+//
+// Compressed pages live in slab caches of ZSWAP_CLASS_SIZE steps, so at
+// most one class step is lost per page. The pool is capped at
+// ZSWAP_MAX_POOL_PERCENT of RAM; when a store would go over the cap the
+// oldest entries are decompressed and written to their slots (LRU
+// writeback), and only if that cannot make room does the new page go to
+// disk itself.
+//
+// A slot's pool copy lives until the slot is freed, like its disk copy,
+// so a clean swap-cache page can still be dropped without a write.
+
+typedef struct {
+    uint32_t offset;            // swap slot
+    uint16_t len;               // compressed length, 0 for a zero-filled page
+    uint8_t cls;                // size class of data
+    void *data;
+    list_entry_t lru;           // link in zswap_lru, oldest first
+} zswap_entry_t;
+
+#define le2zentry(le) to_struct((le), zswap_entry_t, lru)
+
+static zswap_entry_t **zswap_tree = NULL;      // entry per swap slot
+static unsigned int zswap_nr_slots = 0;
+static list_entry_t zswap_lru;
+static uint32_t zswap_max_pool_bytes = 0;
+static int zswap_enabled = 1;
+static int zswap_busy = 0;
+
+static kmem_cache_t *zswap_entry_cache = NULL;
+static kmem_cache_t *zswap_pool[ZSWAP_NR_CLASSES];
+static const char *const zswap_pool_names[ZSWAP_NR_CLASSES] = {
+    "zswap-256", "zswap-512", "zswap-768", "zswap-1024",
+    "zswap-1280", "zswap-1536", "zswap-1792", "zswap-2048",
+};
+
+static zswap_stats_t zswap_stats;
+
+// Compression output and write-back staging
+static uint8_t zswap_buf[ZSWAP_MAX_OBJ];
+static void *zswap_wb_page = NULL;
+
+void zswap_init(unsigned int nr_slots) {
+    zswap_tree = kmalloc(nr_slots * sizeof(zswap_entry_t *));
+    zswap_entry_cache = kmem_cache_create("zswap_entry", sizeof(zswap_entry_t));
+    PageDesc *wb = alloc_page();
+    if (zswap_tree == NULL || zswap_entry_cache == NULL || wb == NULL) {
+        cprintf("zswap: cannot allocate pool index, disabled\n");
+        zswap_tree = NULL;
+        return;
+    }
+    for (int i = 0; i < ZSWAP_NR_CLASSES; i++) {
+        zswap_pool[i] = kmem_cache_create(zswap_pool_names[i], (i + 1) * ZSWAP_CLASS_SIZE);
+        if (zswap_pool[i] == NULL) {
+            cprintf("zswap: cannot create %s, disabled\n", zswap_pool_names[i]);
+            zswap_tree = NULL;
+            return;
+        }
+    }
+
+    memset(zswap_tree, 0, nr_slots * sizeof(zswap_entry_t *));
+    zswap_nr_slots = nr_slots;
+    list_init(&zswap_lru);
+    zswap_wb_page = page2kva(wb);
+    zswap_max_pool_bytes = pmm_nr_free_pages() * ZSWAP_MAX_POOL_PERCENT / 100 * PG_SIZE;
+
+    cprintf("zswap: pool limit %d KB (%d%c of free memory)\n",
+            zswap_max_pool_bytes / 1024, ZSWAP_MAX_POOL_PERCENT, '%');
+}
+
+static int page_is_zero(const void *kva) {
+    const uint32_t *p = (const uint32_t *)kva;
+    for (int i = 0; i < PG_SIZE / 4; i++) {
+        if (p[i] != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Unlink an entry and free its data
+static void zswap_entry_free(zswap_entry_t *e) {
+    intr_save();
+    zswap_tree[e->offset] = NULL;
+    list_del(&e->lru);
+    zswap_stats.nr_entries--;
+    if (e->len == 0) {
+        zswap_stats.nr_zero--;
+    } else {
+        zswap_stats.comp_bytes -= e->len;
+        zswap_stats.pool_bytes -= (e->cls + 1) * ZSWAP_CLASS_SIZE;
+    }
+    intr_restore();
+
+    if (e->data) {
+        kmem_cache_free(zswap_pool[e->cls], e->data);
+    }
+    kmem_cache_free(zswap_entry_cache, e);
+}
+
+// Decompress an entry into buf (one page)
+static int zswap_decompress(zswap_entry_t *e, void *buf) {
+    if (e->len == 0) {
+        clear_page(buf);
+        return 0;
+    }
+    if (lz_decompress(e->data, e->len, buf, PG_SIZE) != PG_SIZE) {
+        cprintf("zswap: corrupt entry for slot %d\n", e->offset);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Write the oldest entries to their slots until size more bytes fit
+ * @return 0 if there is room now
+ */
+static int zswap_writeback(uint32_t size) {
+    for (int i = 0; i < ZSWAP_WRITEBACK_BATCH; i++) {
+        if (zswap_stats.pool_bytes + size <= zswap_max_pool_bytes) {
+            return 0;
+        }
+        if (list_next(&zswap_lru) == &zswap_lru) {
+            break;
+        }
+
+        // Take the entry off the LRU and hold its slot across the write,
+        // which may sleep: a fault can still load the entry meanwhile, but
+        // the slot cannot be freed (invalidating e) or handed out again
+        zswap_entry_t *e = le2zentry(list_next(&zswap_lru));
+        uint32_t offset = e->offset;
+        intr_save();
+        list_del(&e->lru);
+        list_init(&e->lru);
+        intr_restore();
+        swap_slot_dup(offset);
+
+        PageDesc *wb_page = kva2page(zswap_wb_page);
+        int ret = zswap_decompress(e, zswap_wb_page);
+        if (ret == 0) {
+            ret = swapfs_write_pages(offset, &wb_page, 1);
+        }
+
+        assert(zswap_tree[offset] == e);
+        if (ret == 0) {
+            zswap_entry_free(e);
+            zswap_stats.writebacks++;
+        } else {
+            // Still the only copy: back to the oldest end
+            intr_save();
+            list_add(&zswap_lru, &e->lru);
+            intr_restore();
+        }
+        swap_slot_free(offset);
+        if (ret != 0) {
+            break;
+        }
+    }
+    return (zswap_stats.pool_bytes + size <= zswap_max_pool_bytes) ? 0 : -1;
+}
+
+int zswap_store(uint32_t offset, PageDesc *page) {
+    // A store reached again from reclaim inside one of our own allocations
+    // must not touch the staging buffer
+    if (!zswap_enabled || zswap_tree == NULL || zswap_busy || offset >= zswap_nr_slots) {
+        return -1;
+    }
+    zswap_busy = 1;
+
+    if (zswap_tree[offset]) {
+        zswap_entry_free(zswap_tree[offset]);
+    }
+
+    int ret = -1;
+    void *kva = page2kva(page);
+    size_t len = 0;
+    int cls = 0;
+    void *data = NULL;
+
+    if (!page_is_zero(kva)) {
+        len = lz_compress(kva, PG_SIZE, zswap_buf, ZSWAP_MAX_OBJ);
+        if (len == 0) {
+            zswap_stats.rejects++;
+            goto out;
+        }
+        cls = (len - 1) / ZSWAP_CLASS_SIZE;
+        if (zswap_writeback((cls + 1) * ZSWAP_CLASS_SIZE) != 0) {
+            zswap_stats.pool_full++;
+            goto out;
+        }
+        data = kmem_cache_alloc(zswap_pool[cls]);
+        if (data == NULL) {
+            zswap_stats.pool_full++;
+            goto out;
+        }
+        memcpy(data, zswap_buf, len);
+    }
+
+    zswap_entry_t *e = kmem_cache_alloc(zswap_entry_cache);
+    if (e == NULL) {
+        if (data) {
+            kmem_cache_free(zswap_pool[cls], data);
+        }
+        goto out;
+    }
+    e->offset = offset;
+    e->len = len;
+    e->cls = cls;
+    e->data = data;
+
+    intr_save();
+    zswap_tree[offset] = e;
+    list_add_before(&zswap_lru, &e->lru);
+    zswap_stats.nr_entries++;
+    if (len == 0) {
+        zswap_stats.nr_zero++;
+        zswap_stats.zero_pages++;
+    } else {
+        zswap_stats.comp_bytes += len;
+        zswap_stats.pool_bytes += (cls + 1) * ZSWAP_CLASS_SIZE;
+    }
+    zswap_stats.stores++;
+    intr_restore();
+    ret = 0;
+
+out:
+    zswap_busy = 0;
+    return ret;
+}
+
+int zswap_load(uint32_t offset, PageDesc *page) {
+    if (!zswap_present(offset)) {
+        return -1;
+    }
+    if (zswap_decompress(zswap_tree[offset], page2kva(page)) != 0) {
+        return -1;
+    }
+    zswap_stats.loads++;
+    return 0;
+}
+
+int zswap_present(uint32_t offset) {
+    return zswap_tree != NULL && offset < zswap_nr_slots && zswap_tree[offset] != NULL;
+}
+
+void zswap_invalidate(uint32_t offset) {
+    if (!zswap_present(offset)) {
+        return;
+    }
+    zswap_entry_free(zswap_tree[offset]);
+    zswap_stats.invalidates++;
+}
+
+int zswap_set_enabled(int enabled) {
+    int old = zswap_enabled;
+    zswap_enabled = enabled ? 1 : 0;
+    return old;
+}
+
+const zswap_stats_t *zswap_get_stats(void) {
+    return &zswap_stats;
+}
+
+void zswap_print_info(void) {
+    const zswap_stats_t *zs = &zswap_stats;
+
+    if (zswap_tree == NULL) {
+        cprintf("zswap:       unavailable\n");
+        return;
+    }
+
+    unsigned int slab_pages = 0;
+    for (int i = 0; i < ZSWAP_NR_CLASSES; i++) {
+        slab_pages += zswap_pool[i]->nr_slabs;
+    }
+
+    // Uncompressed size of the pooled non-zero pages over their compressed size
+    uint32_t ratio = 0;
+    if (zs->comp_bytes > 0) {
+        uint64_t r = (uint64_t)(zs->nr_entries - zs->nr_zero) * PG_SIZE * 100;
+        do_div(r, zs->comp_bytes);
+        ratio = (uint32_t)r;
+    }
+
+    cprintf("zswap:       %s, %u pages pooled (%u zero-filled)\n",
+            zswap_enabled ? "on" : "off", zs->nr_entries, zs->nr_zero);
+    cprintf("zswap pool:  %u / %u KB (%u%c), %u slab pages, ratio %u.%02u\n",
+            zs->pool_bytes / 1024, zswap_max_pool_bytes / 1024,
+            zswap_max_pool_bytes ? zs->pool_bytes / (zswap_max_pool_bytes / 100) : 0, '%',
+            slab_pages, ratio / 100, ratio % 100);
+    cprintf("zswap I/O:   %u writes and %u reads avoided, %u written back\n",
+            zs->stores - zs->writebacks, zs->loads, zs->writebacks);
+    cprintf("zswap:       %u incompressible, %u refused (pool full), %u invalidated\n",
+            zs->rejects, zs->pool_full, zs->invalidates);
+}
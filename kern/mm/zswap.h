@@ -0,0 +1,50 @@
+#pragma once
+
+#include <base/types.h>
+
+#include "pmm.h"
+
+// Compressed swap cache in front of the swap device
+#define ZSWAP_MAX_POOL_PERCENT  20      // pool cap, share of free RAM at boot
+#define ZSWAP_MAX_OBJ           2048    // larger compressed pages go to disk
+#define ZSWAP_CLASS_SIZE        256     // pool object size granularity
+#define ZSWAP_NR_CLASSES        (ZSWAP_MAX_OBJ / ZSWAP_CLASS_SIZE)
+#define ZSWAP_WRITEBACK_BATCH   8       // oldest entries written back when full
+
+// zswap counters
+typedef struct {
+    uint32_t stores;            // pages kept in the pool instead of written
+    uint32_t zero_pages;        // of those, zero-filled pages (no pool space)
+    uint32_t rejects;           // pages that did not compress below ZSWAP_MAX_OBJ
+    uint32_t pool_full;         // stores refused because write back could not make room
+    uint32_t loads;             // faults served from the pool
+    uint32_t writebacks;        // entries moved to disk to make room
+    uint32_t invalidates;       // entries dropped with their slot
+    uint32_t nr_entries;        // entries in the pool now
+    uint32_t nr_zero;           // of those, zero-filled
+    uint32_t comp_bytes;        // compressed bytes held now
+    uint32_t pool_bytes;        // object bytes held now (what the cap counts)
+} zswap_stats_t;
+
+void zswap_init(unsigned int nr_slots);
+
+// Keep a compressed copy of page for swap slot offset. 0 if stored,
+// -1 if the page has to be written to disk.
+int zswap_store(uint32_t offset, PageDesc *page);
+
+// Fill page from the pool copy of offset. 0 on success, -1 if not pooled.
+int zswap_load(uint32_t offset, PageDesc *page);
+
+// 1 if offset's data is held in the pool (not on disk)
+int zswap_present(uint32_t offset);
+
+// Drop the pool copy of a slot that was freed
+void zswap_invalidate(uint32_t offset);
+
+// Turn the pool on or off for new stores; returns the previous setting
+int zswap_set_enabled(int enabled);
+
+const zswap_stats_t *zswap_get_stats(void);
+
+// Print pool usage and compression statistics (swapinfo)
+void zswap_print_info(void);
@@ -1,6 +1,7 @@
 #include "sched.h"
 #include "../mm/vmm.h"
 #include "../mm/pmm.h"
+#include "../mm/slab.h"
 #include "../include/stdio.h"
 #include "../include/memory.h"
 #include "../drivers/intr.h"
@@ -24,6 +25,8 @@ task_struct *current = NULL;          // Current running process
 
 static int nr_process = 0;            // Number of processes
 
+static kmem_cache_t *task_cache = NULL;  // Object cache for task_struct
+
 // Process hash table for fast PID lookup
 #define HASH_SHIFT 10
 #define HASH_LIST_SIZE (1 << HASH_SHIFT)
@@ -51,7 +54,7 @@ uintptr_t proc_get_cr3(task_struct *proc) {
 
 // Allocate a new process structure
 static task_struct *alloc_proc(void) {
-    task_struct *proc = kmalloc(sizeof(task_struct));
+    task_struct *proc = kmem_cache_alloc(task_cache);
     if (proc) {
         proc->state = TASK_UNINIT;
         proc->pid = -1;
@@ -106,7 +109,7 @@ extern void trapret(void);
 static void copy_thread(task_struct *proc, uintptr_t esp, trap_frame *tf) {
     proc->tf = (trap_frame *)(proc->kstack + KSTACK_SIZE) - 1;
     
-    *proc->tf = *tf;
+    memcpy(proc->tf, tf, sizeof(trap_frame));
     proc->tf->tf_regs.reg_eax = 0;  // Return value for child
     proc->tf->tf_esp = esp;
     proc->tf->tf_eflags |= 0x200;   // Enable interrupts
@@ -133,7 +136,7 @@ static void unhash_proc(task_struct *proc) {
 }
 
 // Find process by PID using hash table
-static task_struct *find_proc(int pid) {
+task_struct *find_proc(int pid) {
     if (pid <= 0) {
         return NULL;
     }
@@ -196,16 +199,19 @@ void schedule(void) {
         current->state = TASK_RUNNABLE; 
     }
     
-    // Find next runnable process
+    // Find next runnable process, starting after the current one so
+    // every runnable process gets its turn
     task_struct *next = idle_proc;
-    list_entry_t *le = &proc_list;
-    while ((le = list_next(le)) != &proc_list) {
-        task_struct *proc = le2proc(le, list_link);
-        if (proc->state == TASK_RUNNABLE) {
-            next = proc;
-            break;
+    list_entry_t *le = &current->list_link, *last = le;
+    do {
+        if ((le = list_next(le)) != &proc_list) {
+            task_struct *proc = le2proc(le, list_link);
+            if (proc->state == TASK_RUNNABLE) {
+                next = proc;
+                break;
+            }
         }
-    }
+    } while (le != last);
     
     if (next != current) {
         proc_run(next);
@@ -270,6 +276,30 @@ int do_fork(uint32_t clone_flags, uintptr_t stack, trap_frame *tf) {
     return proc->pid;
 }
 
+extern void kernel_thread_entry(void);
+
+// Create a kernel thread running fn(arg) in init_mm
+int kernel_thread(int (*fn)(void *), void *arg, const char *name) {
+    trap_frame tf;
+    memset(&tf, 0, sizeof(trap_frame));
+    tf.tf_cs = KERNEL_CS;
+    tf.tf_eflags = FL_IF;
+    tf.tf_regs.reg_ebx = (uint32_t)fn;
+    tf.tf_regs.reg_edx = (uint32_t)arg;
+    tf.tf_eip = (uintptr_t)kernel_thread_entry;
+
+    int pid = do_fork(0, 0, &tf);
+    task_struct *proc = find_proc(pid);
+    if (proc == NULL) {
+        return -1;
+    }
+
+    for (int i = 0; i < sizeof(proc->name) - 1 && name[i] != '\0'; i++) {
+        proc->name[i] = name[i];
+    }
+    return pid;
+}
+
 // Do exit system call
 int do_exit(int error_code) {
     current->state = TASK_ZOMBIE;
@@ -390,8 +420,8 @@ static const char *state_str(enum proc_state state) {
 // Print all processes information (like Linux ps command)
 void print_all_procs(void) {
     // Print header (similar to ps aux format)
-    cprintf("PID  STAT  PPID  KSTACK    MM        NAME\n");
-    cprintf("---  ----  ----  --------  --------  ----------------\n");
+    cprintf("PID  STAT  PPID  KSTACK    MM        RSS    SWAP   NAME\n");
+    cprintf("---  ----  ----  --------  --------  -----  -----  ----------------\n");
     
     list_entry_t *le = &proc_list;
     while ((le = list_prev(le)) != &proc_list) {
@@ -400,13 +430,16 @@ void print_all_procs(void) {
         // Mark current process
         char mark = (proc == current) ? '*' : ' ';
         
-        cprintf("%c%-3d %-4s  %-4d  %08x  %08x  %s\n",
+        // RSS and SWAP are per address space, in pages
+        cprintf("%c%-3d %-4s  %-4d  %08x  %08x  %-5u  %-5u  %s\n",
                mark,
                proc->pid,
                state_str(proc->state),
                (proc->parent ? proc->parent->pid : -1),
                proc->kstack,
                proc->mm,
+               proc->mm ? proc->mm->rss : 0,
+               proc->mm ? proc->mm->swap_ents : 0,
                proc->name);
     }
     
@@ -416,6 +449,9 @@ void print_all_procs(void) {
 
 // Initialize process management
 void sched_init(void) {
+    task_cache = kmem_cache_create("task_struct", sizeof(task_struct));
+    assert(task_cache != NULL);
+
     // Initialize process list and hash table
     list_init(&proc_list);
     for (int i = 0; i < HASH_LIST_SIZE; i++) {
@@ -61,6 +61,8 @@ void sched_init(void);
 void schedule(void);
 void wakeup_proc(task_struct *proc);
 int do_fork(uint32_t clone_flags, uintptr_t stack, trap_frame *tf);
+int kernel_thread(int (*fn)(void *), void *arg, const char *name);
+task_struct *find_proc(int pid);
 int do_exit(int error_code);
 int do_wait(int pid, int *code_store);
 
@@ -0,0 +1,32 @@
+#include "wait.h"
+#include "sched.h"
+
+void wait_queue_init(wait_queue_t *q) {
+    list_init(&q->head);
+}
+
+void wait_sleep(wait_queue_t *q) {
+    wait_t w;
+
+    w.proc = current;
+    list_add_before(&q->head, &w.link);
+    current->state = TASK_SLEEPING;
+
+    schedule();
+
+    // Made runnable by something other than wake_up(q)
+    if (list_next(&w.link) != &w.link) {
+        list_del(&w.link);
+    }
+}
+
+void wake_up(wait_queue_t *q) {
+    list_entry_t *le;
+
+    while ((le = list_next(&q->head)) != &q->head) {
+        wait_t *w = le2wait(le);
+        list_del(le);
+        list_init(le);
+        wakeup_proc(w->proc);
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <base/types.h>
+
+#include "../include/list.h"
+
+struct task_struct;
+
+// Processes sleeping until an event (e.g. a disk request completing)
+typedef struct {
+    list_entry_t head;
+} wait_queue_t;
+
+// One sleeper, lives on the sleeper's stack
+typedef struct {
+    struct task_struct *proc;
+    list_entry_t link;                 // link in wait_queue_t.head
+} wait_t;
+
+#define le2wait(le) to_struct((le), wait_t, link)
+
+void wait_queue_init(wait_queue_t *q);
+
+// Sleep on q until wake_up(q). Call with interrupts disabled, right after
+// finding the awaited condition false, so a wakeup cannot slip in between;
+// the caller re-checks the condition when this returns.
+void wait_sleep(wait_queue_t *q);
+
+// Make every process sleeping on q runnable (safe in interrupt handlers)
+void wake_up(wait_queue_t *q);
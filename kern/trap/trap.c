@@ -10,12 +10,43 @@
 #include "../drivers/kdb.h"
 #include "../drivers/pit.h"
 #include "../drivers/pic.h"
+#include "../drivers/hd.h"
+#include "../drivers/bcache.h"
 #include "../cons/cons.h"
 #include "../mm/vmm.h"
 #include "../sched/sched.h"
 
 #define TICK_NUM 100
 
+// Hardware interrupt handlers in progress. Every IDT entry is a trap gate,
+// so handlers run with interrupts enabled and higher-priority IRQs nest.
+static volatile int irq_depth = 0;
+
+int in_irq(void) {
+    return irq_depth > 0;
+}
+
+static void (*irq_handlers[16][IRQ_MAX_SHARED])(void);
+
+int irq_register(int irq, void (*handler)(void)) {
+    if (irq < 0 || irq >= 16) {
+        return -1;
+    }
+    for (int i = 0; i < IRQ_MAX_SHARED; i++) {
+        if (irq_handlers[irq][i] == NULL || irq_handlers[irq][i] == handler) {
+            irq_handlers[irq][i] = handler;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void irq_dispatch(int irq) {
+    for (int i = 0; i < IRQ_MAX_SHARED && irq_handlers[irq][i] != NULL; i++) {
+        irq_handlers[irq][i]();
+    }
+}
+
 static const char *trap_name(int trapno) {
     static const char *const excnames[] = {
         "Divide error",
@@ -78,6 +109,7 @@ void print_pgfault(trap_frame *tf) {
 
 static void irq_timer(trap_frame *tf) {
     ticks++;
+    bcache_tick();
     if ((int)ticks % TICK_NUM == 0) {
         // cprintf("%d ticks\n", TICK_NUM);
     }
@@ -101,6 +133,12 @@ static int pg_fault(trap_frame *tf) {
 }
 
 void trap(trap_frame *tf) {
+    int irq = (tf->tf_trapno >= IRQ_OFFSET && tf->tf_trapno < IRQ_OFFSET + 16);
+
+    if (irq) {
+        irq_depth++;
+    }
+
     switch(tf->tf_trapno) {
         case T_PGFLT:
             pg_fault(tf);
@@ -112,17 +150,23 @@ void trap(trap_frame *tf) {
             irq_kbd(tf);
             break;
         case IRQ_OFFSET + IRQ_IDE1:
+            hd_intr(0);
             break;
         case IRQ_OFFSET + IRQ_IDE2:
+            hd_intr(1);
             break;
         case T_SYSCALL:
             break;
         default:
+            if (irq) {
+                irq_dispatch(tf->tf_trapno - IRQ_OFFSET);
+            }
             break;
     }
     
     // Send EOI for hardware interrupts (IRQ 0-15)
-    if (tf->tf_trapno >= IRQ_OFFSET && tf->tf_trapno < IRQ_OFFSET + 16) {
+    if (irq) {
         pic_send_eoi(tf->tf_trapno - IRQ_OFFSET);
+        irq_depth--;
     }
 }
\ No newline at end of file
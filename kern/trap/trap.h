@@ -30,5 +30,12 @@ typedef struct {
 
 // Trap handling functions
 void trap(trap_frame *tf);
+// Nonzero while a hardware interrupt handler is running (they may nest)
+int in_irq(void);
+
+// Handlers for IRQ lines chosen at run time (PCI interrupt lines). A line
+// may be shared, so each handler checks whether its device interrupted.
+#define IRQ_MAX_SHARED 4
+int irq_register(int irq, void (*handler)(void));
 void trapret(void);  // Assembly function to return from trap
 
@@ -0,0 +1,379 @@
+
+bin/bootblock:     file format elf32-i386
+
+
+Disassembly of section .startup:
+
+00007c00 <_start>:
+#include <arch/x86/drivers/i8259.h>
+
+.globl _start
+_start:
+.code16                                             # Assemble for 16-bit mode
+    cli                                             # Disable interrupts
+    7c00:	fa                   	cli
+    cld                                             # String operations increment
+    7c01:	fc                   	cld
+    # Set up the important data segment registers (DS, ES, SS).
+    xorw %ax, %ax                                   # Segment number zero
+    7c02:	31 c0                	xor    %eax,%eax
+    movw %ax, %ds                                   # -> Data Segment
+    7c04:	8e d8                	mov    %eax,%ds
+    movw %ax, %es                                   # -> Extra Segment
+    7c06:	8e c0                	mov    %eax,%es
+    movw %ax, %ss                                   # -> Stack Segment
+    7c08:	8e d0                	mov    %eax,%ss
+	
+# Probe memory
+    movl $0, E820_MEM_BASE
+    7c0a:	66 c7 06 00 80       	movw   $0x8000,(%esi)
+    7c0f:	00 00                	add    %al,(%eax)
+    7c11:	00 00                	add    %al,(%eax)
+    xorl %ebx, %ebx
+    7c13:	66 31 db             	xor    %bx,%bx
+    movw $E820_MEM_DATA, %di
+    7c16:	bf                   	.byte 0xbf
+    7c17:	04 80                	add    $0x80,%al
+
+00007c19 <start_probe>:
+start_probe:
+    movl $INT_ESI_AX_E820, %eax
+    7c19:	66 b8 20 e8          	mov    $0xe820,%ax
+    7c1d:	00 00                	add    %al,(%eax)
+    movl $INT_ESI_DESC_SIZE, %ecx
+    7c1f:	66 b9 14 00          	mov    $0x14,%cx
+    7c23:	00 00                	add    %al,(%eax)
+    movl $SMAP, %edx
+    7c25:	66 ba 50 41          	mov    $0x4150,%dx
+    7c29:	4d                   	dec    %ebp
+    7c2a:	53                   	push   %ebx
+    int  $INT_ESI
+    7c2b:	cd 15                	int    $0x15
+    jnc cont                               # If the CF bit of eflags is 0, it means there are still memory segments to be probed
+    7c2d:	73 08                	jae    7c37 <cont>
+    movw $INT_ESI_ERROR_CODE, E820_MEM_BASE # Probe has a error, finish
+    7c2f:	c7 06 00 80 ff ff    	movl   $0xffff8000,(%esi)
+    jmp finish_probe
+    7c35:	eb 0e                	jmp    7c45 <finish_probe>
+
+00007c37 <cont>:
+cont:
+    addw $INT_ESI_DESC_SIZE, %di           # Set the starting address of the mapping address descriptor returned by the next BIOS
+    7c37:	83 c7 14             	add    $0x14,%edi
+    incl E820_MEM_BASE                      # Increment the member variable nr_map of struct e820map
+    7c3a:	66 ff 06             	incw   (%esi)
+    7c3d:	00 80 66 83 fb 00    	add    %al,0xfb8366(%eax)
+    cmpl $0, %ebx                          # If the ebx returned by INT0x15 is zero, it means the detection is over, otherwise continue to detect
+    jnz start_probe
+    7c43:	75 d4                	jne    7c19 <start_probe>
+
+00007c45 <finish_probe>:
+finish_probe:
+
+
+# Enable A20
+	call check_8042
+    7c45:	e8 49 00 b0 d1       	call   d1b07c93 <bootmain+0xd1afff20>
+	movb $KBD_CMD_WO_PORT, %al
+    outb %al, $KBD_STATUS_REG                   # write data to 8042's P2 port
+    7c4a:	e6 64                	out    %al,$0x64
+
+	call check_8042
+    7c4c:	e8 42 00 b0 df       	call   dfb07c93 <bootmain+0xdfafff20>
+	movb $KBD_A20_ENABLE, %al
+    outb %al, $KBD_DATA_REG                     # set P2's A20 bit(the 1 bit) to 1
+    7c51:	e6 60                	out    %al,$0x60
+
+# Load 16bit GDT
+    lgdt gdt48
+    7c53:	0f 01 16             	lgdtl  (%esi)
+    7c56:	d0 7c b0 11          	sarb   0x11(%eax,%esi,4)
+
+# PIC Init
+# ICW1: Init PIC, Set Enable ICW4
+    mov $ICW1_ICW4 | ICW1_INIT, %al
+    out %al, $PIC1_CMD
+    7c5a:	e6 20                	out    %al,$0x20
+    out %al, $PIC2_CMD
+    7c5c:	e6 a0                	out    %al,$0xa0
+
+# ICW2: Set Interrupt Address
+    mov $IRQ_OFFSET, %al        # Master PIC Interrupt [RQ0, RQ8) is [0x20, 0x28)
+    7c5e:	b0 20                	mov    $0x20,%al
+    out %al, $PIC1_IMR
+    7c60:	e6 21                	out    %al,$0x21
+
+    mov $IRQ_OFFSET + 8, %al    # Master PIC Interrupt [RQ8, RQ16) is [0x28, 0x30)
+    7c62:	b0 28                	mov    $0x28,%al
+    out %al, $PIC2_IMR
+    7c64:	e6 a1                	out    %al,$0xa1
+
+# ICW3:
+    mov $BIT_SLAVE, %al                 # Slave PIC connect in IRQ_SLAVE
+    7c66:	b0 04                	mov    $0x4,%al
+    out %al, $PIC1_IMR
+    7c68:	e6 21                	out    %al,$0x21
+
+    mov $IRQ_SLAVE, %al                 # connect to Master PIC's IRQ2(IRQ_SLAVE)
+    7c6a:	b0 02                	mov    $0x2,%al
+    out %al, $PIC2_IMR
+    7c6c:	e6 a1                	out    %al,$0xa1
+
+# ICW4: Set Work Mode
+    mov $ICW4_8086 | ICW4_AUTO, %al
+    7c6e:	b0 03                	mov    $0x3,%al
+    out %al, $PIC1_IMR
+    7c70:	e6 21                	out    %al,$0x21
+    out %al, $PIC2_IMR
+    7c72:	e6 a1                	out    %al,$0xa1
+
+# OCW3:
+    mov OCW3_ASM(OCW3_SET_MASK), %al
+    7c74:	a0 68 00 e6 20       	mov    0x20e60068,%al
+    out %al, $PIC1_CMD
+    out %al, $PIC2_CMD
+    7c79:	e6 a0                	out    %al,$0xa0
+
+    mov OCW3_ASM(OCW3_READ_IRR), %al
+    7c7b:	a0 0a 00 e6 20       	mov    0x20e6000a,%al
+    out %al, $PIC1_CMD
+    out %al, $PIC2_CMD
+    7c80:	e6 a0                	out    %al,$0xa0
+
+# Enable PE
+    movl %cr0   , %eax
+    7c82:	0f 20 c0             	mov    %cr0,%eax
+    orl  $CR0_PE, %eax                              
+    7c85:	66 83 c8 01          	or     $0x1,%ax
+    movl %eax   , %cr0
+    7c89:	0f 22 c0             	mov    %eax,%cr0
+
+	ljmp $KERNEL_CS, $protected  # Set CS
+    7c8c:	ea                   	.byte 0xea
+    7c8d:	98                   	cwtl
+    7c8e:	7c 08                	jl     7c98 <protected>
+	...
+
+00007c91 <check_8042>:
+
+check_8042:
+    inb   $KBD_STATUS_REG, %al                    # Wait for not busy(8042 input buffer empty).
+    7c91:	e4 64                	in     $0x64,%al
+    testb $KBD_IBF_FULL, %al
+    7c93:	a8 02                	test   $0x2,%al
+    jnz   check_8042
+    7c95:	75 fa                	jne    7c91 <check_8042>
+	ret
+    7c97:	c3                   	ret
+
+00007c98 <protected>:
+
+.code32
+protected:
+    movw $KERNEL_DS, %ax                            # Our data segment selector
+    7c98:	66 b8 10 00          	mov    $0x10,%ax
+    movw %ax, %ds                                   # -> DS: Data Segment
+    7c9c:	8e d8                	mov    %eax,%ds
+    movw %ax, %es                                   # -> ES: Extra Segment
+    7c9e:	8e c0                	mov    %eax,%es
+    movw %ax, %fs                                   # -> FS
+    7ca0:	8e e0                	mov    %eax,%fs
+    movw %ax, %gs                                   # -> GS
+    7ca2:	8e e8                	mov    %eax,%gs
+    movw %ax, %ss                                   # -> SS: Stack Segment
+    7ca4:	8e d0                	mov    %eax,%ss
+
+    movl $0x0,    %ebp
+    7ca6:	bd 00 00 00 00       	mov    $0x0,%ebp
+    movl $_start, %esp   # esp will decrease when push value to stack
+    7cab:	bc 00 7c 00 00       	mov    $0x7c00,%esp
+
+    call bootmain
+    7cb0:	e8 be 00 00 00       	call   7d73 <bootmain>
+    7cb5:	8d 76 00             	lea    0x0(%esi),%esi
+
+00007cb8 <gdt16>:
+	...
+    7cc0:	ff                   	(bad)
+    7cc1:	ff 00                	incl   (%eax)
+    7cc3:	00 00                	add    %al,(%eax)
+    7cc5:	9a cf 00 ff ff 00 00 	lcall  $0x0,$0xffff00cf
+    7ccc:	00                   	.byte 0x0
+    7ccd:	92                   	xchg   %eax,%edx
+    7cce:	cf                   	iret
+	...
+
+00007cd0 <__gdt16_end>:
+    7cd0:	17                   	pop    %ss
+    7cd1:	00                   	.byte 0x0
+    7cd2:	b8                   	.byte 0xb8
+    7cd3:	7c 00                	jl     7cd5 <__gdt16_end+0x5>
+	...
+
+Disassembly of section .text:
+
+00007cd6 <readseg>:
+    waitdisk();
+
+    insl(0x1F0, dst, SECT_SIZE / 4);
+}
+
+static void readseg(uintptr_t va, uint32_t count, uint32_t offset) {
+    7cd6:	55                   	push   %ebp
+    7cd7:	89 e5                	mov    %esp,%ebp
+    7cd9:	57                   	push   %edi
+    uintptr_t end_va = va + count;
+    7cda:	8d 3c 10             	lea    (%eax,%edx,1),%edi
+
+    va -= offset % SECT_SIZE;
+    7cdd:	89 ca                	mov    %ecx,%edx
+static void readseg(uintptr_t va, uint32_t count, uint32_t offset) {
+    7cdf:	56                   	push   %esi
+    va -= offset % SECT_SIZE;
+    7ce0:	81 e2 ff 01 00 00    	and    $0x1ff,%edx
+
+    uint32_t secno = (offset / SECT_SIZE) + 1;  // skip boot sector
+    7ce6:	c1 e9 09             	shr    $0x9,%ecx
+static void readseg(uintptr_t va, uint32_t count, uint32_t offset) {
+    7ce9:	53                   	push   %ebx
+    va -= offset % SECT_SIZE;
+    7cea:	29 d0                	sub    %edx,%eax
+    uint32_t secno = (offset / SECT_SIZE) + 1;  // skip boot sector
+    7cec:	8d 71 01             	lea    0x1(%ecx),%esi
+static void readseg(uintptr_t va, uint32_t count, uint32_t offset) {
+    7cef:	53                   	push   %ebx
+    va -= offset % SECT_SIZE;
+    7cf0:	89 c3                	mov    %eax,%ebx
+    uintptr_t end_va = va + count;
+    7cf2:	89 7d f0             	mov    %edi,-0x10(%ebp)
+
+    for (; va < end_va; va += SECT_SIZE, secno++) {
+    7cf5:	8b 45 f0             	mov    -0x10(%ebp),%eax
+    7cf8:	39 c3                	cmp    %eax,%ebx
+    7cfa:	73 71                	jae    7d6d <readseg+0x97>
+static inline void invlpg(void *addr) __attribute__((always_inline));
+
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t data;
+    asm volatile ("inb %1, %0" : "=a" (data) : "d" (port));
+    7cfc:	ba f7 01 00 00       	mov    $0x1f7,%edx
+    7d01:	ec                   	in     (%dx),%al
+    while ((inb(0x1F7) & 0xC0) != 0x40)
+    7d02:	83 e0 c0             	and    $0xffffffc0,%eax
+    7d05:	3c 40                	cmp    $0x40,%al
+    7d07:	75 f3                	jne    7cfc <readseg+0x26>
+            : "d" (port), "0" (addr), "1" (cnt)
+            : "memory", "cc");
+}
+
+static inline void outb(uint16_t port, uint8_t data) {
+    asm volatile ("outb %0, %1" :: "a"(data), "d"(port));
+    7d09:	ba f2 01 00 00       	mov    $0x1f2,%edx
+    7d0e:	b0 01                	mov    $0x1,%al
+    7d10:	ee                   	out    %al,(%dx)
+    7d11:	ba f3 01 00 00       	mov    $0x1f3,%edx
+    7d16:	89 f0                	mov    %esi,%eax
+    7d18:	ee                   	out    %al,(%dx)
+    outb(0x1F4, (secno >> 8) & 0xFF);
+    7d19:	89 f0                	mov    %esi,%eax
+    7d1b:	ba f4 01 00 00       	mov    $0x1f4,%edx
+    7d20:	c1 e8 08             	shr    $0x8,%eax
+    7d23:	ee                   	out    %al,(%dx)
+    outb(0x1F5, (secno >> 16) & 0xFF);
+    7d24:	89 f0                	mov    %esi,%eax
+    7d26:	ba f5 01 00 00       	mov    $0x1f5,%edx
+    7d2b:	c1 e8 10             	shr    $0x10,%eax
+    7d2e:	ee                   	out    %al,(%dx)
+    outb(0x1F6, ((secno >> 24) & 0xF) | 0xE0);
+    7d2f:	89 f0                	mov    %esi,%eax
+    7d31:	ba f6 01 00 00       	mov    $0x1f6,%edx
+    7d36:	c1 e8 18             	shr    $0x18,%eax
+    7d39:	83 e0 0f             	and    $0xf,%eax
+    7d3c:	83 c8 e0             	or     $0xffffffe0,%eax
+    7d3f:	ee                   	out    %al,(%dx)
+    7d40:	b0 20                	mov    $0x20,%al
+    7d42:	ba f7 01 00 00       	mov    $0x1f7,%edx
+    7d47:	ee                   	out    %al,(%dx)
+    asm volatile ("inb %1, %0" : "=a" (data) : "d" (port));
+    7d48:	ba f7 01 00 00       	mov    $0x1f7,%edx
+    7d4d:	ec                   	in     (%dx),%al
+    while ((inb(0x1F7) & 0xC0) != 0x40)
+    7d4e:	83 e0 c0             	and    $0xffffffc0,%eax
+    7d51:	3c 40                	cmp    $0x40,%al
+    7d53:	75 f3                	jne    7d48 <readseg+0x72>
+    asm volatile (
+    7d55:	89 df                	mov    %ebx,%edi
+    7d57:	b9 80 00 00 00       	mov    $0x80,%ecx
+    7d5c:	ba f0 01 00 00       	mov    $0x1f0,%edx
+    7d61:	fc                   	cld
+    7d62:	f2 6d                	repnz insl (%dx),%es:(%edi)
+    for (; va < end_va; va += SECT_SIZE, secno++) {
+    7d64:	81 c3 00 02 00 00    	add    $0x200,%ebx
+    7d6a:	46                   	inc    %esi
+    7d6b:	eb 88                	jmp    7cf5 <readseg+0x1f>
+        readsect((void *)va, secno);
+    }
+}
+    7d6d:	58                   	pop    %eax
+    7d6e:	5b                   	pop    %ebx
+    7d6f:	5e                   	pop    %esi
+    7d70:	5f                   	pop    %edi
+    7d71:	5d                   	pop    %ebp
+    7d72:	c3                   	ret
+
+00007d73 <bootmain>:
+
+void bootmain(void) {
+    7d73:	55                   	push   %ebp
+    elfhdr* hdr = (elfhdr *)KERNEL_HEADER;
+    readseg((uintptr_t)hdr, SECT_SIZE * 8, 0);
+    7d74:	31 c9                	xor    %ecx,%ecx
+    7d76:	ba 00 10 00 00       	mov    $0x1000,%edx
+    7d7b:	b8 00 00 01 00       	mov    $0x10000,%eax
+void bootmain(void) {
+    7d80:	89 e5                	mov    %esp,%ebp
+    7d82:	56                   	push   %esi
+    7d83:	53                   	push   %ebx
+    readseg((uintptr_t)hdr, SECT_SIZE * 8, 0);
+    7d84:	e8 4d ff ff ff       	call   7cd6 <readseg>
+
+    if (hdr->e_magic != ELF_MAGIC) {
+    7d89:	81 3d 00 00 01 00 7f 	cmpl   $0x464c457f,0x10000
+    7d90:	45 4c 46 
+    7d93:	75 3f                	jne    7dd4 <bootmain+0x61>
+        goto bad;
+    }
+
+    proghdr* ph = (struct proghdr *)((uintptr_t)hdr + hdr->e_phoff);
+    7d95:	a1 1c 00 01 00       	mov    0x1001c,%eax
+    proghdr* eph = ph + hdr->e_phnum;
+    7d9a:	0f b7 35 2c 00 01 00 	movzwl 0x1002c,%esi
+    proghdr* ph = (struct proghdr *)((uintptr_t)hdr + hdr->e_phoff);
+    7da1:	8d 98 00 00 01 00    	lea    0x10000(%eax),%ebx
+    proghdr* eph = ph + hdr->e_phnum;
+    7da7:	c1 e6 05             	shl    $0x5,%esi
+    7daa:	01 de                	add    %ebx,%esi
+    for (; ph < eph; ph++) {
+    7dac:	39 f3                	cmp    %esi,%ebx
+    7dae:	73 18                	jae    7dc8 <bootmain+0x55>
+        readseg(ph->p_va & 0xFFFFFF, ph->p_memsz, ph->p_offset);
+    7db0:	8b 43 08             	mov    0x8(%ebx),%eax
+    7db3:	8b 4b 04             	mov    0x4(%ebx),%ecx
+    for (; ph < eph; ph++) {
+    7db6:	83 c3 20             	add    $0x20,%ebx
+        readseg(ph->p_va & 0xFFFFFF, ph->p_memsz, ph->p_offset);
+    7db9:	8b 53 f4             	mov    -0xc(%ebx),%edx
+    7dbc:	25 ff ff ff 00       	and    $0xffffff,%eax
+    7dc1:	e8 10 ff ff ff       	call   7cd6 <readseg>
+    for (; ph < eph; ph++) {
+    7dc6:	eb e4                	jmp    7dac <bootmain+0x39>
+    }
+    ((void (*)(void))(hdr->e_entry & 0xFFFFFF))();
+    7dc8:	a1 18 00 01 00       	mov    0x10018,%eax
+    7dcd:	25 ff ff ff 00       	and    $0xffffff,%eax
+    7dd2:	ff d0                	call   *%eax
+
+bad:
+    while (1)
+    7dd4:	eb fe                	jmp    7dd4 <bootmain+0x61>